@@ -375,6 +375,36 @@ namespace pinpoint {
 		virtual AnnotationPtr GetAnnotations() const = 0;
 	};
 
+	/**
+	 * @brief Metadata known ahead of time, registered in bulk with Agent::RegisterMetadata().
+	 *
+	 * Each entry must match what the application later passes to the tracing API,
+	 * otherwise the first real request still takes the cache-miss path.
+	 */
+	struct MetadataCatalog {
+		struct Api {
+			/// Operation name: the span operation of NewSpan() (API_TYPE_WEB_REQUEST),
+			/// a span event operation (API_TYPE_DEFAULT) or an async operation
+			/// (API_TYPE_INVOCATION).
+			std::string operation;
+			int32_t api_type = API_TYPE_DEFAULT;
+		};
+
+		struct Sql {
+			/// Raw SQL as passed to SpanEvent::SetSqlQuery().
+			std::string query;
+			/// Service type of the span event that runs the query (e.g.
+			/// SERVICE_TYPE_MYSQL_QUERY). It selects the SQL dialect, so the query
+			/// is normalized exactly as SetSqlQuery() will normalize it.
+			int32_t service_type = SERVICE_TYPE_CPP_FUNC;
+		};
+
+		std::vector<Api> apis;
+		std::vector<Sql> sql_queries;
+		/// Error names as passed to SetError(error_name, error_message).
+		std::vector<std::string> error_names;
+	};
+
 	/**
 	 * @brief Interface exposed to application code for creating spans.
 	 */
@@ -408,6 +438,21 @@ namespace pinpoint {
       	virtual SpanPtr NewSpan(std::string_view operation, std::string_view rpc_point, std::string_view method, TraceContextReader& reader) = 0;
       	/// @brief Returns whether the agent is enabled and sampling.
       	virtual bool Enable() = 0;
+      	/**
+      	 * @brief Pre-registers API, SQL and error metadata in one call.
+      	 *
+      	 * Populates the agent's id caches and queues the metadata for the collector
+      	 * as a single batch, so the first requests that use these names hit the
+      	 * cache instead of registering metadata on the request thread. May be called
+      	 * right after CreateAgent(), before the agent is enabled. The caches hold
+      	 * 1024 entries of each kind (APIs, SQL statements, error names); from a
+      	 * larger list only the last 1024 stay cached, and a warning is logged.
+      	 * The default implementation does nothing, so existing Agent
+      	 * implementations keep compiling.
+      	 *
+      	 * @param catalog Operations, SQL statements and error names to register.
+      	 */
+      	virtual void RegisterMetadata(const MetadataCatalog& catalog) {}
       	/// @brief Initiates a graceful shutdown of the agent.
       	virtual void Shutdown() = 0;
   	};
@@ -319,6 +319,26 @@ typedef struct {
     void (*for_each)(void* userdata, pt_callstack_frame_cb callback, void* callback_userdata);
 } pt_callstack_reader_t;
 
+/**
+ * @brief One operation entry for pt_agent_register_metadata().
+ *
+ * Mirrors pinpoint::MetadataCatalog::Api.
+ */
+typedef struct {
+    const char* operation; /**< NUL-terminated operation name; NULL entries are skipped. */
+    int32_t     api_type;  /**< PT_API_TYPE_* the operation is traced with. */
+} pt_api_metadata_t;
+
+/**
+ * @brief One SQL entry for pt_agent_register_metadata().
+ *
+ * Mirrors pinpoint::MetadataCatalog::Sql.
+ */
+typedef struct {
+    const char* query;        /**< NUL-terminated raw SQL; NULL entries are skipped. */
+    int32_t     service_type; /**< PT_SERVICE_TYPE_* of the span event that runs the query. */
+} pt_sql_metadata_t;
+
 /* ========================================================================== */
 /* Global configuration                                                         */
 /* ========================================================================== */
@@ -433,6 +453,29 @@ int pt_agent_is_enabled(pt_agent_t agent);
  */
 void pt_agent_shutdown(pt_agent_t agent);
 
+/**
+ * @brief Pre-registers API, SQL and error metadata in one call.
+ *
+ * Populates the agent's id caches and queues the metadata as a single batch,
+ * so the first requests using these names do not register metadata on the
+ * request thread. May be called right after pt_create_agent(). The caches
+ * hold 1024 entries of each kind; from a larger array only the last 1024 stay
+ * cached, and a warning is logged.
+ *
+ * @param apis         Optional array of operations. May be NULL.
+ * @param apis_count   Number of entries in apis. Values <= 0 are treated as 0.
+ * @param sqls         Optional array of SQL statements. May be NULL.
+ * @param sqls_count   Number of entries in sqls. Values <= 0 are treated as 0.
+ * @param errors       Optional array of error names. May be NULL.
+ * @param errors_count Number of entries in errors. Values <= 0 are treated as 0.
+ *
+ * Mirrors pinpoint::Agent::RegisterMetadata().
+ */
+void pt_agent_register_metadata(pt_agent_t agent,
+                                const pt_api_metadata_t* apis, int apis_count,
+                                const pt_sql_metadata_t* sqls, int sqls_count,
+                                const char* const* errors, int errors_count);
+
 /* ========================================================================== */
 /* Span creation                                                                */
 /* ========================================================================== */
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+
+namespace pinpoint {
+
+    class ActiveRequestRegistry;
+
+    /**
+     * @brief Registration handle embedded in each span that counts as an active request.
+     *
+     * Holds the registry cell claimed by ActiveRequestRegistry::add() until
+     * drop() releases it. Owned by a single span, so it needs no synchronization
+     * of its own.
+     */
+    class ActiveRequestSlot {
+    public:
+        ActiveRequestSlot() = default;
+        ActiveRequestSlot(const ActiveRequestSlot&) = delete;
+        ActiveRequestSlot& operator=(const ActiveRequestSlot&) = delete;
+
+        bool registered() const { return cell_ != nullptr; }
+
+    private:
+        friend class ActiveRequestRegistry;
+        std::atomic<int64_t>* cell_{nullptr};
+    };
+
+    /**
+     * @brief Lock-free registry of the start times of in-flight requests.
+     *
+     * Start times live in fixed cache-line-sized cells grouped into chunks that
+     * are never freed before the registry. add() claims a free cell with one CAS
+     * and drop() releases it with one store, so neither blocks nor allocates once
+     * the registry has grown to the peak number of concurrent requests. Each
+     * thread resumes its search at the cell it last claimed, which is usually
+     * free again and private to it. for_each() reads the cells without taking
+     * any lock; a request added or dropped during the walk may or may not be seen.
+     *
+     * Growing by one chunk is the only step that takes a mutex.
+     */
+    class ActiveRequestRegistry {
+    public:
+        static constexpr size_t kCellsPerChunk = 64;
+        static constexpr size_t kMaxChunks = 1024;
+
+        ActiveRequestRegistry() = default;
+        ~ActiveRequestRegistry() {
+            for (auto& chunk : chunks_) {
+                delete chunk.load(std::memory_order_relaxed);
+            }
+        }
+        ActiveRequestRegistry(const ActiveRequestRegistry&) = delete;
+        ActiveRequestRegistry& operator=(const ActiveRequestRegistry&) = delete;
+
+        /**
+         * @brief Registers a request started at @p start_time under @p slot.
+         *
+         * @return false if @p slot is already registered or the registry is full.
+         */
+        bool add(ActiveRequestSlot& slot, int64_t start_time) {
+            if (slot.registered()) {
+                return false;
+            }
+            auto& cursor = thread_cursor();
+            while (true) {
+                const auto chunk_count = chunk_count_.load(std::memory_order_acquire);
+                const auto cell_count = chunk_count * kCellsPerChunk;
+                for (size_t i = 0; i < cell_count; ++i) {
+                    const auto index = (cursor + i) % cell_count;
+                    auto& cell = cell_at(index);
+                    auto expected = cell.load(std::memory_order_relaxed);
+                    if (expected == kFree &&
+                        cell.compare_exchange_strong(expected, start_time, std::memory_order_relaxed)) {
+                        slot.cell_ = &cell;
+                        cursor = index;
+                        return true;
+                    }
+                }
+                if (!grow(chunk_count)) {
+                    return false;
+                }
+            }
+        }
+
+        /// @brief Releases the cell held by @p slot; no-op if it is not registered.
+        void drop(ActiveRequestSlot& slot) {
+            if (!slot.registered()) {
+                return;
+            }
+            slot.cell_->store(kFree, std::memory_order_relaxed);
+            slot.cell_ = nullptr;
+        }
+
+        /**
+         * @brief Calls @p fn with the start time of every registered request.
+         *
+         * @param fn Callable taking @c int64_t.
+         */
+        template<typename Fn>
+        void for_each(Fn&& fn) const {
+            const auto chunk_count = chunk_count_.load(std::memory_order_acquire);
+            for (size_t c = 0; c < chunk_count; ++c) {
+                const auto* chunk = chunks_[c].load(std::memory_order_acquire);
+                for (const auto& cell : chunk->cells) {
+                    const auto start_time = cell.start_time.load(std::memory_order_relaxed);
+                    if (start_time != kFree) {
+                        fn(start_time);
+                    }
+                }
+            }
+        }
+
+        /// @brief Number of cells allocated so far.
+        size_t capacity() const { return chunk_count_.load(std::memory_order_acquire) * kCellsPerChunk; }
+
+    private:
+        static constexpr int64_t kFree = std::numeric_limits<int64_t>::min();
+
+        // One cell per cache line: a request thread's add/drop never
+        // invalidates a line another thread is registering on.
+        struct alignas(64) Cell {
+            std::atomic<int64_t> start_time{kFree};
+        };
+        struct Chunk {
+            std::array<Cell, kCellsPerChunk> cells{};
+        };
+
+        std::atomic<int64_t>& cell_at(size_t index) {
+            return chunks_[index / kCellsPerChunk].load(std::memory_order_acquire)->cells[index % kCellsPerChunk].start_time;
+        }
+
+        // Returns false once kMaxChunks chunks are in use.
+        bool grow(size_t seen_chunk_count) {
+            std::lock_guard<std::mutex> lock(grow_mutex_);
+            const auto chunk_count = chunk_count_.load(std::memory_order_relaxed);
+            if (chunk_count != seen_chunk_count) {
+                return true;  // another thread grew it; search again
+            }
+            if (chunk_count == kMaxChunks) {
+                return false;
+            }
+            chunks_[chunk_count].store(new Chunk(), std::memory_order_release);
+            chunk_count_.store(chunk_count + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Where the calling thread starts searching. Threads start on distinct
+        // cells and then stick to the cell they last used.
+        static size_t& thread_cursor() {
+            static std::atomic<size_t> next_thread{0};
+            static thread_local size_t cursor = std::numeric_limits<size_t>::max();
+            if (cursor == std::numeric_limits<size_t>::max()) {
+                cursor = next_thread.fetch_add(1, std::memory_order_relaxed);
+            }
+            return cursor;
+        }
+
+        std::array<std::atomic<Chunk*>, kMaxChunks> chunks_{};
+        std::atomic<size_t> chunk_count_{0};
+        std::mutex grow_mutex_{};
+    };
+
+}  // namespace pinpoint
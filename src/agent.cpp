@@ -25,12 +25,19 @@
 #include "logging.h"
 #include "noop.h"
 #include "agent.h"
+#include "cache_file.h"
+#include "sql.h"
 #include "utility.h"
 
 namespace pinpoint {
 
     // Constants
     constexpr int kCacheSize = 1024;
+    constexpr size_t kMaxCachedSqlParametersSize = 1024;
+    // Per-thread normalization buffers above this are released after use:
+    // typical statements stay well below it, ORM-generated ones up to
+    // SQL_NORMALIZE_MAX_LENGTH do not.
+    constexpr size_t kMaxRetainedSqlBufferSize = 16 * 1024;
 
     // Global agent singleton with thread-safe access
     namespace {
@@ -46,6 +53,19 @@ namespace pinpoint {
             static auto* holder = new std::shared_ptr<AgentImpl>();
             return *holder;
         }
+
+        // Span events and RegisterMetadata() normalize with the same
+        // per-dialect normalizer, so both cache the same normalized form.
+        const SqlNormalizer& sql_normalizer(SqlDialect dialect) {
+            static const SqlNormalizer normalizers[] = {
+                SqlNormalizer(SQL_NORMALIZE_MAX_LENGTH, true, SqlDialect::GENERIC),
+                SqlNormalizer(SQL_NORMALIZE_MAX_LENGTH, true, SqlDialect::MYSQL),
+                SqlNormalizer(SQL_NORMALIZE_MAX_LENGTH, true, SqlDialect::POSTGRESQL),
+                SqlNormalizer(SQL_NORMALIZE_MAX_LENGTH, true, SqlDialect::ORACLE),
+                SqlNormalizer(SQL_NORMALIZE_MAX_LENGTH, true, SqlDialect::MSSQL),
+            };
+            return normalizers[static_cast<size_t>(dialect)];
+        }
     }
 
     AgentImpl::AgentImpl(std::shared_ptr<const Config> cfg,
@@ -62,6 +82,10 @@ namespace pinpoint {
         start_time_(to_milli_seconds(std::chrono::system_clock::now())),
         trace_id_sequence_(1) {
 
+        if (grpc_metadata_ && grpc_span_) {
+            grpc_span_->setMetaWatermark(grpc_metadata_->metaWatermark());
+        }
+
         // Snapshot the immutable identity fields once. isReloadable() guarantees
         // they never change for this agent, so the per-request getters below can
         // serve them without touching the atomic runtime_.
@@ -80,6 +104,10 @@ namespace pinpoint {
         error_cache_ = std::make_unique<IdCache>(kCacheSize);
         sql_cache_ = std::make_unique<IdCache>(kCacheSize);
         sql_uid_cache_ = std::make_unique<SqlUidCache>(kCacheSize);
+        sql_query_cache_ = std::make_unique<SqlQueryCache>(kCacheSize);
+        if (cfg) {
+            load_meta_cache_file(*cfg);
+        }
 
         // Initial build: no previous runtime, so every component is created
         // and published together in one atomic store.
@@ -282,6 +310,113 @@ namespace pinpoint {
         apply_config(runtime_.load(), std::move(cfg));
     }
 
+    void AgentImpl::prime_api(std::string_view api_str, int32_t api_type, MetaBatch& batch) const {
+        const auto [id, found] = api_cache_->get(ApiCacheKey{api_str, api_type});
+        if (!found) {
+            batch.push_back(std::make_unique<MetaData>(META_API, id, api_type, api_str));
+        }
+    }
+
+    void AgentImpl::prime_error(std::string_view error_name, MetaBatch& batch) const {
+        const auto [id, found] = error_cache_->get(error_name);
+        if (!found) {
+            batch.push_back(std::make_unique<MetaData>(META_STRING, id, error_name, STRING_META_ERROR));
+        }
+    }
+
+    int32_t AgentImpl::prime_sql(std::string_view sql_query, MetaBatch& batch) const {
+        const auto [id, found] = sql_cache_->get(sql_query);
+        if (!found) {
+            batch.push_back(std::make_unique<MetaData>(META_STRING, id, sql_query, STRING_META_SQL));
+        }
+        return id;
+    }
+
+    SqlUid AgentImpl::prime_sql_uid(std::string_view sql, MetaBatch& batch) const {
+        const auto [uid, found] = sql_uid_cache_->get(sql);
+        if (!found) {
+            batch.push_back(std::make_unique<MetaData>(META_SQL_UID, uid, sql));
+        }
+        return uid;
+    }
+
+    void AgentImpl::prime_sql_query(std::string_view sql_query, SqlDialect dialect, bool sql_uid,
+                                    MetaBatch& batch) const {
+        sql_query = sql_query.substr(0, SQL_NORMALIZE_MAX_LENGTH);
+        const auto result = sql_normalizer(dialect).normalize(sql_query);
+        CachedSqlQuery cached;
+        if (sql_uid) {
+            cached.sql_uid = prime_sql_uid(result.normalized_sql, batch);
+        } else {
+            cached.sql_id = prime_sql(result.normalized_sql, batch);
+        }
+        if (result.parameters.size() > kMaxCachedSqlParametersSize) {
+            return;
+        }
+        cached.parameters = result.parameters;
+        sql_query_cache_->prime(SqlQueryCache::key(sql_query, dialect, sql_uid), std::move(cached));
+    }
+
+    void AgentImpl::load_meta_cache_file(const Config& cfg) try {
+        if (cfg.metadata.cache_dir.empty()) {
+            return;
+        }
+
+        meta_cache_path_ = MetaCacheFile::path_for(cfg.metadata.cache_dir, agent_id_);
+        std::vector<MetaCacheEntry> entries;
+        if (!MetaCacheFile(meta_cache_path_).load(agent_id_, entries)) {
+            return;
+        }
+
+        // Entries are stored least recently used first, so replaying them in
+        // order through get() rebuilds each cache's LRU ordering. Ids are
+        // reassigned and every entry is re-sent under the new start time.
+        restored_meta_.reserve(entries.size());
+        for (const auto& entry : entries) {
+            switch (entry.type) {
+                case MetaCacheEntryType::API:
+                    prime_api(entry.value, entry.api_type, restored_meta_);
+                    break;
+                case MetaCacheEntryType::ERROR:
+                    prime_error(entry.value, restored_meta_);
+                    break;
+                case MetaCacheEntryType::SQL:
+                    prime_sql(entry.value, restored_meta_);
+                    break;
+                case MetaCacheEntryType::SQL_UID:
+                    prime_sql_uid(entry.value, restored_meta_);
+                    break;
+            }
+        }
+        LOG_INFO("restored {} metadata entries from {}", restored_meta_.size(), meta_cache_path_);
+    } catch (const std::exception &e) {
+        LOG_ERROR("failed to load metadata cache file: exception = {}", e.what());
+    }
+
+    void AgentImpl::save_meta_cache_file() const try {
+        if (meta_cache_path_.empty()) {
+            return;
+        }
+
+        std::vector<MetaCacheEntry> entries;
+        api_cache_->for_each([&entries](const ApiCacheStoredKey& key, int32_t) {
+            entries.push_back(MetaCacheEntry{MetaCacheEntryType::API, key.api_type, key.api_str});
+        });
+        error_cache_->for_each([&entries](const std::string& key, int32_t) {
+            entries.push_back(MetaCacheEntry{MetaCacheEntryType::ERROR, 0, key});
+        });
+        sql_cache_->for_each([&entries](const std::string& key, int32_t) {
+            entries.push_back(MetaCacheEntry{MetaCacheEntryType::SQL, 0, key});
+        });
+        sql_uid_cache_->for_each([&entries](const std::string& key, const SqlUid&) {
+            entries.push_back(MetaCacheEntry{MetaCacheEntryType::SQL_UID, 0, key});
+        });
+
+        MetaCacheFile(meta_cache_path_).save(agent_id_, start_time_, entries);
+    } catch (const std::exception &e) {
+        LOG_ERROR("failed to save metadata cache file: exception = {}", e.what());
+    }
+
     void AgentImpl::init_grpc_workers() try {
         grpc_agent_->setAgentService(this);
         grpc_metadata_->setAgentService(this);
@@ -293,6 +428,10 @@ namespace pinpoint {
 
         grpc_agent_->startAgentInfo();
 
+        // Re-register the keys restored from the cache file before the meta
+        // worker starts, so they go out ahead of any new metadata.
+        grpc_metadata_->enqueueMetaBatch(std::move(restored_meta_));
+
         ping_thread_ = std::thread{&GrpcAgent::sendPingWorker, grpc_agent_.get()};
         meta_thread_ = std::thread{&GrpcMetadata::sendMetaWorker, grpc_metadata_.get()};
         span_thread_ = std::thread{&GrpcSpan::sendSpanWorker, grpc_span_.get()};
@@ -300,7 +439,6 @@ namespace pinpoint {
         if (grpc_command_) {
             command_thread_ = std::thread{&GrpcCommand::commandWorker, grpc_command_.get()};
         }
-        url_stat_add_thread_ = std::thread{&UrlStats::addUrlStatsWorker, url_stats_.get()};
         url_stat_send_thread_ = std::thread{&UrlStats::sendUrlStatsWorker, url_stats_.get()};
         agent_stat_thread_ = std::thread{&AgentStats::agentStatsWorker, agent_stats_.get()};
     } catch (const std::exception &e) {
@@ -323,7 +461,6 @@ namespace pinpoint {
 
     void AgentImpl::close_grpc_workers() {
         grpc_agent_->stopAgentInfo();
-        url_stats_->stopAddUrlStatsWorker();
         url_stats_->stopSendUrlStatsWorker();
         agent_stats_->stopAgentStatsWorker();
         grpc_agent_->stopPingWorker();
@@ -375,7 +512,7 @@ namespace pinpoint {
         }
 
         std::thread* workers[] = {
-            &url_stat_add_thread_, &url_stat_send_thread_,
+            &url_stat_send_thread_,
             &agent_stat_thread_, &ping_thread_, &meta_thread_,
             &span_thread_, &stat_thread_, &command_thread_,
         };
@@ -431,7 +568,6 @@ namespace pinpoint {
         safe_detach(span_thread_);
         safe_detach(stat_thread_);
         safe_detach(command_thread_);
-        safe_detach(url_stat_add_thread_);
         safe_detach(url_stat_send_thread_);
         safe_detach(agent_stat_thread_);
     }
@@ -503,6 +639,48 @@ namespace pinpoint {
     	return enabled_;
 	}
 
+    void AgentImpl::RegisterMetadata(const MetadataCatalog& catalog) try {
+        // Not gated on enabled_: pre-registration is meant to run right after
+        // CreateAgent(), before AgentInfo has been acknowledged. The batch waits
+        // in the metadata queue until the worker sends it.
+        if (shutting_down_) {
+            return;
+        }
+
+        const auto cfg = getConfig();
+        const auto cache_size = static_cast<size_t>(kCacheSize);
+        if (catalog.apis.size() > cache_size || catalog.sql_queries.size() > cache_size ||
+            catalog.error_names.size() > cache_size) {
+            LOG_WARN("register metadata: catalog exceeds the metadata cache size {} "
+                     "(apis={}, sqls={}, errors={}); the earliest entries of a larger list are evicted",
+                     kCacheSize, catalog.apis.size(), catalog.sql_queries.size(), catalog.error_names.size());
+        }
+        MetaBatch batch;
+        batch.reserve(catalog.apis.size() + catalog.sql_queries.size() + catalog.error_names.size());
+
+        for (const auto& api : catalog.apis) {
+            prime_api(api.operation, api.api_type, batch);
+        }
+        for (const auto& error_name : catalog.error_names) {
+            prime_error(error_name, batch);
+        }
+
+        // Cache what SpanEventImpl::SetSqlQuery() looks up: the raw statement
+        // and its normalized form, both depending on the span event's dialect.
+        const bool sql_uid = cfg && cfg->sql.enable_sql_stats;
+        for (const auto& sql : catalog.sql_queries) {
+            prime_sql_query(sql.query, sql_dialect_for(sql.service_type), sql_uid, batch);
+        }
+
+        LOG_INFO("register metadata: apis={}, sqls={}, errors={}, new={}",
+                 catalog.apis.size(), catalog.sql_queries.size(), catalog.error_names.size(), batch.size());
+        grpc_metadata_->enqueueMetaBatch(std::move(batch));
+    } catch (const std::exception &e) {
+        LOG_ERROR("failed to register metadata: exception = {}", e.what());
+    } catch (...) {
+        LOG_ERROR("failed to register metadata: unknown exception");
+    }
+
     void AgentImpl::Shutdown() noexcept {
         // Keep *this alive across do_shutdown(): if the global handle holds the
         // last reference, resetting it would destroy the agent mid-call when
@@ -528,6 +706,11 @@ namespace pinpoint {
         try { LOG_INFO("agent shutdown"); } catch (...) {}
         try { stop_config_file_watcher(); } catch (...) {}
         try { close_grpc_workers(); } catch (...) {}
+        try { save_meta_cache_file(); } catch (...) {}
+        try {
+            LOG_INFO("sql query cache: hits={}, misses={}, coalesced misses={}", sql_query_cache_->hits(),
+                     sql_query_cache_->misses(), sql_query_cache_->coalesced_misses());
+        } catch (...) {}
         try { shutdown_logger(); } catch (...) {}
     }
 
@@ -546,9 +729,9 @@ namespace pinpoint {
         }
     }
 
-    void AgentImpl::recordUrlStat(UrlStatEntry stat) const {
+    void AgentImpl::recordUrlStat(const UrlStatEntry& stat) const {
         if (enabled_) {
-            url_stats_->enqueueUrlStats(std::move(stat));
+            url_stats_->recordUrlStat(stat);
         }
     }
 
@@ -639,6 +822,8 @@ namespace pinpoint {
     void AgentImpl::removeCacheSql(const StringMeta& sql_meta) const {
         if (enabled_) {
             sql_cache_->remove(sql_meta.str_val_);
+            // Raw statements normalized to it would keep reusing the id.
+            sql_query_cache_->clear();
         }
     }
 
@@ -667,8 +852,61 @@ namespace pinpoint {
 
     void AgentImpl::removeCacheSqlUid(const SqlUidMeta& sql_uid_meta) const {
         if (enabled_) {
-            sql_uid_cache_->remove(sql_uid_meta.sql_);
+            sql_uid_cache_->remove(sql_uid_meta.sql_, sql_uid_meta.uid_);
+            sql_query_cache_->clear();
+        }
+    }
+
+    CachedSqlQuery AgentImpl::cacheSqlQuery(std::string_view sql_query, SqlDialect dialect, bool sql_uid) const try {
+        if (!enabled_) {
+            return {};
+        }
+
+        // Normalization never reads past SQL_NORMALIZE_MAX_LENGTH, so the key
+        // covers the same prefix; Sql.AsyncNormalize only keeps that much of
+        // the statement, and both modes must map it to the same entry.
+        sql_query = sql_query.substr(0, SQL_NORMALIZE_MAX_LENGTH);
+        const auto key = SqlQueryCache::key(sql_query, dialect, sql_uid);
+        auto [cached, found] = sql_query_cache_->get(key, [this, sql_query, dialect, sql_uid]() {
+            return normalize_sql_query(sql_query, dialect, sql_uid);
+        });
+        // Failures are retried next time, and statements with long literals
+        // rarely repeat verbatim, so neither is worth a cache slot.
+        const bool failed = sql_uid ? !cached.sql_uid.has_value() : cached.sql_id == 0;
+        if (!found && (failed || cached.parameters.size() > kMaxCachedSqlParametersSize)) {
+            sql_query_cache_->remove(key);
+        }
+        return std::move(cached);
+    } catch (const std::exception &e) {
+        LOG_ERROR("failed to cache sql query: exception = {}", e.what());
+        return {};
+    } catch (...) {
+        LOG_ERROR("failed to cache sql query: unknown exception");
+        return {};
+    }
+
+    CachedSqlQuery AgentImpl::normalize_sql_query(std::string_view sql_query, SqlDialect dialect, bool sql_uid) const {
+        const auto& normalizer = sql_normalizer(dialect);
+        // Reused per thread: the metadata caches copy the normalized SQL only
+        // when they insert it, so a statement already known allocates nothing
+        // but its parameters.
+        thread_local SqlNormalizeResult result;
+        normalizer.normalize(sql_query, result);
+
+        CachedSqlQuery cached;
+        if (sql_uid) {
+            cached.sql_uid = cacheSqlUid(result.normalized_sql);
+        } else {
+            cached.sql_id = cacheSql(result.normalized_sql);
+        }
+        cached.parameters.assign(result.parameters);
+
+        // Don't pin the memory of an unusually long statement to the thread.
+        if (result.normalized_sql.capacity() > kMaxRetainedSqlBufferSize ||
+            result.parameters.capacity() > kMaxRetainedSqlBufferSize) {
+            result = SqlNormalizeResult();
         }
+        return cached;
     }
 
     void AgentImpl::recordException(const TraceId& trace_id, int64_t span_id, std::string_view url_template,
@@ -101,6 +101,8 @@ namespace pinpoint {
     	SpanPtr NewSpan(std::string_view operation, std::string_view rpc_point, std::string_view method, TraceContextReader& reader) override;
 		/// @brief Returns whether the agent is enabled for tracing.
 		bool Enable() override;
+		/// @brief Populates the metadata caches from catalog and queues its metadata as one batch.
+		void RegisterMetadata(const MetadataCatalog& catalog) override;
 		/// @brief Initiates a graceful shutdown of the agent.
 		void Shutdown() noexcept override;
 
@@ -124,7 +126,7 @@ namespace pinpoint {
 
     	TraceId generateTraceId() override;
     	void recordSpan(std::unique_ptr<SpanChunk> span) const override;
-    	void recordUrlStat(UrlStatEntry stat) const override;
+    	void recordUrlStat(const UrlStatEntry& stat) const override;
         void recordException(const TraceId& trace_id, int64_t span_id, std::string_view url_template,
                              std::vector<std::unique_ptr<Exception>>&& exceptions) const override;
     	void recordStats(StatsType stats) const override;
@@ -137,6 +139,7 @@ namespace pinpoint {
     	void removeCacheSql(const StringMeta& sql_meta) const override;
     	std::optional<SqlUid> cacheSqlUid(std::string_view sql) const override;
     	void removeCacheSqlUid(const SqlUidMeta& sql_uid_meta) const override;
+    	CachedSqlQuery cacheSqlQuery(std::string_view sql_query, SqlDialect dialect, bool sql_uid) const override;
 
     	bool isStatusFail(int status) const override;
     	void recordServerHeader(HeaderType which, HeaderReader& reader, AnnotationPtr annotation) const override;
@@ -144,6 +147,8 @@ namespace pinpoint {
 
     	AgentStats& getAgentStats() override { return *agent_stats_; }
     	UrlStats& getUrlStats() override { return *url_stats_; }
+    	/// @brief Returns the raw-statement SQL cache, e.g. for its hit and miss counters.
+    	const SqlQueryCache& getSqlQueryCache() const { return *sql_query_cache_; }
 
     private:
 
@@ -167,6 +172,12 @@ namespace pinpoint {
     	std::unique_ptr<IdCache> error_cache_{};
     	std::unique_ptr<IdCache> sql_cache_{};
     	std::unique_ptr<SqlUidCache> sql_uid_cache_{};
+    	std::unique_ptr<SqlQueryCache> sql_query_cache_{};
+    	// Empty unless Metadata.CacheDir is configured.
+    	std::string meta_cache_path_;
+    	// Metadata rebuilt from the cache file, handed to the metadata worker
+    	// in one batch by init_grpc_workers().
+    	std::vector<std::unique_ptr<MetaData>> restored_meta_;
 
     	std::unique_ptr<GrpcAgent> grpc_agent_{};
     	std::unique_ptr<GrpcMetadata> grpc_metadata_{};
@@ -182,7 +193,6 @@ namespace pinpoint {
     	std::thread span_thread_;
     	std::thread stat_thread_;
 		std::thread command_thread_;
-    	std::thread url_stat_add_thread_;
     	std::thread url_stat_send_thread_;
     	std::thread agent_stat_thread_;
 
@@ -213,6 +223,22 @@ namespace pinpoint {
     	                  std::shared_ptr<const Config> cfg);
     	/// @brief Populates rt's HTTP header recorders for server and client.
     	static void build_header_recorders(AgentRuntime& rt, const Config& cfg);
+    	using MetaBatch = std::vector<std::unique_ptr<MetaData>>;
+    	/// @brief Inserts a key into its cache without the enabled_ gate of
+    	/// cacheApi() and friends; on a miss, appends the metadata to batch.
+    	void prime_api(std::string_view api_str, int32_t api_type, MetaBatch& batch) const;
+    	void prime_error(std::string_view error_name, MetaBatch& batch) const;
+    	int32_t prime_sql(std::string_view sql_query, MetaBatch& batch) const;
+    	SqlUid prime_sql_uid(std::string_view sql, MetaBatch& batch) const;
+    	/// @brief Primes the metadata caches and the raw-statement cache for a statement
+    	/// exactly as cacheSqlQuery() would fill them on its first use.
+    	void prime_sql_query(std::string_view sql_query, SqlDialect dialect, bool sql_uid, MetaBatch& batch) const;
+    	CachedSqlQuery normalize_sql_query(std::string_view sql_query, SqlDialect dialect, bool sql_uid) const;
+    	/// @brief Pre-populates the metadata caches from the cache file written
+    	/// by a previous run of this agent, if any.
+    	void load_meta_cache_file(const Config& cfg);
+    	/// @brief Writes the current metadata cache keys to the cache file.
+    	void save_meta_cache_file() const;
     	/// @brief Starts background threads responsible for gRPC communication.
     	void init_grpc_workers();
     	/// @brief Signals all gRPC workers to stop and joins their threads.
@@ -20,6 +20,7 @@
 #include <optional>
 #include <string>
 #include "pinpoint/tracer.h"
+#include "cache.h"
 #include "utility.h"
  
  namespace pinpoint {
@@ -109,11 +110,14 @@
        */
       virtual void recordSpan(std::unique_ptr<SpanChunk> span) const = 0;
       /**
-       * @brief Sends an aggregated URL statistic to the collector.
+       * @brief Aggregates a URL statistic for the collector.
        *
-       * @param stat URL statistic record to be transferred.
+       * The statistic is recorded before the call returns, so the caller's
+       * entry is only borrowed.
+       *
+       * @param stat URL statistic record to be aggregated.
        */
-      virtual void recordUrlStat(UrlStatEntry stat) const = 0;
+      virtual void recordUrlStat(const UrlStatEntry& stat) const = 0;
       /**
        * @brief Reports exceptions captured during span processing.
        */
@@ -164,6 +168,19 @@
       virtual std::optional<SqlUid> cacheSqlUid(std::string_view sql) const = 0;
       /// @brief Removes a previously cached SQL UID entry.
       virtual void removeCacheSqlUid(const SqlUidMeta& sql_uid_meta) const = 0;
+      /**
+       * @brief Normalizes a raw SQL statement and caches it with cacheSql() or cacheSqlUid().
+       *
+       * The result is remembered per raw statement, so repeating the same text
+       * skips normalization.
+       *
+       * @param sql_query Raw SQL statement.
+       * @param dialect Dialect the statement is normalized in (see sql_dialect_for()).
+       * @param sql_uid Whether to cache an SQL UID (Sql.EnableSqlStats) rather than an SQL id.
+       * @return SQL id or UID and the extracted literals; empty when the agent
+       *         is disabled or caching fails.
+       */
+      virtual CachedSqlQuery cacheSqlQuery(std::string_view sql_query, SqlDialect dialect, bool sql_uid) const = 0;
  
       /**
        * @brief Determines whether a HTTP status is considered a failure.
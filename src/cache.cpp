@@ -19,10 +19,54 @@
 
 namespace pinpoint {
 
+    namespace {
+        uint64_t rotl64(uint64_t x, int r) {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        // splitmix64 finalizer
+        uint64_t mix64(uint64_t x) {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+    } // namespace
+
+    RawSqlKey SqlQueryCache::key(std::string_view raw_sql, SqlDialect dialect, bool sql_uid) noexcept {
+        // Two lanes with different constants and update steps, fed the same
+        // words in one pass; the statements are up to 64KB, so this runs at
+        // several GB/s rather than the byte-at-a-time speed of normalization.
+        const auto* p = raw_sql.data();
+        auto n = raw_sql.size();
+        uint64_t hash = 0x9e3779b97f4a7c15ULL;
+        uint64_t check = 0xc2b2ae3d27d4eb4fULL;
+        for (; n >= 8; p += 8, n -= 8) {
+            uint64_t word;
+            std::memcpy(&word, p, sizeof(word));
+            hash = rotl64(hash ^ word, 29) * 0xff51afd7ed558ccdULL;
+            check = (check + word) * 0xc4ceb9fe1a85ec53ULL;
+            check ^= check >> 32;
+        }
+        uint64_t tail = 0;
+        if (n != 0) {
+            // An empty string_view may carry a null data(), and memcpy from
+            // null is undefined even for zero bytes.
+            std::memcpy(&tail, p, n);
+        }
+        const auto length = static_cast<uint64_t>(raw_sql.size());
+        return RawSqlKey{mix64(hash ^ tail ^ length), mix64(check + tail + rotl64(length, 32)), raw_sql.size(), dialect,
+                         sql_uid};
+    }
+
     SqlUidCacheResult SqlUidCache::get(std::string_view key) {
-        // Use the template cache with a lambda generator for new UIDs
-        return cache_.get(key, [&key]() {
-            return generate_sql_uid(key);
+        // The UID is needed for the map hash anyway, so compute it up front and
+        // let the generator hand it back on a miss: one MurmurHash per lookup.
+        return get(key, generate_sql_uid(key));
+    }
+
+    SqlUidCacheResult SqlUidCache::get(std::string_view key, const SqlUid& uid) {
+        return cache_.get(key, SqlUidCacheKeyTraits::hash(uid), [&uid]() {
+            return uid;
         });
     }
 } // namespace pinpoint
@@ -17,9 +17,14 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <shared_mutex>
 #include <string>
 #include <string_view>
@@ -27,6 +32,7 @@
 #include <utility>
 #include <vector>
 
+#include "sql.h"
 #include "utility.h"
 
 namespace pinpoint {
@@ -62,8 +68,13 @@ namespace pinpoint {
 
     struct ApiCacheKeyHash {
         size_t operator()(const ApiCacheKey& key) const noexcept {
-            size_t seed = std::hash<std::string_view>{}(key.api_str);
-            seed ^= std::hash<int32_t>{}(key.api_type) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            return combine(std::hash<std::string_view>{}(key.api_str), key.api_type);
+        }
+
+        /// @brief Mixes the api type into an already computed hash of the api string.
+        static size_t combine(size_t str_hash, int32_t api_type) noexcept {
+            size_t seed = str_hash;
+            seed ^= std::hash<int32_t>{}(api_type) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
             return seed;
         }
     };
@@ -74,13 +85,25 @@ namespace pinpoint {
         }
     };
 
+    /*
+     * KeyTraits contract used by LruCacheImpl:
+     *   LookupKey  - argument type of get()/remove() (non-owning)
+     *   StoredKey  - owned copy kept in the LRU list node
+     *   MapKey     - non-owning view used for equality inside the map
+     *   Equal      - equality over MapKey
+     *   hash(key)  - the one hash computed per lookup; callers that already know
+     *                it may pass it to the precomputed-hash overloads instead
+     */
     struct StringCacheKeyTraits {
         using LookupKey = std::string_view;
         using StoredKey = std::string;
         using MapKey = std::string_view;
-        using Hash = std::hash<MapKey>;
         using Equal = std::equal_to<MapKey>;
 
+        static size_t hash(LookupKey key) noexcept {
+            return std::hash<std::string_view>{}(key);
+        }
+
         static MapKey lookup_key(LookupKey key) noexcept {
             return key;
         }
@@ -98,9 +121,12 @@ namespace pinpoint {
         using LookupKey = ApiCacheKey;
         using StoredKey = ApiCacheStoredKey;
         using MapKey = ApiCacheKey;
-        using Hash = ApiCacheKeyHash;
         using Equal = ApiCacheKeyEqual;
 
+        static size_t hash(LookupKey key) noexcept {
+            return ApiCacheKeyHash{}(key);
+        }
+
         static MapKey lookup_key(LookupKey key) noexcept {
             return key;
         }
@@ -114,6 +140,25 @@ namespace pinpoint {
         }
     };
 
+    /**
+     * @brief Key traits for SqlUidCache.
+     *
+     * The map hash is folded out of the 128-bit MurmurHash3 SqlUid, so a lookup
+     * hashes the SQL text exactly once: the same digest serves as bucket hash and,
+     * on a miss, as the cached value.
+     */
+    struct SqlUidCacheKeyTraits : StringCacheKeyTraits {
+        static size_t hash(LookupKey key) noexcept {
+            return hash(generate_sql_uid(key));
+        }
+
+        static size_t hash(const SqlUid& uid) noexcept {
+            uint64_t folded{};
+            std::memcpy(&folded, uid.data(), sizeof(folded));
+            return static_cast<size_t>(folded);
+        }
+    };
+
     /**
      * @brief Result returned from `SqlUidCache::get`.
      *
@@ -123,20 +168,84 @@ namespace pinpoint {
      */
     using SqlUidCacheResult = LruCacheResult<SqlUid>;
 
+    /**
+     * @brief Metadata of a normalized SQL statement, as cached by SqlQueryCache.
+     *
+     * Only one of sql_id and sql_uid is used, depending on Sql.EnableSqlStats.
+     * An unset one (0 or std::nullopt) means the statement could not be cached.
+     */
+    struct CachedSqlQuery {
+        int32_t sql_id{0};
+        std::optional<SqlUid> sql_uid{};
+        std::string parameters{};  // literals extracted by normalization
+    };
+
+    /**
+     * @brief Fingerprint of a raw SQL statement, used instead of its text.
+     *
+     * hash picks the bucket; a false match also needs the same length and a
+     * collision of the independent check hash. sql_uid keeps SQL id and SQL
+     * UID entries apart when Sql.EnableSqlStats is reloaded, and dialect keeps
+     * apart the same text sent to databases that normalize it differently.
+     */
+    struct RawSqlKey {
+        uint64_t hash;
+        uint64_t check;
+        size_t length;
+        SqlDialect dialect;
+        bool sql_uid;
+    };
+
+    inline bool operator==(const RawSqlKey& lhs, const RawSqlKey& rhs) noexcept {
+        return lhs.hash == rhs.hash && lhs.check == rhs.check && lhs.length == rhs.length &&
+               lhs.dialect == rhs.dialect && lhs.sql_uid == rhs.sql_uid;
+    }
+
+    struct RawSqlKeyTraits {
+        using LookupKey = RawSqlKey;
+        using StoredKey = RawSqlKey;
+        using MapKey = RawSqlKey;
+        using Equal = std::equal_to<RawSqlKey>;
+
+        static size_t hash(LookupKey key) noexcept {
+            return static_cast<size_t>(key.hash);
+        }
+
+        static MapKey lookup_key(LookupKey key) noexcept {
+            return key;
+        }
+
+        static StoredKey store(LookupKey key) noexcept {
+            return key;
+        }
+
+        static MapKey map_key(const StoredKey& key) noexcept {
+            return key;
+        }
+    };
+
     /**
      * @brief Thread-safe LRU cache implementation template.
      *
      * Combines a std::list (LRU ordering) with a std::unordered_map keyed by
      * a non-owning map key from KeyTraits (O(1) lookup, no allocation on the hit path).
+     * The key hash is computed once per call (or supplied by the caller) and
+     * stored alongside the entry, so inserts and evictions never rehash key bytes.
      * Access is guarded by a std::shared_mutex: lookups take a shared lock so
      * cache hits run concurrently. LRU reordering is performed lazily — only once
      * the cache has reached max_size — because no eviction can occur before then,
      * which makes the ordering irrelevant while the cache is still filling up.
+     * With CoalesceMisses, concurrent misses on the same key are coalesced: only
+     * the first caller runs the generator, the others wait for its result
+     * (single-flight). That only pays off for expensive generators; when the
+     * generator is cheaper than the wait, pass false and let racing misses each
+     * generate a value, of which the first one inserted wins.
      *
      * @tparam ValueType Type of values stored in the cache.
      * @tparam KeyTraits Converts lookup keys into owned storage and map keys.
+     * @tparam CoalesceMisses Whether concurrent misses on one key share a generator run.
      */
-    template<typename ValueType, typename KeyTraits = StringCacheKeyTraits>
+    template<typename ValueType, typename KeyTraits = StringCacheKeyTraits, bool CoalesceMisses = true>
     class LruCacheImpl {
     public:
         using LookupKey = typename KeyTraits::LookupKey;
@@ -164,6 +273,9 @@ namespace pinpoint {
          * shared-lock read. Reordering (and the exclusive lock it needs) only kicks
          * in once the cache is full. On a miss the generator runs OUTSIDE any lock,
          * so an expensive generator does not serialize other threads' lookups.
+         * With CoalesceMisses, threads that miss on a key whose generator is
+         * already running wait for that result instead of generating it again,
+         * and report found = true.
          *
          * @param key The key to look up (no allocation on hit).
          * @param generator Function to generate a new value if key not found.
@@ -171,17 +283,38 @@ namespace pinpoint {
          */
         template<typename Generator>
         LruCacheResult<ValueType> get(LookupKey key, Generator&& generator) {
-            const auto map_key = KeyTraits::lookup_key(key);
+            return get(key, KeyTraits::hash(key), std::forward<Generator>(generator));
+        }
+
+        /**
+         * @brief Retrieves or creates a cache entry using a precomputed hash.
+         *
+         * The hash is computed once by the caller and reused for every map
+         * operation of this call (find, insert and the re-resolve after a lock
+         * change), so the key bytes are never rehashed. It must equal
+         * KeyTraits::hash(key); entries looked up with a different hash are
+         * simply not found.
+         *
+         * @param key The key to look up (no allocation on hit).
+         * @param hash KeyTraits::hash(key), computed by the caller.
+         * @param generator Function to generate a new value if key not found.
+         * @return Result containing the value and whether it was found.
+         */
+        template<typename Generator>
+        LruCacheResult<ValueType> get(LookupKey key, size_t hash, Generator&& generator) {
+            const HashedKey map_key{KeyTraits::lookup_key(key), hash};
             bool hit_while_full = false;
+            uint64_t generation = 0;
             {
                 // Fast path: a shared lock lets concurrent hits proceed in parallel.
                 std::shared_lock<std::shared_mutex> lock(mutex_);
+                generation = generation_;
                 const auto it = cache_map_.find(map_key);
                 if (it != cache_map_.end()) {
                     if (cache_map_.size() < max_size_) {
                         // Below capacity: nothing can be evicted, so LRU order does
                         // not matter — skip the splice and keep this a pure read.
-                        return LruCacheResult<ValueType>{it->second->second, true};
+                        return LruCacheResult<ValueType>{it->second->value, true};
                     }
                     hit_while_full = true;
                 }
@@ -197,17 +330,60 @@ namespace pinpoint {
                 const auto it = cache_map_.find(map_key);
                 if (it != cache_map_.end()) {
                     cache_list_.splice(cache_list_.begin(), cache_list_, it->second);
-                    return LruCacheResult<ValueType>{it->second->second, true};
+                    return LruCacheResult<ValueType>{it->second->value, true};
                 }
             }
 
-            // Cache miss: run the (potentially expensive) generator WITHOUT holding
-            // the lock. For SqlUidCache this is a MurmurHash over the full SQL text,
-            // which would otherwise serialize every concurrent lookup.
-            auto new_value = generator();
+            if constexpr (!CoalesceMisses) {
+                auto new_value = generator();
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                if (generation != generation_) {
+                    // clear() ran while generating: the value may be stale.
+                    return LruCacheResult<ValueType>{std::move(new_value), false};
+                }
+                return insert_or_promote(key, hash, std::move(new_value));
+            }
 
-            std::unique_lock<std::shared_mutex> lock(mutex_);
-            return insert_or_promote(key, std::move(new_value));
+            while (true) {
+                std::shared_ptr<InFlight> flight;
+                bool leader = false;
+                {
+                    // Re-check under the exclusive lock: the key may have been
+                    // inserted, or another thread may already be generating it.
+                    std::unique_lock<std::shared_mutex> lock(mutex_);
+                    const auto it = cache_map_.find(map_key);
+                    if (it != cache_map_.end()) {
+                        cache_list_.splice(cache_list_.begin(), cache_list_, it->second);
+                        return LruCacheResult<ValueType>{it->second->value, true};
+                    }
+                    // The in-flight map key views the leader's lookup key, which
+                    // stays alive until the leader erases the entry below.
+                    auto& slot = in_flight_[map_key];
+                    if (slot == nullptr) {
+                        slot = std::make_shared<InFlight>();
+                        slot->generation = generation_;
+                        leader = true;
+                    }
+                    flight = slot;
+                }
+
+                if (leader) {
+                    return generate_and_publish(key, hash, map_key, *flight, std::forward<Generator>(generator));
+                }
+
+                std::unique_lock<std::mutex> wait_lock(flight->mutex);
+                flight->cv.wait(wait_lock, [&flight] { return flight->done; });
+                if (flight->value.has_value()) {
+                    coalesced_misses_.fetch_add(1, std::memory_order_relaxed);
+                    return LruCacheResult<ValueType>{*flight->value, true};
+                }
+                // The leader's generator threw; retry, possibly as the new leader.
+            }
+        }
+
+        /// @brief Number of misses that waited for a concurrent generator instead of running their own.
+        uint64_t coalesced_misses() const noexcept {
+            return coalesced_misses_.load(std::memory_order_relaxed);
         }
 
         /**
@@ -216,16 +392,114 @@ namespace pinpoint {
          * @param key The key to remove.
          */
         void remove(LookupKey key) {
+            remove(key, KeyTraits::hash(key));
+        }
+
+        /**
+         * @brief Removes an entry from the cache using a precomputed hash.
+         *
+         * @param key The key to remove.
+         * @param hash KeyTraits::hash(key), computed by the caller.
+         */
+        void remove(LookupKey key, size_t hash) {
             std::unique_lock<std::shared_mutex> lock(mutex_);
 
-            const auto it = cache_map_.find(KeyTraits::lookup_key(key));
+            const auto it = cache_map_.find(HashedKey{KeyTraits::lookup_key(key), hash});
             if (it != cache_map_.end()) {
                 cache_list_.erase(it->second);
                 cache_map_.erase(it);
             }
         }
 
+        /**
+         * @brief Removes every entry.
+         *
+         * Starts a new generation: generators already running still return
+         * their result to their callers but no longer insert it, and misses
+         * after clear() run a fresh generator instead of waiting for them.
+         */
+        void clear() {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            cache_map_.clear();
+            cache_list_.clear();
+            in_flight_.clear();
+            ++generation_;
+        }
+
+        /**
+         * @brief Visits every entry from least to most recently used.
+         *
+         * Runs under a shared lock, so the visitor must not call back into the
+         * cache. Replaying the visited keys through get() in this order rebuilds
+         * the same LRU ordering.
+         *
+         * @param visitor Called as visitor(const StoredKey&, const ValueType&).
+         */
+        template<typename Visitor>
+        void for_each(Visitor&& visitor) const {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            for (auto it = cache_list_.rbegin(); it != cache_list_.rend(); ++it) {
+                visitor(it->key, it->value);
+            }
+        }
+
     private:
+        struct HashedKey;
+
+        // Result slot shared between the thread generating a missing key and
+        // the threads that missed on the same key while it was running.
+        struct InFlight {
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool done{false};
+            std::optional<ValueType> value;  // empty if the generator threw
+            uint64_t generation{0};          // generation_ when the slot was created
+        };
+
+        /**
+         * @brief Runs the generator as the single-flight leader for a key.
+         *
+         * The generator runs WITHOUT holding mutex_. Its result is inserted
+         * unless clear() ran meanwhile, the in-flight slot is retired, and
+         * waiting followers are woken.
+         */
+        template<typename Generator>
+        LruCacheResult<ValueType> generate_and_publish(LookupKey key, size_t hash, const HashedKey& map_key,
+                                                       InFlight& flight, Generator&& generator) {
+            std::optional<LruCacheResult<ValueType>> result;
+            try {
+                auto new_value = generator();
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                if (flight.generation == generation_) {
+                    result = insert_or_promote(key, hash, std::move(new_value));
+                    in_flight_.erase(map_key);
+                } else {
+                    // clear() dropped the slot; the value may be stale.
+                    result = LruCacheResult<ValueType>{std::move(new_value), false};
+                }
+            } catch (...) {
+                {
+                    std::unique_lock<std::shared_mutex> lock(mutex_);
+                    if (flight.generation == generation_) {
+                        in_flight_.erase(map_key);
+                    }
+                }
+                finish(flight, std::nullopt);
+                throw;
+            }
+            finish(flight, result->value);
+            return *result;
+        }
+
+        static void finish(InFlight& flight, std::optional<ValueType> value) {
+            {
+                std::lock_guard<std::mutex> lock(flight.mutex);
+                flight.value = std::move(value);
+                flight.done = true;
+            }
+            flight.cv.notify_all();
+        }
+
         /**
          * @brief Inserts a freshly generated entry, or promotes an existing one.
          *
@@ -234,21 +508,22 @@ namespace pinpoint {
          * try_emplace and, if so, discard our value and return the existing entry
          * (found = true). Assumes the lock is already held by the caller.
          *
-         * Hashes the key once: try_emplace performs the existence check and the
-         * insert in a single map operation.
+         * The hash travels with the key and is stored in the list node, so neither
+         * the insert nor a later eviction of this entry rehashes the key bytes.
          *
          * @param key The key to insert (copied into storage only when inserting).
+         * @param hash Precomputed hash of key.
          * @param value The freshly generated value (moved).
          */
-        LruCacheResult<ValueType> insert_or_promote(LookupKey key, ValueType&& value) {
+        LruCacheResult<ValueType> insert_or_promote(LookupKey key, size_t hash, ValueType&& value) {
             // Speculatively create the list node first so the map key can be a
             // view into the node's owned key storage (single key allocation).
-            cache_list_.emplace_front(KeyTraits::store(key), std::move(value));
+            cache_list_.push_front(Entry{KeyTraits::store(key), hash, std::move(value)});
             const auto list_it = cache_list_.begin();
 
             std::pair<typename MapType::iterator, bool> inserted;
             try {
-                inserted = cache_map_.try_emplace(KeyTraits::map_key(list_it->first), list_it);
+                inserted = cache_map_.try_emplace(HashedKey{KeyTraits::map_key(list_it->key), hash}, list_it);
             } catch (...) {
                 cache_list_.pop_front();  // Rollback the speculative node
                 throw;
@@ -259,26 +534,53 @@ namespace pinpoint {
                 // our node and promote the existing entry to most-recently-used.
                 cache_list_.pop_front();
                 cache_list_.splice(cache_list_.begin(), cache_list_, inserted.first->second);
-                return LruCacheResult<ValueType>{inserted.first->second->second, true};
+                return LruCacheResult<ValueType>{inserted.first->second->value, true};
             }
 
             // Evict least recently used entry if over capacity
             if (cache_map_.size() > max_size_) {
-                cache_map_.erase(KeyTraits::map_key(cache_list_.back().first));
+                const auto& lru = cache_list_.back();
+                cache_map_.erase(HashedKey{KeyTraits::map_key(lru.key), lru.hash});
                 cache_list_.pop_back();
             }
-            return LruCacheResult<ValueType>{list_it->second, false};
+            return LruCacheResult<ValueType>{list_it->value, false};
         }
 
-        using KeyValuePair = std::pair<typename KeyTraits::StoredKey, ValueType>;
-        using MapType = std::unordered_map<typename KeyTraits::MapKey,
-                                          typename std::list<KeyValuePair>::iterator,
-                                          typename KeyTraits::Hash,
-                                          typename KeyTraits::Equal>;
-        std::list<KeyValuePair> cache_list_{};
+        struct Entry {
+            typename KeyTraits::StoredKey key;
+            size_t hash;
+            ValueType value;
+        };
+
+        // Map key carrying its precomputed hash; the hasher just returns it.
+        struct HashedKey {
+            typename KeyTraits::MapKey key;
+            size_t hash;
+        };
+
+        struct HashedKeyHash {
+            size_t operator()(const HashedKey& key) const noexcept {
+                return key.hash;
+            }
+        };
+
+        struct HashedKeyEqual {
+            bool operator()(const HashedKey& lhs, const HashedKey& rhs) const noexcept {
+                return lhs.hash == rhs.hash && typename KeyTraits::Equal{}(lhs.key, rhs.key);
+            }
+        };
+
+        using MapType = std::unordered_map<HashedKey,
+                                          typename std::list<Entry>::iterator,
+                                          HashedKeyHash,
+                                          HashedKeyEqual>;
+        std::list<Entry> cache_list_{};
         MapType cache_map_{};
+        std::unordered_map<HashedKey, std::shared_ptr<InFlight>, HashedKeyHash, HashedKeyEqual> in_flight_{};
         const size_t max_size_{};
+        uint64_t generation_{0};  // bumped by clear(); guarded by mutex_
         mutable std::shared_mutex mutex_{};
+        std::atomic<uint64_t> coalesced_misses_{0};
     };
 
     /**
@@ -308,7 +610,18 @@ namespace pinpoint {
          * @return CacheResult containing the identifier and whether the entry already existed.
          */
         CacheResult get(LookupKey key) {
-            return cache_.get(key, [this]() {
+            return get(key, hash(key));
+        }
+
+        /**
+         * @brief Looks up or inserts a key identifier with a precomputed hash.
+         *
+         * @param key Key to cache (no allocation on cache hit).
+         * @param key_hash Value of hash(key), e.g. computed once for a static operation name.
+         * @return CacheResult containing the identifier and whether the entry already existed.
+         */
+        CacheResult get(LookupKey key, size_t key_hash) {
+            return cache_.get(key, key_hash, [this]() {
                 return ++id_sequence_;
             });
         }
@@ -322,8 +635,25 @@ namespace pinpoint {
             cache_.remove(key);
         }
 
+        /**
+         * @brief Visits every cached key and its identifier, least recently used first.
+         *
+         * @param visitor Called as visitor(const StoredKey&, int32_t id).
+         */
+        template<typename Visitor>
+        void for_each(Visitor&& visitor) const {
+            cache_.for_each(std::forward<Visitor>(visitor));
+        }
+
+        /// @brief Returns the hash the cache uses for key; pass it to get(key, key_hash).
+        static size_t hash(LookupKey key) noexcept {
+            return KeyTraits::hash(key);
+        }
+
     private:
-        LruCacheImpl<int32_t, KeyTraits> cache_;
+        // Generating an id is a single atomic increment, far cheaper than
+        // waiting on another thread's miss; racing misses just skip an id.
+        LruCacheImpl<int32_t, KeyTraits, false> cache_;
         std::atomic<int32_t> id_sequence_{0};
     };
 
@@ -352,6 +682,18 @@ namespace pinpoint {
          */
         SqlUidCacheResult get(std::string_view key);
 
+        /**
+         * @brief Looks up or inserts an SQL UID entry whose UID is already known.
+         *
+         * The map hash is derived from uid, so no further hashing of the SQL
+         * text happens here.
+         *
+         * @param key Normalized SQL string (no allocation on cache hit).
+         * @param uid generate_sql_uid(key), computed by the caller.
+         * @return Cache result containing UID bytes and whether the entry existed.
+         */
+        SqlUidCacheResult get(std::string_view key, const SqlUid& uid);
+
         /**
          * @brief Removes a cached SQL UID entry.
          *
@@ -361,8 +703,98 @@ namespace pinpoint {
             cache_.remove(key);
         }
 
+        /**
+         * @brief Removes a cached SQL UID entry whose UID is already known.
+         *
+         * @param key Normalized SQL string.
+         * @param uid UID returned for key by get().
+         */
+        void remove(std::string_view key, const SqlUid& uid) {
+            cache_.remove(key, SqlUidCacheKeyTraits::hash(uid));
+        }
+
+        /**
+         * @brief Visits every cached SQL string and its UID, least recently used first.
+         *
+         * @param visitor Called as visitor(const std::string&, const SqlUid&).
+         */
+        template<typename Visitor>
+        void for_each(Visitor&& visitor) const {
+            cache_.for_each(std::forward<Visitor>(visitor));
+        }
+
+    private:
+        // The UID is computed before the lookup for the map hash, so a miss has
+        // nothing left to generate and is not worth coalescing.
+        LruCacheImpl<SqlUid, SqlUidCacheKeyTraits, false> cache_;
+    };
+
+    /**
+     * @brief LRU cache from raw SQL text to its normalized SQL id or UID.
+     *
+     * Repeated identical statements skip normalization and the MurmurHash3 of
+     * the normalized text: a lookup costs one pass of a cheap 128-bit hash
+     * over the raw text, which is not stored. The cached metadata must be
+     * dropped with clear() whenever the SQL metadata caches forget an entry
+     * the collector never received, since a hit would reuse it.
+     */
+    class SqlQueryCache {
+    public:
+        explicit SqlQueryCache(size_t max_size) : cache_(max_size) {}
+        ~SqlQueryCache() = default;
+
+        // Delete copy and move operations
+        SqlQueryCache(const SqlQueryCache&) = delete;
+        SqlQueryCache& operator=(const SqlQueryCache&) = delete;
+        SqlQueryCache(SqlQueryCache&&) = delete;
+        SqlQueryCache& operator=(SqlQueryCache&&) = delete;
+
+        /// @brief Fingerprints @p raw_sql in @p dialect for an SQL id (@p sql_uid false) or SQL UID lookup.
+        static RawSqlKey key(std::string_view raw_sql, SqlDialect dialect, bool sql_uid) noexcept;
+
+        /**
+         * @brief Looks up a statement, normalizing it with @p generator on a miss.
+         *
+         * @param key SqlQueryCache::key() of the raw statement.
+         * @param generator Returns the CachedSqlQuery of the statement.
+         */
+        template<typename Generator>
+        LruCacheResult<CachedSqlQuery> get(const RawSqlKey& key, Generator&& generator) {
+            auto result = cache_.get(key, std::forward<Generator>(generator));
+            (result.found ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+            return result;
+        }
+
+        /// @brief Inserts @p value for @p key unless it is cached; not counted as a hit or miss.
+        void prime(const RawSqlKey& key, CachedSqlQuery value) {
+            cache_.get(key, [&value]() { return std::move(value); });
+        }
+
+        void remove(const RawSqlKey& key) {
+            cache_.remove(key);
+        }
+
+        void clear() {
+            cache_.clear();
+        }
+
+        uint64_t hits() const noexcept {
+            return hits_.load(std::memory_order_relaxed);
+        }
+
+        uint64_t misses() const noexcept {
+            return misses_.load(std::memory_order_relaxed);
+        }
+
+        /// @brief Number of misses that waited for a concurrent normalization of the same statement.
+        uint64_t coalesced_misses() const noexcept {
+            return cache_.coalesced_misses();
+        }
+
     private:
-        LruCacheImpl<SqlUid> cache_;
+        LruCacheImpl<CachedSqlQuery, RawSqlKeyTraits> cache_;
+        std::atomic<uint64_t> hits_{0};
+        std::atomic<uint64_t> misses_{0};
     };
 
 } // namespace pinpoint
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache_file.h"
+#include "logging.h"
+
+namespace pinpoint {
+
+    namespace {
+        constexpr char kMagic[4] = {'P', 'P', 'M', 'C'};
+        constexpr uint32_t kFormatVersion = 1;
+        // Guards against allocating absurd sizes from a corrupted length field.
+        constexpr uint32_t kMaxValueLength = 1024 * 1024;
+
+        struct FileHeader {
+            char magic[4];
+            uint32_t version;
+            int64_t start_time;
+            uint32_t agent_id_length;
+            uint32_t entry_count;
+        };
+
+        // Bounds-checked cursor over the mapped file.
+        class Reader {
+        public:
+            Reader(const char* data, size_t size) : data_(data), size_(size) {}
+
+            template<typename T>
+            bool read(T& out) {
+                if (size_ - pos_ < sizeof(T)) {
+                    return false;
+                }
+                std::memcpy(&out, data_ + pos_, sizeof(T));
+                pos_ += sizeof(T);
+                return true;
+            }
+
+            bool read_bytes(size_t length, std::string_view& out) {
+                if (size_ - pos_ < length) {
+                    return false;
+                }
+                out = std::string_view(data_ + pos_, length);
+                pos_ += length;
+                return true;
+            }
+
+        private:
+            const char* data_;
+            size_t size_;
+            size_t pos_{0};
+        };
+
+        template<typename T>
+        void append(std::string& buffer, const T& value) {
+            buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        // Makes a completed rename durable. Best effort: the new file is
+        // already complete, so a failure only risks seeing the old one.
+        void sync_parent_dir(const std::string& path) {
+            const auto slash = path.find_last_of('/');
+            const std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+            const int fd = ::open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            if (::fsync(fd) != 0) {
+                LOG_WARN("metadata cache file: failed to sync directory {}: {}", dir, std::strerror(errno));
+            }
+            ::close(fd);
+        }
+
+        bool is_valid_type(uint8_t type) {
+            return type >= static_cast<uint8_t>(MetaCacheEntryType::API) &&
+                   type <= static_cast<uint8_t>(MetaCacheEntryType::SQL_UID);
+        }
+
+        bool parse(const char* data, size_t size, std::string_view agent_id,
+                   std::vector<MetaCacheEntry>& entries) {
+            Reader reader(data, size);
+
+            FileHeader header{};
+            if (!reader.read(header) || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+                LOG_WARN("metadata cache file: bad magic, ignoring");
+                return false;
+            }
+            if (header.version != kFormatVersion) {
+                LOG_INFO("metadata cache file: unsupported version {}, ignoring", header.version);
+                return false;
+            }
+
+            std::string_view file_agent_id;
+            if (!reader.read_bytes(header.agent_id_length, file_agent_id)) {
+                return false;
+            }
+            if (file_agent_id != agent_id) {
+                LOG_INFO("metadata cache file: written by agent '{}', ignoring", file_agent_id);
+                return false;
+            }
+
+            std::vector<MetaCacheEntry> parsed;
+            parsed.reserve(header.entry_count);
+            for (uint32_t i = 0; i < header.entry_count; ++i) {
+                uint8_t type{};
+                int32_t api_type{};
+                uint32_t length{};
+                std::string_view value;
+                if (!reader.read(type) || !reader.read(api_type) || !reader.read(length) ||
+                    !is_valid_type(type) || length > kMaxValueLength || !reader.read_bytes(length, value)) {
+                    LOG_WARN("metadata cache file: truncated or corrupt entry {}, ignoring file", i);
+                    return false;
+                }
+                parsed.push_back(MetaCacheEntry{static_cast<MetaCacheEntryType>(type), api_type, std::string(value)});
+            }
+
+            LOG_INFO("metadata cache file: loaded {} entries written at start time {}",
+                     parsed.size(), header.start_time);
+            entries = std::move(parsed);
+            return true;
+        }
+    }
+
+    std::string MetaCacheFile::path_for(std::string_view dir, std::string_view agent_id) {
+        std::string path(dir);
+        if (!path.empty() && path.back() != '/') {
+            path.push_back('/');
+        }
+        for (const char c : agent_id) {
+            const bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                              (c >= '0' && c <= '9') || c == '.' || c == '_' || c == '-';
+            path.push_back(safe ? c : '_');
+        }
+        path.append(".meta");
+        return path;
+    }
+
+    bool MetaCacheFile::load(std::string_view agent_id, std::vector<MetaCacheEntry>& entries) const {
+        const int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno != ENOENT) {
+                LOG_WARN("metadata cache file: failed to open {}: {}", path_, std::strerror(errno));
+            }
+            return false;
+        }
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+
+        const auto size = static_cast<size_t>(st.st_size);
+        void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            LOG_WARN("metadata cache file: failed to map {}: {}", path_, std::strerror(errno));
+            return false;
+        }
+
+        bool loaded = false;
+        try {
+            loaded = parse(static_cast<const char*>(mapped), size, agent_id, entries);
+        } catch (const std::exception& e) {
+            LOG_ERROR("metadata cache file: load exception = {}", e.what());
+        }
+        ::munmap(mapped, size);
+        return loaded;
+    }
+
+    bool MetaCacheFile::save(std::string_view agent_id, int64_t start_time,
+                             const std::vector<MetaCacheEntry>& entries) const {
+        std::string buffer;
+        size_t total = sizeof(FileHeader) + agent_id.size();
+        for (const auto& entry : entries) {
+            total += sizeof(uint8_t) + sizeof(int32_t) + sizeof(uint32_t) + entry.value.size();
+        }
+        buffer.reserve(total);
+
+        FileHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kFormatVersion;
+        header.start_time = start_time;
+        header.agent_id_length = static_cast<uint32_t>(agent_id.size());
+        header.entry_count = static_cast<uint32_t>(entries.size());
+        append(buffer, header);
+        buffer.append(agent_id);
+
+        for (const auto& entry : entries) {
+            append(buffer, static_cast<uint8_t>(entry.type));
+            append(buffer, entry.api_type);
+            append(buffer, static_cast<uint32_t>(entry.value.size()));
+            buffer.append(entry.value);
+        }
+
+        // A unique temporary name: processes sharing an agent id must not
+        // write into, or rename, each other's half-written file.
+        std::string tmp_path = path_ + ".XXXXXX";
+        const int fd = ::mkstemp(tmp_path.data());
+        if (fd < 0) {
+            LOG_WARN("metadata cache file: failed to create {}: {}", tmp_path, std::strerror(errno));
+            return false;
+        }
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        ::fchmod(fd, 0644);
+
+        const char* data = buffer.data();
+        size_t remaining = buffer.size();
+        while (remaining > 0) {
+            const ssize_t written = ::write(fd, data, remaining);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOG_WARN("metadata cache file: failed to write {}: {}", tmp_path, std::strerror(errno));
+                ::close(fd);
+                ::unlink(tmp_path.c_str());
+                return false;
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        // The data must be on disk before the rename makes it visible, or a
+        // crash could leave an empty or truncated file under the final name.
+        if (::fsync(fd) != 0) {
+            LOG_WARN("metadata cache file: failed to sync {}: {}", tmp_path, std::strerror(errno));
+            ::close(fd);
+            ::unlink(tmp_path.c_str());
+            return false;
+        }
+        ::close(fd);
+
+        if (::rename(tmp_path.c_str(), path_.c_str()) != 0) {
+            LOG_WARN("metadata cache file: failed to rename {}: {}", tmp_path, std::strerror(errno));
+            ::unlink(tmp_path.c_str());
+            return false;
+        }
+        sync_parent_dir(path_);
+
+        LOG_INFO("metadata cache file: saved {} entries to {}", entries.size(), path_);
+        return true;
+    }
+
+}  // namespace pinpoint
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pinpoint {
+
+    /**
+     * @brief Kind of metadata entry persisted in a MetaCacheFile.
+     */
+    enum class MetaCacheEntryType : uint8_t {
+        API = 1,
+        ERROR = 2,
+        SQL = 3,
+        SQL_UID = 4
+    };
+
+    /**
+     * @brief One persisted cache key. api_type is only meaningful for API entries.
+     */
+    struct MetaCacheEntry {
+        MetaCacheEntryType type;
+        int32_t api_type;
+        std::string value;
+    };
+
+    /**
+     * @brief On-disk snapshot of the agent's metadata caches for warm restarts.
+     *
+     * The file records the agent id and start time of the agent that wrote it,
+     * followed by the cached API, error, SQL and SQL UID keys in LRU order
+     * (least recently used first). Only keys are stored: numeric ids and UIDs
+     * are reassigned or recomputed on reload, and the metadata is re-sent under
+     * the new agent start time, which the collector requires anyway.
+     *
+     * Loading maps the file read-only and parses it in place. Saving writes a
+     * uniquely named temporary file next to the target, syncs it and renames it
+     * over, so neither a crash mid-save nor a concurrent save by another process
+     * with the same agent id leaves a torn file behind; the last save wins. The format uses native byte order; it is
+     * a host-local cache, not an interchange format.
+     */
+    class MetaCacheFile {
+    public:
+        explicit MetaCacheFile(std::string path) : path_(std::move(path)) {}
+
+        /**
+         * @brief Builds the cache file path for an agent inside a directory.
+         *
+         * Characters outside [A-Za-z0-9._-] in the agent id are replaced by '_'.
+         */
+        static std::string path_for(std::string_view dir, std::string_view agent_id);
+
+        /**
+         * @brief Reads the entries written by a previous run of the same agent.
+         *
+         * @param agent_id Current agent id; files written by another agent are ignored.
+         * @param entries Receives the persisted entries on success.
+         * @return `true` if the file existed, was valid and belonged to agent_id.
+         */
+        bool load(std::string_view agent_id, std::vector<MetaCacheEntry>& entries) const;
+
+        /**
+         * @brief Atomically replaces the file with the given entries.
+         *
+         * The agent calls this only from Shutdown(); a crashed or killed agent
+         * leaves the file of its last clean shutdown in place.
+         *
+         * @return `true` on success.
+         */
+        bool save(std::string_view agent_id, int64_t start_time,
+                  const std::vector<MetaCacheEntry>& entries) const;
+
+        const std::string& path() const { return path_; }
+
+    private:
+        std::string path_;
+    };
+
+}  // namespace pinpoint
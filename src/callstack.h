@@ -81,6 +81,19 @@ namespace pinpoint {
             return stack_;
         }
 
+        /**
+         * @brief Replaces the frames with a single marker frame.
+         *
+         * The marker keeps the top frame's module, which is sent as the
+         * exception class name, and carries @p marker as its function.
+         */
+        void collapse(std::string_view marker) {
+            std::string module = stack_.empty() ? std::string() : std::move(stack_[0].module);
+            stack_.clear();
+            stack_.shrink_to_fit();
+            stack_.emplace_back(StackFrame{std::move(module), std::string(marker), std::string(), 0});
+        }
+
         /**
          * @brief Convenience accessor for the module name of the top frame.
          */
@@ -114,6 +127,10 @@ namespace pinpoint {
          * @brief Returns a reference to the captured call stack.
          */
         const CallStack& getCallStack() const { return *callstack_; }
+        /**
+         * @brief Replaces the call stack frames with a single marker frame.
+         */
+        void collapseCallStack(std::string_view marker) { callstack_->collapse(marker); }
         
         static std::atomic<int32_t> exception_id_gen;
 
@@ -29,6 +29,7 @@
 #include <memory>
 #include <sstream>
 #include <algorithm>
+#include <functional>
 #include <tuple>
 
 #include "absl/strings/str_cat.h"
@@ -257,6 +258,20 @@ namespace pinpoint {
         return default_value;
     }
 
+    static std::vector<int> get_int_vector(const YAML::Node& yaml, std::string_view cname,
+                                           std::vector<int> default_value) {
+        try {
+            if (yaml[cname]) {
+                return yaml[cname].as<std::vector<int>>();
+            }
+        } catch (const YAML::Exception& e) {
+            LOG_WARN("Failed to read '{}' as int vector: {}. Using default value",
+                     std::string(cname), e.what());
+        }
+
+        return default_value;
+    }
+
     static int get_int(const YAML::Node& yaml, std::string_view cname, int default_value) {
         try {
             if (yaml[cname]) {
@@ -341,6 +356,7 @@ namespace pinpoint {
             config.stat.enable = get_boolean(stat, "Enable", true);
             config.stat.batch_count = get_int(stat, "BatchCount", defaults::STAT_BATCH_COUNT);
             config.stat.collect_interval = get_int(stat, "BatchInterval", defaults::STAT_INTERVAL_MS);
+            config.stat.retained_batches = get_int(stat, "RetainedBatches", defaults::STAT_RETAINED_BATCHES);
         }
 
         if (auto& http = yaml["Http"]) {
@@ -349,6 +365,10 @@ namespace pinpoint {
             config.http.url_stat.enable_trim_path = get_boolean(http, "UrlStatEnableTrimPath", true);
             config.http.url_stat.trim_path_depth = get_int(http, "UrlStatTrimPathDepth", 1);
             config.http.url_stat.method_prefix = get_boolean(http, "UrlStatMethodPrefix", false);
+            config.http.url_stat.percentile_bounds = get_int_vector(http, "UrlStatPercentileBounds", {});
+            config.http.url_stat.heavy_hitter = get_boolean(http, "UrlStatHeavyHitter", false);
+            config.http.url_stat.tick_interval_ms = get_int(http, "UrlStatTickIntervalMs", defaults::HTTP_URL_STAT_TICK_INTERVAL_MS);
+            config.http.url_stat.send_interval_ms = get_int(http, "UrlStatSendIntervalMs", defaults::HTTP_URL_STAT_SEND_INTERVAL_MS);
 
             if (auto& srv = http["Server"]) {
                 config.http.server.status_errors = get_string_vector(srv, "StatusCodeErrors", {"5xx"});
@@ -385,6 +405,7 @@ namespace pinpoint {
                 config.span.batch.flush_interval_ms = get_int(batch, "FlushIntervalMs", defaults::SPAN_BATCH_FLUSH_INTERVAL_MS);
                 config.span.batch.collect_deadline_ms = get_int(batch, "CollectDeadlineMs", defaults::SPAN_BATCH_COLLECT_DEADLINE_MS);
                 config.span.batch.max_concurrent_requests = get_int(batch, "MaxConcurrentRequests", defaults::SPAN_BATCH_MAX_CONCURRENT_REQUESTS);
+                config.span.batch.metadata_barrier_timeout_ms = get_int(batch, "MetadataBarrierTimeoutMs", defaults::SPAN_BATCH_METADATA_BARRIER_TIMEOUT_MS);
             }
         }
 
@@ -404,6 +425,14 @@ namespace pinpoint {
         if (auto& sql = yaml["Sql"]) {
             config.sql.max_bind_args_size = get_int(sql, "MaxBindArgsSize", defaults::SQL_MAX_BIND_ARGS_SIZE);
             config.sql.enable_sql_stats = get_boolean(sql, "EnableSqlStats", false);
+            config.sql.async_normalize = get_boolean(sql, "AsyncNormalize", false);
+        }
+
+        if (auto& metadata = yaml["Metadata"]) {
+            config.metadata.cache_dir = get_string(metadata, "CacheDir", "");
+            config.metadata.max_concurrent_requests = get_int(metadata, "MaxConcurrentRequests", defaults::METADATA_MAX_CONCURRENT_REQUESTS);
+            config.metadata.exception_dedup_interval_ms = get_int(metadata, "ExceptionDedupIntervalMs", defaults::METADATA_EXCEPTION_DEDUP_INTERVAL_MS);
+            config.metadata.exception_max_unique_stacks = get_int(metadata, "ExceptionMaxUniqueStacks", defaults::METADATA_EXCEPTION_MAX_UNIQUE_STACKS);
         }
 
         config.enable_callstack_trace = get_boolean(yaml, "EnableCallstackTrace", false);
@@ -537,6 +566,9 @@ namespace pinpoint {
         if(auto e = get_env(env::STAT_BATCH_INTERVAL)) {
             config.stat.collect_interval = safe_env_stoi(e.name.c_str(), e.value, defaults::STAT_INTERVAL_MS);
         }
+        if(auto e = get_env(env::STAT_RETAINED_BATCHES)) {
+            config.stat.retained_batches = safe_env_stoi(e.name.c_str(), e.value, defaults::STAT_RETAINED_BATCHES);
+        }
 
         if(auto e = get_env(env::SAMPLING_TYPE)) {
             config.sampling.type = std::string(e.value);
@@ -578,6 +610,9 @@ namespace pinpoint {
         if(auto e = get_env(env::SPAN_BATCH_MAX_CONCURRENT_REQUESTS)) {
             config.span.batch.max_concurrent_requests = safe_env_stoi(e.name.c_str(), e.value, defaults::SPAN_BATCH_MAX_CONCURRENT_REQUESTS);
         }
+        if(auto e = get_env(env::SPAN_BATCH_METADATA_BARRIER_TIMEOUT_MS)) {
+            config.span.batch.metadata_barrier_timeout_ms = safe_env_stoi(e.name.c_str(), e.value, defaults::SPAN_BATCH_METADATA_BARRIER_TIMEOUT_MS);
+        }
         if(auto e = get_env(env::AGENT_INFO_REFRESH_INTERVAL_MS)) {
             config.agent_info.refresh_interval_ms = safe_env_stoi(e.name.c_str(), e.value, defaults::AGENT_INFO_REFRESH_INTERVAL_MS);
         }
@@ -624,6 +659,27 @@ namespace pinpoint {
         if(auto e = get_env(env::HTTP_URL_STAT_METHOD_PREFIX)) {
             config.http.url_stat.method_prefix = safe_env_stob(e.name.c_str(), e.value, false);
         }
+        if(auto e = get_env(env::HTTP_URL_STAT_PERCENTILE_BOUNDS)) {
+            const std::vector<std::string> parts = absl::StrSplit(e.value, ',', absl::SkipEmpty());
+            std::vector<int> bounds;
+            for (const auto& part : parts) {
+                if (const auto bound = stoi_(part)) {
+                    bounds.push_back(*bound);
+                } else {
+                    LOG_WARN("Invalid integer value '{}' in environment variable '{}'. Ignored", part, e.name);
+                }
+            }
+            config.http.url_stat.percentile_bounds = std::move(bounds);
+        }
+        if(auto e = get_env(env::HTTP_URL_STAT_HEAVY_HITTER)) {
+            config.http.url_stat.heavy_hitter = safe_env_stob(e.name.c_str(), e.value, false);
+        }
+        if(auto e = get_env(env::HTTP_URL_STAT_TICK_INTERVAL_MS)) {
+            config.http.url_stat.tick_interval_ms = safe_env_stoi(e.name.c_str(), e.value, defaults::HTTP_URL_STAT_TICK_INTERVAL_MS);
+        }
+        if(auto e = get_env(env::HTTP_URL_STAT_SEND_INTERVAL_MS)) {
+            config.http.url_stat.send_interval_ms = safe_env_stoi(e.name.c_str(), e.value, defaults::HTTP_URL_STAT_SEND_INTERVAL_MS);
+        }
 
         if(auto e = get_env(env::HTTP_SERVER_STATUS_CODE_ERRORS)) {
             config.http.server.status_errors = absl::StrSplit(e.value, ',');
@@ -659,6 +715,21 @@ namespace pinpoint {
         if(auto e = get_env(env::SQL_ENABLE_SQL_STATS)) {
             config.sql.enable_sql_stats = safe_env_stob(e.name.c_str(), e.value, false);
         }
+        if(auto e = get_env(env::SQL_ASYNC_NORMALIZE)) {
+            config.sql.async_normalize = safe_env_stob(e.name.c_str(), e.value, false);
+        }
+        if(auto e = get_env(env::METADATA_CACHE_DIR)) {
+            config.metadata.cache_dir = e.value;
+        }
+        if(auto e = get_env(env::METADATA_MAX_CONCURRENT_REQUESTS)) {
+            config.metadata.max_concurrent_requests = safe_env_stoi(e.name.c_str(), e.value, defaults::METADATA_MAX_CONCURRENT_REQUESTS);
+        }
+        if(auto e = get_env(env::METADATA_EXCEPTION_DEDUP_INTERVAL_MS)) {
+            config.metadata.exception_dedup_interval_ms = safe_env_stoi(e.name.c_str(), e.value, defaults::METADATA_EXCEPTION_DEDUP_INTERVAL_MS);
+        }
+        if(auto e = get_env(env::METADATA_EXCEPTION_MAX_UNIQUE_STACKS)) {
+            config.metadata.exception_max_unique_stacks = safe_env_stoi(e.name.c_str(), e.value, defaults::METADATA_EXCEPTION_MAX_UNIQUE_STACKS);
+        }
         if(auto e = get_env(env::ENABLE_CALLSTACK_TRACE)) {
             config.enable_callstack_trace = safe_env_stob(e.name.c_str(), e.value, false);
         }
@@ -717,6 +788,13 @@ namespace pinpoint {
     constexpr int MAX_STAT_BATCH_COUNT = 100;
     constexpr int MIN_STAT_INTERVAL_MS = 1000;
     constexpr int MAX_STAT_INTERVAL_MS = 60000;
+    constexpr int MIN_STAT_RETAINED_BATCHES = 1;
+    constexpr int MAX_STAT_RETAINED_BATCHES = 100;
+    constexpr size_t MAX_URL_STAT_PERCENTILE_BOUNDS = 64;
+    constexpr int MIN_URL_STAT_INTERVAL_MS = 1000;
+    // Ticks are rolled up to the collector's 30s URL stat granularity.
+    constexpr int MAX_URL_STAT_TICK_INTERVAL_MS = defaults::HTTP_URL_STAT_TICK_INTERVAL_MS;
+    constexpr int MAX_URL_STAT_SEND_INTERVAL_MS = 60000;
     constexpr int MIN_GRPC_QUEUE_SIZE = 1;
     constexpr int MAX_GRPC_QUEUE_SIZE = 65536;
 
@@ -869,6 +947,13 @@ namespace pinpoint {
                      config->stat.collect_interval, MIN_STAT_INTERVAL_MS, MAX_STAT_INTERVAL_MS, defaults::STAT_INTERVAL_MS);
             config->stat.collect_interval = defaults::STAT_INTERVAL_MS;
         }
+        if (config->stat.retained_batches < MIN_STAT_RETAINED_BATCHES ||
+            config->stat.retained_batches > MAX_STAT_RETAINED_BATCHES) {
+            LOG_WARN("stat retained batches {} is out of range ({}-{}), using default: {}",
+                     config->stat.retained_batches, MIN_STAT_RETAINED_BATCHES, MAX_STAT_RETAINED_BATCHES,
+                     defaults::STAT_RETAINED_BATCHES);
+            config->stat.retained_batches = defaults::STAT_RETAINED_BATCHES;
+        }
 
         if (config->sampling.counter_rate < NONE_SAMPLING_COUNTER_RATE) {
             LOG_WARN("sampling counter rate {} is invalid, using default: {}",
@@ -944,6 +1029,26 @@ namespace pinpoint {
                      config->span.batch.max_concurrent_requests, defaults::SPAN_BATCH_MAX_CONCURRENT_REQUESTS);
             config->span.batch.max_concurrent_requests = defaults::SPAN_BATCH_MAX_CONCURRENT_REQUESTS;
         }
+        if (config->span.batch.metadata_barrier_timeout_ms < 0) {
+            LOG_WARN("span batch metadata barrier timeout {}ms is invalid, using default: {}ms",
+                     config->span.batch.metadata_barrier_timeout_ms, defaults::SPAN_BATCH_METADATA_BARRIER_TIMEOUT_MS);
+            config->span.batch.metadata_barrier_timeout_ms = defaults::SPAN_BATCH_METADATA_BARRIER_TIMEOUT_MS;
+        }
+        if (config->metadata.max_concurrent_requests < 1) {
+            LOG_WARN("metadata max concurrent requests {} is invalid, using default: {}",
+                     config->metadata.max_concurrent_requests, defaults::METADATA_MAX_CONCURRENT_REQUESTS);
+            config->metadata.max_concurrent_requests = defaults::METADATA_MAX_CONCURRENT_REQUESTS;
+        }
+        if (config->metadata.exception_dedup_interval_ms < 0) {
+            LOG_WARN("exception dedup interval {}ms is invalid, using default: {}ms",
+                     config->metadata.exception_dedup_interval_ms, defaults::METADATA_EXCEPTION_DEDUP_INTERVAL_MS);
+            config->metadata.exception_dedup_interval_ms = defaults::METADATA_EXCEPTION_DEDUP_INTERVAL_MS;
+        }
+        if (config->metadata.exception_max_unique_stacks < 1) {
+            LOG_WARN("exception max unique stacks {} is invalid, using default: {}",
+                     config->metadata.exception_max_unique_stacks, defaults::METADATA_EXCEPTION_MAX_UNIQUE_STACKS);
+            config->metadata.exception_max_unique_stacks = defaults::METADATA_EXCEPTION_MAX_UNIQUE_STACKS;
+        }
         if (config->agent_info.refresh_interval_ms < 1) {
             LOG_WARN("agent info refresh interval {}ms is invalid, using default: {}ms",
                      config->agent_info.refresh_interval_ms, defaults::AGENT_INFO_REFRESH_INTERVAL_MS);
@@ -968,6 +1073,27 @@ namespace pinpoint {
                      config->http.url_stat.limit, defaults::HTTP_URL_STAT_LIMIT);
             config->http.url_stat.limit = defaults::HTTP_URL_STAT_LIMIT;
         }
+        if (const auto& bounds = config->http.url_stat.percentile_bounds;
+            bounds.size() > MAX_URL_STAT_PERCENTILE_BOUNDS || (!bounds.empty() && bounds.front() <= 0) ||
+            std::adjacent_find(bounds.begin(), bounds.end(), std::greater_equal<int>()) != bounds.end()) {
+            LOG_WARN("http url stat percentile bounds must be at most {} increasing positive values, "
+                     "using collector buckets only", MAX_URL_STAT_PERCENTILE_BOUNDS);
+            config->http.url_stat.percentile_bounds.clear();
+        }
+        if (const auto tick = config->http.url_stat.tick_interval_ms;
+            tick < MIN_URL_STAT_INTERVAL_MS || tick > MAX_URL_STAT_TICK_INTERVAL_MS ||
+            tick % 1000 != 0 || MAX_URL_STAT_TICK_INTERVAL_MS % tick != 0) {
+            LOG_WARN("http url stat tick interval {}ms must be whole seconds dividing {}ms, using default: {}ms",
+                     tick, MAX_URL_STAT_TICK_INTERVAL_MS, defaults::HTTP_URL_STAT_TICK_INTERVAL_MS);
+            config->http.url_stat.tick_interval_ms = defaults::HTTP_URL_STAT_TICK_INTERVAL_MS;
+        }
+        if (config->http.url_stat.send_interval_ms < MIN_URL_STAT_INTERVAL_MS ||
+            config->http.url_stat.send_interval_ms > MAX_URL_STAT_SEND_INTERVAL_MS) {
+            LOG_WARN("http url stat send interval {}ms is out of range ({}-{}ms), using default: {}ms",
+                     config->http.url_stat.send_interval_ms, MIN_URL_STAT_INTERVAL_MS, MAX_URL_STAT_SEND_INTERVAL_MS,
+                     defaults::HTTP_URL_STAT_SEND_INTERVAL_MS);
+            config->http.url_stat.send_interval_ms = defaults::HTTP_URL_STAT_SEND_INTERVAL_MS;
+        }
 
         validate_grpc_channel(config->grpc.channel, "grpc", Config::GrpcChannelOptions());
 
@@ -993,7 +1119,8 @@ namespace pinpoint {
             return emitter.c_str();
         }
 
-        std::string config_value_to_string(const std::vector<std::string>& values) {
+        template <typename T>
+        std::string config_value_to_string(const std::vector<T>& values) {
             YAML::Emitter emitter;
             emitter << YAML::Flow << YAML::BeginSeq;
             for (const auto& value : values) {
@@ -1049,6 +1176,8 @@ namespace pinpoint {
         add_non_default_config(config_strings, "Stat.BatchCount", config.stat.batch_count, default_config.stat.batch_count);
         add_non_default_config(config_strings, "Stat.BatchInterval", config.stat.collect_interval,
                                default_config.stat.collect_interval);
+        add_non_default_config(config_strings, "Stat.RetainedBatches", config.stat.retained_batches,
+                               default_config.stat.retained_batches);
         add_non_default_config(config_strings, "Sampling.Type", config.sampling.type, default_config.sampling.type);
         add_non_default_config(config_strings, "Sampling.CounterRate", config.sampling.counter_rate,
                                default_config.sampling.counter_rate);
@@ -1074,6 +1203,9 @@ namespace pinpoint {
         add_non_default_config(config_strings, "Span.Batch.MaxConcurrentRequests",
                                config.span.batch.max_concurrent_requests,
                                default_config.span.batch.max_concurrent_requests);
+        add_non_default_config(config_strings, "Span.Batch.MetadataBarrierTimeoutMs",
+                               config.span.batch.metadata_barrier_timeout_ms,
+                               default_config.span.batch.metadata_barrier_timeout_ms);
         add_non_default_config(config_strings, "AgentInfo.RefreshIntervalMs", config.agent_info.refresh_interval_ms,
                                default_config.agent_info.refresh_interval_ms);
         add_non_default_config(config_strings, "AgentInfo.SendRetryIntervalMs", config.agent_info.send_retry_interval_ms,
@@ -1090,6 +1222,14 @@ namespace pinpoint {
                                default_config.http.url_stat.trim_path_depth);
         add_non_default_config(config_strings, "Http.UrlStatMethodPrefix", config.http.url_stat.method_prefix,
                                default_config.http.url_stat.method_prefix);
+        add_non_default_config(config_strings, "Http.UrlStatPercentileBounds", config.http.url_stat.percentile_bounds,
+                               default_config.http.url_stat.percentile_bounds);
+        add_non_default_config(config_strings, "Http.UrlStatHeavyHitter", config.http.url_stat.heavy_hitter,
+                               default_config.http.url_stat.heavy_hitter);
+        add_non_default_config(config_strings, "Http.UrlStatTickIntervalMs", config.http.url_stat.tick_interval_ms,
+                               default_config.http.url_stat.tick_interval_ms);
+        add_non_default_config(config_strings, "Http.UrlStatSendIntervalMs", config.http.url_stat.send_interval_ms,
+                               default_config.http.url_stat.send_interval_ms);
         add_non_default_config(config_strings, "Http.Server.StatusCodeErrors", config.http.server.status_errors,
                                default_config.http.server.status_errors);
         add_non_default_config(config_strings, "Http.Server.ExcludeUrl", config.http.server.exclude_url,
@@ -1112,6 +1252,16 @@ namespace pinpoint {
                                default_config.sql.max_bind_args_size);
         add_non_default_config(config_strings, "Sql.EnableSqlStats", config.sql.enable_sql_stats,
                                default_config.sql.enable_sql_stats);
+        add_non_default_config(config_strings, "Sql.AsyncNormalize", config.sql.async_normalize,
+                               default_config.sql.async_normalize);
+        add_non_default_config(config_strings, "Metadata.CacheDir", config.metadata.cache_dir,
+                               default_config.metadata.cache_dir);
+        add_non_default_config(config_strings, "Metadata.MaxConcurrentRequests", config.metadata.max_concurrent_requests,
+                               default_config.metadata.max_concurrent_requests);
+        add_non_default_config(config_strings, "Metadata.ExceptionDedupIntervalMs", config.metadata.exception_dedup_interval_ms,
+                               default_config.metadata.exception_dedup_interval_ms);
+        add_non_default_config(config_strings, "Metadata.ExceptionMaxUniqueStacks", config.metadata.exception_max_unique_stacks,
+                               default_config.metadata.exception_max_unique_stacks);
         add_non_default_config(config_strings, "EnableCallstackTrace", config.enable_callstack_trace,
                                default_config.enable_callstack_trace);
 
@@ -1177,6 +1327,7 @@ namespace pinpoint {
         emitter << YAML::Key << "Enable" << YAML::Value << config.stat.enable;
         emitter << YAML::Key << "BatchCount" << YAML::Value << config.stat.batch_count;
         emitter << YAML::Key << "BatchInterval" << YAML::Value << config.stat.collect_interval;
+        emitter << YAML::Key << "RetainedBatches" << YAML::Value << config.stat.retained_batches;
         emitter << YAML::EndMap;
 
         emitter << YAML::Key << "Sampling";
@@ -1200,6 +1351,7 @@ namespace pinpoint {
         emitter << YAML::Key << "FlushIntervalMs" << YAML::Value << config.span.batch.flush_interval_ms;
         emitter << YAML::Key << "CollectDeadlineMs" << YAML::Value << config.span.batch.collect_deadline_ms;
         emitter << YAML::Key << "MaxConcurrentRequests" << YAML::Value << config.span.batch.max_concurrent_requests;
+        emitter << YAML::Key << "MetadataBarrierTimeoutMs" << YAML::Value << config.span.batch.metadata_barrier_timeout_ms;
         emitter << YAML::EndMap;
         emitter << YAML::EndMap;
 
@@ -1218,6 +1370,14 @@ namespace pinpoint {
         emitter << YAML::Key << "UrlStatEnableTrimPath" << YAML::Value << config.http.url_stat.enable_trim_path;
         emitter << YAML::Key << "UrlStatTrimPathDepth" << YAML::Value << config.http.url_stat.trim_path_depth;
         emitter << YAML::Key << "UrlStatMethodPrefix" << YAML::Value << config.http.url_stat.method_prefix;
+        emitter << YAML::Key << "UrlStatPercentileBounds" << YAML::Value << YAML::Flow << YAML::BeginSeq;
+        for (const auto bound : config.http.url_stat.percentile_bounds) {
+            emitter << bound;
+        }
+        emitter << YAML::EndSeq;
+        emitter << YAML::Key << "UrlStatHeavyHitter" << YAML::Value << config.http.url_stat.heavy_hitter;
+        emitter << YAML::Key << "UrlStatTickIntervalMs" << YAML::Value << config.http.url_stat.tick_interval_ms;
+        emitter << YAML::Key << "UrlStatSendIntervalMs" << YAML::Value << config.http.url_stat.send_interval_ms;
 
         emitter << YAML::Key << "Server";
         emitter << YAML::BeginMap;
@@ -1287,6 +1447,15 @@ namespace pinpoint {
         emitter << YAML::BeginMap;
         emitter << YAML::Key << "MaxBindArgsSize" << YAML::Value << config.sql.max_bind_args_size;
         emitter << YAML::Key << "EnableSqlStats" << YAML::Value << config.sql.enable_sql_stats;
+        emitter << YAML::Key << "AsyncNormalize" << YAML::Value << config.sql.async_normalize;
+        emitter << YAML::EndMap;
+
+        emitter << YAML::Key << "Metadata";
+        emitter << YAML::BeginMap;
+        emitter << YAML::Key << "CacheDir" << YAML::Value << config.metadata.cache_dir;
+        emitter << YAML::Key << "MaxConcurrentRequests" << YAML::Value << config.metadata.max_concurrent_requests;
+        emitter << YAML::Key << "ExceptionDedupIntervalMs" << YAML::Value << config.metadata.exception_dedup_interval_ms;
+        emitter << YAML::Key << "ExceptionMaxUniqueStacks" << YAML::Value << config.metadata.exception_max_unique_stacks;
         emitter << YAML::EndMap;
 
         emitter << YAML::Key << "EnableCallstackTrace" << YAML::Value << config.enable_callstack_trace;
@@ -30,6 +30,7 @@ namespace pinpoint {
         constexpr int SPAN_PORT = 9993;
         constexpr int STAT_PORT = 9992;
         constexpr int STAT_BATCH_COUNT = 6;
+        constexpr int STAT_RETAINED_BATCHES = 10;
         constexpr int STAT_INTERVAL_MS = 5000;
         constexpr int SAMPLING_COUNTER_RATE = 1;
         constexpr double SAMPLING_PERCENT_RATE = 100.0;
@@ -41,6 +42,10 @@ namespace pinpoint {
         constexpr int SPAN_BATCH_FLUSH_INTERVAL_MS = 1000;
         constexpr int SPAN_BATCH_COLLECT_DEADLINE_MS = 500;
         constexpr int SPAN_BATCH_MAX_CONCURRENT_REQUESTS = 10;
+        constexpr int SPAN_BATCH_METADATA_BARRIER_TIMEOUT_MS = 0;
+        constexpr int METADATA_MAX_CONCURRENT_REQUESTS = 1;
+        constexpr int METADATA_EXCEPTION_DEDUP_INTERVAL_MS = 0;
+        constexpr int METADATA_EXCEPTION_MAX_UNIQUE_STACKS = 1000;
         constexpr int AGENT_INFO_REFRESH_INTERVAL_MS = 24 * 60 * 60 * 1000;
         constexpr int AGENT_INFO_SEND_RETRY_INTERVAL_MS = 3000;
         constexpr int AGENT_INFO_MAX_TRY_PER_ATTEMPT = 3;
@@ -50,6 +55,8 @@ namespace pinpoint {
         constexpr int GRPC_SENDER_QUEUE_SIZE = 1000;
         constexpr int GRPC_CHANNEL_EXECUTOR_QUEUE_SIZE = 1000;
         constexpr int HTTP_URL_STAT_LIMIT = 1024;
+        constexpr int HTTP_URL_STAT_TICK_INTERVAL_MS = 30000;
+        constexpr int HTTP_URL_STAT_SEND_INTERVAL_MS = 30000;
         constexpr int SQL_MAX_BIND_ARGS_SIZE = 1024;
         constexpr int LOG_MAX_FILE_SIZE_MB = 10;
         constexpr const char* LOG_LEVEL = "info";
@@ -87,6 +94,7 @@ namespace pinpoint {
         constexpr const char* GRPC_STAT_PORT = "GRPC_STAT_PORT";
         constexpr const char* STAT_ENABLE = "STAT_ENABLE";
         constexpr const char* STAT_BATCH_COUNT = "STAT_BATCH_COUNT";
+        constexpr const char* STAT_RETAINED_BATCHES = "STAT_RETAINED_BATCHES";
         constexpr const char* STAT_BATCH_INTERVAL = "STAT_BATCH_INTERVAL";
         constexpr const char* SAMPLING_TYPE = "SAMPLING_TYPE";
         constexpr const char* SAMPLING_COUNTER_RATE = "SAMPLING_COUNTER_RATE";
@@ -101,6 +109,7 @@ namespace pinpoint {
         constexpr const char* SPAN_BATCH_FLUSH_INTERVAL_MS = "SPAN_BATCH_FLUSH_INTERVAL_MS";
         constexpr const char* SPAN_BATCH_COLLECT_DEADLINE_MS = "SPAN_BATCH_COLLECT_DEADLINE_MS";
         constexpr const char* SPAN_BATCH_MAX_CONCURRENT_REQUESTS = "SPAN_BATCH_MAX_CONCURRENT_REQUESTS";
+        constexpr const char* SPAN_BATCH_METADATA_BARRIER_TIMEOUT_MS = "SPAN_BATCH_METADATA_BARRIER_TIMEOUT_MS";
         constexpr const char* AGENT_INFO_REFRESH_INTERVAL_MS = "AGENT_INFO_REFRESH_INTERVAL_MS";
         constexpr const char* AGENT_INFO_SEND_RETRY_INTERVAL_MS = "AGENT_INFO_SEND_RETRY_INTERVAL_MS";
         constexpr const char* AGENT_INFO_MAX_TRY_PER_ATTEMPT = "AGENT_INFO_MAX_TRY_PER_ATTEMPT";
@@ -120,6 +129,10 @@ namespace pinpoint {
         constexpr const char* HTTP_URL_STAT_ENABLE_TRIM_PATH = "HTTP_URL_STAT_ENABLE_TRIM_PATH";
         constexpr const char* HTTP_URL_STAT_TRIM_PATH_DEPTH = "HTTP_URL_STAT_TRIM_PATH_DEPTH";
         constexpr const char* HTTP_URL_STAT_METHOD_PREFIX = "HTTP_URL_STAT_METHOD_PREFIX";
+        constexpr const char* HTTP_URL_STAT_PERCENTILE_BOUNDS = "HTTP_URL_STAT_PERCENTILE_BOUNDS";
+        constexpr const char* HTTP_URL_STAT_HEAVY_HITTER = "HTTP_URL_STAT_HEAVY_HITTER";
+        constexpr const char* HTTP_URL_STAT_TICK_INTERVAL_MS = "HTTP_URL_STAT_TICK_INTERVAL_MS";
+        constexpr const char* HTTP_URL_STAT_SEND_INTERVAL_MS = "HTTP_URL_STAT_SEND_INTERVAL_MS";
         constexpr const char* HTTP_SERVER_STATUS_CODE_ERRORS = "HTTP_SERVER_STATUS_CODE_ERRORS";
         constexpr const char* HTTP_SERVER_EXCLUDE_URL = "HTTP_SERVER_EXCLUDE_URL";
         constexpr const char* HTTP_SERVER_EXCLUDE_METHOD = "HTTP_SERVER_EXCLUDE_METHOD";
@@ -131,6 +144,11 @@ namespace pinpoint {
         constexpr const char* HTTP_CLIENT_RECORD_RESPONSE_HEADER = "HTTP_CLIENT_RECORD_RESPONSE_HEADER";
         constexpr const char* SQL_MAX_BIND_ARGS_SIZE = "SQL_MAX_BIND_ARGS_SIZE";
         constexpr const char* SQL_ENABLE_SQL_STATS = "SQL_ENABLE_SQL_STATS";
+        constexpr const char* SQL_ASYNC_NORMALIZE = "SQL_ASYNC_NORMALIZE";
+        constexpr const char* METADATA_CACHE_DIR = "METADATA_CACHE_DIR";
+        constexpr const char* METADATA_MAX_CONCURRENT_REQUESTS = "METADATA_MAX_CONCURRENT_REQUESTS";
+        constexpr const char* METADATA_EXCEPTION_DEDUP_INTERVAL_MS = "METADATA_EXCEPTION_DEDUP_INTERVAL_MS";
+        constexpr const char* METADATA_EXCEPTION_MAX_UNIQUE_STACKS = "METADATA_EXCEPTION_MAX_UNIQUE_STACKS";
         constexpr const char* CONFIG_FILE = "CONFIG_FILE";
         constexpr const char* ENABLE_CALLSTACK_TRACE = "ENABLE_CALLSTACK_TRACE";
     }
@@ -187,6 +205,8 @@ namespace pinpoint {
             bool enable = true;
             int batch_count = defaults::STAT_BATCH_COUNT;
             int collect_interval = defaults::STAT_INTERVAL_MS;
+            // Batches kept while the collector is unreachable.
+            int retained_batches = defaults::STAT_RETAINED_BATCHES;
         } stat;
 
         struct {
@@ -208,6 +228,9 @@ namespace pinpoint {
                 int flush_interval_ms = defaults::SPAN_BATCH_FLUSH_INTERVAL_MS;
                 int collect_deadline_ms = defaults::SPAN_BATCH_COLLECT_DEADLINE_MS;
                 int max_concurrent_requests = defaults::SPAN_BATCH_MAX_CONCURRENT_REQUESTS;
+                // Max wait for earlier metadata to be acknowledged before a batch
+                // is sent; 0 disables the span/metadata ordering barrier.
+                int metadata_barrier_timeout_ms = defaults::SPAN_BATCH_METADATA_BARRIER_TIMEOUT_MS;
             } batch;
         } span;
 
@@ -245,6 +268,10 @@ namespace pinpoint {
                 bool enable_trim_path = true;
                 int trim_path_depth = 1;
                 bool method_prefix = false;
+                std::vector<int> percentile_bounds;  // ms; empty keeps only the collector's buckets
+                bool heavy_hitter = false;           // keep the top-K URLs instead of the first K
+                int tick_interval_ms = defaults::HTTP_URL_STAT_TICK_INTERVAL_MS;
+                int send_interval_ms = defaults::HTTP_URL_STAT_SEND_INTERVAL_MS;
             } url_stat;
 
             struct {
@@ -266,8 +293,21 @@ namespace pinpoint {
         struct {
             int max_bind_args_size = defaults::SQL_MAX_BIND_ARGS_SIZE;
             bool enable_sql_stats = false;
+            // Defer SetSqlQuery normalization and metadata lookup to the span worker.
+            bool async_normalize = false;
         } sql;
 
+        struct {
+            // Directory for the on-disk metadata cache; empty disables it.
+            std::string cache_dir;
+            // Metadata RPCs kept in flight at once; 1 sends them one at a time.
+            int max_concurrent_requests = defaults::METADATA_MAX_CONCURRENT_REQUESTS;
+            // Interval over which exception metadata is collected and each call
+            // stack sent once; 0 sends each span's exceptions at once.
+            int exception_dedup_interval_ms = defaults::METADATA_EXCEPTION_DEDUP_INTERVAL_MS;
+            int exception_max_unique_stacks = defaults::METADATA_EXCEPTION_MAX_UNIQUE_STACKS;
+        } metadata;
+
         /**
          * @brief Validates required config fields and constraints.
          *
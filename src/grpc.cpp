@@ -297,11 +297,249 @@ namespace pinpoint {
 
     constexpr int METADATA_RETRY_MAX_ATTEMPTS = 3;
     constexpr auto METADATA_RETRY_DELAY = std::chrono::milliseconds(1000);
+    constexpr auto METADATA_RETRY_WHEEL_TICK = std::chrono::milliseconds(10);
+    constexpr size_t METADATA_RETRY_WHEEL_SLOTS = 512;
+    constexpr auto METADATA_PERMIT_WAIT_SLICE = std::chrono::milliseconds(100);
+    constexpr auto METADATA_SHUTDOWN_AWAIT_TIMEOUT = std::chrono::seconds(3);
+
+    //ExceptionMetaAggregator
+
+    uint64_t ExceptionMetaAggregator::fingerprint(const CallStack& callstack) {
+        const auto& frames = callstack.getStack();
+        uint64_t seed = frames.size();
+        auto mix = [&seed](size_t value) {
+            seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+        };
+        for (const auto& frame : frames) {
+            mix(std::hash<std::string_view>{}(frame.module));
+            mix(std::hash<std::string_view>{}(frame.function));
+            mix(std::hash<std::string_view>{}(frame.file));
+            mix(std::hash<int>{}(frame.line));
+        }
+        return seed;
+    }
+
+    void ExceptionMetaAggregator::add(ExceptionMeta&& meta) {
+        auto same_frames = [](const CallStack& a, const CallStack& b) {
+            return std::equal(a.getStack().begin(), a.getStack().end(), b.getStack().begin(), b.getStack().end(),
+                              [](const StackFrame& x, const StackFrame& y) {
+                return x.line == y.line && x.function == y.function && x.file == y.file && x.module == y.module;
+            });
+        };
+
+        auto& exceptions = meta.exceptions_;
+        if (exceptions.empty()) {
+            return;
+        }
+        for (auto& exception : exceptions) {
+            const auto fp = fingerprint(exception->getCallStack());
+            if (const auto seen = seen_stacks_.find(fp); seen != seen_stacks_.end()) {
+                // A fingerprint collision with a different stack is sent in full.
+                if (same_frames(seen->second->getCallStack(), exception->getCallStack())) {
+                    ++repeated_count_;
+                    exception->collapseCallStack("(same call stack as exception " +
+                                                 std::to_string(seen->second->getId()) + ")");
+                }
+                continue;
+            }
+            if (seen_stacks_.size() >= max_unique_stacks_) {
+                ++overflow_count_;
+                exception->collapseCallStack("(call stack omitted: unique call stack limit reached)");
+                continue;
+            }
+            seen_stacks_.emplace(fp, exception.get());
+        }
+
+        if (const auto it = span_index_.find(meta.span_id_); it != span_index_.end()) {
+            auto& existing = pending_[it->second];
+            if (existing.txid_.Sequence == meta.txid_.Sequence &&
+                existing.txid_.StartTime == meta.txid_.StartTime &&
+                existing.txid_.AgentId == meta.txid_.AgentId) {
+                for (auto& exception : exceptions) {
+                    existing.exceptions_.push_back(std::move(exception));
+                }
+                return;
+            }
+        }
+        span_index_[meta.span_id_] = pending_.size();
+        pending_.push_back(std::move(meta));
+    }
+
+    std::vector<ExceptionMeta> ExceptionMetaAggregator::drain() {
+        std::vector<ExceptionMeta> drained;
+        drained.swap(pending_);
+        span_index_.clear();
+        seen_stacks_.clear();
+        repeated_count_ = 0;
+        overflow_count_ = 0;
+        return drained;
+    }
+
+    //MetaWatermark
+
+    uint64_t MetaWatermark::issue() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return ++issued_;
+    }
+
+    uint64_t MetaWatermark::issued() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return issued_;
+    }
+
+    void MetaWatermark::settle(uint64_t sequence) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (sequence <= watermark_) {
+                return;
+            }
+            settled_ahead_.insert(sequence);
+            while (!settled_ahead_.empty() && *settled_ahead_.begin() == watermark_ + 1) {
+                ++watermark_;
+                settled_ahead_.erase(settled_ahead_.begin());
+            }
+        }
+        cv_.notify_all();
+    }
+
+    uint64_t MetaWatermark::watermark() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return watermark_;
+    }
+
+    bool MetaWatermark::wait_for(uint64_t sequence, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, timeout, [this, sequence] { return watermark_ >= sequence || interrupted_; });
+        return watermark_ >= sequence;
+    }
+
+    void MetaWatermark::interrupt() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            interrupted_ = true;
+        }
+        cv_.notify_all();
+    }
 
     //GrpcMetadata
 
-    GrpcMetadata::GrpcMetadata(std::shared_ptr<const Config> config) : GrpcClient(METADATA, std::move(config)) {
+    // Heap-resident state for a single async metadata RPC. The payload moves
+    // into the call for its lifetime so a failed call can be handed back to the
+    // worker for retry.
+    struct PendingMetaCall {
+        grpc::ClientContext ctx;
+        google::protobuf::Arena arena;
+        v1::PResult reply;
+        std::unique_ptr<MetaData> meta;
+        int retry_count{0};
+        uint64_t sequence{0};
+    };
+
+    // Permit accounting, in-flight call registry and failed-call hand-off
+    // shared between GrpcMetadata and its async completion callbacks. As with
+    // SpanBatchInflight, callbacks hold this by shared_ptr and never touch the
+    // client itself; the only link back is the worker's queue condition
+    // variable, which ~GrpcMetadata detaches under owner_mutex.
+    struct MetaCallInflight {
+        std::mutex mutex;
+        std::condition_variable cv;
+        int permits{0};
+        int max_permits{0};
+        std::vector<std::shared_ptr<PendingMetaCall>> pending;
+        std::vector<std::shared_ptr<PendingMetaCall>> failed;
+        std::shared_ptr<MetaWatermark> watermark;
+
+        std::mutex owner_mutex;
+        std::mutex* queue_mutex{nullptr};
+        std::condition_variable* queue_cv{nullptr};
+
+        void completeCall(const std::shared_ptr<PendingMetaCall>& call, bool ok) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.erase(std::remove(pending.begin(), pending.end(), call), pending.end());
+                if (!ok) {
+                    failed.push_back(call);
+                }
+                ++permits;
+            }
+            cv.notify_one();
+            if (ok) {
+                watermark->settle(call->sequence);
+            } else {
+                wakeOwner();
+            }
+        }
+
+        void wakeOwner() {
+            std::lock_guard<std::mutex> owner_lock(owner_mutex);
+            if (queue_cv == nullptr) {
+                return;
+            }
+            // Passing through the queue mutex orders the hand-off above with
+            // the worker's predicate check, so the wakeup cannot be lost.
+            { std::lock_guard<std::mutex> lock(*queue_mutex); }
+            queue_cv->notify_one();
+        }
+    };
+
+    namespace {
+        void fill_api_meta(const ApiMeta& api_meta, v1::PApiMetaData* grpc_api_meta) {
+            grpc_api_meta->set_apiid(api_meta.id_);
+            grpc_api_meta->set_apiinfo(api_meta.api_str_);
+            grpc_api_meta->set_type(api_meta.type_);
+        }
+
+        void fill_error_meta(const StringMeta& error_meta, v1::PStringMetaData* grpc_error_meta) {
+            grpc_error_meta->set_stringid(error_meta.id_);
+            grpc_error_meta->set_stringvalue(error_meta.str_val_);
+        }
+
+        void fill_sql_meta(const StringMeta& sql_meta, v1::PSqlMetaData* grpc_sql_meta) {
+            grpc_sql_meta->set_sqlid(sql_meta.id_);
+            grpc_sql_meta->set_sql(sql_meta.str_val_);
+        }
+
+        void fill_sql_uid_meta(const SqlUidMeta& sql_uid_meta, v1::PSqlUidMetaData* grpc_sql_uid_meta) {
+            grpc_sql_uid_meta->set_sqluid(std::string(sql_uid_meta.uid_.begin(), sql_uid_meta.uid_.end()));
+            grpc_sql_uid_meta->set_sql(sql_uid_meta.sql_);
+        }
+
+        std::function<void(grpc::Status)> make_meta_callback(std::shared_ptr<MetaCallInflight> state,
+                                                             std::shared_ptr<PendingMetaCall> call,
+                                                             std::string_view operation_name) {
+            return [state = std::move(state), call = std::move(call), operation_name](const grpc::Status& status) {
+                const bool ok = status.ok() && call->reply.success();
+                if (!status.ok()) {
+                    LOG_ERROR("failed to send {} metadata: {}, {}",
+                              operation_name, static_cast<int>(status.error_code()), status.error_message());
+                } else if (!call->reply.success()) {
+                    LOG_INFO("failed to send {} metadata: PResult.success=false", operation_name);
+                } else {
+                    LOG_DEBUG("success to send {} metadata", operation_name);
+                }
+                state->completeCall(call, ok);
+            };
+        }
+    }
+
+    GrpcMetadata::GrpcMetadata(std::shared_ptr<const Config> config)
+        : GrpcClient(METADATA, std::move(config)),
+          retry_wheel_(METADATA_RETRY_WHEEL_TICK, METADATA_RETRY_WHEEL_SLOTS),
+          exception_aggregator_(static_cast<size_t>(config_->metadata.exception_max_unique_stacks)) {
         set_meta_stub(v1::Metadata::NewStub(channel_));
+        inflight_ = std::make_shared<MetaCallInflight>();
+        inflight_->max_permits = config_->metadata.max_concurrent_requests;
+        inflight_->permits = inflight_->max_permits;
+        inflight_->queue_mutex = &meta_queue_mutex_;
+        inflight_->queue_cv = &meta_queue_cv_;
+        watermark_ = std::make_shared<MetaWatermark>();
+        inflight_->watermark = watermark_;
+    }
+
+    GrpcMetadata::~GrpcMetadata() {
+        std::lock_guard<std::mutex> lock(inflight_->owner_mutex);
+        inflight_->queue_mutex = nullptr;
+        inflight_->queue_cv = nullptr;
     }
 
     template<typename Request, typename StubMethod>
@@ -336,10 +574,7 @@ namespace pinpoint {
 
     GrpcRequestStatus GrpcMetadata::send_api_meta(ApiMeta& api_meta) {
         v1::PApiMetaData grpc_api_meta;
-
-        grpc_api_meta.set_apiid(api_meta.id_);
-        grpc_api_meta.set_apiinfo(api_meta.api_str_);
-        grpc_api_meta.set_type(api_meta.type_);
+        fill_api_meta(api_meta, &grpc_api_meta);
 
         auto stub_method = [this](grpc::ClientContext* ctx, const v1::PApiMetaData& req, v1::PResult* reply) {
             return meta_stub_->RequestApiMetaData(ctx, req, reply);
@@ -350,9 +585,7 @@ namespace pinpoint {
 
     GrpcRequestStatus GrpcMetadata::send_error_meta(StringMeta& error_meta) {
         v1::PStringMetaData grpc_error_meta;
-
-        grpc_error_meta.set_stringid(error_meta.id_);
-        grpc_error_meta.set_stringvalue(error_meta.str_val_);
+        fill_error_meta(error_meta, &grpc_error_meta);
 
         auto stub_method = [this](grpc::ClientContext* ctx, const v1::PStringMetaData& req, v1::PResult* reply) {
             return meta_stub_->RequestStringMetaData(ctx, req, reply);
@@ -363,9 +596,7 @@ namespace pinpoint {
 
     GrpcRequestStatus GrpcMetadata::send_sql_meta(StringMeta& sql_meta) {
         v1::PSqlMetaData grpc_sql_meta;
-
-        grpc_sql_meta.set_sqlid(sql_meta.id_);
-        grpc_sql_meta.set_sql(sql_meta.str_val_);
+        fill_sql_meta(sql_meta, &grpc_sql_meta);
 
         auto stub_method = [this](grpc::ClientContext* ctx, const v1::PSqlMetaData& req, v1::PResult* reply) {
             return meta_stub_->RequestSqlMetaData(ctx, req, reply);
@@ -376,9 +607,7 @@ namespace pinpoint {
 
     GrpcRequestStatus GrpcMetadata::send_sql_uid_meta(SqlUidMeta& sql_uid_meta) {
         v1::PSqlUidMetaData grpc_sql_uid_meta;
-
-        grpc_sql_uid_meta.set_sqluid(std::string(sql_uid_meta.uid_.begin(), sql_uid_meta.uid_.end()));
-        grpc_sql_uid_meta.set_sql(sql_uid_meta.sql_);
+        fill_sql_uid_meta(sql_uid_meta, &grpc_sql_uid_meta);
 
         auto stub_method = [this](grpc::ClientContext* ctx, const v1::PSqlUidMetaData& req, v1::PResult* reply) {
             return meta_stub_->RequestSqlUidMetaData(ctx, req, reply);
@@ -446,10 +675,17 @@ namespace pinpoint {
         std::unique_lock<std::mutex> lock(meta_queue_mutex_);
 
         const auto max_queue_size = static_cast<size_t>(config_->grpc.channel.sender_queue_size);
-        if (meta_queue_.size() + retry_queue_.size() < max_queue_size) {
-            meta_queue_.push_back(PendingMeta{std::move(meta), 0, {}});
-        } else {
+        const auto queued = meta_queue_.size() + retry_wheel_.size() + exception_aggregator_.size();
+        if (queued >= max_queue_size) {
             LOG_DEBUG("drop metadata: overflow max queue size {}", max_queue_size);
+        } else if (meta->meta_type_ == META_EXCEPTION && config_->metadata.exception_dedup_interval_ms > 0) {
+            if (exception_aggregator_.empty()) {
+                exception_flush_at_ = std::chrono::steady_clock::now() +
+                                      std::chrono::milliseconds(config_->metadata.exception_dedup_interval_ms);
+            }
+            exception_aggregator_.add(std::get<ExceptionMeta>(std::move(meta->value_)));
+        } else {
+            meta_queue_.push_back(PendingMeta{std::move(meta), 0, {}, watermark_->issue()});
         }
 
         meta_queue_cv_.notify_one();
@@ -459,22 +695,75 @@ namespace pinpoint {
         LOG_ERROR("failed to enqueue metadata: unknown exception");
     }
 
+    void GrpcMetadata::enqueueMetaBatch(std::vector<std::unique_ptr<MetaData>> metas) noexcept try {
+        if (metas.empty() || (agent_ != nullptr && agent_->isExiting())) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(meta_queue_mutex_);
+        for (auto& meta : metas) {
+            if (meta != nullptr) {
+                meta_queue_.push_back(PendingMeta{std::move(meta), 0, {}, watermark_->issue()});
+            }
+        }
+        LOG_DEBUG("enqueue metadata batch: size={}", metas.size());
+
+        meta_queue_cv_.notify_one();
+    } catch (const std::exception &e) {
+        LOG_ERROR("failed to enqueue metadata batch: exception = {}", e.what());
+    } catch (...) {
+        LOG_ERROR("failed to enqueue metadata batch: unknown exception");
+    }
+
     std::chrono::milliseconds GrpcMetadata::meta_retry_delay() const {
         return METADATA_RETRY_DELAY;
     }
 
     void GrpcMetadata::schedule_retry(PendingMeta&& pending) {
         pending.available_at = std::chrono::steady_clock::now() + meta_retry_delay();
-        retry_queue_.emplace(pending.available_at, std::move(pending));
+        const auto available_at = pending.available_at;
+        retry_wheel_.schedule(available_at, std::move(pending));
         meta_queue_cv_.notify_one();
     }
 
+    // Caller must hold meta_queue_mutex_.
+    void GrpcMetadata::handle_send_failure(PendingMeta&& pending) {
+        ++pending.retry_count;
+        if (pending.retry_count <= METADATA_RETRY_MAX_ATTEMPTS) {
+            LOG_DEBUG("retry metadata send: retryCount={}/{}", pending.retry_count, METADATA_RETRY_MAX_ATTEMPTS);
+            schedule_retry(std::move(pending));
+        } else {
+            LOG_INFO("drop metadata after retry exhaustion: retryCount={}", pending.retry_count);
+            release_failed_cache(*pending.meta);
+            watermark_->settle(pending.sequence);
+        }
+    }
+
+    bool GrpcMetadata::has_failed_calls() const {
+        std::lock_guard<std::mutex> lock(inflight_->mutex);
+        return !inflight_->failed.empty();
+    }
+
+    // Caller must hold meta_queue_mutex_.
+    void GrpcMetadata::drain_failed_calls() {
+        std::vector<std::shared_ptr<PendingMetaCall>> failed;
+        {
+            std::lock_guard<std::mutex> lock(inflight_->mutex);
+            failed.swap(inflight_->failed);
+        }
+        for (auto& call : failed) {
+            handle_send_failure(PendingMeta{std::move(call->meta), call->retry_count, {}, call->sequence});
+        }
+    }
+
     bool GrpcMetadata::pop_next_meta(PendingMeta& pending, std::unique_lock<std::mutex>& lock) {
         while (true) {
             if (meta_stop_requested_ || agent_->isExiting()) {
                 return false;
             }
 
+            drain_failed_calls();
+
             if (!meta_queue_.empty()) {
                 pending = std::move(meta_queue_.front());
                 meta_queue_.pop_front();
@@ -482,26 +771,67 @@ namespace pinpoint {
             }
 
             const auto now = std::chrono::steady_clock::now();
-            if (!retry_queue_.empty()) {
-                auto retry = retry_queue_.begin();
-                if (retry->first <= now) {
-                    pending = std::move(retry->second);
-                    retry_queue_.erase(retry);
-                    return true;
+            if (!exception_aggregator_.empty() && now >= exception_flush_at_) {
+                flush_exception_meta();
+                continue;
+            }
+
+            if (!retry_wheel_.empty() || !exception_aggregator_.empty()) {
+                retry_wheel_.expire(now, [this](PendingMeta&& due) {
+                    meta_queue_.push_back(std::move(due));
+                });
+                if (!meta_queue_.empty()) {
+                    continue;
                 }
 
-                meta_queue_cv_.wait_until(lock, retry->first, [this] {
-                    return !meta_queue_.empty() || meta_stop_requested_ || agent_->isExiting();
+                auto deadline = retry_wheel_.next_deadline();
+                if (!exception_aggregator_.empty()) {
+                    deadline = std::min(deadline, exception_flush_at_);
+                }
+                // An exception arriving while only retries are held sets an
+                // earlier deadline, so it must end the wait too.
+                const auto had_exceptions = !exception_aggregator_.empty();
+                meta_queue_cv_.wait_until(lock, deadline, [this, had_exceptions] {
+                    return !meta_queue_.empty() || exception_aggregator_.empty() == had_exceptions ||
+                           has_failed_calls() || meta_stop_requested_ || agent_->isExiting();
                 });
             } else {
                 meta_queue_cv_.wait(lock, [this] {
-                    return !meta_queue_.empty() || !retry_queue_.empty() || meta_stop_requested_ || agent_->isExiting();
+                    return !meta_queue_.empty() || !retry_wheel_.empty() || !exception_aggregator_.empty() ||
+                           has_failed_calls() || meta_stop_requested_ || agent_->isExiting();
                 });
             }
         }
     }
 
+    // Caller must hold meta_queue_mutex_.
+    void GrpcMetadata::flush_exception_meta() {
+        const auto repeated = exception_aggregator_.repeatedCount();
+        const auto overflow = exception_aggregator_.overflowCount();
+        auto drained = exception_aggregator_.drain();
+        for (auto& m : drained) {
+            meta_queue_.push_back(PendingMeta{
+                std::make_unique<MetaData>(META_EXCEPTION, m.txid_, m.span_id_, m.url_template_, std::move(m.exceptions_)),
+                0, {}, watermark_->issue()});
+        }
+        LOG_DEBUG("flush exception metadata: spans={}, repeated callstacks={}, over limit={}",
+                  drained.size(), repeated, overflow);
+    }
+
     void GrpcMetadata::sendMetaWorker() try {
+        if (inflight_->max_permits > 1) {
+            send_meta_worker_pipelined();
+        } else {
+            send_meta_worker_sync();
+        }
+        LOG_INFO("send meta worker end");
+    } catch (const std::exception& e) {
+        LOG_ERROR("failed to send grpc meta: exception = {}", e.what());
+    } catch (...) {
+        LOG_ERROR("failed to send grpc meta: unknown exception");
+    }
+
+    void GrpcMetadata::send_meta_worker_sync() {
         while (true) {
             PendingMeta pending;
             {
@@ -513,28 +843,172 @@ namespace pinpoint {
 
             const auto sent = send_meta(*pending.meta) == SEND_OK;
             if (sent) {
+                watermark_->settle(pending.sequence);
                 continue;
             }
 
-            ++pending.retry_count;
             if (agent_->isExiting()) {
                 break;
             }
 
             std::unique_lock<std::mutex> lock(meta_queue_mutex_);
-            if (pending.retry_count <= METADATA_RETRY_MAX_ATTEMPTS) {
-                LOG_DEBUG("retry metadata send: retryCount={}/{}", pending.retry_count, METADATA_RETRY_MAX_ATTEMPTS);
-                schedule_retry(std::move(pending));
-            } else {
-                LOG_INFO("drop metadata after retry exhaustion: retryCount={}", pending.retry_count);
-                release_failed_cache(*pending.meta);
+            handle_send_failure(std::move(pending));
+        }
+    }
+
+    void GrpcMetadata::send_meta_worker_pipelined() {
+        LOG_INFO("send meta worker pipelined: maxConcurrentRequests={}", inflight_->max_permits);
+        while (true) {
+            PendingMeta pending;
+            {
+                std::unique_lock<std::mutex> lock(meta_queue_mutex_);
+                if (!pop_next_meta(pending, lock)) {
+                    break;
+                }
+            }
+
+            if (!acquire_meta_permit()) {
+                break;
+            }
+
+            if (send_meta_async(pending)) {
+                continue;
             }
+
+            if (agent_->isExiting()) {
+                break;
+            }
+
+            std::unique_lock<std::mutex> lock(meta_queue_mutex_);
+            handle_send_failure(std::move(pending));
+        }
+        await_in_flight_meta();
+    }
+
+    bool GrpcMetadata::acquire_meta_permit() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(inflight_->mutex);
+                if (inflight_->cv.wait_for(lock, METADATA_PERMIT_WAIT_SLICE, [this] { return inflight_->permits > 0; })) {
+                    --inflight_->permits;
+                    return true;
+                }
+            }
+            std::unique_lock<std::mutex> lock(meta_queue_mutex_);
+            if (meta_stop_requested_ || agent_->isExiting()) {
+                return false;
+            }
+        }
+    }
+
+    bool GrpcMetadata::send_meta_async(PendingMeta& pending) {
+        // The permit is held on entry. Every path that does not launch the
+        // call must return it; once launched, the completion callback does.
+        auto release_permit = [this] {
+            {
+                std::lock_guard<std::mutex> lock(inflight_->mutex);
+                ++inflight_->permits;
+            }
+            inflight_->cv.notify_one();
+        };
+
+        if (!readyChannel()) {
+            release_permit();
+            return false;
+        }
+
+        std::shared_ptr<PendingMetaCall> call;
+        try {
+            call = std::make_shared<PendingMetaCall>();
+            build_grpc_context(&call->ctx, 0);
+            set_request_deadline(call->ctx);
+            call->retry_count = pending.retry_count;
+            call->sequence = pending.sequence;
+            {
+                std::lock_guard<std::mutex> lock(inflight_->mutex);
+                inflight_->pending.push_back(call);
+            }
+
+            // Move the payload into the call before launching: the callback
+            // may run (and hand the call back as failed) before this returns.
+            call->meta = std::move(pending.meta);
+            auto* arena = &call->arena;
+            auto* async_stub = meta_stub_->async();
+            std::visit([&](const auto& value) {
+                using T = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<T, ApiMeta>) {
+                    auto* request = google::protobuf::Arena::Create<v1::PApiMetaData>(arena);
+                    fill_api_meta(value, request);
+                    async_stub->RequestApiMetaData(&call->ctx, request, &call->reply,
+                                                   make_meta_callback(inflight_, call, "api"));
+                } else if constexpr (std::is_same_v<T, StringMeta>) {
+                    if (value.type_ == STRING_META_ERROR) {
+                        auto* request = google::protobuf::Arena::Create<v1::PStringMetaData>(arena);
+                        fill_error_meta(value, request);
+                        async_stub->RequestStringMetaData(&call->ctx, request, &call->reply,
+                                                          make_meta_callback(inflight_, call, "error"));
+                    } else {
+                        auto* request = google::protobuf::Arena::Create<v1::PSqlMetaData>(arena);
+                        fill_sql_meta(value, request);
+                        async_stub->RequestSqlMetaData(&call->ctx, request, &call->reply,
+                                                       make_meta_callback(inflight_, call, "sql"));
+                    }
+                } else if constexpr (std::is_same_v<T, SqlUidMeta>) {
+                    auto* request = google::protobuf::Arena::Create<v1::PSqlUidMetaData>(arena);
+                    fill_sql_uid_meta(value, request);
+                    async_stub->RequestSqlUidMetaData(&call->ctx, request, &call->reply,
+                                                      make_meta_callback(inflight_, call, "sql uid"));
+                } else if constexpr (std::is_same_v<T, ExceptionMeta>) {
+                    auto* request = build_exception_metadata(value.txid_, value.span_id_, value.url_template_,
+                                                             value.exceptions_, arena);
+                    async_stub->RequestExceptionMetaData(&call->ctx, request, &call->reply,
+                                                         make_meta_callback(inflight_, call, "exception"));
+                }
+            }, call->meta->value_);
+            return true;
+        } catch (const std::exception& e) {
+            LOG_ERROR("failed to send metadata asynchronously: exception = {}", e.what());
+            // The call was never launched: take the payload back for retry and
+            // drop the call from the registry before returning the permit.
+            if (call) {
+                if (call->meta) {
+                    pending.meta = std::move(call->meta);
+                }
+                std::lock_guard<std::mutex> lock(inflight_->mutex);
+                auto& pending_calls = inflight_->pending;
+                pending_calls.erase(std::remove(pending_calls.begin(), pending_calls.end(), call),
+                                    pending_calls.end());
+            }
+            release_permit();
+            return false;
+        }
+    }
+
+    void GrpcMetadata::await_in_flight_meta() {
+        auto all_permits_returned = [this] {
+            std::unique_lock<std::mutex> lock(inflight_->mutex);
+            return inflight_->cv.wait_for(lock, METADATA_SHUTDOWN_AWAIT_TIMEOUT, [this] {
+                return inflight_->permits >= inflight_->max_permits;
+            });
+        };
+        if (all_permits_returned()) {
+            return;
+        }
+
+        std::vector<std::shared_ptr<PendingMetaCall>> stragglers;
+        {
+            std::lock_guard<std::mutex> lock(inflight_->mutex);
+            stragglers = inflight_->pending;
+        }
+        LOG_WARN("timed out waiting for in-flight metadata requests; cancelling {} request(s)",
+                 stragglers.size());
+        for (const auto& call : stragglers) {
+            call->ctx.TryCancel();
+        }
+
+        if (!all_permits_returned()) {
+            LOG_WARN("in-flight metadata requests still pending after cancellation");
         }
-        LOG_INFO("send meta worker end");
-    } catch (const std::exception& e) {
-        LOG_ERROR("failed to send grpc meta: exception = {}", e.what());
-    } catch (...) {
-        LOG_ERROR("failed to send grpc meta: unknown exception");
     }
 
     void GrpcMetadata::stopMetaWorker() {
@@ -1383,6 +1857,12 @@ namespace pinpoint {
             return;
         }
 
+        if (meta_watermark_ != nullptr && config_->span.batch.metadata_barrier_timeout_ms > 0) {
+            // Any metadata this span references was queued on the recording
+            // path before the span finished, so it is covered by issued().
+            span->setMetaSequence(meta_watermark_->issued());
+        }
+
         {
             std::unique_lock<std::mutex> lock(span_queue_mutex_);
 
@@ -1455,6 +1935,34 @@ namespace pinpoint {
                   buffer.size(), batch_size, span_queue_.size());
     }
 
+    void GrpcSpan::resolve_sql_queries(std::vector<std::unique_ptr<SpanChunk>>& batch) {
+        const bool barrier = meta_watermark_ != nullptr && config_->span.batch.metadata_barrier_timeout_ms > 0;
+        for (auto& chunk : batch) {
+            // SQL metadata queued here was not covered when the chunk was
+            // enqueued, so move its barrier past it.
+            if (chunk->resolveSqlQueries() && barrier) {
+                chunk->setMetaSequence(meta_watermark_->issued());
+            }
+        }
+    }
+
+    void GrpcSpan::wait_for_metadata(const std::vector<std::unique_ptr<SpanChunk>>& batch) {
+        const auto timeout_ms = config_->span.batch.metadata_barrier_timeout_ms;
+        if (timeout_ms <= 0 || meta_watermark_ == nullptr) {
+            return;
+        }
+
+        uint64_t required = 0;
+        for (const auto& chunk : batch) {
+            required = std::max(required, chunk->getMetaSequence());
+        }
+        if (meta_watermark_->wait_for(required, std::chrono::milliseconds(timeout_ms))) {
+            return;
+        }
+        LOG_DEBUG("span batch sent ahead of metadata: required={} acknowledged={} timeout={}ms",
+                  required, meta_watermark_->watermark(), timeout_ms);
+    }
+
     void GrpcSpan::send_batch_async(std::vector<std::unique_ptr<SpanChunk>>& batch) try {
         if (batch.empty()) {
             return;
@@ -1590,6 +2098,7 @@ namespace pinpoint {
             // the channel state directly and send only over a live connection.
             if (channel_->GetState(false) == GRPC_CHANNEL_READY) {
                 LOG_INFO("flushing {} remaining spans on shutdown", remaining.size());
+                resolve_sql_queries(remaining);
                 const auto batch_size = std::max<size_t>(1, static_cast<size_t>(config_->span.batch.size));
                 std::vector<std::unique_ptr<SpanChunk>> batch;
                 batch.reserve(std::min(batch_size, remaining.size()));
@@ -1618,6 +2127,8 @@ namespace pinpoint {
             }
 
             if (readyChannel()) {
+                resolve_sql_queries(batch);
+                wait_for_metadata(batch);
                 send_batch_async(batch);
             }
         }
@@ -1630,6 +2141,11 @@ namespace pinpoint {
     }
 
     void GrpcSpan::stopSpanWorker() {
+        // The worker may be parked on the metadata barrier rather than on the
+        // queue; release it so shutdown does not wait out the barrier timeout.
+        if (meta_watermark_ != nullptr) {
+            meta_watermark_->interrupt();
+        }
         std::unique_lock<std::mutex> lock(span_queue_mutex_);
         span_queue_cv_.notify_all();
     }
@@ -1738,6 +2254,8 @@ namespace pinpoint {
         stream_cv_.notify_one();
     }
 
+    constexpr size_t MAX_STATS_QUEUE_SIZE = 2;
+
     GrpcStreamStatus GrpcStats::next_write() try {
         LOG_DEBUG("stats - next_write");
         // should be hold stream_mutex_
@@ -1754,10 +2272,26 @@ namespace pinpoint {
             stats_queue_.pop();
         }
 
-        msg_ = google::protobuf::Arena::Create<v1::PStatMessage>(&arena_);
         if (stats == AGENT_STATS) {
-            msg_->unsafe_arena_set_allocated_agentstatbatch(build_agent_stat_batch(agent_->getAgentStats().getSnapshots(), &arena_));
+            // One batch per message. Snapshots retained while the stream was
+            // down are sent by re-queueing until the backlog is below a batch.
+            auto& agent_stats = agent_->getAgentStats();
+            const auto batch_count = static_cast<size_t>(config_->stat.batch_count);
+            agent_stat_batch_.clear();
+            if (agent_stats.takeSnapshots(agent_stat_batch_, batch_count) == 0) {
+                LOG_DEBUG("stats - no agent stats pending");
+                return STREAM_CONTINUE;
+            }
+            if (agent_stats.pendingSnapshots() >= batch_count) {
+                std::unique_lock<std::mutex> lock(stats_queue_mutex_);
+                if (stats_queue_.size() < MAX_STATS_QUEUE_SIZE) {
+                    stats_queue_.push(AGENT_STATS);
+                }
+            }
+            msg_ = google::protobuf::Arena::Create<v1::PStatMessage>(&arena_);
+            msg_->unsafe_arena_set_allocated_agentstatbatch(build_agent_stat_batch(agent_stat_batch_, &arena_));
         } else {
+            msg_ = google::protobuf::Arena::Create<v1::PStatMessage>(&arena_);
             auto snapshot = agent_->getUrlStats().takeSnapshot();
             msg_->unsafe_arena_set_allocated_agenturistat(build_url_stat(snapshot.get(), &arena_));
         }
@@ -1768,8 +2302,6 @@ namespace pinpoint {
         return STREAM_EXCEPTION;
     }
 
-    constexpr size_t MAX_STATS_QUEUE_SIZE = 2;
-
     void GrpcStats::enqueueStats(const StatsType stats) noexcept try {
         const auto& config = config_;
         if (!config->stat.enable && !config->http.url_stat.enable) {
@@ -1800,9 +2332,9 @@ namespace pinpoint {
             
             stats_queue_.swap(temp_queue);
         }
-        
-        agent_->getAgentStats().initAgentStats();
-        // clear URL stat snapshot
+
+        // Agent stats stay in their snapshot ring and go out with the next
+        // batch; only the URL stat snapshot is stale.
         (void)agent_->getUrlStats().takeSnapshot();
     } catch (const std::exception &e) {
         LOG_ERROR("failed to empty stats queue: exception = {}", e.what());
@@ -19,13 +19,13 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
-#include <map>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <deque>
 #include <queue>
 #include <random>
+#include <set>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -46,6 +46,8 @@
 #include "agent_service.h"
 #include "callstack.h"
 #include "span.h"
+#include "stat.h"
+#include "timing_wheel.h"
 
 namespace pinpoint {
     /**
@@ -251,13 +253,102 @@ namespace pinpoint {
             : meta_type_(meta_type), value_(ExceptionMeta(txid, span_id, url_template, std::move(exceptions))) {}
     };
 
+    /**
+     * @brief Collects exception metadata over an interval and sends each call stack once.
+     *
+     * Call stacks are fingerprinted over their frames. The first occurrence of
+     * a call stack in an interval is kept with its full stack. Later ones, and
+     * new stacks once @c max_unique_stacks were seen, keep their id, class name
+     * and message but carry one marker frame instead of their frames, because
+     * span annotations reference every exception id. Exceptions reported for
+     * the same span are merged into one payload.
+     *
+     * Not thread-safe; GrpcMetadata guards it with its queue mutex.
+     */
+    class ExceptionMetaAggregator {
+    public:
+        explicit ExceptionMetaAggregator(size_t max_unique_stacks) : max_unique_stacks_(max_unique_stacks) {}
+
+        /// @brief Adds a span's exceptions to the current interval.
+        void add(ExceptionMeta&& meta);
+        /// @brief Returns the collected payloads and starts a new interval.
+        std::vector<ExceptionMeta> drain();
+
+        /// @brief Number of span payloads held.
+        size_t size() const { return pending_.size(); }
+        bool empty() const { return pending_.empty(); }
+        /// @brief Repeats of an already kept call stack in the current interval.
+        size_t repeatedCount() const { return repeated_count_; }
+        /// @brief New call stacks sent without frames in the current interval because of @c max_unique_stacks.
+        size_t overflowCount() const { return overflow_count_; }
+
+        /// @brief Hashes a call stack's frames; the error message is not part of it.
+        static uint64_t fingerprint(const CallStack& callstack);
+
+    private:
+        size_t max_unique_stacks_;
+        std::vector<ExceptionMeta> pending_{};
+        std::unordered_map<int64_t, size_t> span_index_{};
+        // Fingerprint -> first exception with that stack, owned by pending_.
+        std::unordered_map<uint64_t, const Exception*> seen_stacks_{};
+        size_t repeated_count_{0};
+        size_t overflow_count_{0};
+    };
+
+    /**
+     * @brief Sequence numbers for queued metadata and the low watermark of settled ones.
+     *
+     * Every metadata payload is issued a sequence number when it is queued and
+     * settled once the collector acknowledges it or it is finally dropped.
+     * watermark() is the highest sequence at or below which everything is
+     * settled; settles may arrive out of order in the pipelined mode.
+     * GrpcSpan uses it to hold back span batches that may reference metadata
+     * the collector has not seen yet.
+     */
+    class MetaWatermark {
+    public:
+        /// @brief Issues the next sequence number.
+        uint64_t issue();
+        /// @brief Returns the last issued sequence number.
+        uint64_t issued() const;
+        /// @brief Marks a sequence number as acknowledged or dropped.
+        void settle(uint64_t sequence);
+        /// @brief Returns the highest sequence with no unsettled sequence at or below it.
+        uint64_t watermark() const;
+        /**
+         * @brief Waits until watermark() reaches @p sequence.
+         *
+         * @return false when @p timeout elapses first or the wait is interrupted.
+         */
+        bool wait_for(uint64_t sequence, std::chrono::milliseconds timeout);
+        /// @brief Wakes every waiter and makes later waits return at once; used on shutdown.
+        void interrupt();
+
+    private:
+        mutable std::mutex mutex_{};
+        std::condition_variable cv_{};
+        uint64_t issued_{0};
+        uint64_t watermark_{0};
+        bool interrupted_{false};
+        std::set<uint64_t> settled_ahead_{};
+    };
+
     /**
      * @brief gRPC client responsible for metadata upload.
+     *
+     * With @c metadata.max_concurrent_requests at 1 each payload is sent as a
+     * blocking unary RPC. Above 1 the worker switches to the callback-based
+     * async stub and keeps up to that many RPCs in flight, using the same
+     * permit semaphore and shutdown cancellation scheme as GrpcSpan. Failed
+     * async calls are handed back to the worker, which applies the usual
+     * retry and cache-eviction policy.
      */
+    struct MetaCallInflight;
+
     class GrpcMetadata : public GrpcClient {
     public:
         explicit GrpcMetadata(std::shared_ptr<const Config> config);
-        ~GrpcMetadata() override = default;
+        ~GrpcMetadata() override;
 
         /**
          * @brief Adds metadata to the outbound queue.
@@ -265,10 +356,22 @@ namespace pinpoint {
          * @param meta Metadata payload (ownership transferred).
          */
         void enqueueMeta(std::unique_ptr<MetaData> meta) noexcept;
+        /**
+         * @brief Adds a batch of metadata to the outbound queue under a single lock.
+         *
+         * Unlike enqueueMeta(), the batch is not bounded by the sender queue size:
+         * every entry corresponds to a key already held in an agent cache, and
+         * dropping it would leave that key cached but never registered.
+         *
+         * @param metas Metadata payloads (ownership transferred).
+         */
+        void enqueueMetaBatch(std::vector<std::unique_ptr<MetaData>> metas) noexcept;
         /// @brief Worker loop that sends metadata payloads.
         void sendMetaWorker();
         /// @brief Stops the metadata worker loop.
         void stopMetaWorker();
+        /// @brief Returns the sequence tracker of queued and settled metadata.
+        std::shared_ptr<MetaWatermark> metaWatermark() const { return watermark_; }
 
     protected:
         void set_meta_stub(std::unique_ptr<v1::Metadata::StubInterface> stub) { meta_stub_ = std::move(stub); }
@@ -280,16 +383,29 @@ namespace pinpoint {
             std::unique_ptr<MetaData> meta;
             int retry_count{0};
             std::chrono::steady_clock::time_point available_at{};
+            uint64_t sequence{0};
         };
 
         std::unique_ptr<v1::Metadata::StubInterface> meta_stub_{};
 
         std::deque<PendingMeta> meta_queue_{};
-        std::multimap<std::chrono::steady_clock::time_point, PendingMeta> retry_queue_{};
+        // Failed sends waiting for their retry delay. During a collector outage
+        // every queued payload can end up here, so scheduling must stay O(1).
+        TimingWheel<PendingMeta> retry_wheel_;
         std::mutex meta_queue_mutex_{};
         std::condition_variable meta_queue_cv_{};
         bool meta_stop_requested_{false};
 
+        // Permits and in-flight call registry for the pipelined mode. Shared
+        // with the async completion callbacks, which never capture `this`.
+        std::shared_ptr<MetaCallInflight> inflight_{};
+        std::shared_ptr<MetaWatermark> watermark_{};
+
+        // Exception metadata held until exception_flush_at_ when
+        // metadata.exception_dedup_interval_ms is set; guarded by meta_queue_mutex_.
+        ExceptionMetaAggregator exception_aggregator_;
+        std::chrono::steady_clock::time_point exception_flush_at_{};
+
         template<typename Request, typename StubMethod>
         GrpcRequestStatus send_meta_helper(StubMethod stub_method, Request& request, std::string_view operation_name);
         GrpcRequestStatus send_api_meta(ApiMeta& api_meta);
@@ -300,7 +416,17 @@ namespace pinpoint {
         GrpcRequestStatus send_meta(MetaData& meta);
         void release_failed_cache(const MetaData& meta) const;
         void schedule_retry(PendingMeta&& pending);
+        void handle_send_failure(PendingMeta&& pending);
         bool pop_next_meta(PendingMeta& pending, std::unique_lock<std::mutex>& lock);
+        void flush_exception_meta();
+        bool has_failed_calls() const;
+        void drain_failed_calls();
+
+        void send_meta_worker_sync();
+        void send_meta_worker_pipelined();
+        bool acquire_meta_permit();
+        bool send_meta_async(PendingMeta& pending);
+        void await_in_flight_meta();
     };
 
     /**
@@ -524,6 +650,13 @@ namespace pinpoint {
         void sendSpanWorker();
         /// @brief Signals the worker loop to stop; the loop flushes pending spans before exiting.
         void stopSpanWorker();
+        /**
+         * @brief Links the metadata sequence tracker used by the ordering barrier.
+         *
+         * Must be called before spans are enqueued. Has no effect unless
+         * @c span.batch.metadata_barrier_timeout_ms is positive.
+         */
+        void setMetaWatermark(std::shared_ptr<MetaWatermark> watermark) { meta_watermark_ = std::move(watermark); }
 
     protected:
         void set_span_stub(std::unique_ptr<v1::Span::StubInterface> stub) { span_stub_ = std::move(stub); }
@@ -540,7 +673,10 @@ namespace pinpoint {
         // shutdown can cancel them. Heap-resident and shared with the async
         // completion callbacks so a late callback never touches this object.
         std::shared_ptr<SpanBatchInflight> inflight_{};
+        std::shared_ptr<MetaWatermark> meta_watermark_{};
 
+        void resolve_sql_queries(std::vector<std::unique_ptr<SpanChunk>>& batch);
+        void wait_for_metadata(const std::vector<std::unique_ptr<SpanChunk>>& batch);
         void collect_batch(std::vector<std::unique_ptr<SpanChunk>>& buffer);
         void send_batch_async(std::vector<std::unique_ptr<SpanChunk>>& batch);
         bool try_acquire_permit(std::chrono::milliseconds timeout);
@@ -585,6 +721,7 @@ namespace pinpoint {
         google::protobuf::Arena arena_{};
         v1::PStatMessage* msg_{};
         google::protobuf::Empty reply_{};
+        std::vector<AgentStatsSnapshot> agent_stat_batch_{};  // reused across writes
 
         std::queue<StatsType> stats_queue_{};
         std::mutex stats_queue_mutex_{};
@@ -236,6 +236,10 @@ namespace pinpoint {
             auto* total_thread = google::protobuf::Arena::Create<v1::PTotalThread>(arena);
             total_thread->set_totalthreadcount(stat.num_threads_);
             agent_stat->unsafe_arena_set_allocated_totalthread(total_thread);
+
+            auto* file_descriptor = google::protobuf::Arena::Create<v1::PFileDescriptor>(arena);
+            file_descriptor->set_openfiledescriptorcount(stat.open_file_descriptors_);
+            agent_stat->unsafe_arena_set_allocated_filedescriptor(file_descriptor);
         }
 
         void build_url_histogram(v1::PUriHistogram* grpc_histogram, const UrlStatHistogram& url_histogram) {
@@ -247,10 +251,10 @@ namespace pinpoint {
         }
 
         void build_each_url_stat(v1::PEachUriStat* url_stat,
-                                 const UrlKey& key,
+                                 const std::string& uri,
                                  EachUrlStat* each_stats,
                                  google::protobuf::Arena* arena) {
-            url_stat->set_uri(key.url_);
+            url_stat->set_uri(uri);
 
             auto* total = google::protobuf::Arena::Create<v1::PUriHistogram>(arena);
             build_url_histogram(total, each_stats->getTotalHistogram());
@@ -371,7 +375,7 @@ namespace pinpoint {
         const auto& m = snapshot->getEachStats();
         for (const auto& [key, each_stats] : m) {
             auto* url_stat = uri_stat->add_eachuristat();
-            build_each_url_stat(url_stat, key, each_stats.get(), arena);
+            build_each_url_stat(url_stat, snapshot->url(key), each_stats.get(), arena);
         }
         return uri_stat;
     }
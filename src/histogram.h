@@ -0,0 +1,126 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace pinpoint {
+
+    /**
+     * @brief Fixed-size log-linear histogram with lock-free recording (HdrHistogram-like).
+     *
+     * Values below 16 get one bucket each. Every power-of-two range above that
+     * is split into 16 equal buckets, so a bucket's width is at most 1/16 of its
+     * lower bound and a reported percentile is within 6.25% of the recorded
+     * value. Values from 2^32 up share the last bucket. record() is a single
+     * relaxed fetch_add; memory is constant (kBucketCount counters).
+     */
+    class LogLinearHistogram {
+    public:
+        static constexpr int kSubBucketBits = 4;
+        static constexpr int64_t kSubBucketCount = int64_t{1} << kSubBucketBits;
+        static constexpr int kMaxValueBits = 32;
+        static constexpr size_t kBucketCount = (kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount;
+
+        /**
+         * @brief Plain bucket counts drained from one or more histograms.
+         */
+        struct Snapshot {
+            std::array<uint64_t, kBucketCount> counts{};
+            uint64_t total{0};
+            int64_t max{0};
+
+            /**
+             * @brief Returns the value at or below which @p percentile percent of
+             *        the recorded values fall, reported as the upper bound of its
+             *        bucket and capped at the largest value recorded.
+             *
+             * Returns 0 when nothing was recorded.
+             */
+            int64_t percentile(double percentile) const {
+                if (total == 0) {
+                    return 0;
+                }
+                const auto clamped = std::clamp(percentile, 0.0, 100.0);
+                auto rank = static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(total) + 0.5);
+                rank = std::clamp<uint64_t>(rank, 1, total);
+                uint64_t seen = 0;
+                for (size_t i = 0; i < kBucketCount; ++i) {
+                    seen += counts[i];
+                    if (seen >= rank) {
+                        return std::min(bucket_upper(i), max);
+                    }
+                }
+                return max;
+            }
+        };
+
+        /// @brief Maps a value to its bucket; negative values count as 0.
+        static size_t bucket_index(int64_t value) {
+            if (value < kSubBucketCount) {
+                return value < 0 ? 0 : static_cast<size_t>(value);
+            }
+            if (value >= (int64_t{1} << kMaxValueBits)) {
+                return kBucketCount - 1;
+            }
+            const auto msb = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+            const auto shift = msb - kSubBucketBits;
+            const auto sub = (value >> shift) & (kSubBucketCount - 1);
+            return static_cast<size_t>((shift + 1) * kSubBucketCount + sub);
+        }
+
+        /// @brief Returns the largest value that maps to bucket @p index.
+        static int64_t bucket_upper(size_t index) {
+            const auto group = static_cast<int64_t>(index) / kSubBucketCount;
+            const auto sub = static_cast<int64_t>(index) % kSubBucketCount;
+            if (group == 0) {
+                return sub;
+            }
+            const auto width = int64_t{1} << (group - 1);
+            return (kSubBucketCount + sub) * width + width - 1;
+        }
+
+        void record(int64_t value) {
+            buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// @brief Adds this histogram's counts to @p out and resets them.
+        void drain_into(Snapshot& out) {
+            for (size_t i = 0; i < kBucketCount; ++i) {
+                const auto count = buckets_[i].exchange(0, std::memory_order_relaxed);
+                out.counts[i] += count;
+                out.total += count;
+            }
+        }
+
+        void reset() {
+            for (auto& bucket : buckets_) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        // 32-bit counters keep a shard's histogram under 2KB; one shard would
+        // need ~2^32 requests within a single collect interval to wrap.
+        std::array<std::atomic<uint32_t>, kBucketCount> buckets_{};
+    };
+
+}  // namespace pinpoint
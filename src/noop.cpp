@@ -55,7 +55,7 @@ namespace pinpoint {
         // Guard the deref to stay consistent with the null check on agent_ref_
         // above (agent_ is always the live AgentImpl in production).
         if (agent_ != nullptr) {
-            agent_->getAgentStats().addActiveSpan(span_id_, start_time_);
+            agent_->getAgentStats().addActiveSpan(active_slot_, start_time_);
         }
     }
 
@@ -79,12 +79,12 @@ namespace pinpoint {
 
         auto& stats = agent_->getAgentStats();
         stats.collectResponseTime(elapsed_);
-        stats.dropActiveSpan(span_id_);
+        stats.dropActiveSpan(active_slot_);
 
         if (url_stat_) {
             url_stat_->end_time_ = end_time_;
             url_stat_->elapsed_ = elapsed_;
-            agent_->recordUrlStat(std::move(*url_stat_));
+            agent_->recordUrlStat(*url_stat_);
             url_stat_.reset();
         }
     }
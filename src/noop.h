@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "pinpoint/tracer.h"
+#include "active_request.h"
 #include "agent_service.h"
 #include "url_stat.h"
 
@@ -171,6 +172,7 @@ namespace pinpoint {
         int64_t span_id_;
         int64_t start_time_;
         std::atomic<bool> finished_{false};
+        ActiveRequestSlot active_slot_;
         std::optional<UrlStatEntry> url_stat_;
         // Keeps the agent alive while user code still holds this span.
         std::shared_ptr<AgentService> agent_ref_;
@@ -192,6 +194,7 @@ namespace pinpoint {
             TraceContextReader& reader) override { return noopSpan(); }
 
         bool Enable() override { return false; }
+        void RegisterMetadata(const MetadataCatalog& catalog) override {}
         void Shutdown() override {}
     };
 
@@ -0,0 +1,348 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "proc_reader.h"
+
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "logging.h"
+
+namespace pinpoint {
+
+    // Large enough for /proc/self/status (~1.5KB) and /proc/stat's first line.
+    constexpr size_t kProcReadBufferSize = 4096;
+
+    ProcFile::~ProcFile() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    std::string_view ProcFile::read(char* buf, size_t size) {
+        if (failed_ || size == 0) {
+            return {};
+        }
+        const auto pid = getpid();
+        if (fd_ >= 0 && pid_ != pid) {
+            close(fd_);
+            fd_ = -1;
+        }
+        if (fd_ < 0) {
+            fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd_ < 0) {
+                LOG_DEBUG("{} is not available: errno={}", path_, errno);
+                failed_ = true;
+                return {};
+            }
+            pid_ = pid;
+        }
+
+        ssize_t n;
+        do {
+            n = pread(fd_, buf, size, 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            return {};
+        }
+        return std::string_view(buf, static_cast<size_t>(n));
+    }
+
+    namespace {
+        void skip_spaces(std::string_view& s) {
+            size_t i = 0;
+            while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) {
+                ++i;
+            }
+            s.remove_prefix(i);
+        }
+
+        // Consumes leading spaces and one unsigned decimal number.
+        bool take_number(std::string_view& s, int64_t& value) {
+            skip_spaces(s);
+            size_t i = 0;
+            int64_t v = 0;
+            while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+                v = v * 10 + (s[i] - '0');
+                ++i;
+            }
+            if (i == 0) {
+                return false;
+            }
+            s.remove_prefix(i);
+            value = v;
+            return true;
+        }
+
+        std::string_view next_line(std::string_view& s) {
+            const auto eol = s.find('\n');
+            const auto line = s.substr(0, eol);
+            s.remove_prefix(eol == std::string_view::npos ? s.size() : eol + 1);
+            return line;
+        }
+
+        bool starts_with(std::string_view s, std::string_view prefix) {
+            return s.substr(0, prefix.size()) == prefix;
+        }
+    }
+
+    namespace proc_parse {
+        bool cpu_ticks(std::string_view proc_stat, int64_t& ticks) {
+            auto line = next_line(proc_stat);
+            if (!starts_with(line, "cpu ")) {
+                return false;
+            }
+            line.remove_prefix(4);
+            int64_t user = 0, nice = 0, system = 0;
+            if (!take_number(line, user) || !take_number(line, nice) || !take_number(line, system)) {
+                return false;
+            }
+            ticks = user + nice + system;
+            return true;
+        }
+
+        bool status(std::string_view proc_status, int64_t& vm_peak, int64_t& threads) {
+            bool found_peak = false, found_threads = false;
+            while (!proc_status.empty() && !(found_peak && found_threads)) {
+                auto line = next_line(proc_status);
+                if (starts_with(line, "VmPeak:")) {
+                    line.remove_prefix(7);
+                    found_peak = take_number(line, vm_peak);
+                    vm_peak *= found_peak ? 1024 : 1;  // kB to bytes
+                } else if (starts_with(line, "Threads:")) {
+                    line.remove_prefix(8);
+                    found_threads = take_number(line, threads);
+                }
+            }
+            return found_peak && found_threads;
+        }
+
+        bool statm_resident(std::string_view statm, int64_t& resident_pages) {
+            int64_t size = 0;
+            return take_number(statm, size) && take_number(statm, resident_pages);
+        }
+
+        bool cgroup_cpu_stat(std::string_view cpu_stat, int64_t& usage_usec, int64_t& throttled_usec) {
+            bool found_usage = false;
+            throttled_usec = 0;  // absent when the cgroup has no CPU limit
+            while (!cpu_stat.empty()) {
+                auto line = next_line(cpu_stat);
+                if (starts_with(line, "usage_usec ")) {
+                    line.remove_prefix(11);
+                    found_usage = take_number(line, usage_usec);
+                } else if (starts_with(line, "throttled_usec ")) {
+                    line.remove_prefix(15);
+                    take_number(line, throttled_usec);
+                }
+            }
+            return found_usage;
+        }
+
+        bool single_value(std::string_view content, int64_t& value) {
+            return take_number(content, value);
+        }
+
+        std::string_view cgroup_v2_path(std::string_view proc_cgroup) {
+            while (!proc_cgroup.empty()) {
+                const auto line = next_line(proc_cgroup);
+                if (starts_with(line, "0::")) {
+                    return line.substr(3);
+                }
+            }
+            return {};
+        }
+
+        bool cgroup_v1_entry(std::string_view proc_cgroup, std::string_view controller,
+                             std::string_view& controllers, std::string_view& path) {
+            // Lines look like "4:cpu,cpuacct:/kubepods/pod1/c1".
+            while (!proc_cgroup.empty()) {
+                auto line = next_line(proc_cgroup);
+                const auto first = line.find(':');
+                const auto second = first == std::string_view::npos ? first : line.find(':', first + 1);
+                if (second == std::string_view::npos) {
+                    continue;
+                }
+                auto list = line.substr(first + 1, second - first - 1);
+                const auto all = list;
+                while (!list.empty()) {
+                    const auto comma = list.find(',');
+                    if (list.substr(0, comma) == controller) {
+                        controllers = all;
+                        path = line.substr(second + 1);
+                        return true;
+                    }
+                    list.remove_prefix(comma == std::string_view::npos ? list.size() : comma + 1);
+                }
+            }
+            return false;
+        }
+
+        bool cgroup_cpu_max(std::string_view cpu_max, int64_t& quota, int64_t& period) {
+            skip_spaces(cpu_max);
+            if (starts_with(cpu_max, "max")) {
+                cpu_max.remove_prefix(3);
+                quota = -1;
+                return take_number(cpu_max, period);
+            }
+            return take_number(cpu_max, quota) && take_number(cpu_max, period);
+        }
+
+        bool key_value(std::string_view content, std::string_view key, int64_t& value) {
+            while (!content.empty()) {
+                auto line = next_line(content);
+                if (starts_with(line, key) && line.size() > key.size() && line[key.size()] == ' ') {
+                    line.remove_prefix(key.size());
+                    return take_number(line, value);
+                }
+            }
+            return false;
+        }
+    }
+
+    ProcSampler::Paths ProcSampler::resolve(std::string_view proc_root, std::string_view cgroup_root) {
+        Paths paths{std::string(proc_root), {}, {}};
+        char buf[kProcReadBufferSize];
+        ProcFile proc_cgroup(std::string(proc_root) + "/self/cgroup");
+        const auto content = proc_cgroup.read(buf, sizeof(buf));
+        const std::string root(cgroup_root);
+
+        // Without a cgroup namespace the path is the host's and may not be
+        // mounted inside a container; the mount root is then this cgroup.
+        const auto v2_path = proc_parse::cgroup_v2_path(content);
+        for (const auto& dir : {root + std::string(v2_path), root}) {
+            if (access((dir + "/cpu.stat").c_str(), R_OK) == 0) {
+                paths.cgroup_dir = dir;
+                break;
+            }
+        }
+
+        std::string_view controllers, v1_path;
+        if (paths.cgroup_dir.empty() && proc_parse::cgroup_v1_entry(content, "cpu", controllers, v1_path)) {
+            const auto mount = root + "/" + std::string(controllers);
+            for (const auto& dir : {mount + std::string(v1_path), mount, root + "/cpu"}) {
+                if (access((dir + "/cpu.cfs_quota_us").c_str(), R_OK) == 0) {
+                    paths.cgroup_v1_cpu_dir = dir;
+                    break;
+                }
+            }
+        }
+        return paths;
+    }
+
+    ProcSampler::ProcSampler() : ProcSampler("/proc", "/sys/fs/cgroup") {}
+
+    ProcSampler::ProcSampler(std::string_view proc_root, std::string_view cgroup_root)
+        : ProcSampler(resolve(proc_root, cgroup_root)) {}
+
+    ProcSampler::ProcSampler(Paths paths)
+        : stat_(paths.proc_root + "/stat"),
+          status_(paths.proc_root + "/self/status"),
+          statm_(paths.proc_root + "/self/statm"),
+          cgroup_cpu_stat_(paths.cgroup_dir + "/cpu.stat"),
+          cgroup_memory_current_(paths.cgroup_dir + "/memory.current"),
+          cgroup_cpu_max_(paths.cgroup_dir + "/cpu.max"),
+          cgroup_v1_quota_(paths.cgroup_v1_cpu_dir + "/cpu.cfs_quota_us"),
+          cgroup_v1_period_(paths.cgroup_v1_cpu_dir + "/cpu.cfs_period_us"),
+          cgroup_v1_cpu_stat_(paths.cgroup_v1_cpu_dir + "/cpu.stat"),
+          fd_dir_(paths.proc_root + "/self/fd"),
+          page_size_(sysconf(_SC_PAGESIZE)),
+          has_cgroup_(!paths.cgroup_dir.empty()),
+          has_cgroup_v1_cpu_(!paths.cgroup_v1_cpu_dir.empty()) {}
+
+    int64_t ProcSampler::systemCpuTicks() {
+        char buf[kProcReadBufferSize];
+        int64_t ticks = -1;
+        if (!proc_parse::cpu_ticks(stat_.read(buf, sizeof(buf)), ticks)) {
+            return -1;
+        }
+        return ticks;
+    }
+
+    ProcSampler::Sample ProcSampler::sample() {
+        Sample s;
+        char buf[kProcReadBufferSize];
+
+        int64_t vm_peak = 0, threads = 0;
+        if (proc_parse::status(status_.read(buf, sizeof(buf)), vm_peak, threads)) {
+            s.vm_peak_bytes = vm_peak;
+            s.num_threads = threads;
+        }
+
+        int64_t resident_pages = 0;
+        if (proc_parse::statm_resident(statm_.read(buf, sizeof(buf)), resident_pages)) {
+            s.rss_bytes = resident_pages * page_size_;
+        }
+
+        if (has_cgroup_) {
+            int64_t usage = 0, throttled = 0;
+            if (proc_parse::cgroup_cpu_stat(cgroup_cpu_stat_.read(buf, sizeof(buf)), usage, throttled)) {
+                s.cgroup_cpu_usage_usec = usage;
+                s.cgroup_cpu_throttled_usec = throttled;
+            }
+            int64_t memory = 0;
+            if (proc_parse::single_value(cgroup_memory_current_.read(buf, sizeof(buf)), memory)) {
+                s.cgroup_memory_bytes = memory;
+            }
+        } else if (has_cgroup_v1_cpu_) {
+            int64_t throttled_ns = 0;
+            if (proc_parse::key_value(cgroup_v1_cpu_stat_.read(buf, sizeof(buf)), "throttled_time", throttled_ns)) {
+                s.cgroup_cpu_throttled_usec = throttled_ns / 1000;
+            }
+        }
+        return s;
+    }
+
+    double ProcSampler::cpuLimit() {
+        char buf[kProcReadBufferSize];
+        int64_t quota = -1, period = 0;
+        if (has_cgroup_) {
+            if (!proc_parse::cgroup_cpu_max(cgroup_cpu_max_.read(buf, sizeof(buf)), quota, period)) {
+                return 0;
+            }
+        } else if (has_cgroup_v1_cpu_) {
+            // cfs_quota_us is "-1" when unlimited, which take_number rejects.
+            if (!proc_parse::single_value(cgroup_v1_quota_.read(buf, sizeof(buf)), quota) ||
+                !proc_parse::single_value(cgroup_v1_period_.read(buf, sizeof(buf)), period)) {
+                return 0;
+            }
+        }
+        if (quota <= 0 || period <= 0) {
+            return 0;
+        }
+        return static_cast<double>(quota) / static_cast<double>(period);
+    }
+
+    int64_t ProcSampler::openFileDescriptors() {
+        DIR* dir = opendir(fd_dir_.c_str());
+        if (dir == nullptr) {
+            return -1;
+        }
+        const auto self = std::to_string(dirfd(dir));
+
+        int64_t count = 0;
+        while (const auto* entry = readdir(dir)) {
+            if (entry->d_name[0] == '.' || self == entry->d_name) {
+                continue;
+            }
+            ++count;
+        }
+        closedir(dir);
+        return count;
+    }
+
+}  // namespace pinpoint
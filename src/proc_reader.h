@@ -0,0 +1,158 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+namespace pinpoint {
+
+    /**
+     * @brief A /proc or cgroup file kept open and re-read from offset 0.
+     *
+     * The file is opened on the first read() and kept open, so each sample is
+     * a single pread() into the caller's buffer with no FILE allocation. If the
+     * process forked since the file was opened, it is reopened so /proc/self
+     * refers to the current process. A file that cannot be opened (e.g. no
+     * cgroup v2 mount) is not retried.
+     */
+    class ProcFile {
+    public:
+        explicit ProcFile(std::string path) : path_(std::move(path)) {}
+        ~ProcFile();
+        ProcFile(const ProcFile&) = delete;
+        ProcFile& operator=(const ProcFile&) = delete;
+
+        /**
+         * @brief Reads the file into @p buf.
+         *
+         * @return The bytes read; empty if the file is unavailable. Content
+         *         longer than the buffer is truncated.
+         */
+        std::string_view read(char* buf, size_t size);
+
+        const std::string& path() const { return path_; }
+
+    private:
+        std::string path_;
+        int fd_{-1};
+        pid_t pid_{0};
+        bool failed_{false};
+    };
+
+    /// @brief Hand-rolled parsers for the files ProcSampler reads; each returns false on malformed input.
+    namespace proc_parse {
+        /// @brief Parses the aggregate "cpu" line of /proc/stat into user+nice+system ticks.
+        bool cpu_ticks(std::string_view proc_stat, int64_t& ticks);
+        /// @brief Parses VmPeak (bytes) and Threads from /proc/self/status.
+        bool status(std::string_view proc_status, int64_t& vm_peak, int64_t& threads);
+        /// @brief Parses the resident page count from /proc/self/statm.
+        bool statm_resident(std::string_view statm, int64_t& resident_pages);
+        /// @brief Parses usage_usec and throttled_usec from a cgroup v2 cpu.stat.
+        bool cgroup_cpu_stat(std::string_view cpu_stat, int64_t& usage_usec, int64_t& throttled_usec);
+        /// @brief Parses a single integer file such as memory.current.
+        bool single_value(std::string_view content, int64_t& value);
+        /// @brief Returns the cgroup v2 path ("0::<path>" line) from /proc/self/cgroup, or empty.
+        std::string_view cgroup_v2_path(std::string_view proc_cgroup);
+        /**
+         * @brief Finds the cgroup v1 hierarchy holding @p controller in /proc/self/cgroup.
+         *
+         * @param controllers Receives the hierarchy's controller list, e.g. "cpu,cpuacct".
+         * @param path Receives the cgroup path inside that hierarchy.
+         */
+        bool cgroup_v1_entry(std::string_view proc_cgroup, std::string_view controller,
+                             std::string_view& controllers, std::string_view& path);
+        /// @brief Parses a cgroup v2 cpu.max; @p quota is -1 for "max" (no limit).
+        bool cgroup_cpu_max(std::string_view cpu_max, int64_t& quota, int64_t& period);
+        /// @brief Parses the value of a "key value" line, as in cgroup v1 cpu.stat.
+        bool key_value(std::string_view content, std::string_view key, int64_t& value);
+    }
+
+    /**
+     * @brief Samples process and container resource usage for AgentStats (Linux only).
+     *
+     * Reads /proc/stat, /proc/self/status, /proc/self/statm and, when the process
+     * is in a cgroup v2 hierarchy, the cgroup's cpu.stat, cpu.max and
+     * memory.current. Under cgroup v1 the cpu controller's CFS quota and
+     * throttled time are read instead. Values that are unavailable are reported
+     * as -1. On other platforms every read fails and callers keep their own
+     * fallbacks.
+     *
+     * Not thread-safe; AgentStats samples from its single worker thread.
+     */
+    class ProcSampler {
+    public:
+        ProcSampler();
+        /// @brief Uses @p proc_root and @p cgroup_root instead of /proc and /sys/fs/cgroup (tests).
+        ProcSampler(std::string_view proc_root, std::string_view cgroup_root);
+
+        struct Sample {
+            int64_t rss_bytes{-1};
+            int64_t vm_peak_bytes{-1};
+            int64_t num_threads{-1};
+            int64_t cgroup_cpu_usage_usec{-1};
+            int64_t cgroup_cpu_throttled_usec{-1};
+            int64_t cgroup_memory_bytes{-1};
+        };
+
+        /// @brief Reads the system-wide user+nice+system ticks from /proc/stat; -1 if unavailable.
+        int64_t systemCpuTicks();
+        /// @brief Reads every per-process and cgroup source once.
+        Sample sample();
+        /**
+         * @brief Returns the cgroup CPU quota in CPUs (quota / period).
+         *
+         * Re-read on every call, since the quota can be resized at runtime.
+         * Returns 0 when there is no quota or no cgroup.
+         */
+        double cpuLimit();
+        /// @brief Counts the open descriptors in /proc/self/fd, excluding the one used to list it; -1 if unavailable.
+        int64_t openFileDescriptors();
+
+        /// @brief Whether a cgroup v2 directory with cpu.stat was found.
+        bool hasCgroup() const { return has_cgroup_; }
+        /// @brief Whether a cgroup v1 cpu controller directory was found.
+        bool hasCgroupV1Cpu() const { return has_cgroup_v1_cpu_; }
+
+    private:
+        struct Paths {
+            std::string proc_root;
+            std::string cgroup_dir;         // empty without cgroup v2
+            std::string cgroup_v1_cpu_dir;  // empty without a cgroup v1 cpu controller
+        };
+        explicit ProcSampler(Paths paths);
+        static Paths resolve(std::string_view proc_root, std::string_view cgroup_root);
+
+        ProcFile stat_;
+        ProcFile status_;
+        ProcFile statm_;
+        ProcFile cgroup_cpu_stat_;
+        ProcFile cgroup_memory_current_;
+        ProcFile cgroup_cpu_max_;
+        ProcFile cgroup_v1_quota_;
+        ProcFile cgroup_v1_period_;
+        ProcFile cgroup_v1_cpu_stat_;
+        std::string fd_dir_;
+        int64_t page_size_;
+        bool has_cgroup_{false};
+        bool has_cgroup_v1_cpu_{false};
+    };
+
+}  // namespace pinpoint
@@ -157,6 +157,17 @@ namespace pinpoint {
         span_data_->takeFinishedEvents(event_chunk_);
     }
 
+    bool SpanChunk::resolveSqlQueries() {
+        bool resolved = false;
+        for (const auto& se : event_chunk_) {
+            if (se->hasPendingSqlQuery()) {
+                se->resolveSqlQueries();
+                resolved = true;
+            }
+        }
+        return resolved;
+    }
+
     void SpanChunk::optimizeSpanEvents() {
         if (event_chunk_.empty()) {
             return;
@@ -341,7 +352,7 @@ namespace pinpoint {
             data_->finishSpanEvent(); //async span event
         } else {
             auto& stats = agent_->getAgentStats();
-            stats.dropActiveSpan(data_->getSpanId());
+            stats.dropActiveSpan(active_slot_);
             stats.collectResponseTime(data_->getElapsed());
             sendExceptions();
             sendUrlStat();
@@ -437,7 +448,7 @@ namespace pinpoint {
             data_->setRemoteAddr(v);
         }
 
-        agent_->getAgentStats().addActiveSpan(data_->getSpanId(), data_->getStartTime());
+        agent_->getAgentStats().addActiveSpan(active_slot_, data_->getStartTime());
     }
 
     SpanPtr SpanImpl::NewAsyncSpan(std::string_view async_operation) try {
@@ -549,7 +560,7 @@ namespace pinpoint {
         url_stat_->end_time_ = data_->getEndTime();
         url_stat_->elapsed_ = data_->getElapsed();
         url_stat_->failed_ = agent_->isStatusFail(url_stat_->status_code_);
-        agent_->recordUrlStat(std::move(*url_stat_));
+        agent_->recordUrlStat(*url_stat_);
         url_stat_.reset();
     }
 
@@ -26,6 +26,7 @@
 #include <utility>
 #include <vector>
 
+#include "active_request.h"
 #include "agent_service.h"
 #include "callstack.h"
 #include "config.h"
@@ -344,6 +345,13 @@ namespace pinpoint {
 		 */
 		void optimizeSpanEvents();
 
+		/**
+		 * @brief Resolves the SQL statements deferred by Sql.AsyncNormalize in every event.
+		 *
+		 * @return true if any statement was resolved, i.e. SQL metadata may have been queued.
+		 */
+		bool resolveSqlQueries();
+
 		/// @brief Returns the parent span data associated with this chunk.
 		std::shared_ptr<SpanData>& getSpanData() { return span_data_; }
 		/// @brief Returns the span events contained in this chunk.
@@ -352,12 +360,16 @@ namespace pinpoint {
 		int64_t getKeyTime() const { return key_time_; }
 		/// @brief Indicates whether this chunk represents the final events of the span.
 		bool isFinal() const { return final_; }
+		/// @brief Metadata sequence issued before this chunk was queued (0 when not tracked).
+		uint64_t getMetaSequence() const { return meta_sequence_; }
+		void setMetaSequence(uint64_t sequence) { meta_sequence_ = sequence; }
 
 	private:
 		std::shared_ptr<SpanData> span_data_;
 		std::vector<std::unique_ptr<SpanEventImpl>> event_chunk_;
 		bool final_;
 		int64_t key_time_;
+		uint64_t meta_sequence_{0};
 	};
 
     /**
@@ -505,6 +517,11 @@ namespace pinpoint {
             std::shared_ptr<SpanData> data_;
             std::atomic<int32_t> overflow_;
             std::atomic<bool> finished_;
+            // Registers the span in AgentStats' active-request registry
+            // from extractContext() until EndSpan().
+            ActiveRequestSlot active_slot_;
+            // Owns copies of the SetUrlStat() arguments, which are only views;
+            // lent to recordUrlStat() when the span ends.
             std::optional<UrlStatEntry> url_stat_;
             std::vector<std::unique_ptr<Exception>> exceptions_;
             // Handed out instead of a real event while the event stack is
@@ -22,7 +22,6 @@
 #include "noop.h"
 #include "span.h"
 #include "span_event.h"
-#include "sql.h"
 #include "utility.h"
 
 namespace pinpoint {
@@ -119,27 +118,45 @@ namespace pinpoint {
     }
 
     void SpanEventImpl::SetSqlQuery(std::string_view sql_query, std::string_view args) {
-        // Use a thread-local or static instance since SqlNormalizer is now stateless/thread-safe for normalize()
-        static const SqlNormalizer normalizer(64*1024);
-        SqlNormalizeResult result = normalizer.normalize(sql_query);
-
         const auto& config = span_->config_;
-        if (config->sql.enable_sql_stats) {
-            auto sql_uid = agent_->cacheSqlUid(result.normalized_sql);
-            if (sql_uid) {
-                // result.parameters is dead after this call: move it into the
-                // annotation instead of copying through the string_view path.
-                ensureAnnotations()->AppendData(ANNOTATION_SQL_UID,
-                    AnnotationData(ANNOTATION_TYPE_BYTES_STRING_STRING, *sql_uid,
-                                   std::move(result.parameters), args));
+        const bool sql_uid = config->sql.enable_sql_stats;
+        const auto dialect = sql_dialect_for(service_type_);
+        if (config->sql.async_normalize) {
+            // Only a copy here, of no more than the normalizer reads; the span
+            // worker normalizes it in resolveSqlQueries().
+            try {
+                pending_sql_queries_.push_back(PendingSqlQuery{std::string(sql_query.substr(0, SQL_NORMALIZE_MAX_LENGTH)),
+                                                               std::string(args), dialect, sql_uid});
+            } catch (const std::exception& e) {
+                LOG_ERROR("set sql query exception = {}", e.what());
             }
-        } else {
-            auto sql_id = agent_->cacheSql(result.normalized_sql);
-            if (sql_id) {
-                ensureAnnotations()->AppendData(ANNOTATION_SQL_ID,
-                    AnnotationData(ANNOTATION_TYPE_INT_STRING_STRING, sql_id,
-                                   std::move(result.parameters), args));
+            return;
+        }
+        appendSqlQuery(sql_query, dialect, sql_uid, args);
+    }
+
+    void SpanEventImpl::resolveSqlQueries() {
+        for (const auto& pending : pending_sql_queries_) {
+            appendSqlQuery(pending.sql_query, pending.dialect, pending.sql_uid, pending.args);
+        }
+        pending_sql_queries_.clear();
+    }
+
+    void SpanEventImpl::appendSqlQuery(std::string_view sql_query, SqlDialect dialect, bool sql_uid,
+                                       std::string_view args) {
+        auto cached = agent_->cacheSqlQuery(sql_query, dialect, sql_uid);
+        // cached.parameters is dead after this call: move it into the
+        // annotation instead of copying through the string_view path.
+        if (sql_uid) {
+            if (cached.sql_uid) {
+                ensureAnnotations()->AppendData(ANNOTATION_SQL_UID,
+                    AnnotationData(ANNOTATION_TYPE_BYTES_STRING_STRING, *cached.sql_uid,
+                                   std::move(cached.parameters), args));
             }
+        } else if (cached.sql_id) {
+            ensureAnnotations()->AppendData(ANNOTATION_SQL_ID,
+                AnnotationData(ANNOTATION_TYPE_INT_STRING_STRING, cached.sql_id,
+                               std::move(cached.parameters), args));
         }
     }
 
@@ -17,9 +17,11 @@
 #pragma once
 
 #include <atomic>
+#include <vector>
 
 #include "pinpoint/tracer.h"
 #include "annotation.h"
+#include "sql.h"
 #include "utility.h"
 
 namespace pinpoint {
@@ -124,7 +126,28 @@ namespace pinpoint {
         /// @brief Returns the API identifier.
         int32_t getApiId() const { return api_id_; }
 
+        /// @brief Whether SetSqlQuery deferred a statement (Sql.AsyncNormalize).
+        bool hasPendingSqlQuery() const { return !pending_sql_queries_.empty(); }
+        /**
+         * @brief Normalizes the statements deferred by SetSqlQuery and appends
+         *        their SqlId/SqlUid annotations.
+         *
+         * Called by the span worker once the event is finished and no longer
+         * touched by the traced thread, before the event is serialized.
+         */
+        void resolveSqlQueries();
+
     private:
+        /// @brief Raw statement kept by SetSqlQuery until resolveSqlQueries().
+        struct PendingSqlQuery {
+            std::string sql_query;
+            std::string args;
+            SqlDialect dialect;
+            bool sql_uid;
+        };
+
+        void appendSqlQuery(std::string_view sql_query, SqlDialect dialect, bool sql_uid, std::string_view args);
+
         /// @brief Lazily allocates the annotation container on first use and
         /// returns it. Subsequent calls reuse the same instance, so callers can
         /// rely on a non-null result. Kept const (with a mutable backing field)
@@ -161,6 +184,7 @@ namespace pinpoint {
         // Created lazily via ensureAnnotations(); stays null until the first
         // annotation is recorded or the container is accessed.
         mutable std::unique_ptr<PinpointAnnotation> annotations_;
+        std::vector<PendingSqlQuery> pending_sql_queries_;
     };
 
     /**
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace pinpoint {
+
+    /**
+     * @brief Bounded lock-free ring for exactly one producer and one consumer thread.
+     *
+     * The producer publishes a slot by advancing head_ with a release store and
+     * the consumer frees it by advancing tail_, so neither side ever waits on
+     * the other. push() fails when the ring is full instead of overwriting: the
+     * oldest entries are the ones still owed to the consumer.
+     *
+     * The storage is allocated once by init(). Until then the ring has no
+     * capacity, so push() fails and pop() returns nothing.
+     */
+    template<typename T>
+    class SpscRing {
+    public:
+        SpscRing() = default;
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        /**
+         * @brief Allocates room for @p capacity entries.
+         *
+         * Must happen before either thread uses the ring.
+         *
+         * @return false if the ring was already initialized or @p capacity is 0.
+         */
+        bool init(size_t capacity) {
+            if (capacity == 0 || capacity_.load(std::memory_order_relaxed) != 0) {
+                return false;
+            }
+            slots_ = std::make_unique<T[]>(capacity);
+            capacity_.store(capacity, std::memory_order_release);
+            return true;
+        }
+
+        /// @brief Producer only. Copies @p value in; returns false if the ring is full.
+        bool push(const T& value) {
+            const auto capacity = capacity_.load(std::memory_order_acquire);
+            const auto head = head_.load(std::memory_order_relaxed);
+            if (head - tail_.load(std::memory_order_acquire) >= capacity) {
+                return false;
+            }
+            slots_[head % capacity] = value;
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Consumer only. Moves up to @p max_count of the oldest entries to the end of @p out.
+         *
+         * @return The number of entries moved.
+         */
+        size_t pop(std::vector<T>& out, size_t max_count) {
+            const auto capacity = capacity_.load(std::memory_order_acquire);
+            if (capacity == 0) {
+                return 0;
+            }
+            const auto tail = tail_.load(std::memory_order_relaxed);
+            const auto available = head_.load(std::memory_order_acquire) - tail;
+            const auto count = available < max_count ? available : max_count;
+            for (size_t i = 0; i < count; ++i) {
+                out.push_back(std::move(slots_[(tail + i) % capacity]));
+            }
+            tail_.store(tail + count, std::memory_order_release);
+            return count;
+        }
+
+        /// @brief Entries pushed but not yet popped; may be stale by the time it returns.
+        size_t size() const {
+            // tail first: a head read afterwards can only be larger, never behind it
+            const auto tail = tail_.load(std::memory_order_acquire);
+            return head_.load(std::memory_order_acquire) - tail;
+        }
+
+        size_t capacity() const { return capacity_.load(std::memory_order_acquire); }
+
+    private:
+        std::unique_ptr<T[]> slots_{};
+        std::atomic<size_t> capacity_{0};
+        // Each index is written by one side only; separate lines keep the
+        // producer's stores from invalidating the consumer's cached copy.
+        alignas(64) std::atomic<size_t> head_{0};  // next slot to write
+        alignas(64) std::atomic<size_t> tail_{0};  // next slot to read
+    };
+
+}  // namespace pinpoint
@@ -15,6 +15,8 @@
  */
 
 #include "sql.h"
+#include "sql_scan.h"
+#include "pinpoint/tracer.h"
 #include <algorithm>
 #include <cctype>
 #include <charconv>
@@ -35,6 +37,50 @@ namespace pinpoint {
             return std::isdigit(static_cast<unsigned char>(c)) != 0;
         }
 
+        bool isIdentifierChar(char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '_' || c == '$';
+        }
+
+        bool isSpace(char c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        }
+
+        size_t skipSpaces(std::string_view sql, size_t pos) {
+            while (pos < sql.length() && isSpace(sql[pos])) {
+                ++pos;
+            }
+            return pos;
+        }
+
+        // Whether the normalized SQL so far ends with the keyword IN, so a '(' opens an IN list.
+        bool followsInKeyword(const std::string& normalized) {
+            size_t end = normalized.length();
+            while (end > 0 && isSpace(normalized[end - 1])) {
+                --end;
+            }
+            if (end < 2 || (normalized[end - 2] | 0x20) != 'i' || (normalized[end - 1] | 0x20) != 'n') {
+                return false;
+            }
+            return end == 2 || !isIdentifierChar(normalized[end - 3]);
+        }
+
+        // Returns the index of the quote closing the quoted token at open_idx, or npos.
+        // A doubled closing quote is part of the token.
+        size_t findClosingQuote(std::string_view sql, size_t open_idx, char close, bool backslash_escapes) {
+            for (size_t i = open_idx + 1; i < sql.length(); ++i) {
+                if (backslash_escapes && sql[i] == '\\') {
+                    ++i;
+                } else if (sql[i] == close) {
+                    if (i + 1 < sql.length() && sql[i + 1] == close) {
+                        ++i;
+                    } else {
+                        return i;
+                    }
+                }
+            }
+            return std::string_view::npos;
+        }
+
         void appendParameterSeparator(SqlNormalizeResult& result) {
             if (!result.parameters.empty()) {
                 result.parameters += ',';
@@ -49,6 +95,12 @@ namespace pinpoint {
             }
         }
 
+        void appendParameterText(SqlNormalizeResult& result, std::string_view text) {
+            for (const char ch : text) {
+                appendParameterChar(result, ch);
+            }
+        }
+
         // Appends the decimal digits of a parameter index without the
         // temporary std::string that std::to_string would create for every
         // replaced literal.
@@ -80,16 +132,58 @@ namespace pinpoint {
         }
     } // namespace
 
-    SqlNormalizer::SqlNormalizer(size_t max_sql_length, bool remove_comments)
-        : max_sql_length_(max_sql_length), remove_comments_(remove_comments) {
+    SqlDialect sql_dialect_for(int32_t service_type) {
+        switch (service_type) {
+            case SERVICE_TYPE_MYSQL_QUERY:
+                return SqlDialect::MYSQL;
+            case SERVICE_TYPE_PGSQL_QUERY:
+                return SqlDialect::POSTGRESQL;
+            case SERVICE_TYPE_ORACLE_QUERY:
+                return SqlDialect::ORACLE;
+            case SERVICE_TYPE_MSSQL_QUERY:
+                return SqlDialect::MSSQL;
+            default:
+                return SqlDialect::GENERIC;
+        }
+    }
+
+    SqlNormalizer::SqlNormalizer(size_t max_sql_length, bool remove_comments, SqlDialect dialect)
+        : max_sql_length_(max_sql_length), remove_comments_(remove_comments), dialect_(dialect) {
+        switch (dialect_) {
+            case SqlDialect::MYSQL:
+                extra_special_[0] = '"';
+                extra_special_[1] = '`';
+                extra_special_[2] = '(';
+                break;
+            case SqlDialect::POSTGRESQL:
+            case SqlDialect::ORACLE:
+                extra_special_[0] = '"';
+                extra_special_[1] = '(';
+                break;
+            case SqlDialect::MSSQL:
+                extra_special_[0] = '"';
+                extra_special_[1] = '[';
+                extra_special_[2] = '(';
+                break;
+            case SqlDialect::GENERIC:
+                break;
+        }
     }
 
     SqlNormalizeResult SqlNormalizer::normalize(std::string_view sql) const {
         auto result = SqlNormalizeResult();
+        normalize(sql, result);
+        return result;
+    }
+
+    void SqlNormalizer::normalize(std::string_view sql, SqlNormalizeResult& result) const {
+        result.normalized_sql.clear();
+        result.parameters.clear();
+        result.param_index = 0;
         if (sql.empty()) {
-            return result;
+            return;
         }
-        
+
         // Limit SQL length to prevent memory issues.
         sql = sql.substr(0, std::min(sql.length(), max_sql_length_));
         const size_t sql_length = sql.length();
@@ -102,6 +196,29 @@ namespace pinpoint {
         bool number_token_start_enable = true;
 
         for (size_t i = 0; i < sql_length; ++i) {
+            // Every byte up to the next special one is copied as is. For those
+            // bytes the flag depends only on the byte itself, so the last one
+            // of the run decides it.
+            if (const size_t run_end = sql_scan::find_special(sql.data(), sql_length, i, extra_special_[0],
+                                                              extra_special_[1], extra_special_[2]);
+                run_end != i) {
+                result.normalized_sql.append(sql.data() + i, run_end - i);
+                number_token_start_enable =
+                    updateNumberTokenStartEnable(sql[run_end - 1], '\0', number_token_start_enable);
+                i = run_end;
+                if (i == sql_length) {
+                    break;
+                }
+            }
+
+            if (dialect_ != SqlDialect::GENERIC) {
+                if (const size_t end = handleDialectToken(sql, sql_length, i, result, number_token_start_enable);
+                    end != std::string_view::npos) {
+                    i = end;
+                    continue;
+                }
+            }
+
             char c = sql[i];
             char next_c = lookAhead1(sql, i);
 
@@ -142,14 +259,6 @@ namespace pinpoint {
                     }
                     break;
 
-                case ' ': case '\t': case '\n': case '\r':
-                case '*': case '+': case '%': case '=': case '<': case '>':
-                case '&': case '|': case '^': case '~': case '!':
-                case '(': case ')': case ',': case ';':
-                    number_token_start_enable = true;
-                    result.normalized_sql += c;
-                    break;
-
                 case '$':
                     if (next_c >= '0' && next_c <= '9') {
                         number_token_start_enable = false;
@@ -157,19 +266,12 @@ namespace pinpoint {
                     result.normalized_sql += c;
                     break;
 
-                case '.': case '_': case '@': case ':':
-                    number_token_start_enable = false;
-                    result.normalized_sql += c;
-                    break;
-
                 default:
                     number_token_start_enable = updateNumberTokenStartEnable(c, next_c, number_token_start_enable);
                     result.normalized_sql += c;
                     break;
             }
         }
-
-        return result;
     }
 
     std::string SqlNormalizer::combineOutputParams(std::string_view sql, const std::vector<std::string>& output_params) const {
@@ -321,7 +423,239 @@ namespace pinpoint {
         return result;
     }
 
-    size_t SqlNormalizer::handleStringLiteral(std::string_view sql, size_t sql_length, size_t start_idx, char quote_char, SqlNormalizeResult& result) {
+    size_t SqlNormalizer::handleDialectToken(std::string_view sql, size_t sql_length, size_t start_idx,
+                                             SqlNormalizeResult& result, bool& number_token_start_enable) const {
+        constexpr auto npos = std::string_view::npos;
+        const char c = sql[start_idx];
+        const char next_c = lookAhead1(sql, start_idx);
+        const char prev_c = start_idx > 0 ? sql[start_idx - 1] : '\0';
+        // A one-letter string prefix such as E'...' or q'...', not the end of a longer name.
+        const bool prefixed = start_idx > 0 && (start_idx < 2 || !isIdentifierChar(sql[start_idx - 2]));
+
+        switch (c) {
+            case '"':
+            case '`':
+            case '[': {
+                if (c == '"' && dialect_ == SqlDialect::MYSQL) {
+                    return handleStringLiteral(sql, sql_length, start_idx, c, result, true);
+                }
+                // Quoted identifiers are kept as written, digits included.
+                const size_t close = findClosingQuote(sql, start_idx, c == '[' ? ']' : c, false);
+                const size_t end = close == npos ? sql_length - 1 : close;
+                result.normalized_sql.append(sql.substr(start_idx, end - start_idx + 1));
+                number_token_start_enable = false;
+                return end;
+            }
+
+            case '(':
+                if (followsInKeyword(result.normalized_sql)) {
+                    if (const size_t close = collapseInList(sql, sql_length, start_idx, result); close != start_idx) {
+                        number_token_start_enable = true;
+                        return close;
+                    }
+                }
+                return npos;
+
+            case '\'':
+                if (dialect_ == SqlDialect::MYSQL ||
+                    (dialect_ == SqlDialect::POSTGRESQL && prefixed && (prev_c == 'E' || prev_c == 'e'))) {
+                    return handleStringLiteral(sql, sql_length, start_idx, c, result, true);
+                }
+                if (dialect_ == SqlDialect::ORACLE && prefixed && (prev_c == 'q' || prev_c == 'Q') &&
+                    next_c != '\0' && !isSpace(next_c)) {
+                    // q'<d>...<d>' where <d> is any character, or a bracket closed by its pair.
+                    char close = next_c;
+                    switch (next_c) {
+                        case '[': close = ']'; break;
+                        case '(': close = ')'; break;
+                        case '{': close = '}'; break;
+                        case '<': close = '>'; break;
+                        default: break;
+                    }
+                    size_t end = sql.find(close, start_idx + 2);
+                    while (end != npos && lookAhead1(sql, end) != '\'') {
+                        end = sql.find(close, end + 1);
+                    }
+                    if (end == npos) {
+                        return npos;
+                    }
+                    result.normalized_sql += c;
+                    appendParameterSeparator(result);
+                    appendParameterText(result, sql.substr(start_idx + 1, end - start_idx));
+                    appendParameterIndex(result.normalized_sql, result.param_index++);
+                    result.normalized_sql += kSymbolReplace;
+                    result.normalized_sql += c;
+                    return end + 1;
+                }
+                return npos;
+
+            case '$': {
+                if (dialect_ != SqlDialect::POSTGRESQL || isIdentifierChar(prev_c)) {
+                    return npos;
+                }
+                // $$...$$ or $tag$...$tag$; a tag does not start with a digit, unlike $1.
+                size_t tag_end = start_idx + 1;
+                while (tag_end < sql_length && (std::isalpha(static_cast<unsigned char>(sql[tag_end])) ||
+                                                sql[tag_end] == '_' ||
+                                                (tag_end > start_idx + 1 && isDigit(sql[tag_end])))) {
+                    ++tag_end;
+                }
+                if (tag_end >= sql_length || sql[tag_end] != '$') {
+                    return npos;
+                }
+                const auto tag = sql.substr(start_idx, tag_end - start_idx + 1);
+                const size_t close = sql.find(tag, tag_end + 1);
+                if (close == npos) {
+                    return npos;
+                }
+                // "$tag$N$$tag$": the N$ token is restored like a quoted string's.
+                result.normalized_sql.append(tag);
+                appendParameterSeparator(result);
+                appendParameterText(result, sql.substr(tag_end + 1, close - tag_end - 1));
+                appendParameterIndex(result.normalized_sql, result.param_index++);
+                result.normalized_sql += kSymbolReplace;
+                result.normalized_sql.append(tag);
+                return close + tag.length() - 1;
+            }
+
+            case '0': {
+                if (!number_token_start_enable || dialect_ == SqlDialect::ORACLE) {
+                    return npos;
+                }
+                const bool hex = next_c == 'x' || next_c == 'X';
+                const bool bits = (next_c == 'b' || next_c == 'B') && dialect_ != SqlDialect::MSSQL;
+                auto is_digit_of_base = [hex](char ch) {
+                    return hex ? std::isxdigit(static_cast<unsigned char>(ch)) != 0 : ch == '0' || ch == '1';
+                };
+                if ((!hex && !bits) || !is_digit_of_base(lookAhead1(sql, start_idx + 1))) {
+                    return npos;
+                }
+                size_t end = start_idx + 2;
+                while (end < sql_length && is_digit_of_base(sql[end])) {
+                    ++end;
+                }
+                appendParameterSeparator(result);
+                result.parameters.append(sql.substr(start_idx, end - start_idx));
+                appendParameterIndex(result.normalized_sql, result.param_index++);
+                result.normalized_sql += kNumberReplace;
+                return end - 1;
+            }
+
+            default:
+                return npos;
+        }
+    }
+
+    size_t SqlNormalizer::collapseInList(std::string_view sql, size_t sql_length, size_t open_idx,
+                                         SqlNormalizeResult& result) const {
+        size_t elements = 0;
+        bool literals = false;
+        // Prefix of the bind markers seen: '?', or '$', ':' or '@' for $1, :1 and @p1.
+        char bind = '\0';
+        size_t pos = open_idx + 1;
+        while (true) {
+            pos = skipSpaces(sql, pos);
+            if (pos >= sql_length) {
+                return open_idx;
+            }
+            const char c = sql[pos];
+            if (const size_t marker_end = bindMarkerEnd(sql, sql_length, pos); marker_end != pos) {
+                if (bind != '\0' && bind != c) {
+                    return open_idx;
+                }
+                bind = c;
+                pos = marker_end;
+            } else if (c == '\'' || (c == '"' && dialect_ == SqlDialect::MYSQL)) {
+                const size_t close = findClosingQuote(sql, pos, c, dialect_ == SqlDialect::MYSQL);
+                if (close == std::string_view::npos) {
+                    return open_idx;
+                }
+                literals = true;
+                pos = close + 1;
+            } else if (isDigit(c) || ((c == '-' || c == '+' || c == '.') && isDigit(lookAhead1(sql, pos)))) {
+                // Digits, decimal points, exponents and 0x/0b digits.
+                ++pos;
+                while (pos < sql_length && (std::isalnum(static_cast<unsigned char>(sql[pos])) || sql[pos] == '.')) {
+                    ++pos;
+                }
+                literals = true;
+            } else {
+                return open_idx;
+            }
+            ++elements;
+
+            pos = skipSpaces(sql, pos);
+            if (pos >= sql_length) {
+                return open_idx;
+            }
+            if (sql[pos] == ')') {
+                break;
+            }
+            if (sql[pos] != ',') {
+                return open_idx;
+            }
+            ++pos;
+        }
+
+        if (literals && bind != '\0') {
+            return open_idx;
+        }
+        if (bind != '\0') {
+            if (elements < 2) {
+                return open_idx;
+            }
+            switch (bind) {
+                case '$': result.normalized_sql += "($n, ...)"; break;
+                case ':': result.normalized_sql += "(:n, ...)"; break;
+                case '@': result.normalized_sql += "(@p, ...)"; break;
+                default: result.normalized_sql += "(?, ...)"; break;
+            }
+            return pos;
+        }
+
+        // The whole list is one parameter, so the original list can be restored in place of N#.
+        result.normalized_sql += '(';
+        appendParameterSeparator(result);
+        appendParameterText(result, sql.substr(open_idx + 1, pos - open_idx - 1));
+        appendParameterIndex(result.normalized_sql, result.param_index++);
+        result.normalized_sql += kNumberReplace;
+        result.normalized_sql += ')';
+        return pos;
+    }
+
+    size_t SqlNormalizer::bindMarkerEnd(std::string_view sql, size_t sql_length, size_t pos) const {
+        const char c = sql[pos];
+        if (c == '?') {
+            return pos + 1;
+        }
+        const char next_c = lookAhead1(sql, pos);
+        bool marker = false;
+        switch (dialect_) {
+            case SqlDialect::POSTGRESQL:
+                marker = c == '$' && isDigit(next_c);
+                break;
+            case SqlDialect::ORACLE:
+                marker = c == ':' && isIdentifierChar(next_c) && next_c != '$';
+                break;
+            case SqlDialect::MSSQL:
+                // @@ROWCOUNT and friends are system functions, not parameters.
+                marker = c == '@' && isIdentifierChar(next_c) && next_c != '$';
+                break;
+            default:
+                break;
+        }
+        if (!marker) {
+            return pos;
+        }
+        size_t end = pos + 1;
+        while (end < sql_length && (c == '$' ? isDigit(sql[end]) : isIdentifierChar(sql[end]))) {
+            ++end;
+        }
+        return end;
+    }
+
+    size_t SqlNormalizer::handleStringLiteral(std::string_view sql, size_t sql_length, size_t start_idx, char quote_char,
+                                              SqlNormalizeResult& result, bool backslash_escapes) {
         if (start_idx + 1 < sql_length && sql[start_idx + 1] == quote_char) {
             result.normalized_sql += quote_char;
             result.normalized_sql += quote_char;
@@ -332,22 +666,35 @@ namespace pinpoint {
         appendParameterSeparator(result);
 
         size_t current_idx = start_idx + 1;
-        for (; current_idx < sql_length; ++current_idx) {
-            const char state_ch = sql[current_idx];
-            if (state_ch == quote_char) {
-                if (current_idx + 1 < sql_length && sql[current_idx + 1] == quote_char) {
-                    ++current_idx;
-                    result.parameters += "''";
-                    continue;
-                } else {
-                    appendParameterIndex(result.normalized_sql, result.param_index);
-                    result.normalized_sql += kSymbolReplace;
-                    result.normalized_sql += quote_char;
-                    ++result.param_index;
-                    break;
+        while (current_idx < sql_length) {
+            const size_t stop = sql_scan::find_first_of(sql.data(), sql_length, current_idx, quote_char, ',',
+                                                        backslash_escapes ? '\\' : quote_char);
+            result.parameters.append(sql.data() + current_idx, stop - current_idx);
+            current_idx = stop;
+            if (current_idx == sql_length) {
+                break;
+            }
+            if (sql[current_idx] == ',') {
+                appendParameterChar(result, ',');
+                ++current_idx;
+            } else if (sql[current_idx] != quote_char) {
+                // Backslash escape: keep it and the escaped character as written.
+                result.parameters += '\\';
+                if (current_idx + 1 < sql_length) {
+                    appendParameterChar(result, sql[current_idx + 1]);
                 }
+                current_idx += 2;
+            } else if (current_idx + 1 < sql_length && sql[current_idx + 1] == quote_char) {
+                current_idx += 2;
+                result.parameters += quote_char;
+                result.parameters += quote_char;
+            } else {
+                appendParameterIndex(result.normalized_sql, result.param_index);
+                result.normalized_sql += kSymbolReplace;
+                result.normalized_sql += quote_char;
+                ++result.param_index;
+                break;
             }
-            appendParameterChar(result, state_ch);
         }
 
         return current_idx;
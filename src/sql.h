@@ -16,12 +16,36 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <vector>
 
 namespace pinpoint {
 
+    // Maximum SQL length normalized for span events and metadata pre-registration.
+    constexpr size_t SQL_NORMALIZE_MAX_LENGTH = 64 * 1024;
+
+    /**
+    * SQL dialect whose lexical rules SqlNormalizer follows
+    *
+    * GENERIC matches the Java agent: only '...' is a string and nothing is
+    * collapsed. The database dialects also collapse IN lists (see SqlNormalizer).
+    */
+    enum class SqlDialect : uint8_t {
+        GENERIC,
+        MYSQL,       // "..." strings, `...` identifiers, backslash escapes, 0x/0b literals
+        POSTGRESQL,  // "..." identifiers, $tag$...$tag$ strings, E'...' escapes, 0x/0b literals
+        ORACLE,      // "..." identifiers, q'[...]' strings
+        MSSQL,       // "..." and [...] identifiers, 0x literals
+    };
+
+    /**
+    * Returns the dialect of a span event service type (e.g. SERVICE_TYPE_MYSQL_QUERY),
+    * or GENERIC for service types that are not a known database.
+    */
+    SqlDialect sql_dialect_for(int32_t service_type);
+
     /**
     * SQL normalization result
     */
@@ -44,6 +68,12 @@ namespace pinpoint {
     * - Removing string literals and replacing with indexed placeholders ('0$', '1$', '2$'...)
     * - Optionally removing comments
     * - Extracting numeric literals and string literals in order (comma-separated)
+    *
+    * With a database dialect, an IN list of two or more bind markers becomes
+    * "(?, ...)", or "($n, ...)", "(:n, ...)" and "(@p, ...)" for PostgreSQL $1,
+    * Oracle :1/:name and SQL Server @p1/@name markers, and an IN list of literals becomes "(N#)" whose parameter is the
+    * list text, so statements differing only in list length share one entry in
+    * the SQL metadata caches while the original list can still be restored.
     */
     class SqlNormalizer {
     public:
@@ -51,7 +81,8 @@ namespace pinpoint {
         * Constructor with optional maximum SQL length. Comments are removed by
         * default, matching the Java agent's default JDBC option.
         */
-        explicit SqlNormalizer(size_t max_sql_length = 2048, bool remove_comments = true);
+        explicit SqlNormalizer(size_t max_sql_length = 2048, bool remove_comments = true,
+                               SqlDialect dialect = SqlDialect::GENERIC);
         
         /**
         * Destructor
@@ -66,13 +97,57 @@ namespace pinpoint {
         */
         SqlNormalizeResult normalize(std::string_view sql) const;
 
+        /**
+        * Normalize SQL query into a reused result
+        *
+        * The previous contents of result are replaced, but its string capacity is
+        * kept, so a long-lived (e.g. thread-local) result normalizes without
+        * allocating once it has grown to the statement sizes seen.
+        *
+        * @param sql Raw SQL query string
+        * @param result Receives the normalized SQL and extracted literals
+        */
+        void normalize(std::string_view sql, SqlNormalizeResult& result) const;
+
         std::string combineOutputParams(std::string_view sql, const std::vector<std::string>& output_params) const;
 
         std::string combineBindValues(std::string_view sql, const std::vector<std::string>& bind_values) const;
 
+        SqlDialect dialect() const { return dialect_; }
+
     private:
         size_t max_sql_length_;
         bool remove_comments_;
+        SqlDialect dialect_;
+        // Dialect-specific bytes that end a verbatim run; unused ones repeat '\''.
+        char extra_special_[3]{'\'', '\'', '\''};
+
+        /**
+        * Handle a token whose meaning depends on the configured dialect: quoted
+        * strings and identifiers, dollar-quoted strings, 0x/0b literals and IN lists
+        *
+        * @return Index of the last character consumed, or std::string_view::npos
+        *         if the byte was not consumed and should be processed as usual
+        */
+        size_t handleDialectToken(std::string_view sql, size_t sql_length, size_t start_idx,
+                                  SqlNormalizeResult& result, bool& number_token_start_enable) const;
+
+        /**
+        * Collapse the IN list opened at open_idx
+        *
+        * @return Index of the closing parenthesis, or open_idx if the list is not
+        *         made only of literals or only of bind markers
+        */
+        size_t collapseInList(std::string_view sql, size_t sql_length, size_t open_idx,
+                              SqlNormalizeResult& result) const;
+
+        /**
+        * Find the end of the bind marker starting at pos: '?' in every dialect,
+        * plus $1 (PostgreSQL), :1 or :name (Oracle) and @p1 or @name (SQL Server)
+        *
+        * @return Index past the marker, or pos if no marker starts there
+        */
+        size_t bindMarkerEnd(std::string_view sql, size_t sql_length, size_t pos) const;
         
         /**
         * Handle string literal
@@ -82,9 +157,11 @@ namespace pinpoint {
         * @param start_idx Index of the opening quote
         * @param quote_char Quote character
         * @param result Result of the normalization
+        * @param backslash_escapes Whether a backslash escapes the next character
         * @return Index of the next character to process
         */
-        static size_t handleStringLiteral(std::string_view sql, size_t sql_length, size_t start_idx, char quote_char, SqlNormalizeResult& result);
+        static size_t handleStringLiteral(std::string_view sql, size_t sql_length, size_t start_idx, char quote_char,
+                                          SqlNormalizeResult& result, bool backslash_escapes = false);
         
         /**
         * Handle numeric literal
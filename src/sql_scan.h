@@ -0,0 +1,165 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace pinpoint {
+
+    /**
+     * @brief Byte scanners used by SqlNormalizer to skip over runs it copies verbatim.
+     *
+     * Each scanner returns the position of the first matching byte at or after
+     * @p pos, or @p size if there is none. The vector paths test 32 (AVX2) or
+     * 16 (SSE2) bytes per step and are chosen at compile time; the scalar
+     * versions are the reference they are tested against and handle the tail.
+     * Unused extra bytes default to '\'', which already matches, so they cost
+     * one compare and match nothing new.
+     */
+    namespace sql_scan {
+
+        /**
+         * @brief Whether @p c can start a comment, string, number or positional
+         *        placeholder, or is one of the dialect's @p extra bytes.
+         */
+        inline bool is_special(char c, char extra1 = '\'', char extra2 = '\'', char extra3 = '\'') {
+            // '/' and the digits are adjacent: 0x2F-0x39.
+            return static_cast<unsigned char>(c - '/') <= '9' - '/' || c == '-' || c == '\'' || c == '$' ||
+                   c == extra1 || c == extra2 || c == extra3;
+        }
+
+        inline size_t find_special_scalar(const char* data, size_t size, size_t pos,
+                                          char extra1 = '\'', char extra2 = '\'', char extra3 = '\'') {
+            while (pos < size && !is_special(data[pos], extra1, extra2, extra3)) {
+                ++pos;
+            }
+            return pos;
+        }
+
+        inline size_t find_first_of_scalar(const char* data, size_t size, size_t pos, char a, char b, char c) {
+            while (pos < size && data[pos] != a && data[pos] != b && data[pos] != c) {
+                ++pos;
+            }
+            return pos;
+        }
+
+        /// @brief Finds the next byte for which is_special() holds.
+        inline size_t find_special(const char* data, size_t size, size_t pos,
+                                   char extra1 = '\'', char extra2 = '\'', char extra3 = '\'') {
+#if defined(__AVX2__)
+            {
+                const auto low = _mm256_set1_epi8('/');
+                const auto span = _mm256_set1_epi8('9' - '/');
+                const auto dash = _mm256_set1_epi8('-');
+                const auto quote = _mm256_set1_epi8('\'');
+                const auto dollar = _mm256_set1_epi8('$');
+                const auto e1 = _mm256_set1_epi8(extra1);
+                const auto e2 = _mm256_set1_epi8(extra2);
+                const auto e3 = _mm256_set1_epi8(extra3);
+                for (; pos + 32 <= size; pos += 32) {
+                    const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+                    const auto offset = _mm256_sub_epi8(v, low);
+                    auto hit = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, span), offset);
+                    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, dash));
+                    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, quote));
+                    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, dollar));
+                    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, e1));
+                    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, e2));
+                    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, e3));
+                    if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit)); mask != 0) {
+                        return pos + static_cast<size_t>(__builtin_ctz(mask));
+                    }
+                }
+            }
+#endif
+#if defined(__SSE2__)
+            {
+                const auto low = _mm_set1_epi8('/');
+                const auto span = _mm_set1_epi8('9' - '/');
+                const auto dash = _mm_set1_epi8('-');
+                const auto quote = _mm_set1_epi8('\'');
+                const auto dollar = _mm_set1_epi8('$');
+                const auto e1 = _mm_set1_epi8(extra1);
+                const auto e2 = _mm_set1_epi8(extra2);
+                const auto e3 = _mm_set1_epi8(extra3);
+                for (; pos + 16 <= size; pos += 16) {
+                    const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+                    const auto offset = _mm_sub_epi8(v, low);
+                    auto hit = _mm_cmpeq_epi8(_mm_min_epu8(offset, span), offset);
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, dash));
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, quote));
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, dollar));
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, e1));
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, e2));
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, e3));
+                    if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hit)); mask != 0) {
+                        return pos + static_cast<size_t>(__builtin_ctz(mask));
+                    }
+                }
+            }
+#endif
+            return find_special_scalar(data, size, pos, extra1, extra2, extra3);
+        }
+
+        /**
+         * @brief Finds the next @p a, @p b or @p c, e.g. the closing quote, a ','
+         *        to escape or a backslash escape in a string literal.
+         */
+        inline size_t find_first_of(const char* data, size_t size, size_t pos, char a, char b, char c) {
+#if defined(__AVX2__)
+            {
+                const auto va = _mm256_set1_epi8(a);
+                const auto vb = _mm256_set1_epi8(b);
+                const auto vc = _mm256_set1_epi8(c);
+                for (; pos + 32 <= size; pos += 32) {
+                    const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+                    const auto hit = _mm256_or_si256(
+                        _mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)), _mm256_cmpeq_epi8(v, vc));
+                    if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit)); mask != 0) {
+                        return pos + static_cast<size_t>(__builtin_ctz(mask));
+                    }
+                }
+            }
+#endif
+#if defined(__SSE2__)
+            {
+                const auto va = _mm_set1_epi8(a);
+                const auto vb = _mm_set1_epi8(b);
+                const auto vc = _mm_set1_epi8(c);
+                for (; pos + 16 <= size; pos += 16) {
+                    const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+                    const auto hit = _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, vc));
+                    if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hit)); mask != 0) {
+                        return pos + static_cast<size_t>(__builtin_ctz(mask));
+                    }
+                }
+            }
+#endif
+            return find_first_of_scalar(data, size, pos, a, b, c);
+        }
+
+    } // namespace sql_scan
+
+} // namespace pinpoint
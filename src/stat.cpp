@@ -16,12 +16,11 @@
 
 #include <atomic>
 #include <cstdlib>
-#include <cstdio>
-#include <cstring>
+#include <sys/resource.h>
 #include <sys/times.h>
 #include <mutex>
-#include <cctype>
 #include <unistd.h>
+#include <algorithm>
 #include <functional>
 #include <thread>
 
@@ -33,6 +32,11 @@
 #include <mach/task_info.h>
 #endif
 
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define PINPOINT_HAS_MALLINFO2 1
+#endif
+
 #include "config.h"
 #include "logging.h"
 #include "utility.h"
@@ -45,22 +49,7 @@ namespace pinpoint {
         sc_nprocessors_onln_ = sysconf(_SC_NPROCESSORS_ONLN);
     }
 
-    // RAII wrapper for FILE*
-    struct FileCloser {
-        FILE* fp;
-        explicit FileCloser(FILE* f) : fp(f) {}
-        ~FileCloser() { if (fp) fclose(fp); }
-        FileCloser(const FileCloser&) = delete;
-        FileCloser& operator=(const FileCloser&) = delete;
-    };
-
-    // Constants for buffer sizes (Linux /proc readers only)
-#ifndef __APPLE__
-    constexpr size_t kProcStatBufferSize = 256;
-    constexpr size_t kProcStatusBufferSize = 256;
-#endif
-
-    static void get_cpu_time(clock_t *sys_time, clock_t *proc_time) {
+    static void get_cpu_time([[maybe_unused]] ProcSampler& sampler, clock_t *sys_time, clock_t *proc_time) {
         if (sys_time) {
 #ifdef __APPLE__
             // System-wide CPU ticks via Mach. Ticks are reported in CLK_TCK units
@@ -84,23 +73,12 @@ namespace pinpoint {
                 *sys_time = 0;
             }
 #else
-            FILE *fd = fopen("/proc/stat", "r");
-            if (fd == nullptr) {
-                return;
-            }
-            FileCloser closer(fd);  // RAII: Automatically closes on scope exit
-
-            char buf[kProcStatBufferSize];
-            clock_t user = 0, nice = 0, system = 0;
-            memset(buf, 0, sizeof(buf));
-
-            if (fgets(buf, sizeof(buf) - 1, fd) != nullptr) {
-                if (sscanf(buf, "%*s %lu %lu %lu", &user, &nice, &system) == 3) {
-                    *sys_time = user + system + nice;
-                } else {
-                    LOG_WARN("Failed to parse /proc/stat format");
-                    *sys_time = 0;
-                }
+            const auto ticks = sampler.systemCpuTicks();
+            if (ticks >= 0) {
+                *sys_time = static_cast<clock_t>(ticks);
+            } else {
+                LOG_WARN("Failed to read /proc/stat");
+                *sys_time = 0;
             }
 #endif
         }
@@ -114,13 +92,36 @@ namespace pinpoint {
         }
     }
 
+    AgentStats::ProcessCounters AgentStats::getProcessCounters() {
+        ProcessCounters counters;
+        struct rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            counters.voluntary_context_switches = usage.ru_nvcsw;
+            counters.involuntary_context_switches = usage.ru_nivcsw;
+            counters.minor_page_faults = usage.ru_minflt;
+            counters.major_page_faults = usage.ru_majflt;
+        }
+        return counters;
+    }
+
     AgentStats::CpuLoad AgentStats::getCpuLoad(std::chrono::seconds dur) {
         clock_t sys_time = 0, proc_time = 0;
         double total_cpu = static_cast<double>(dur.count() * sc_clk_tck_ * sc_nprocessors_onln_);
 
         if (total_cpu <= 0) total_cpu = 1; // Prevent division by zero
 
-        get_cpu_time(&sys_time, &proc_time);
+        // /proc/stat is host-wide, so only the process load is relative to the
+        // container's CPU quota. A container limited to 2 of 16 CPUs reports
+        // 100% when it uses both, instead of 12.5%.
+        double proc_total_cpu = total_cpu;
+        if (is_container_) {
+            const auto cpu_limit = proc_sampler_.cpuLimit();
+            if (cpu_limit > 0 && cpu_limit < static_cast<double>(sc_nprocessors_onln_)) {
+                proc_total_cpu = std::max(static_cast<double>(dur.count() * sc_clk_tck_) * cpu_limit, 1.0);
+            }
+        }
+
+        get_cpu_time(proc_sampler_, &sys_time, &proc_time);
 
         clock_t sys_cpu = sys_time - last_sys_cpu_time_;
         double sys_load = static_cast<double>(sys_cpu) / total_cpu;
@@ -128,7 +129,7 @@ namespace pinpoint {
         if (sys_load < 0.0) { sys_load = 0.0; }
 
         clock_t proc_cpu = proc_time - last_proc_cpu_time_;
-        double proc_load = static_cast<double>(proc_cpu) / total_cpu;
+        double proc_load = static_cast<double>(proc_cpu) / proc_total_cpu;
         if (proc_load > 1.0) { proc_load = 1.0; }
         if (proc_load < 0.0) { proc_load = 0.0; }
 
@@ -138,32 +139,16 @@ namespace pinpoint {
         return CpuLoad{sys_load, proc_load};
     }
 
-#ifndef __APPLE__
-    // Helper to parse integers from /proc/self/status lines
-    static std::optional<int64_t> parse_int_value(const char* buf, size_t buf_size, const char* prefix) {
-        size_t prefix_len = strlen(prefix);
-        if (strncmp(buf, prefix, prefix_len) != 0) {
-            return std::nullopt;
-        }
-
-        const char* p = buf + prefix_len;
-        const char* buf_end = buf + buf_size;
-
-        // Skip whitespace
-        while (p < buf_end && isspace(*p)) p++;
-
-        // Extract digits only (values may have trailing units like "kB")
-        const char* digit_start = p;
-        while (p < buf_end && isdigit(*p)) p++;
-        if (p > digit_start) {
-            return stoi_(std::string_view(digit_start, p - digit_start));
-        }
-        return std::nullopt;
-    }
-#endif
-
     AgentStats::ProcessStatus AgentStats::getProcessStatus() {
-        ProcessStatus status{0, 0, 0};
+        ProcessStatus status;
+        status.counters = getProcessCounters();
+
+#ifdef PINPOINT_HAS_MALLINFO2
+        // Walks every arena under its lock; cheap enough once per interval.
+        const auto mi = mallinfo2();
+        status.malloc_in_use = static_cast<int64_t>(mi.uordblks + mi.hblkhd);
+        status.malloc_free = static_cast<int64_t>(mi.fordblks);
+#endif
 
 #ifdef __APPLE__
         // Resident set size (current and peak) via Mach task_info.
@@ -193,27 +178,13 @@ namespace pinpoint {
             LOG_WARN("task_threads() failed");
         }
 #else
-        FILE* fd = fopen("/proc/self/status", "r");
-        if (fd == nullptr) {
-            return status;
-        }
-        FileCloser closer(fd);  // RAII: Automatically closes on scope exit
-
-        char buf[kProcStatusBufferSize] = {};
-        int found = 0;
-        while (fgets(buf, sizeof(buf), fd) != nullptr) {
-            if (auto val = parse_int_value(buf, sizeof(buf), "VmRSS:")) {
-                status.heap_alloc = *val * 1024;  // kB to bytes
-                found++;
-            } else if (auto val = parse_int_value(buf, sizeof(buf), "VmPeak:")) {
-                status.heap_max = *val * 1024;  // kB to bytes
-                found++;
-            } else if (auto val = parse_int_value(buf, sizeof(buf), "Threads:")) {
-                status.num_threads = *val;
-                found++;
-            }
-            if (found == 3) break;
-        }
+        const auto sample = proc_sampler_.sample();
+        status.heap_alloc = std::max<int64_t>(sample.rss_bytes, 0);
+        status.heap_max = std::max<int64_t>(sample.vm_peak_bytes, 0);
+        status.num_threads = std::max<int64_t>(sample.num_threads, 0);
+        status.container_memory = std::max<int64_t>(sample.cgroup_memory_bytes, 0);
+        status.cpu_throttled_usec = sample.cgroup_cpu_throttled_usec;
+        status.open_file_descriptors = std::max<int64_t>(proc_sampler_.openFileDescriptors(), 0);
 #endif
 
         return status;
@@ -227,16 +198,20 @@ namespace pinpoint {
                 shard.acc_response_time_.store(0, std::memory_order_relaxed);
                 shard.request_count_.store(0, std::memory_order_relaxed);
                 shard.max_response_time_.store(0, std::memory_order_relaxed);
+                shard.histogram_.reset();
             }
+            last_percentiles_ = {};
             resumeResponseTimeUpdates();
         }
         
-        sample_new_.store(0, std::memory_order_relaxed);
-        un_sample_new_.store(0, std::memory_order_relaxed);
-        sample_cont_.store(0, std::memory_order_relaxed);
-        un_sample_cont_.store(0, std::memory_order_relaxed);
-        skip_new_.store(0, std::memory_order_relaxed);
-        skip_cont_.store(0, std::memory_order_relaxed);
+        for (auto& shard : counter_shards_) {
+            shard.sample_new_.store(0, std::memory_order_relaxed);
+            shard.un_sample_new_.store(0, std::memory_order_relaxed);
+            shard.sample_cont_.store(0, std::memory_order_relaxed);
+            shard.un_sample_cont_.store(0, std::memory_order_relaxed);
+            shard.skip_new_.store(0, std::memory_order_relaxed);
+            shard.skip_cont_.store(0, std::memory_order_relaxed);
+        }
     }
 
     int64_t AgentStats::getResponseTimeAvg() {
@@ -269,13 +244,14 @@ namespace pinpoint {
         response_time_snapshotting_.store(false, std::memory_order_release);
     }
 
-    void AgentStats::collectAndResetResponseTime(int64_t& avg, int64_t& max) {
+    void AgentStats::collectAndResetResponseTime(AgentStatsSnapshot& stat) {
         std::lock_guard<std::mutex> lock(response_time_snapshot_mutex_);
         pauseResponseTimeUpdates();
 
         int64_t request_count = 0;
         int64_t acc_response_time = 0;
-        max = 0;
+        int64_t max = 0;
+        LogLinearHistogram::Snapshot merged;
         for (auto& shard : response_time_shards_) {
             request_count += shard.request_count_.exchange(0, std::memory_order_relaxed);
             acc_response_time += shard.acc_response_time_.exchange(0, std::memory_order_relaxed);
@@ -283,16 +259,38 @@ namespace pinpoint {
             if (shard_max > max) {
                 max = shard_max;
             }
+            shard.histogram_.drain_into(merged);
         }
 
         resumeResponseTimeUpdates();
-        avg = request_count > 0 ? acc_response_time / request_count : 0;
+        merged.max = max;
+
+        stat.response_time_avg_ = request_count > 0 ? acc_response_time / request_count : 0;
+        stat.response_time_max_ = max;
+        stat.response_time_p50_ = merged.percentile(50);
+        stat.response_time_p90_ = merged.percentile(90);
+        stat.response_time_p99_ = merged.percentile(99);
+        last_percentiles_ = {stat.response_time_p50_, stat.response_time_p90_, stat.response_time_p99_};
+    }
+
+    ResponseTimePercentiles AgentStats::getResponseTimePercentiles() {
+        std::lock_guard<std::mutex> lock(response_time_snapshot_mutex_);
+        return last_percentiles_;
     }
 
     void AgentStats::initAgentStats() {
         last_sys_cpu_time_ = 0;
         last_proc_cpu_time_ = 0;
-        get_cpu_time(&last_sys_cpu_time_, &last_proc_cpu_time_);
+        get_cpu_time(proc_sampler_, &last_sys_cpu_time_, &last_proc_cpu_time_);
+        last_cpu_throttled_usec_ = -1;
+        last_process_counters_ = getProcessCounters();
+
+        const auto config = agent_->getConfig();
+        is_container_ = config && config->is_container;
+        if (is_container_) {
+            LOG_INFO("container cpu limit: {} cpus (0 = unlimited), host cpus: {}",
+                     proc_sampler_.cpuLimit(), sc_nprocessors_onln_);
+        }
         
         resetAgentStats();
         
@@ -300,13 +298,32 @@ namespace pinpoint {
         batch_ = 0;
     }
 
+    size_t AgentStats::threadSlot() {
+        // Handed out round-robin on a thread's first call and kept for its
+        // lifetime, so the first N threads land on N distinct shards. Hashing
+        // std::thread::id instead clusters: it is the pthread_t address, which
+        // is aligned to the thread stack size.
+        // The constant-initialized thread_local needs no init guard on the hot path.
+        static std::atomic<size_t> next_slot{0};
+        static thread_local size_t slot = SIZE_MAX;
+        if (slot == SIZE_MAX) {
+            slot = next_slot.fetch_add(1, std::memory_order_relaxed);
+        }
+        return slot;
+    }
+
     AgentStats::ResponseTimeShard& AgentStats::responseTimeShard() {
-        // Hashed once per thread: each application thread sticks to one shard
-        // for its lifetime, so its RMWs stay on a single cache line that no
-        // other shard's threads touch.
-        static const thread_local size_t shard_index =
-            std::hash<std::thread::id>{}(std::this_thread::get_id()) % kResponseTimeShardCount;
-        return response_time_shards_[shard_index];
+        // Each application thread sticks to one shard for its lifetime, so its
+        // RMWs stay on a single cache line that no other shard's threads touch.
+        return response_time_shards_[threadSlot() % kResponseTimeShardCount];
+    }
+
+    int64_t AgentStats::collectAndResetCounter(Counter counter) {
+        int64_t total = 0;
+        for (auto& shard : counter_shards_) {
+            total += (shard.*counter).exchange(0, std::memory_order_relaxed);
+        }
+        return total;
     }
 
     void AgentStats::collectResponseTime(int64_t response_time) {
@@ -325,6 +342,7 @@ namespace pinpoint {
 
         shard.acc_response_time_.fetch_add(response_time, std::memory_order_relaxed);
         shard.request_count_.fetch_add(1, std::memory_order_relaxed);
+        shard.histogram_.record(response_time);
 
         auto current_max = shard.max_response_time_.load(std::memory_order_relaxed);
         while (current_max < response_time &&
@@ -336,21 +354,14 @@ namespace pinpoint {
         shard.writers_.fetch_sub(1, std::memory_order_acq_rel);
     }
 
-    AgentStats::ActiveSpanShard& AgentStats::activeSpanShard(int64_t spanId) {
-        const auto shard_index = std::hash<int64_t>{}(spanId) % active_span_shards_.size();
-        return active_span_shards_[shard_index];
-    }
-
-    void AgentStats::addActiveSpan(int64_t spanId, int64_t start_time) {
-        auto& shard = activeSpanShard(spanId);
-        std::lock_guard<std::mutex> lock(shard.mutex_);
-        shard.spans_.insert(std::make_pair(spanId, start_time));
+    void AgentStats::addActiveSpan(ActiveRequestSlot& slot, int64_t start_time) {
+        if (!active_requests_.add(slot, start_time) && !slot.registered()) {
+            LOG_DEBUG("active request registry is full: capacity={}", active_requests_.capacity());
+        }
     }
 
-    void AgentStats::dropActiveSpan(int64_t spanId) {
-        auto& shard = activeSpanShard(spanId);
-        std::lock_guard<std::mutex> lock(shard.mutex_);
-        shard.spans_.erase(spanId);
+    void AgentStats::dropActiveSpan(ActiveRequestSlot& slot) {
+        active_requests_.drop(slot);
     }
 
     void AgentStats::collectActiveRequests(int32_t active_requests[4], int64_t sample_time_ms) {
@@ -359,21 +370,18 @@ namespace pinpoint {
         active_requests[2] = 0;
         active_requests[3] = 0;
 
-        for (auto& shard : active_span_shards_) {
-            std::lock_guard<std::mutex> lock(shard.mutex_);
-            for (const auto& iter : shard.spans_) {
-                auto active_time = sample_time_ms - iter.second;
-                if (active_time < 1000) {
-                    active_requests[0]++;
-                } else if (active_time < 3000) {
-                    active_requests[1]++;
-                } else if (active_time < 5000) {
-                    active_requests[2]++;
-                } else {
-                    active_requests[3]++;
-                }
+        active_requests_.for_each([active_requests, sample_time_ms](int64_t start_time) {
+            auto active_time = sample_time_ms - start_time;
+            if (active_time < 1000) {
+                active_requests[0]++;
+            } else if (active_time < 3000) {
+                active_requests[1]++;
+            } else if (active_time < 5000) {
+                active_requests[2]++;
+            } else {
+                active_requests[3]++;
             }
-        }
+        });
     }
 
     void AgentStats::collectAgentStat(AgentStatsSnapshot &stat) {
@@ -392,17 +400,40 @@ namespace pinpoint {
         stat.heap_alloc_size_ = process_status.heap_alloc;
         stat.heap_max_size_ = process_status.heap_max;
         stat.num_threads_ = process_status.num_threads;
+        stat.container_memory_usage_ = process_status.container_memory;
+
+        // The first sample after init only sets the baseline.
+        stat.cpu_throttled_time_ms_ = 0;
+        if (process_status.cpu_throttled_usec >= 0) {
+            if (last_cpu_throttled_usec_ >= 0) {
+                stat.cpu_throttled_time_ms_ =
+                    std::max<int64_t>(process_status.cpu_throttled_usec - last_cpu_throttled_usec_, 0) / 1000;
+            }
+            last_cpu_throttled_usec_ = process_status.cpu_throttled_usec;
+        }
 
-        // Calculate avg response time and snapshot max
-        collectAndResetResponseTime(stat.response_time_avg_, stat.response_time_max_);
-
-        // Snapshot atomics
-        stat.num_sample_new_ = sample_new_.exchange(0);
-        stat.num_sample_cont_ = sample_cont_.exchange(0);
-        stat.num_unsample_new_ = un_sample_new_.exchange(0);
-        stat.num_unsample_cont_ = un_sample_cont_.exchange(0);
-        stat.num_skip_new_ = skip_new_.exchange(0);
-        stat.num_skip_cont_ = skip_cont_.exchange(0);
+        const auto& counters = process_status.counters;
+        stat.voluntary_context_switches_ =
+            counters.voluntary_context_switches - last_process_counters_.voluntary_context_switches;
+        stat.involuntary_context_switches_ =
+            counters.involuntary_context_switches - last_process_counters_.involuntary_context_switches;
+        stat.minor_page_faults_ = counters.minor_page_faults - last_process_counters_.minor_page_faults;
+        stat.major_page_faults_ = counters.major_page_faults - last_process_counters_.major_page_faults;
+        last_process_counters_ = counters;
+        stat.open_file_descriptors_ = process_status.open_file_descriptors;
+        stat.malloc_in_use_bytes_ = process_status.malloc_in_use;
+        stat.malloc_free_bytes_ = process_status.malloc_free;
+
+        // Calculate avg and percentiles and snapshot max
+        collectAndResetResponseTime(stat);
+
+        // Sum and reset the per-thread counter shards
+        stat.num_sample_new_ = collectAndResetCounter(&CounterShard::sample_new_);
+        stat.num_sample_cont_ = collectAndResetCounter(&CounterShard::sample_cont_);
+        stat.num_unsample_new_ = collectAndResetCounter(&CounterShard::un_sample_new_);
+        stat.num_unsample_cont_ = collectAndResetCounter(&CounterShard::un_sample_cont_);
+        stat.num_skip_new_ = collectAndResetCounter(&CounterShard::skip_new_);
+        stat.num_skip_cont_ = collectAndResetCounter(&CounterShard::skip_cont_);
 
         collectActiveRequests(stat.active_requests_, stat.sample_time_);
     }
@@ -414,12 +445,8 @@ namespace pinpoint {
         }
 
         initAgentStats();
-
-        {
-            // Resize vector safely
-            std::lock_guard<std::mutex> lock(mutex_);
-            agent_stats_snapshots_.resize(config->stat.batch_count);
-        }
+        snapshot_ring_.init(static_cast<size_t>(config->stat.batch_count) *
+                            static_cast<size_t>(config->stat.retained_batches));
 
         std::unique_lock<std::mutex> lock(mutex_);
         collect_interval_ = config->stat.collect_interval;
@@ -428,12 +455,28 @@ namespace pinpoint {
         while (!agent_->isExiting()) {
             if (!cond_var_.wait_for(lock, timeout, [this]{ return agent_->isExiting(); })) {
                 // Period elapsed, collect stats
-                // Unlock while collecting to not block other operations? 
-                // collectAgentStat locks its own internal mutexes, so it's fine to hold outer lock or not.
-                // But 'agent_stats_snapshots_' is protected by 'mutex_'.
-                
-                if (static_cast<size_t>(batch_) < agent_stats_snapshots_.size()) {
-                    collectAgentStat(agent_stats_snapshots_[batch_]);
+                // collectAgentStat locks its own internal mutexes, and the ring
+                // needs none, so the outer lock only guards the wait.
+                {
+                    AgentStatsSnapshot stat;
+                    collectAgentStat(stat);
+                    LOG_DEBUG("response time: avg={}, p50={}, p90={}, p99={}, max={}",
+                              stat.response_time_avg_, stat.response_time_p50_, stat.response_time_p90_,
+                              stat.response_time_p99_, stat.response_time_max_);
+                    LOG_DEBUG("cpu: system={}, process={}, throttled={}ms",
+                              stat.system_cpu_time_, stat.process_cpu_time_, stat.cpu_throttled_time_ms_);
+                    LOG_DEBUG("process: ctx_switches={}/{}, page_faults={}/{}, fds={}, malloc in_use={} free={}",
+                              stat.voluntary_context_switches_, stat.involuntary_context_switches_,
+                              stat.minor_page_faults_, stat.major_page_faults_, stat.open_file_descriptors_,
+                              stat.malloc_in_use_bytes_, stat.malloc_free_bytes_);
+
+                    // Keep what the sender has not taken yet; when it is a full
+                    // retention window behind, the newest snapshot is dropped.
+                    if (!snapshot_ring_.push(stat)) {
+                        const auto dropped = dropped_snapshots_.fetch_add(1, std::memory_order_relaxed) + 1;
+                        LOG_DEBUG("drop agent stats: {} snapshots pending, {} dropped",
+                                  snapshot_ring_.size(), dropped);
+                    }
                     batch_++;
                 }
 
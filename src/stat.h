@@ -22,11 +22,14 @@
 #include <mutex>
 #include <vector>
 #include <atomic>
-#include <unordered_map>
 #include <chrono>
 #include <array>
 
+#include "active_request.h"
 #include "agent_service.h"
+#include "histogram.h"
+#include "proc_reader.h"
+#include "spsc_ring.h"
 
 namespace pinpoint {
     /**
@@ -42,6 +45,24 @@ namespace pinpoint {
         int64_t    heap_max_size_{0};
         int64_t    response_time_avg_{0};
         int64_t    response_time_max_{0};
+        // Not part of PResponseTime; kept for local inspection and logging.
+        int64_t    response_time_p50_{0};
+        int64_t    response_time_p90_{0};
+        int64_t    response_time_p99_{0};
+        // cgroup v2 memory.current; 0 outside a cgroup v2 hierarchy. Not sent.
+        int64_t    container_memory_usage_{0};
+        // Time the cgroup was throttled by its CPU quota during the interval. Not sent.
+        int64_t    cpu_throttled_time_ms_{0};
+        // Native process metrics. Context switches and page faults are counts
+        // within the interval; open_file_descriptors_ is sent as PFileDescriptor,
+        // the rest are only logged.
+        int64_t    voluntary_context_switches_{0};
+        int64_t    involuntary_context_switches_{0};
+        int64_t    minor_page_faults_{0};
+        int64_t    major_page_faults_{0};
+        int64_t    open_file_descriptors_{0};
+        int64_t    malloc_in_use_bytes_{0};
+        int64_t    malloc_free_bytes_{0};
         int64_t    num_sample_new_{0};
         int64_t    num_sample_cont_{0};
         int64_t    num_unsample_new_{0};
@@ -51,6 +72,15 @@ namespace pinpoint {
         int32_t    active_requests_[4]{0, 0, 0, 0};
     };
 
+    /**
+     * @brief Response-time percentiles of one collect interval, in milliseconds.
+     */
+    struct ResponseTimePercentiles {
+        int64_t p50{0};
+        int64_t p90{0};
+        int64_t p99{0};
+    };
+
     /**
      * @brief Worker responsible for periodically sending agent statistics to the collector.
      */
@@ -66,19 +96,33 @@ namespace pinpoint {
 
         // Public methods for data collection (called by global functions)
         void collectResponseTime(int64_t resTime);
-        void addActiveSpan(int64_t spanId, int64_t start_time);
-        void dropActiveSpan(int64_t spanId);
+        /// @brief Counts a request started at @p start_time as active until dropActiveSpan(@p slot).
+        void addActiveSpan(ActiveRequestSlot& slot, int64_t start_time);
+        void dropActiveSpan(ActiveRequestSlot& slot);
         
         // Counter incrementers
-        void incrSampleNew() { sample_new_++; }
-        void incrUnsampleNew() { un_sample_new_++; }
-        void incrSampleCont() { sample_cont_++; }
-        void incrUnsampleCont() { un_sample_cont_++; }
-        void incrSkipNew() { skip_new_++; }
-        void incrSkipCont() { skip_cont_++; }
-
-        // Access to snapshots (for testing or global accessor)
-        std::vector<AgentStatsSnapshot>& getSnapshots() { return agent_stats_snapshots_; }
+        void incrSampleNew() { incr(&CounterShard::sample_new_); }
+        void incrUnsampleNew() { incr(&CounterShard::un_sample_new_); }
+        void incrSampleCont() { incr(&CounterShard::sample_cont_); }
+        void incrUnsampleCont() { incr(&CounterShard::un_sample_cont_); }
+        void incrSkipNew() { incr(&CounterShard::skip_new_); }
+        void incrSkipCont() { incr(&CounterShard::skip_cont_); }
+
+        /**
+         * @brief Moves up to @p max_count of the oldest collected snapshots to @p out.
+         *
+         * Called only from the stats sender thread; the stats worker is the
+         * only producer.
+         *
+         * @return The number of snapshots moved.
+         */
+        size_t takeSnapshots(std::vector<AgentStatsSnapshot>& out, size_t max_count) {
+            return snapshot_ring_.pop(out, max_count);
+        }
+        /// @brief Snapshots collected but not yet taken by the sender.
+        size_t pendingSnapshots() const { return snapshot_ring_.size(); }
+        /// @brief Snapshots dropped because the sender fell more than the retained batches behind.
+        int64_t droppedSnapshots() const { return dropped_snapshots_.load(std::memory_order_relaxed); }
 
         // Singleton instance accessor (for global C-style functions)
         static AgentStats* getInstance();
@@ -87,12 +131,14 @@ namespace pinpoint {
         void collectAgentStat(AgentStatsSnapshot &stat);
         void collectActiveRequests(int32_t active_requests[4], int64_t sample_time_ms);
         void resetAgentStats();
+        /// @brief Returns the response-time percentiles of the last collected interval.
+        ResponseTimePercentiles getResponseTimePercentiles();
 
     private:
         int64_t getResponseTimeAvg();
         void pauseResponseTimeUpdates();
         void resumeResponseTimeUpdates();
-        void collectAndResetResponseTime(int64_t& avg, int64_t& max);
+        void collectAndResetResponseTime(AgentStatsSnapshot& stat);
         
         // System metrics structures
         struct CpuLoad {
@@ -100,38 +146,69 @@ namespace pinpoint {
             double proc_load;
         };
         
+        // Cumulative since process start, from getrusage().
+        struct ProcessCounters {
+            int64_t voluntary_context_switches{0};
+            int64_t involuntary_context_switches{0};
+            int64_t minor_page_faults{0};
+            int64_t major_page_faults{0};
+        };
+
         struct ProcessStatus {
-            int64_t heap_alloc;
-            int64_t heap_max;
-            int64_t num_threads;
+            int64_t heap_alloc{0};
+            int64_t heap_max{0};
+            int64_t num_threads{0};
+            int64_t container_memory{0};
+            int64_t cpu_throttled_usec{-1};  // cumulative; -1 if unavailable
+            ProcessCounters counters{};
+            int64_t open_file_descriptors{0};
+            int64_t malloc_in_use{0};
+            int64_t malloc_free{0};
         };
         
         // System metrics helpers
         CpuLoad getCpuLoad(std::chrono::seconds dur);
         ProcessStatus getProcessStatus();
+        static ProcessCounters getProcessCounters();
 
     private:
-        static constexpr size_t kActiveSpanShardCount = 64;
         static constexpr size_t kResponseTimeShardCount = 16;
-
-        struct ActiveSpanShard {
-            std::mutex mutex_;
-            std::unordered_map<int64_t, int64_t> spans_;
-        };
-
-        // One cache line per shard: every request end updates exactly one
-        // shard (picked by thread id), so the per-request RMWs never contend
-        // across shards. writers_ shares its shard's line on purpose — it is
-        // only ever touched by the same threads that update that shard.
+        static constexpr size_t kCounterShardCount = 64;
+
+        // One cache line per shard for the sums: every request end updates
+        // exactly one shard, the one its thread was handed round-robin by
+        // threadSlot(), so the per-request RMWs only contend with the threads
+        // sharing that slot modulo kResponseTimeShardCount. writers_ shares
+        // its shard's line on purpose — it is only ever touched by the same
+        // threads that update that shard. The histogram follows on its own
+        // lines.
         struct alignas(64) ResponseTimeShard {
             std::atomic<int64_t> acc_response_time_{0};
             std::atomic<int64_t> request_count_{0};
             std::atomic<int64_t> max_response_time_{0};
             std::atomic<int64_t> writers_{0};
+            alignas(64) LogLinearHistogram histogram_;
         };
 
-        ActiveSpanShard& activeSpanShard(int64_t spanId);
+        // Sampling counters, one cache line per shard. Each thread sticks to
+        // one shard, so the per-request increments only ever contend with the
+        // few threads sharing it; collectAgentStat() sums the shards.
+        struct alignas(64) CounterShard {
+            std::atomic<int64_t> sample_new_{0};
+            std::atomic<int64_t> un_sample_new_{0};
+            std::atomic<int64_t> sample_cont_{0};
+            std::atomic<int64_t> un_sample_cont_{0};
+            std::atomic<int64_t> skip_new_{0};
+            std::atomic<int64_t> skip_cont_{0};
+        };
+        using Counter = std::atomic<int64_t> CounterShard::*;
+
         ResponseTimeShard& responseTimeShard();
+        void incr(Counter counter) {
+            (counter_shards_[threadSlot() % kCounterShardCount].*counter).fetch_add(1, std::memory_order_relaxed);
+        }
+        int64_t collectAndResetCounter(Counter counter);
+        static size_t threadSlot();
 
         // Non-owning. AgentImpl owns this object (unique_ptr member) and joins
         // the stats worker before its own destruction, so agent_ never dangles.
@@ -148,22 +225,28 @@ namespace pinpoint {
         std::array<ResponseTimeShard, kResponseTimeShardCount> response_time_shards_;
         std::atomic<bool> response_time_snapshotting_{false};
         std::mutex response_time_snapshot_mutex_;
+        ResponseTimePercentiles last_percentiles_{};  // guarded by response_time_snapshot_mutex_
         
-        std::atomic<int64_t> sample_new_{0};
-        std::atomic<int64_t> un_sample_new_{0};
-        std::atomic<int64_t> sample_cont_{0};
-        std::atomic<int64_t> un_sample_cont_{0};
-        std::atomic<int64_t> skip_new_{0};
-        std::atomic<int64_t> skip_cont_{0};
+        std::array<CounterShard, kCounterShardCount> counter_shards_;
         
-        std::array<ActiveSpanShard, kActiveSpanShardCount> active_span_shards_;
+        ActiveRequestRegistry active_requests_;
         
-        std::vector<AgentStatsSnapshot> agent_stats_snapshots_;
+        // Written by the stats worker, drained by the stats sender. Sized to
+        // stat.batch_count * stat.retained_batches when the worker starts.
+        SpscRing<AgentStatsSnapshot> snapshot_ring_;
+        std::atomic<int64_t> dropped_snapshots_{0};
         int batch_{0};
         int collect_interval_{0};
         
         // Cached system constants
         long sc_clk_tck_{0};
         long sc_nprocessors_onln_{0};
+
+        // Persistent /proc and cgroup descriptors; only used from the stats worker.
+        ProcSampler proc_sampler_;
+        // Normalize process CPU load by the cgroup quota (config is_container).
+        bool is_container_{false};
+        int64_t last_cpu_throttled_usec_{-1};
+        ProcessCounters last_process_counters_{};
     };
 }
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace pinpoint {
+
+    /**
+     * @brief Hashed timing wheel holding items until their deadline passes.
+     *
+     * Deadlines are rounded up to a whole tick and hashed into one of
+     * @c slot_count slots, so schedule() is O(1) and never allocates once a
+     * slot's storage has grown to its working size. Deadlines further out than
+     * one revolution share a slot with nearer ones and are skipped until their
+     * round comes up.
+     *
+     * Not thread-safe; callers serialize access with their own lock.
+     *
+     * @tparam T Item type; only needs to be move-constructible.
+     */
+    template<typename T>
+    class TimingWheel {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        TimingWheel(std::chrono::milliseconds tick, size_t slot_count)
+            : tick_(std::max(tick, std::chrono::milliseconds(1))),
+              slots_(std::max<size_t>(slot_count, 1)),
+              origin_(Clock::now()) {}
+
+        /// @brief Schedules @p item to expire once @p due has passed.
+        void schedule(Clock::time_point due, T item) {
+            const auto due_tick = std::max(tick_of(due), next_tick_);
+            slots_[due_tick % slots_.size()].push_back(Entry{due_tick, std::move(item)});
+            ++size_;
+        }
+
+        /**
+         * @brief Hands every item whose deadline has passed as of @p now to @p on_expired.
+         *
+         * Items are delivered in tick order; order within a tick is unspecified.
+         *
+         * @param on_expired Callable taking @c T&&.
+         */
+        template<typename Fn>
+        void expire(Clock::time_point now, Fn&& on_expired) {
+            const auto now_tick = tick_of_floor(now);
+            if (now_tick < next_tick_) {
+                return;
+            }
+            // A full revolution visits every slot; going further only repeats them.
+            const auto last_tick = std::min(now_tick, next_tick_ + slots_.size() - 1);
+            for (auto tick = next_tick_; tick <= last_tick && size_ > 0; ++tick) {
+                auto& slot = slots_[tick % slots_.size()];
+                for (size_t i = 0; i < slot.size();) {
+                    if (slot[i].due_tick > now_tick) {
+                        ++i;
+                        continue;
+                    }
+                    T item = std::move(slot[i].item);
+                    if (i + 1 != slot.size()) {
+                        slot[i] = std::move(slot.back());
+                    }
+                    slot.pop_back();
+                    --size_;
+                    on_expired(std::move(item));
+                }
+            }
+            next_tick_ = now_tick + 1;
+        }
+
+        /**
+         * @brief Returns the earliest deadline still held, rounded up to its tick.
+         *
+         * Returns @c Clock::time_point::max() when the wheel is empty.
+         */
+        Clock::time_point next_deadline() const {
+            if (size_ == 0) {
+                return Clock::time_point::max();
+            }
+            // Within one revolution the first non-empty slot holding an item
+            // of the current round is the earliest; otherwise fall back to a scan.
+            for (uint64_t tick = next_tick_; tick < next_tick_ + slots_.size(); ++tick) {
+                for (const auto& entry : slots_[tick % slots_.size()]) {
+                    if (entry.due_tick <= tick) {
+                        return time_of(tick);
+                    }
+                }
+            }
+            auto earliest = std::numeric_limits<uint64_t>::max();
+            for (const auto& slot : slots_) {
+                for (const auto& entry : slot) {
+                    earliest = std::min(earliest, entry.due_tick);
+                }
+            }
+            return time_of(earliest);
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+    private:
+        struct Entry {
+            uint64_t due_tick;
+            T item;
+        };
+
+        uint64_t tick_of_floor(Clock::time_point t) const {
+            if (t <= origin_) {
+                return 0;
+            }
+            return static_cast<uint64_t>((t - origin_) / tick_);
+        }
+
+        uint64_t tick_of(Clock::time_point t) const {
+            if (t <= origin_) {
+                return 0;
+            }
+            const auto elapsed = t - origin_;
+            const auto ticks = static_cast<uint64_t>(elapsed / tick_);
+            return elapsed % tick_ == Clock::duration::zero() ? ticks : ticks + 1;
+        }
+
+        Clock::time_point time_of(uint64_t tick) const {
+            return origin_ + tick_ * static_cast<int64_t>(tick);
+        }
+
+        std::chrono::milliseconds tick_;
+        std::vector<std::vector<Entry>> slots_;
+        Clock::time_point origin_;
+        uint64_t next_tick_{0};
+        size_t size_{0};
+    };
+
+}  // namespace pinpoint
@@ -466,6 +466,35 @@ void pt_agent_shutdown(pt_agent_t agent) {
     });
 }
 
+void pt_agent_register_metadata(pt_agent_t agent,
+                                const pt_api_metadata_t* apis, int apis_count,
+                                const pt_sql_metadata_t* sqls, int sqls_count,
+                                const char* const* errors, int errors_count) {
+    pt_api_call(__func__, [&] {
+        pt_handle_call(agent, [&](pt_agent_t valid) {
+            pinpoint::MetadataCatalog catalog;
+            if (apis && apis_count > 0) {
+                catalog.apis.reserve(static_cast<std::size_t>(apis_count));
+                for (int i = 0; i < apis_count; ++i) {
+                    if (apis[i].operation) {
+                        catalog.apis.push_back({apis[i].operation, apis[i].api_type});
+                    }
+                }
+            }
+            if (sqls && sqls_count > 0) {
+                catalog.sql_queries.reserve(static_cast<std::size_t>(sqls_count));
+                for (int i = 0; i < sqls_count; ++i) {
+                    if (sqls[i].query) {
+                        catalog.sql_queries.push_back({sqls[i].query, sqls[i].service_type});
+                    }
+                }
+            }
+            catalog.error_names = to_string_vector(errors, errors_count);
+            valid->ptr->RegisterMetadata(catalog);
+        });
+    });
+}
+
 // ============================================================================
 // Span creation
 // ============================================================================
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <mutex>
 
 #include "logging.h"
@@ -21,9 +22,8 @@
 
 namespace pinpoint {
 
-    // URL stat configuration constants
-    constexpr int URL_STAT_TICK_INTERVAL_SECONDS = 30;
-    constexpr int URL_STAT_SEND_INTERVAL_SECONDS = 30;
+    // The collector aggregates URL stats in 30s ticks; finer ticks are rolled up before sending.
+    constexpr int64_t URL_STAT_COLLECTOR_TICK_MILLIS = 30000;
     
     // Histogram bucket thresholds (in milliseconds)
     constexpr int32_t BUCKET_THRESHOLD_100MS = 100;
@@ -33,6 +33,10 @@ namespace pinpoint {
     constexpr int32_t BUCKET_THRESHOLD_3S = 3000;
     constexpr int32_t BUCKET_THRESHOLD_5S = 5000;
     constexpr int32_t BUCKET_THRESHOLD_8S = 8000;
+    constexpr int32_t COLLECTOR_BUCKET_THRESHOLDS[URL_STATS_BUCKET_SIZE - 1] = {
+        BUCKET_THRESHOLD_100MS, BUCKET_THRESHOLD_300MS, BUCKET_THRESHOLD_500MS, BUCKET_THRESHOLD_1S,
+        BUCKET_THRESHOLD_3S, BUCKET_THRESHOLD_5S, BUCKET_THRESHOLD_8S,
+    };
 
     struct TrimmedUrlPath {
         std::string_view path;
@@ -68,14 +72,13 @@ namespace pinpoint {
         return {url.substr(0, end), wildcard};
     }
 
-    static std::string build_url_stat_key(const UrlStatEntry& us, const Config& config) {
+    // Builds the key into @p url, reusing its capacity.
+    static void build_url_stat_key(std::string& url, const UrlStatEntry& us, const Config& config) {
         const auto trimmed = config.http.url_stat.enable_trim_path
             ? trim_url_path_view(us.url_pattern_, config.http.url_stat.trim_path_depth)
             : TrimmedUrlPath{us.url_pattern_, false};
 
-        const auto method_prefix_size = config.http.url_stat.method_prefix ? us.method_.size() + 1 : 0;
-        std::string url;
-        url.reserve(method_prefix_size + trimmed.path.size() + (trimmed.wildcard ? 1 : 0));
+        url.clear();
         if (config.http.url_stat.method_prefix) {
             url.append(us.method_);
             url.push_back(' ');
@@ -84,24 +87,152 @@ namespace pinpoint {
         if (trimmed.wildcard) {
             url.push_back('*');
         }
-        return url;
     }
-    
+
+    static uint64_t next_url_stats_id() {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // takeSnapshot() starts a new interning table once the current one holds
+    // this many times the URL limit.
+    constexpr size_t URL_TEMPLATE_RESET_FACTOR = 4;
+
+    uint32_t UrlTemplateTable::intern(std::string_view url) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (const auto f = ids_.find(url); f != ids_.end()) {
+            return f->second;
+        }
+        const auto id = static_cast<uint32_t>(urls_.size());
+        const auto& stored = urls_.emplace_back(url);
+        ids_.emplace(stored, id);
+        return id;
+    }
+
+    const std::string& UrlTemplateTable::url(uint32_t id) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return urls_.at(id);
+    }
+
+    size_t UrlTemplateTable::size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return urls_.size();
+    }
+
+    // Http.UrlStatLimit bounds the URL/tick entries held in memory. A snapshot
+    // holds every tick of one send interval, so the limit is scaled by the
+    // number of ticks per send interval to cover as many URLs in each tick.
+    static size_t url_stat_entry_limit(int limit, int send_interval_ms, const TickClock& tick_clock) {
+        const auto tick_millis = tick_clock.intervalMillis();
+        const auto ticks = tick_millis > 0
+            ? std::max<int64_t>((send_interval_ms + tick_millis - 1) / tick_millis, 1)
+            : 1;
+        return static_cast<size_t>(std::max(limit, 0)) * static_cast<size_t>(ticks);
+    }
+
+    static int64_t url_stat_tick_seconds(const std::shared_ptr<const Config>& config) {
+        const auto tick_ms = config ? config->http.url_stat.tick_interval_ms : defaults::HTTP_URL_STAT_TICK_INTERVAL_MS;
+        return tick_ms / 1000;
+    }
+
     UrlStats::UrlStats(AgentService* agent)
         : agent_(agent),
-          tick_clock_(URL_STAT_TICK_INTERVAL_SECONDS),
-          snapshot_(std::make_unique<UrlStatSnapshot>()) {}
+          id_(next_url_stats_id()),
+          tick_clock_(url_stat_tick_seconds(agent->getConfig())),
+          templates_(std::make_shared<UrlTemplateTable>()) {}
+
+    UrlStats::~UrlStats() {
+        std::lock_guard<std::mutex> lock(partials_mutex_);
+        for (auto& partial : partials_) {
+            partial->orphaned_.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    UrlStats::Partial& UrlStats::thread_partial() {
+        struct CachedPartial {
+            uint64_t owner_id;
+            std::shared_ptr<Partial> partial;
+        };
+        // Usually a single entry: one agent per process.
+        static thread_local std::vector<CachedPartial> cache;
+        for (const auto& cached : cache) {
+            if (cached.owner_id == id_) {
+                return *cached.partial;
+            }
+        }
+
+        cache.erase(std::remove_if(cache.begin(), cache.end(), [](const CachedPartial& cached) {
+            return cached.partial->orphaned_.load(std::memory_order_relaxed);
+        }), cache.end());
+        std::shared_ptr<Partial> partial;
+        {
+            std::lock_guard<std::mutex> lock(partials_mutex_);
+            partial = std::make_shared<Partial>(templates_);
+            partials_.push_back(partial);
+        }
+        cache.push_back({id_, partial});
+        return *partial;
+    }
 
     void UrlStats::addSnapshot(const UrlStatEntry* us, const Config& config) {
-        std::lock_guard<std::mutex> lock(snapshot_mutex_);
-        snapshot_->add(us, config, tick_clock_);
+        auto& partial = thread_partial();
+        std::lock_guard<std::mutex> lock(partial.mutex_);
+        partial.snapshot_.add(us, config, tick_clock_);
     }
 
     std::unique_ptr<UrlStatSnapshot> UrlStats::takeSnapshot() {
-        std::lock_guard<std::mutex> lock(snapshot_mutex_);
-        auto old_snapshot = std::move(snapshot_);
-        snapshot_ = std::make_unique<UrlStatSnapshot>();
-        return old_snapshot;
+        const auto config = agent_->getConfig();
+        const auto limit = url_stat_entry_limit(
+            config ? config->http.url_stat.limit : defaults::HTTP_URL_STAT_LIMIT,
+            config ? config->http.url_stat.send_interval_ms : defaults::HTTP_URL_STAT_SEND_INTERVAL_MS,
+            tick_clock_);
+        // Heavy hitters are picked once over every thread's traffic, not per merge.
+        const bool heavy_hitter = config && config->http.url_stat.heavy_hitter;
+        const auto merge_limit = heavy_hitter ? SIZE_MAX : limit;
+
+        std::unique_ptr<UrlStatSnapshot> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(partials_mutex_);
+            snapshot = std::make_unique<UrlStatSnapshot>(templates_);
+            // The returned snapshot keeps the old table alive to resolve its URLs.
+            const auto next_templates = templates_->size() > limit * URL_TEMPLATE_RESET_FACTOR
+                ? std::make_shared<UrlTemplateTable>()
+                : templates_;
+            for (auto it = partials_.begin(); it != partials_.end();) {
+                {
+                    std::lock_guard<std::mutex> partial_lock((*it)->mutex_);
+                    snapshot->merge((*it)->snapshot_, merge_limit);
+                    if (next_templates != templates_) {
+                        (*it)->snapshot_.rebind(next_templates);
+                    }
+                }
+                // Only the registry still refers to it: its thread has exited.
+                if (it->use_count() == 1) {
+                    it = partials_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            templates_ = next_templates;
+        }
+        if (heavy_hitter) {
+            snapshot->foldOverflow(limit);
+        }
+
+        // The collector only takes the coarse buckets and 30s ticks; fine-grained
+        // percentiles are reported locally, per tick before the roll-up.
+        if (config && !config->http.url_stat.percentile_bounds.empty()) {
+            for (const auto& [key, each] : snapshot->getEachStats()) {
+                const auto& histogram = each->getTotalHistogram();
+                LOG_DEBUG("url stats percentiles: {}, tick={}, p50={}ms, p95={}ms, p99={}ms", snapshot->url(key),
+                          each->tick(), histogram.percentile(50), histogram.percentile(95),
+                          histogram.percentile(99));
+            }
+        }
+        if (tick_clock_.intervalMillis() < URL_STAT_COLLECTOR_TICK_MILLIS) {
+            snapshot->rollUp(URL_STAT_COLLECTOR_TICK_MILLIS);
+        }
+        return snapshot;
     }
 
     int64_t TickClock::tick(const std::chrono::system_clock::time_point end_time) const {
@@ -111,15 +242,38 @@ namespace pinpoint {
         return end_millis.count() - cutoff.count();
     }
 
-    static constexpr int getBucket(int32_t elapsed) noexcept {
-        if (elapsed < BUCKET_THRESHOLD_100MS) return 0;
-        if (elapsed < BUCKET_THRESHOLD_300MS) return 1;
-        if (elapsed < BUCKET_THRESHOLD_500MS) return 2;
-        if (elapsed < BUCKET_THRESHOLD_1S) return 3;
-        if (elapsed < BUCKET_THRESHOLD_3S) return 4;
-        if (elapsed < BUCKET_THRESHOLD_5S) return 5;
-        if (elapsed < BUCKET_THRESHOLD_8S) return 6;
-        return 7;
+    UrlStatBucketSchema::UrlStatBucketSchema(const std::vector<int>& bounds)
+        : bounds_(std::begin(COLLECTOR_BUCKET_THRESHOLDS), std::end(COLLECTOR_BUCKET_THRESHOLDS)) {
+        for (const auto bound : bounds) {
+            if (bound > 0) {
+                bounds_.push_back(bound);
+            }
+        }
+        std::sort(bounds_.begin(), bounds_.end());
+        bounds_.erase(std::unique(bounds_.begin(), bounds_.end()), bounds_.end());
+
+        // A fine bucket starts at the previous bound, and that start decides
+        // which collector bucket it belongs to.
+        collector_.reserve(size());
+        collector_.push_back(0);
+        const auto thresholds_end = std::end(COLLECTOR_BUCKET_THRESHOLDS);
+        for (const auto lower : bounds_) {
+            collector_.push_back(static_cast<uint8_t>(
+                std::upper_bound(std::begin(COLLECTOR_BUCKET_THRESHOLDS), thresholds_end, lower) -
+                std::begin(COLLECTOR_BUCKET_THRESHOLDS)));
+        }
+    }
+
+    const std::shared_ptr<const UrlStatBucketSchema>& UrlStatBucketSchema::collector() {
+        static const auto schema = std::make_shared<const UrlStatBucketSchema>(std::vector<int>{});
+        return schema;
+    }
+
+    UrlStatHistogram::UrlStatHistogram(std::shared_ptr<const UrlStatBucketSchema> schema)
+        : total_(0), max_(0), schema_(std::move(schema)) {
+        if (schema_->highResolution()) {
+            fine_.assign(schema_->size(), 0);
+        }
     }
 
     void UrlStatHistogram::add(int32_t elapsed) {
@@ -127,7 +281,56 @@ namespace pinpoint {
         if (max_ < elapsed) {
             max_ = elapsed;
         }
-        histogram_[getBucket(elapsed)]++;
+        const auto fine = schema_->bucket(elapsed);
+        histogram_[schema_->collectorBucket(fine)]++;
+        if (!fine_.empty()) {
+            fine_[fine]++;
+        }
+    }
+
+    void UrlStatHistogram::merge(const UrlStatHistogram& other) {
+        total_ += other.total_;
+        if (max_ < other.max_) {
+            max_ = other.max_;
+        }
+        for (int i = 0; i < URL_STATS_BUCKET_SIZE; i++) {
+            histogram_[i] += other.histogram_[i];
+        }
+        if (!fine_.empty() && fine_.size() == other.fine_.size() && *schema_ == *other.schema_) {
+            for (size_t i = 0; i < fine_.size(); i++) {
+                fine_[i] += other.fine_[i];
+            }
+        } else {
+            // The fine counts no longer cover every sample.
+            fine_.clear();
+        }
+    }
+
+    int64_t UrlStatHistogram::percentile(double percentile) const {
+        const auto& schema = fine_.empty() ? *UrlStatBucketSchema::collector() : *schema_;
+        const auto count = [this](size_t i) -> int64_t {
+            return fine_.empty() ? histogram_[i] : fine_[i];
+        };
+
+        int64_t samples = 0;
+        for (size_t i = 0; i < schema.size(); i++) {
+            samples += count(i);
+        }
+        if (samples == 0) {
+            return 0;
+        }
+
+        const auto clamped = std::clamp(percentile, 0.0, 100.0);
+        const auto rank = std::clamp<int64_t>(
+            static_cast<int64_t>(clamped / 100.0 * static_cast<double>(samples) + 0.5), 1, samples);
+        int64_t seen = 0;
+        for (size_t i = 0; i < schema.size(); i++) {
+            seen += count(i);
+            if (seen >= rank) {
+                return std::min(schema.upper(i), max_);
+            }
+        }
+        return max_;
     }
 
     void UrlStatSnapshot::add(const UrlStatEntry* us, const Config& config, TickClock& tick_clock) {
@@ -135,117 +338,284 @@ namespace pinpoint {
             return;
         }
 
-        const auto tick = tick_clock.tick(us->end_time_);
-        auto key = UrlKey{build_url_stat_key(*us, config), tick};
-        LOG_DEBUG("url stats snapshot add : {}, {}", key.url_, key.tick_);
+        // Looked up through per-thread buffers that are reused, so a hit
+        // allocates nothing and skips trimming the pattern.
+        static thread_local std::string raw_key;
+        raw_key.assign(us->method_);
+        raw_key.push_back(' ');
+        raw_key.append(us->url_pattern_);
+
+        uint32_t id;
+        if (const auto f = resolved_.find(raw_key); f != resolved_.end()) {
+            id = f->second;
+        } else {
+            if (resolved_.size() >= kMaxResolvedUrls) {
+                resolved_.clear();
+            }
+            static thread_local std::string url;
+            build_url_stat_key(url, *us, config);
+            id = templates_->intern(url);
+            resolved_.emplace(raw_key, id);
+        }
+
+        const UrlKey key{id, tick_clock.tick(us->end_time_)};
+        LOG_DEBUG("url stats snapshot add : {}, {}", id, key.tick_);
+
+        if (!schema_) {
+            const auto& bounds = config.http.url_stat.percentile_bounds;
+            schema_ = bounds.empty()
+                ? UrlStatBucketSchema::collector()
+                : std::make_shared<const UrlStatBucketSchema>(bounds);
+        }
 
         EachUrlStat *e;
         if (const auto f = urlMap_.find(key); f == urlMap_.end()) {
-            if (urlMap_.size() >= static_cast<size_t>(config.http.url_stat.limit)) {
-                return;
+            const auto limit = url_stat_entry_limit(config.http.url_stat.limit,
+                                                    config.http.url_stat.send_interval_ms, tick_clock);
+            uint64_t inherited_weight = 0;
+            if (urlCount() >= limit) {
+                if (!config.http.url_stat.heavy_hitter || urlCount() == 0) {
+                    return;
+                }
+                if (!admission_) {
+                    admission_ = std::make_unique<UrlCountMinSketch>(urlCount());
+                }
+                // One-off URLs (scans) never outrank a tracked URL, so they
+                // only ever reach the other bucket.
+                const auto estimate = admission_->increment(key);
+                const auto [lightest_weight, lightest_key] = lightest();
+                if (estimate <= lightest_weight) {
+                    e = &otherStat(key.tick_, schema_);
+                    e->getTotalHistogram().add(us->elapsed_);
+                    if (us->failed_) {
+                        e->getFailHistogram().add(us->elapsed_);
+                    }
+                    return;
+                }
+                // The estimate already counts this sample.
+                inherited_weight = estimate - 1;
+                const auto evicted = urlMap_.find(lightest_key);
+                std::pop_heap(lightest_.begin(), lightest_.end(), std::greater<>());
+                lightest_.pop_back();
+                fold(evicted);
             }
-            if (urlMap_.empty() && config.http.url_stat.limit > 0) {
+            if (urlMap_.empty() && limit > 0) {
                 constexpr size_t kMaxInitialReserve = 4096;
-                urlMap_.reserve(std::min(static_cast<size_t>(config.http.url_stat.limit), kMaxInitialReserve));
+                urlMap_.reserve(std::min(limit, kMaxInitialReserve));
             }
-            auto new_stat = std::make_unique<EachUrlStat>(key.tick_);
+            auto new_stat = std::make_unique<EachUrlStat>(key.tick_, schema_);
             e = new_stat.get();
-            urlMap_.emplace(std::move(key), std::move(new_stat));
+            e->addWeight(inherited_weight);
+            urlMap_.emplace(key, std::move(new_stat));
+            if (!lightest_.empty()) {
+                lightest_.emplace_back(inherited_weight, key);
+                std::push_heap(lightest_.begin(), lightest_.end(), std::greater<>());
+            }
         } else {
             e = f->second.get();
         }
 
+        // Entries already in the heap keep their stale weight until popped.
+        e->addWeight(1);
         e->getTotalHistogram().add(us->elapsed_);
         if (us->failed_) {
             e->getFailHistogram().add(us->elapsed_);
         }
     }
 
-    std::string UrlStatSnapshot::trim_url_path(std::string_view url, int depth) {
-        const auto trimmed = trim_url_path_view(url, depth);
-        std::string result;
-        result.reserve(trimmed.path.size() + (trimmed.wildcard ? 1 : 0));
-        result.append(trimmed.path.data(), trimmed.path.size());
-        if (trimmed.wildcard) {
-            result.push_back('*');
+    void UrlStatSnapshot::merge(UrlStatSnapshot& other, size_t limit) {
+        const bool same_templates = templates_ == other.templates_;
+        if (same_templates && urlMap_.empty() && other.urlCount() <= limit) {
+            urlMap_.swap(other.urlMap_);
+            other_entries_ = other.other_entries_;
+            other_id_ = other.other_id_;
+            other.clearUrls();
+            return;
         }
-        return result;
+        if (other.other_entries_ > 0) {
+            otherId();
+        }
+        // New entries would be missing from the heap; rebuild it on demand.
+        lightest_.clear();
+        for (auto& [other_key, stat] : other.urlMap_) {
+            const auto key = same_templates
+                ? other_key
+                : UrlKey{templates_->intern(other.url(other_key)), other_key.tick_};
+            if (const auto f = urlMap_.find(key); f != urlMap_.end()) {
+                f->second->merge(*stat);
+            } else if (isOther(key)) {
+                urlMap_.emplace(key, std::move(stat));
+                ++other_entries_;
+            } else if (urlCount() < limit) {
+                urlMap_.emplace(key, std::move(stat));
+            }
+        }
+        other.clearUrls();
     }
 
-    void UrlStats::enqueueUrlStats(std::unique_ptr<UrlStatEntry> stats) noexcept try {
-        if (!stats) {
+    void UrlStatSnapshot::foldOverflow(size_t limit) {
+        if (urlCount() <= limit) {
             return;
         }
-        enqueueUrlStats(std::move(*stats));
-    } catch (const std::exception &e) {
-        LOG_ERROR("failed to enqueue url stats: exception = {}", e.what());
-    } catch (...) {
-        LOG_ERROR("failed to enqueue url stats: unknown exception");
+        std::vector<std::pair<uint64_t, UrlKey>> urls;
+        urls.reserve(urlCount());
+        for (const auto& [key, stat] : urlMap_) {
+            if (!isOther(key)) {
+                urls.emplace_back(stat->weight(), key);
+            }
+        }
+        // Heaviest first; everything past the first limit entries is folded.
+        std::nth_element(urls.begin(), urls.begin() + static_cast<std::ptrdiff_t>(limit), urls.end(),
+                         std::greater<>());
+        for (auto it = urls.begin() + static_cast<std::ptrdiff_t>(limit); it != urls.end(); ++it) {
+            fold(urlMap_.find(it->second));
+        }
+        lightest_.clear();
     }
 
-    void UrlStats::enqueueUrlStats(UrlStatEntry stats) noexcept try {
-        const auto config = agent_->getConfig();
-        if (!config->http.url_stat.enable) {
-            return;
+    void UrlStatSnapshot::rollUp(int64_t interval_millis) {
+        UrlStatMap rolled;
+        rolled.reserve(urlMap_.size());
+        other_entries_ = 0;
+        for (auto& [key, stat] : urlMap_) {
+            const auto tick = key.tick_ - key.tick_ % interval_millis;
+            const UrlKey rolled_key{key.id_, tick};
+            auto f = rolled.find(rolled_key);
+            if (f == rolled.end()) {
+                f = rolled.emplace(rolled_key, std::make_unique<EachUrlStat>(
+                        tick, stat->getTotalHistogram().schema())).first;
+                if (isOther(rolled_key)) {
+                    ++other_entries_;
+                }
+            }
+            f->second->merge(*stat);
         }
+        urlMap_.swap(rolled);
+        lightest_.clear();
+    }
 
-        std::unique_lock<std::mutex> lock(add_mutex_);
+    void UrlStatSnapshot::rebind(std::shared_ptr<UrlTemplateTable> templates) {
+        templates_ = std::move(templates);
+        other_id_ = kNoId;
+        resolved_.clear();
+    }
 
-        if (url_stats_.size() < config->span.queue_size) {
-            url_stats_.push(std::move(stats));
-            lock.unlock();
-            add_cond_var_.notify_one();
-        } else {
-            LOG_DEBUG("drop url stats: overflow max queue size {}", config->span.queue_size);
+    uint32_t UrlStatSnapshot::otherId() {
+        if (other_id_ == kNoId) {
+            other_id_ = templates_->intern(kOtherUrl);
         }
-    } catch (const std::exception &e) {
-        LOG_ERROR("failed to enqueue url stats: exception = {}", e.what());
-    } catch (...) {
-        LOG_ERROR("failed to enqueue url stats: unknown exception");
+        return other_id_;
     }
 
-    void UrlStats::addUrlStatsWorker() try {
-        const auto config = agent_->getConfig();
-        if (!config->http.url_stat.enable) {
-            return;
+    EachUrlStat& UrlStatSnapshot::otherStat(int64_t tick, const std::shared_ptr<const UrlStatBucketSchema>& schema) {
+        const UrlKey other_key{otherId(), tick};
+        auto f = urlMap_.find(other_key);
+        if (f == urlMap_.end()) {
+            f = urlMap_.emplace(other_key, std::make_unique<EachUrlStat>(tick, schema)).first;
+            ++other_entries_;
         }
+        return *f->second;
+    }
 
-        std::unique_lock<std::mutex> lock(add_mutex_);
-        std::queue<UrlStatEntry> batch;
-        while (!agent_->isExiting()) {
-            add_cond_var_.wait(lock, [this] {
-                return !url_stats_.empty() || agent_->isExiting();
-            });
-            if (agent_->isExiting()) {
-                break;
-            }
+    void UrlStatSnapshot::fold(UrlStatMap::iterator it) {
+        // Detached first: creating the other bucket may rehash the map.
+        const auto stat = std::move(it->second);
+        urlMap_.erase(it);
+        otherStat(stat->tick(), stat->getTotalHistogram().schema()).merge(*stat);
+    }
 
-            batch.swap(url_stats_);
-            lock.unlock();
-            {
-                std::lock_guard<std::mutex> snapshot_lock(snapshot_mutex_);
-                while (!batch.empty()) {
-                    auto us = std::move(batch.front());
-                    batch.pop();
-                    snapshot_->add(&us, *config, tick_clock_);
+    const std::pair<uint64_t, UrlKey>& UrlStatSnapshot::lightest() {
+        if (lightest_.empty()) {
+            lightest_.reserve(urlCount());
+            for (const auto& [key, stat] : urlMap_) {
+                if (!isOther(key)) {
+                    lightest_.emplace_back(stat->weight(), key);
                 }
             }
-            lock.lock();
+            std::make_heap(lightest_.begin(), lightest_.end(), std::greater<>());
         }
-        LOG_INFO("add url stats worker end");
-    } catch (const std::exception& e) {
-        LOG_ERROR("add url stats worker exception = {}", e.what());
-    } catch (...) {
-        LOG_ERROR("add url stats worker unknown exception");
+
+        // Every tracked URL has an entry, so the loop ends on a fresh one.
+        while (true) {
+            const auto& [weight, key] = lightest_.front();
+            const auto current = urlMap_.at(key)->weight();
+            if (current == weight) {
+                return lightest_.front();
+            }
+            // Hit since it was pushed: requeue with its current weight.
+            std::pop_heap(lightest_.begin(), lightest_.end(), std::greater<>());
+            lightest_.back().first = current;
+            std::push_heap(lightest_.begin(), lightest_.end(), std::greater<>());
+        }
+    }
+
+    void UrlStatSnapshot::clearUrls() {
+        urlMap_.clear();
+        other_entries_ = 0;
+        lightest_.clear();
+        if (admission_) {
+            admission_->clear();
+        }
+    }
+
+    UrlCountMinSketch::UrlCountMinSketch(size_t keys) {
+        // Four counters per key and row keep collisions rare; 16-bit counters
+        // cap a thread's sketch at 256KB.
+        constexpr size_t kMaxWidth = size_t{1} << 15;
+        size_t width = 64;
+        while (width < keys * 4 && width < kMaxWidth) {
+            width <<= 1;
+        }
+        mask_ = width - 1;
+        counters_.assign(kDepth * width, 0);
+    }
+
+    uint32_t UrlCountMinSketch::increment(const UrlKey& key) {
+        // splitmix64 finalizer; its two halves seed double hashing across the rows.
+        auto h = (static_cast<uint64_t>(key.id_) << 32) ^ static_cast<uint64_t>(key.tick_);
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        const auto h1 = static_cast<uint32_t>(h);
+        const auto h2 = static_cast<uint32_t>(h >> 32) | 1;
+
+        uint32_t estimate = UINT16_MAX;
+        const auto width = mask_ + 1;
+        for (size_t row = 0; row < kDepth; row++) {
+            auto& counter = counters_[row * width + ((h1 + row * h2) & mask_)];
+            if (counter < UINT16_MAX) {
+                counter++;
+            }
+            estimate = std::min<uint32_t>(estimate, counter);
+        }
+        return estimate;
+    }
+
+    void UrlCountMinSketch::clear() {
+        std::fill(counters_.begin(), counters_.end(), 0);
     }
 
-    void UrlStats::stopAddUrlStatsWorker() {
+    std::string UrlStatSnapshot::trim_url_path(std::string_view url, int depth) {
+        const auto trimmed = trim_url_path_view(url, depth);
+        std::string result;
+        result.reserve(trimmed.path.size() + (trimmed.wildcard ? 1 : 0));
+        result.append(trimmed.path.data(), trimmed.path.size());
+        if (trimmed.wildcard) {
+            result.push_back('*');
+        }
+        return result;
+    }
+
+    void UrlStats::recordUrlStat(const UrlStatEntry& stats) noexcept try {
         const auto config = agent_->getConfig();
         if (!config->http.url_stat.enable) {
             return;
         }
-
-        add_cond_var_.notify_one();
+        addSnapshot(&stats, *config);
+    } catch (const std::exception &e) {
+        LOG_ERROR("failed to record url stats: exception = {}", e.what());
+    } catch (...) {
+        LOG_ERROR("failed to record url stats: unknown exception");
     }
 
     void UrlStats::sendUrlStatsWorker() try {
@@ -255,7 +625,7 @@ namespace pinpoint {
         }
 
         std::unique_lock<std::mutex> lock(send_mutex_);
-        const auto timeout = std::chrono::seconds(URL_STAT_SEND_INTERVAL_SECONDS);
+        const auto timeout = std::chrono::milliseconds(config->http.url_stat.send_interval_ms);
 
         while (!agent_->isExiting()) {
             if (!send_cond_var_.wait_for(lock, timeout, [this]{ return agent_->isExiting(); })) {
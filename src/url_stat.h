@@ -17,15 +17,18 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "config.h"
 #include "agent_service.h"
@@ -46,19 +49,63 @@ namespace pinpoint {
          * @param end_time Span completion time.
          */
         int64_t tick(std::chrono::system_clock::time_point end_time) const;
+        /// @brief Returns the tick length in milliseconds.
+        int64_t intervalMillis() const { return interval_ * 1000; }
 
     private:
         int64_t interval_;
     };
 
+    /**
+     * @brief Bucket boundaries of the per-URL response time histograms.
+     *
+     * The collector's URL_STATS_BUCKET_SIZE buckets (100ms ... 8s) are always
+     * part of the schema. Configured bounds (Http.UrlStatPercentileBounds)
+     * split them into finer buckets that stay on the agent for percentiles.
+     * Every fine bucket lies inside one collector bucket, so the collector
+     * histogram is a downsampling of the fine one.
+     */
+    class UrlStatBucketSchema {
+    public:
+        /// @brief Builds a schema from @p bounds (ms) merged with the collector's thresholds.
+        explicit UrlStatBucketSchema(const std::vector<int>& bounds);
+
+        /// @brief Returns the shared schema holding only the collector's buckets.
+        static const std::shared_ptr<const UrlStatBucketSchema>& collector();
+
+        /// @brief Returns the fine bucket holding @p elapsed (binary search over the bounds).
+        size_t bucket(int32_t elapsed) const {
+            return static_cast<size_t>(std::upper_bound(bounds_.begin(), bounds_.end(), elapsed) - bounds_.begin());
+        }
+        /// @brief Returns the collector bucket containing fine bucket @p fine.
+        int collectorBucket(size_t fine) const { return collector_[fine]; }
+        /// @brief Returns the largest elapsed time in fine bucket @p fine; the last bucket is unbounded.
+        int64_t upper(size_t fine) const {
+            return fine < bounds_.size() ? bounds_[fine] - 1 : INT64_MAX;
+        }
+        /// @brief Returns the number of fine buckets.
+        size_t size() const { return bounds_.size() + 1; }
+        /// @brief Whether the schema is finer than the collector's buckets.
+        bool highResolution() const { return size() > URL_STATS_BUCKET_SIZE; }
+
+        bool operator==(const UrlStatBucketSchema& o) const { return bounds_ == o.bounds_; }
+
+    private:
+        std::vector<int32_t> bounds_;   // exclusive upper bound of every bucket but the last
+        std::vector<uint8_t> collector_;
+    };
+
     /**
      * @brief Histogram aggregating elapsed times for URL statistics.
+     *
+     * Always keeps the collector's URL_STATS_BUCKET_SIZE buckets. With a
+     * high-resolution schema it also keeps a count per fine bucket, which
+     * percentile() uses instead of the collector buckets.
      */
     class UrlStatHistogram {
     public:
-        UrlStatHistogram() : total_(0), max_(0) {
-            std::fill_n(histogram_, URL_STATS_BUCKET_SIZE, 0);
-        }
+        UrlStatHistogram() : UrlStatHistogram(UrlStatBucketSchema::collector()) {}
+        explicit UrlStatHistogram(std::shared_ptr<const UrlStatBucketSchema> schema);
         ~UrlStatHistogram() = default;
 
         /**
@@ -67,10 +114,27 @@ namespace pinpoint {
          * @param elapsed Sample duration in milliseconds.
          */
         void add(int32_t elapsed);
+        /**
+         * @brief Adds the samples of @p other to this histogram.
+         *
+         * Fine buckets are only merged when both histograms share a schema.
+         */
+        void merge(const UrlStatHistogram& other);
+        /**
+         * @brief Returns the elapsed time at or below which @p percentile
+         *        percent of the samples fall.
+         *
+         * Reported as the upper bound of the bucket, capped at max(); 0 when
+         * empty. Only as precise as the fine buckets, or the collector ones
+         * without a high-resolution schema.
+         */
+        int64_t percentile(double percentile) const;
         /// @brief Returns the total accumulated elapsed time.
         int64_t total() const { return total_; }
         /// @brief Returns the maximum observed elapsed time.
         int64_t max() const { return max_; }
+        /// @brief Returns the bucket schema the histogram was built with.
+        const std::shared_ptr<const UrlStatBucketSchema>& schema() const { return schema_; }
         /// @brief Returns the bucket value at the specified index.
         int32_t histogram(int index) const { 
             if (index < 0 || index >= URL_STATS_BUCKET_SIZE) {
@@ -83,6 +147,8 @@ namespace pinpoint {
         int64_t total_;
         int64_t max_;
         int32_t histogram_[URL_STATS_BUCKET_SIZE]{};
+        std::shared_ptr<const UrlStatBucketSchema> schema_;
+        std::vector<int32_t> fine_{};  // empty unless the schema is high-resolution
     };
 
 
@@ -91,7 +157,9 @@ namespace pinpoint {
      */
     class EachUrlStat {
     public:
-        explicit EachUrlStat(int64_t tick) : tickTime_(tick) {}
+        explicit EachUrlStat(int64_t tick,
+                             const std::shared_ptr<const UrlStatBucketSchema>& schema = UrlStatBucketSchema::collector())
+            : totalHistogram_(schema), failedHistogram_(schema), tickTime_(tick) {}
         ~EachUrlStat() = default;
 
         /// @brief Returns the histogram aggregating all responses.
@@ -100,38 +168,100 @@ namespace pinpoint {
         UrlStatHistogram& getFailHistogram() { return failedHistogram_; }
         /// @brief Returns the tick value associated with this statistic.
         int64_t tick() const { return tickTime_; }
+        /**
+         * @brief Returns the traffic weight used to rank URLs in heavy-hitter mode.
+         *
+         * The number of samples, plus the weight inherited from the URL this
+         * one evicted (Space-Saving), so it may overestimate but never
+         * underestimate the URL's traffic.
+         */
+        uint64_t weight() const { return weight_; }
+        void addWeight(uint64_t weight) { weight_ += weight; }
+        /// @brief Adds the histograms and weight of @p other to this statistic.
+        void merge(const EachUrlStat& other) {
+            totalHistogram_.merge(other.totalHistogram_);
+            failedHistogram_.merge(other.failedHistogram_);
+            weight_ += other.weight_;
+        }
 
     private:
         UrlStatHistogram totalHistogram_;
         UrlStatHistogram failedHistogram_;
         int64_t tickTime_;
+        uint64_t weight_{0};
     };
 
     /**
-     * @brief Key used to order URL statistics by pattern and tick.
+     * @brief Interns URL statistic keys ("[METHOD ]template") as compact ids.
+     *
+     * Ids are dense and never reused, and an interned string stays valid for
+     * the table's lifetime, so snapshots keyed by id resolve the URL only
+     * when they are sent. Thread-safe; request threads reach it only when
+     * their snapshot's own id cache misses.
+     */
+    class UrlTemplateTable {
+    public:
+        /// @brief Returns the id of @p url, assigning the next one on first use.
+        uint32_t intern(std::string_view url);
+        /// @brief Returns the URL interned as @p id.
+        const std::string& url(uint32_t id) const;
+        /// @brief Returns the number of interned URLs.
+        size_t size() const;
+
+    private:
+        mutable std::mutex mutex_{};
+        std::deque<std::string> urls_{};                         // indexed by id; elements never move
+        std::unordered_map<std::string_view, uint32_t> ids_{};  // views into urls_
+    };
+
+    /**
+     * @brief Key used to order URL statistics by interned URL id and tick.
      */
     struct UrlKey {
-        std::string url_;
+        uint32_t id_;
         int64_t tick_;
         bool operator<(const UrlKey &o) const {
-            if (url_ != o.url_) {
-                return url_ < o.url_;
+            if (id_ != o.id_) {
+                return id_ < o.id_;
             }
             return tick_ < o.tick_;
         }
         bool operator==(const UrlKey &o) const {
-            return tick_ == o.tick_ && url_ == o.url_;
+            return id_ == o.id_ && tick_ == o.tick_;
         }
     };
 
     struct UrlKeyHash {
         size_t operator()(const UrlKey& key) const noexcept {
-            const auto url_hash = std::hash<std::string>{}(key.url_);
-            const auto tick_hash = std::hash<int64_t>{}(key.tick_);
-            return url_hash ^ (tick_hash + 0x9e3779b97f4a7c15ULL + (url_hash << 6) + (url_hash >> 2));
+            // Both parts are small integers; packed into one word they hash
+            // well enough for the prime-sized buckets.
+            return std::hash<uint64_t>{}((static_cast<uint64_t>(key.id_) << 32) ^ static_cast<uint64_t>(key.tick_));
         }
     };
 
+    /**
+     * @brief Count-min sketch estimating how often URL/tick keys were seen.
+     *
+     * Used by heavy-hitter mode to decide whether a URL arriving at a full
+     * snapshot is busy enough to take a tracked URL's place. Estimates never
+     * undercount; collisions can only inflate them. Counters saturate.
+     */
+    class UrlCountMinSketch {
+    public:
+        /// @brief Sizes the sketch for about @p keys distinct keys.
+        explicit UrlCountMinSketch(size_t keys);
+
+        /// @brief Counts one more occurrence of @p key and returns its estimate.
+        uint32_t increment(const UrlKey& key);
+        void clear();
+
+    private:
+        static constexpr size_t kDepth = 4;
+
+        size_t mask_;
+        std::vector<uint16_t> counters_;  // kDepth rows of mask_ + 1 counters
+    };
+
     /**
      * @brief Raw runtime information for a single URL invocation.
      */
@@ -155,19 +285,67 @@ namespace pinpoint {
     public:
         using UrlStatMap = std::unordered_map<UrlKey, std::unique_ptr<EachUrlStat>, UrlKeyHash>;
 
-        UrlStatSnapshot() : urlMap_{} {}
+        /// @brief URL of the bucket that URLs folded out of the top-K are aggregated into.
+        static constexpr std::string_view kOtherUrl = "__other__";
+
+        UrlStatSnapshot() : templates_(std::make_shared<UrlTemplateTable>()) {}
+        /// @brief Interns URLs in @p templates, shared with the snapshots it is merged with.
+        explicit UrlStatSnapshot(std::shared_ptr<UrlTemplateTable> templates) : templates_(std::move(templates)) {}
         ~UrlStatSnapshot() = default;
         
         /**
          * @brief Adds a URL statistic to the snapshot using bucketization rules.
          *
+         * The method and raw URL pattern are resolved to an interned id once;
+         * later samples of the same pattern are a cache lookup and histogram
+         * increments. The cache assumes the url_stat settings in @p config do
+         * not change over the snapshot's lifetime.
+         *
+         * Once the snapshot holds Http.UrlStatLimit URLs, a new URL is dropped.
+         * Each URL takes one entry per tick, so the limit is multiplied by
+         * the ticks per Http.UrlStatSendIntervalMs, rounded up.
+         * With Http.UrlStatHeavyHitter it is recorded in the kOtherUrl bucket
+         * of its tick instead, until its estimated count exceeds that of the
+         * lightest tracked URL; then it takes that URL's place and the
+         * lightest URL's statistics are folded into kOtherUrl.
+         *
          * @param us URL statistic entry.
          * @param config Agent configuration for histogram settings.
          * @param tick_clock Clock for time bucketing.
          */
         void add(const UrlStatEntry* us, const Config& config, TickClock& tick_clock);
+        /**
+         * @brief Moves every statistic of @p other into this snapshot and clears @p other.
+         *
+         * Histograms of URL/tick keys present in both are summed. New keys
+         * beyond @p limit are dropped, as in add().
+         */
+        void merge(UrlStatSnapshot& other, size_t limit);
+        /**
+         * @brief Folds the lightest URLs into the kOtherUrl buckets until at
+         *        most @p limit URLs remain.
+         *
+         * Used in heavy-hitter mode after merging without a limit, so the
+         * top-K is chosen over the combined traffic of every thread.
+         */
+        void foldOverflow(size_t limit);
+        /**
+         * @brief Merges the statistics of each URL into ticks of @p interval_millis.
+         *
+         * Used when Http.UrlStatTickIntervalMs is finer than the collector's
+         * tick. Histogram totals and counts are preserved.
+         */
+        void rollUp(int64_t interval_millis);
+        /**
+         * @brief Switches an empty snapshot to another interning table.
+         *
+         * Ids cached from the previous table are discarded.
+         */
+        void rebind(std::shared_ptr<UrlTemplateTable> templates);
         /// @brief Returns the const map storing statistics per URL/tick.
         const UrlStatMap& getEachStats() const { return urlMap_; }
+        /// @brief Returns the URL (with method prefix, if configured) of @p key.
+        const std::string& url(const UrlKey& key) const { return templates_->url(key.id_); }
 
         /**
          * @brief Trims a URL path using the configured depth.
@@ -178,36 +356,68 @@ namespace pinpoint {
         static std::string trim_url_path(std::string_view url, int depth);
 
     private:
-        UrlStatMap urlMap_;
+        // Bounds the raw-pattern cache when trimming folds unbounded raw URLs
+        // (e.g. ids in the path) into few templates.
+        static constexpr size_t kMaxResolvedUrls = 4096;
+
+        static constexpr uint32_t kNoId = UINT32_MAX;
+
+        uint32_t otherId();
+        bool isOther(const UrlKey& key) const { return key.id_ == other_id_; }
+        /// Number of URL entries, not counting the kOtherUrl buckets.
+        size_t urlCount() const { return urlMap_.size() - other_entries_; }
+        EachUrlStat& otherStat(int64_t tick, const std::shared_ptr<const UrlStatBucketSchema>& schema);
+        /// Moves the statistic at @p it into the kOtherUrl bucket of its tick.
+        void fold(UrlStatMap::iterator it);
+        /// Returns the lightest tracked URL's entry on top of lightest_, refreshing stale weights.
+        const std::pair<uint64_t, UrlKey>& lightest();
+        void clearUrls();
+
+        std::shared_ptr<UrlTemplateTable> templates_;
+        std::shared_ptr<const UrlStatBucketSchema> schema_{};   // built from config on the first add()
+        std::unordered_map<std::string, uint32_t> resolved_{};  // "METHOD pattern" -> id
+        UrlStatMap urlMap_{};
+        uint32_t other_id_{kNoId};  // interned lazily on the first fold
+        size_t other_entries_{0};
+        // Min-heap of (weight, key), built on the first eviction. Weights only
+        // grow, so an entry is refreshed when popped rather than on every hit.
+        std::vector<std::pair<uint64_t, UrlKey>> lightest_{};
+        std::unique_ptr<UrlCountMinSketch> admission_{};  // allocated on the first overflow
     };
 
     /**
-     * @brief Background workers for collecting and sending URL statistics.
+     * @brief Aggregates URL statistics on the request threads and sends them periodically.
+     *
+     * Each thread that records a statistic gets its own partial snapshot,
+     * guarded by a mutex only takeSnapshot() ever contends for. Recording is
+     * a map lookup in that partial with no queue hop and no allocation when
+     * the URL/tick key already exists. Building the entry is not free: a span
+     * copies the URL pattern and method into its UrlStatEntry at SetUrlStat(),
+     * which allocates once they outgrow the small-string buffer, and lends it
+     * here when it ends. takeSnapshot() merges and clears every partial, and drops
+     * the partials of threads that have exited.
      */
     class UrlStats {
     public:
         explicit UrlStats(AgentService* agent);
-        ~UrlStats() = default;
+        ~UrlStats();
+        UrlStats(const UrlStats&) = delete;
+        UrlStats& operator=(const UrlStats&) = delete;
 
         /**
-         * @brief Queues a URL statistic for aggregation.
+         * @brief Aggregates a URL statistic into the calling thread's partial snapshot.
          *
-         * @param stats URL statistic entry (ownership transferred).
+         * No-op when URL statistics are disabled.
          */
-        void enqueueUrlStats(std::unique_ptr<UrlStatEntry> stats) noexcept;
-        void enqueueUrlStats(UrlStatEntry stats) noexcept;
-        /// @brief Worker loop that aggregates URL statistics.
-        void addUrlStatsWorker();
-        /// @brief Stops the aggregation worker.
-        void stopAddUrlStatsWorker();
+        void recordUrlStat(const UrlStatEntry& stats) noexcept;
         /// @brief Worker loop that sends aggregated statistics to the collector.
         void sendUrlStatsWorker();
         /// @brief Stops the sending worker.
         void stopSendUrlStatsWorker();
 
-        /// @brief Adds a runtime statistic to the current snapshot buffer.
+        /// @brief Adds a runtime statistic to the calling thread's partial snapshot.
         void addSnapshot(const UrlStatEntry* us, const Config& config);
-        /// @brief Extracts the latest URL statistic snapshot for transmission.
+        /// @brief Merges and clears every thread's partial snapshot for transmission.
         std::unique_ptr<UrlStatSnapshot> takeSnapshot();
         /// @brief Returns the tick clock for time bucketing.
         TickClock& getTickClock() { return tick_clock_; }
@@ -218,15 +428,24 @@ namespace pinpoint {
         // dangles. A shared_ptr here would form a cycle and leak the agent.
         AgentService* agent_{};
 
-        // Queue for incoming URL stats
-        std::mutex add_mutex_{};
-        std::condition_variable add_cond_var_{};
-        std::queue<UrlStatEntry> url_stats_{};
+        struct Partial {
+            explicit Partial(std::shared_ptr<UrlTemplateTable> templates) : snapshot_(std::move(templates)) {}
+            std::mutex mutex_{};
+            UrlStatSnapshot snapshot_;
+            // Set when the owning UrlStats is destroyed, so a thread's cache can drop it.
+            std::atomic<bool> orphaned_{false};
+        };
+        Partial& thread_partial();
 
-        // Snapshot management
+        // Tells apart UrlStats instances in the per-thread partial cache,
+        // where a reused address could otherwise match a destroyed one.
+        const uint64_t id_;
         TickClock tick_clock_;
-        std::unique_ptr<UrlStatSnapshot> snapshot_;
-        std::mutex snapshot_mutex_{};
+        std::mutex partials_mutex_{};
+        std::vector<std::shared_ptr<Partial>> partials_{};  // guarded by partials_mutex_
+        // Shared by every partial so their ids agree when merged. Replaced once
+        // it holds far more URLs than the limit, so stale URLs do not pile up.
+        std::shared_ptr<UrlTemplateTable> templates_;       // guarded by partials_mutex_
 
         // Send worker synchronization
         std::mutex send_mutex_{};
@@ -27,6 +27,7 @@
 #include "../src/config.h"
 #include "../src/http.h"
 #include "../src/span.h"
+#include "../src/sql.h"
 #include "../src/stat.h"
 #include "../src/url_stat.h"
 
@@ -63,7 +64,7 @@ public:
         recorded_spans_.push_back(std::move(span));
     }
 
-    void recordUrlStat(UrlStatEntry stat) const override {
+    void recordUrlStat(const UrlStatEntry& stat) const override {
         recorded_url_stats_++;
         last_url_stat_url_ = stat.url_pattern_;
         last_url_stat_method_ = stat.method_;
@@ -124,6 +125,19 @@ public:
         removed_sql_uid_count_++;
     }
 
+    CachedSqlQuery cacheSqlQuery(std::string_view sql_query, SqlDialect dialect, bool sql_uid) const override {
+        const SqlNormalizer normalizer(SQL_NORMALIZE_MAX_LENGTH, true, dialect);
+        auto result = normalizer.normalize(sql_query);
+        CachedSqlQuery cached;
+        if (sql_uid) {
+            cached.sql_uid = cacheSqlUid(result.normalized_sql);
+        } else {
+            cached.sql_id = cacheSql(result.normalized_sql);
+        }
+        cached.parameters = std::move(result.parameters);
+        return cached;
+    }
+
     bool isStatusFail(int status) const override {
         // Mirror AgentImpl::isStatusFail: use the configurable HttpStatusErrors
         // (default {"5xx"}) so URL-stat failure tracks the same rule as spans.
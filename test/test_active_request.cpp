@@ -0,0 +1,140 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../src/active_request.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace pinpoint {
+
+static std::vector<int64_t> registered_start_times(const ActiveRequestRegistry& registry) {
+    std::vector<int64_t> start_times;
+    registry.for_each([&start_times](int64_t start_time) { start_times.push_back(start_time); });
+    std::sort(start_times.begin(), start_times.end());
+    return start_times;
+}
+
+// Test that add/drop register and release a slot's start time
+TEST(ActiveRequestRegistryTest, AddAndDropTest) {
+    ActiveRequestRegistry registry;
+    ActiveRequestSlot first;
+    ActiveRequestSlot second;
+
+    EXPECT_TRUE(registry.add(first, 100));
+    EXPECT_TRUE(registry.add(second, 200));
+    EXPECT_TRUE(first.registered());
+    EXPECT_EQ(registered_start_times(registry), (std::vector<int64_t>{100, 200}));
+
+    registry.drop(first);
+    EXPECT_FALSE(first.registered());
+    EXPECT_EQ(registered_start_times(registry), std::vector<int64_t>{200});
+
+    // Dropping an unregistered slot is a no-op
+    registry.drop(first);
+    registry.drop(second);
+    EXPECT_TRUE(registered_start_times(registry).empty());
+}
+
+// Test that an already registered slot keeps its original start time
+TEST(ActiveRequestRegistryTest, AddRegisteredSlotIsIgnoredTest) {
+    ActiveRequestRegistry registry;
+    ActiveRequestSlot slot;
+
+    EXPECT_TRUE(registry.add(slot, 100));
+    EXPECT_FALSE(registry.add(slot, 50));
+    EXPECT_EQ(registered_start_times(registry), std::vector<int64_t>{100});
+    registry.drop(slot);
+}
+
+// Test that released cells are reused instead of growing the registry
+TEST(ActiveRequestRegistryTest, ReusesCellsTest) {
+    ActiveRequestRegistry registry;
+    for (int i = 0; i < 1000; ++i) {
+        ActiveRequestSlot slot;
+        ASSERT_TRUE(registry.add(slot, i));
+        registry.drop(slot);
+    }
+    EXPECT_EQ(registry.capacity(), ActiveRequestRegistry::kCellsPerChunk);
+}
+
+// Test that the registry grows past one chunk when that many requests are active
+TEST(ActiveRequestRegistryTest, GrowsBeyondOneChunkTest) {
+    ActiveRequestRegistry registry;
+    const size_t count = ActiveRequestRegistry::kCellsPerChunk * 3 + 1;
+    std::vector<ActiveRequestSlot> slots(count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_TRUE(registry.add(slots[i], static_cast<int64_t>(i)));
+    }
+    EXPECT_EQ(registry.capacity(), ActiveRequestRegistry::kCellsPerChunk * 4);
+    EXPECT_EQ(registered_start_times(registry).size(), count);
+
+    for (auto& slot : slots) {
+        registry.drop(slot);
+    }
+    EXPECT_TRUE(registered_start_times(registry).empty());
+}
+
+// Test that concurrent add/drop keeps every registration while a reader walks the cells
+TEST(ActiveRequestRegistryTest, ConcurrentAddDropWithReaderTest) {
+    constexpr int kThreads = 8;
+    constexpr int kSlotsPerThread = 100;
+    constexpr int kRounds = 200;
+    ActiveRequestRegistry registry;
+    std::atomic<bool> done{false};
+
+    // The walk races with add/drop by design; it only has to stay safe.
+    std::atomic<size_t> walks{0};
+    std::thread reader([&registry, &done, &walks]() {
+        do {
+            registry.for_each([](int64_t start_time) { EXPECT_GE(start_time, 0); });
+            walks.fetch_add(1);
+        } while (!done.load());
+    });
+
+    // The last round stays registered so the final walk can count it
+    std::vector<std::unique_ptr<std::vector<ActiveRequestSlot>>> slots_per_thread;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        slots_per_thread.push_back(std::make_unique<std::vector<ActiveRequestSlot>>(kSlotsPerThread));
+        threads.emplace_back([&registry, &slots = *slots_per_thread.back(), t]() {
+            for (int round = 0; round < kRounds; ++round) {
+                for (auto& slot : slots) {
+                    EXPECT_TRUE(registry.add(slot, t));
+                }
+                if (round + 1 == kRounds) {
+                    break;
+                }
+                for (auto& slot : slots) {
+                    registry.drop(slot);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    done.store(true);
+    reader.join();
+
+    EXPECT_GT(walks.load(), 0u);
+    EXPECT_EQ(registered_start_times(registry).size(), static_cast<size_t>(kThreads * kSlotsPerThread));
+}
+
+}  // namespace pinpoint
@@ -30,6 +30,7 @@
 #include "../src/config.h"
 #include "../src/noop.h"
 #include "../src/span.h"
+#include "../src/sql.h"
 #include "../src/stat.h"
 #include "../src/url_stat.h"
 #include "../src/logging.h"
@@ -313,6 +314,96 @@ TEST_F(AgentImplTest, CacheSqlUidReturnsNonEmpty) {
     EXPECT_EQ(uid->size(), 16u);
 }
 
+TEST_F(AgentImplTest, CacheSqlQueryMatchesNormalizedSql) {
+    const std::string raw = "SELECT * FROM orders WHERE id = 42 AND name = 'kim'";
+    const SqlNormalizer normalizer(SQL_NORMALIZE_MAX_LENGTH);
+    const auto normalized = normalizer.normalize(raw).normalized_sql;
+
+    const auto first = agent_->cacheSqlQuery(raw, SqlDialect::GENERIC, false);
+    const auto second = agent_->cacheSqlQuery(raw, SqlDialect::GENERIC, false);
+    EXPECT_EQ(first.sql_id, agent_->cacheSql(normalized));
+    EXPECT_EQ(second.sql_id, first.sql_id);
+    EXPECT_EQ(second.parameters, "42,kim");
+
+    const auto uid = agent_->cacheSqlQuery(raw, SqlDialect::GENERIC, true);
+    ASSERT_TRUE(uid.sql_uid.has_value());
+    EXPECT_EQ(*uid.sql_uid, generate_sql_uid(normalized));
+}
+
+TEST_F(AgentImplTest, RegisterMetadataPopulatesCaches) {
+    MetadataCatalog catalog;
+    catalog.apis.push_back({"com.example.Registered", API_TYPE_WEB_REQUEST});
+    catalog.sql_queries.push_back({"SELECT * FROM orders WHERE id = 10"});
+    catalog.sql_queries.push_back({"SELECT * FROM items WHERE id IN (1, 2, 3)", SERVICE_TYPE_MYSQL_QUERY});
+    catalog.error_names.push_back("RegisteredError");
+    agent_->RegisterMetadata(catalog);
+
+    // Registered keys were assigned ids before any key first seen afterwards.
+    EXPECT_LT(agent_->cacheApi("com.example.Registered", API_TYPE_WEB_REQUEST),
+              agent_->cacheApi("com.example.Unregistered", API_TYPE_WEB_REQUEST));
+    EXPECT_LT(agent_->cacheError("RegisteredError"), agent_->cacheError("UnregisteredError"));
+
+    // SQL is cached in the same normalized form span events of its service type look up.
+    const int32_t unregistered = agent_->cacheSql("SELECT * FROM unregistered");
+    EXPECT_LT(agent_->cacheSqlQuery("SELECT * FROM orders WHERE id = 42", SqlDialect::GENERIC, false).sql_id,
+              unregistered);
+    EXPECT_LT(agent_->cacheSqlQuery("SELECT * FROM items WHERE id IN (4, 5)", SqlDialect::MYSQL, false).sql_id,
+              unregistered);
+}
+
+TEST_F(AgentImplTest, RegisterMetadataPrimesRawSqlCache) {
+    MetadataCatalog catalog;
+    catalog.sql_queries.push_back({"SELECT * FROM items WHERE id IN (1, 2) AND name = 'a'", SERVICE_TYPE_MYSQL_QUERY});
+    agent_->RegisterMetadata(catalog);
+
+    // The first use of the statement is a raw-statement cache hit, without normalization.
+    const auto cached = agent_->cacheSqlQuery(catalog.sql_queries[0].query, SqlDialect::MYSQL, false);
+    EXPECT_NE(cached.sql_id, 0);
+    EXPECT_EQ(cached.parameters, "1,, 2,a");
+    EXPECT_EQ(agent_->getSqlQueryCache().hits(), 1u);
+    EXPECT_EQ(agent_->getSqlQueryCache().misses(), 0u);
+
+    // The entry is keyed by dialect: another dialect still takes the miss path.
+    agent_->cacheSqlQuery(catalog.sql_queries[0].query, SqlDialect::GENERIC, false);
+    EXPECT_EQ(agent_->getSqlQueryCache().misses(), 1u);
+}
+
+TEST_F(AgentImplTest, CacheSqlQueryKeysOnNormalizedPrefix) {
+    // Sql.AsyncNormalize only keeps SQL_NORMALIZE_MAX_LENGTH bytes of the
+    // statement; the synchronous path must map the full text to the same entry.
+    std::string long_sql = "SELECT * FROM items WHERE id = 1 AND c";
+    long_sql.append(SQL_NORMALIZE_MAX_LENGTH, 'x');
+    long_sql += " = 2";
+    ASSERT_GT(long_sql.size(), static_cast<size_t>(SQL_NORMALIZE_MAX_LENGTH));
+
+    const auto full = agent_->cacheSqlQuery(long_sql, SqlDialect::GENERIC, false);
+    const auto prefix = agent_->cacheSqlQuery(
+        std::string_view(long_sql).substr(0, SQL_NORMALIZE_MAX_LENGTH), SqlDialect::GENERIC, false);
+    EXPECT_NE(full.sql_id, 0);
+    EXPECT_EQ(prefix.sql_id, full.sql_id);
+    EXPECT_EQ(prefix.parameters, full.parameters);
+    EXPECT_EQ(agent_->getSqlQueryCache().misses(), 1u);
+    EXPECT_EQ(agent_->getSqlQueryCache().hits(), 1u);
+}
+
+TEST_F(AgentImplTest, RegisterMetadataIsIdempotent) {
+    MetadataCatalog catalog;
+    catalog.apis.push_back({"com.example.Api", API_TYPE_DEFAULT});
+    agent_->RegisterMetadata(catalog);
+    const int32_t id = agent_->cacheApi("com.example.Api", API_TYPE_DEFAULT);
+
+    agent_->RegisterMetadata(catalog);
+    EXPECT_EQ(agent_->cacheApi("com.example.Api", API_TYPE_DEFAULT), id);
+}
+
+TEST_F(AgentImplTest, RegisterMetadataAfterShutdownDoesNotCrash) {
+    agent_->Shutdown();
+    MetadataCatalog catalog;
+    catalog.apis.push_back({"com.example.Api", API_TYPE_DEFAULT});
+    catalog.sql_queries.push_back({"SELECT 1"});
+    agent_->RegisterMetadata(catalog);
+}
+
 TEST_F(AgentImplTest, ShutdownDisablesAgent) {
     EXPECT_TRUE(agent_->Enable());
     agent_->Shutdown();
@@ -16,11 +16,13 @@
 
 #include "../src/cache.h"
 #include <gtest/gtest.h>
+#include <atomic>
 #include <thread>
 #include <chrono>
 #include <vector>
 #include <future>
 #include <set>
+#include <stdexcept>
 #include <string>
 
 namespace pinpoint {
@@ -639,6 +641,159 @@ TEST_F(CacheTest, ApiIdCacheLRUEvictionTest) {
     EXPECT_FALSE(cache.get(ApiCacheKey{"operation2", 100}).found);
 }
 
+TEST_F(CacheTest, PrecomputedHashMatchesDefaultLookupTest) {
+    IdCache cache(5);
+
+    const auto key_hash = IdCache::hash("key1");
+    auto result1 = cache.get("key1", key_hash);
+    EXPECT_FALSE(result1.found);
+
+    auto result2 = cache.get("key1");
+    EXPECT_TRUE(result2.found) << "Precomputed and default hashing must address the same entry";
+    EXPECT_EQ(result2.value, result1.value);
+
+    auto result3 = cache.get("key1", key_hash);
+    EXPECT_TRUE(result3.found);
+    EXPECT_EQ(result3.value, result1.value);
+}
+
+TEST_F(CacheTest, ApiIdCachePrecomputedHashTest) {
+    ApiIdCache cache(2);
+
+    const ApiCacheKey key{"operation", 100};
+    const auto key_hash = ApiIdCache::hash(key);
+    EXPECT_EQ(key_hash, ApiCacheKeyHash::combine(std::hash<std::string_view>{}("operation"), 100));
+
+    auto result1 = cache.get(key, key_hash);
+    EXPECT_FALSE(result1.found);
+    EXPECT_TRUE(cache.get(ApiCacheKey{"operation", 100}).found);
+    EXPECT_FALSE(cache.get(ApiCacheKey{"operation", 200}).found);
+
+    // Eviction uses the stored hash: filling past capacity must still evict cleanly.
+    cache.get(ApiCacheKey{"operation", 300});
+    EXPECT_FALSE(cache.get(key, key_hash).found);
+}
+
+// Test that concurrent misses on one key run the generator once and wait for it
+TEST_F(CacheTest, SingleFlightCoalescesConcurrentMissesTest) {
+    LruCacheImpl<int32_t> cache(10);
+    const int num_threads = 8;
+    std::atomic<int> generator_calls{0};
+    std::atomic<int> started{0};
+
+    std::vector<std::future<CacheResult>> futures;
+    for (int i = 0; i < num_threads; ++i) {
+        futures.push_back(std::async(std::launch::async, [&]() {
+            started.fetch_add(1);
+            return cache.get("slow_key", [&]() {
+                generator_calls.fetch_add(1);
+                // Keep the leader busy until every thread has issued its lookup.
+                while (started.load() < num_threads) {
+                    std::this_thread::yield();
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                return 42;
+            });
+        }));
+    }
+
+    int misses = 0;
+    for (auto& future : futures) {
+        const auto result = future.get();
+        EXPECT_EQ(result.value, 42);
+        misses += result.found ? 0 : 1;
+    }
+
+    EXPECT_EQ(generator_calls.load(), 1) << "Only the first miss should run the generator";
+    EXPECT_EQ(misses, 1) << "Coalesced misses should report found=true";
+    EXPECT_EQ(cache.coalesced_misses(), static_cast<uint64_t>(num_threads - 1));
+}
+
+// Test that a throwing generator wakes waiters, which then retry
+TEST_F(CacheTest, SingleFlightGeneratorExceptionTest) {
+    LruCacheImpl<int32_t> cache(10);
+
+    EXPECT_THROW(cache.get("key", []() -> int32_t { throw std::runtime_error("boom"); }), std::runtime_error);
+
+    const auto result = cache.get("key", []() { return 7; });
+    EXPECT_EQ(result.value, 7);
+    EXPECT_FALSE(result.found) << "A failed generation must not leave a cached or in-flight entry";
+    EXPECT_EQ(cache.coalesced_misses(), 0u);
+}
+
+// Test that without coalescing racing misses all generate, and the first insert wins
+TEST_F(CacheTest, UncoalescedConcurrentMissesTest) {
+    LruCacheImpl<int32_t, StringCacheKeyTraits, false> cache(10);
+    const int num_threads = 4;
+    std::atomic<int> generator_calls{0};
+
+    std::vector<std::future<CacheResult>> futures;
+    for (int i = 0; i < num_threads; ++i) {
+        futures.push_back(std::async(std::launch::async, [&, i]() {
+            return cache.get("racy_key", [&, i]() {
+                generator_calls.fetch_add(1);
+                // Hold every generator until all threads have missed.
+                while (generator_calls.load() < num_threads) {
+                    std::this_thread::yield();
+                }
+                return i + 1;
+            });
+        }));
+    }
+
+    std::vector<CacheResult> results;
+    for (auto& future : futures) {
+        results.push_back(future.get());
+    }
+
+    int misses = 0;
+    for (const auto& result : results) {
+        EXPECT_EQ(result.value, results[0].value) << "All racing misses must agree on the inserted value";
+        misses += result.found ? 0 : 1;
+    }
+    EXPECT_EQ(generator_calls.load(), num_threads);
+    EXPECT_EQ(misses, 1) << "Only the inserting miss should report found=false";
+    EXPECT_EQ(cache.coalesced_misses(), 0u);
+}
+
+// Test that a generator running across clear() does not publish its stale result
+TEST_F(CacheTest, ClearDropsInFlightResultTest) {
+    LruCacheImpl<int32_t> cache(10);
+    CacheResult fresh{};
+
+    const auto stale = cache.get("key", [&]() {
+        cache.clear();
+        // A miss after clear() runs its own generator instead of waiting for this one.
+        fresh = cache.get("key", []() { return 2; });
+        return 1;
+    });
+    EXPECT_EQ(stale.value, 1);
+    EXPECT_FALSE(stale.found);
+    EXPECT_EQ(fresh.value, 2);
+    EXPECT_FALSE(fresh.found);
+    EXPECT_EQ(cache.coalesced_misses(), 0u);
+
+    const auto result = cache.get("key", []() { return 3; });
+    EXPECT_EQ(result.value, 2) << "Only the generation started after clear() may be cached";
+    EXPECT_TRUE(result.found);
+}
+
+// Test the same for racing misses that are not coalesced
+TEST_F(CacheTest, UncoalescedClearDropsInFlightResultTest) {
+    LruCacheImpl<int32_t, StringCacheKeyTraits, false> cache(10);
+
+    const auto stale = cache.get("key", [&]() {
+        cache.clear();
+        return 1;
+    });
+    EXPECT_EQ(stale.value, 1);
+    EXPECT_FALSE(stale.found);
+
+    const auto result = cache.get("key", []() { return 2; });
+    EXPECT_EQ(result.value, 2);
+    EXPECT_FALSE(result.found) << "The stale value must not have been inserted";
+}
+
 // SqlUidCache Test Suite
 class SqlUidCacheTest : public ::testing::Test {
 protected:
@@ -1208,4 +1363,81 @@ TEST_F(SqlUidCacheTest, RemoveAndReaddLRUPositionTest) {
     EXPECT_TRUE(r1.found) << "sql1 should be in cache (was MRU after re-add)";
 }
 
+// Test lookups with a caller-provided UID share entries with plain lookups
+TEST_F(SqlUidCacheTest, PrecomputedUidLookupTest) {
+    SqlUidCache cache(5);
+
+    const std::string sql = "SELECT * FROM orders WHERE id = ?";
+    const auto uid = generate_sql_uid(sql);
+
+    auto result1 = cache.get(sql, uid);
+    EXPECT_FALSE(result1.found);
+    EXPECT_TRUE(areUidsEqual(result1.value, uid));
+
+    auto result2 = cache.get(sql);
+    EXPECT_TRUE(result2.found);
+    EXPECT_TRUE(areUidsEqual(result2.value, uid));
+
+    cache.remove(sql, uid);
+    EXPECT_FALSE(cache.get(sql).found) << "remove with UID should drop the entry";
+}
+
+// Test that raw SQL keys differ on any change to the text, its length, the dialect or the lookup kind
+TEST(SqlQueryCacheTest, KeyTest) {
+    const std::string sql = "SELECT * FROM orders WHERE customer_id = ? AND status = ?";
+    const auto key = SqlQueryCache::key(sql, SqlDialect::GENERIC, false);
+    EXPECT_EQ(key, SqlQueryCache::key(std::string(sql), SqlDialect::GENERIC, false));
+    EXPECT_EQ(key.length, sql.size());
+    EXPECT_FALSE(key == SqlQueryCache::key(sql, SqlDialect::GENERIC, true));
+    EXPECT_FALSE(key == SqlQueryCache::key(sql, SqlDialect::MYSQL, false));
+
+    std::set<uint64_t> hashes{key.hash};
+    std::set<uint64_t> checks{key.check};
+    for (size_t i = 0; i < sql.size(); ++i) {
+        auto changed = sql;
+        changed[i] ^= 0x01;
+        const auto changed_key = SqlQueryCache::key(changed, SqlDialect::GENERIC, false);
+        hashes.insert(changed_key.hash);
+        checks.insert(changed_key.check);
+    }
+    EXPECT_EQ(hashes.size(), sql.size() + 1);
+    EXPECT_EQ(checks.size(), sql.size() + 1);
+
+    // Trailing zero bytes must not alias the shorter text
+    const std::string padded = sql + std::string(3, '\0');
+    EXPECT_NE(SqlQueryCache::key(padded, SqlDialect::GENERIC, false).hash, key.hash);
+    EXPECT_EQ(SqlQueryCache::key("", SqlDialect::GENERIC, false),
+              SqlQueryCache::key(std::string_view(), SqlDialect::GENERIC, false));
+}
+
+// Test that repeated statements hit without normalizing again, and clear() forgets them
+TEST(SqlQueryCacheTest, HitAndClearTest) {
+    SqlQueryCache cache(4);
+    int normalized = 0;
+    auto normalize = [&normalized]() {
+        ++normalized;
+        CachedSqlQuery cached;
+        cached.sql_id = normalized;
+        cached.parameters = "1,foo";
+        return cached;
+    };
+
+    const auto key = SqlQueryCache::key("SELECT * FROM t WHERE id = 1 AND name = 'foo'", SqlDialect::GENERIC, false);
+    auto first = cache.get(key, normalize);
+    EXPECT_FALSE(first.found);
+    auto second = cache.get(key, normalize);
+    EXPECT_TRUE(second.found);
+    EXPECT_EQ(second.value.sql_id, 1);
+    EXPECT_EQ(second.value.parameters, "1,foo");
+    EXPECT_EQ(normalized, 1);
+    EXPECT_EQ(cache.hits(), 1u);
+    EXPECT_EQ(cache.misses(), 1u);
+
+    cache.clear();
+    auto third = cache.get(key, normalize);
+    EXPECT_FALSE(third.found);
+    EXPECT_EQ(third.value.sql_id, 2);
+    EXPECT_EQ(cache.misses(), 2u);
+}
+
 } // namespace pinpoint
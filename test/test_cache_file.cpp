@@ -0,0 +1,193 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../src/cache_file.h"
+#include "../src/cache.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace pinpoint {
+
+class MetaCacheFileTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = std::filesystem::temp_directory_path() /
+               ("pinpoint_meta_cache_test_" + std::to_string(::getpid()));
+        std::filesystem::create_directories(dir_);
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove_all(dir_, ec);
+    }
+
+    std::string path(std::string_view agent_id) const {
+        return MetaCacheFile::path_for(dir_.string(), agent_id);
+    }
+
+    std::filesystem::path dir_;
+};
+
+// Test that the agent id is sanitized into a single file name inside the directory
+TEST_F(MetaCacheFileTest, PathForSanitizesAgentIdTest) {
+    EXPECT_EQ(MetaCacheFile::path_for("/tmp/cache", "agent-1"), "/tmp/cache/agent-1.meta");
+    EXPECT_EQ(MetaCacheFile::path_for("/tmp/cache/", "a/b c"), "/tmp/cache/a_b_c.meta");
+}
+
+// Test that saved entries are loaded back unchanged and in order
+TEST_F(MetaCacheFileTest, SaveLoadRoundTripTest) {
+    const std::vector<MetaCacheEntry> saved = {
+        {MetaCacheEntryType::API, 100, "main.handler"},
+        {MetaCacheEntryType::ERROR, 0, "std::runtime_error"},
+        {MetaCacheEntryType::SQL, 0, "SELECT * FROM t WHERE id = ?"},
+        {MetaCacheEntryType::SQL_UID, 0, "UPDATE t SET v = ?"},
+        {MetaCacheEntryType::SQL, 0, ""},
+    };
+
+    MetaCacheFile file(path("agent"));
+    ASSERT_TRUE(file.save("agent", 1234, saved));
+
+    std::vector<MetaCacheEntry> loaded;
+    ASSERT_TRUE(file.load("agent", loaded));
+    ASSERT_EQ(loaded.size(), saved.size());
+    for (size_t i = 0; i < saved.size(); ++i) {
+        EXPECT_EQ(loaded[i].type, saved[i].type);
+        EXPECT_EQ(loaded[i].api_type, saved[i].api_type);
+        EXPECT_EQ(loaded[i].value, saved[i].value);
+    }
+}
+
+// Test that a missing file is reported as not loaded
+TEST_F(MetaCacheFileTest, MissingFileTest) {
+    std::vector<MetaCacheEntry> loaded;
+    EXPECT_FALSE(MetaCacheFile(path("absent")).load("absent", loaded));
+    EXPECT_TRUE(loaded.empty());
+}
+
+// Test that a file written by another agent is ignored
+TEST_F(MetaCacheFileTest, AgentIdMismatchTest) {
+    MetaCacheFile file(path("agent"));
+    ASSERT_TRUE(file.save("agent", 1, {{MetaCacheEntryType::API, 0, "api"}}));
+
+    std::vector<MetaCacheEntry> loaded;
+    EXPECT_FALSE(file.load("other-agent", loaded));
+    EXPECT_TRUE(loaded.empty());
+}
+
+// Test that a truncated or garbage file is rejected without touching the output
+TEST_F(MetaCacheFileTest, CorruptFileTest) {
+    MetaCacheFile file(path("agent"));
+    ASSERT_TRUE(file.save("agent", 1, {{MetaCacheEntryType::SQL, 0, "SELECT 1"}}));
+
+    const auto size = std::filesystem::file_size(file.path());
+    std::filesystem::resize_file(file.path(), size - 3);
+
+    std::vector<MetaCacheEntry> loaded;
+    EXPECT_FALSE(file.load("agent", loaded));
+    EXPECT_TRUE(loaded.empty());
+
+    {
+        std::ofstream out(file.path(), std::ios::binary | std::ios::trunc);
+        out << "not a metadata cache file";
+    }
+    EXPECT_FALSE(file.load("agent", loaded));
+    EXPECT_TRUE(loaded.empty());
+}
+
+// Test that saving replaces the previous file contents
+TEST_F(MetaCacheFileTest, SaveOverwritesTest) {
+    MetaCacheFile file(path("agent"));
+    ASSERT_TRUE(file.save("agent", 1, {{MetaCacheEntryType::SQL, 0, "old"}, {MetaCacheEntryType::SQL, 0, "old2"}}));
+    ASSERT_TRUE(file.save("agent", 2, {{MetaCacheEntryType::SQL, 0, "new"}}));
+
+    std::vector<MetaCacheEntry> loaded;
+    ASSERT_TRUE(file.load("agent", loaded));
+    ASSERT_EQ(loaded.size(), 1u);
+    EXPECT_EQ(loaded[0].value, "new");
+
+    // Only the target is left behind, readable like a file created with 0644.
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(dir_)) {
+        files.push_back(entry.path());
+    }
+    ASSERT_EQ(files.size(), 1u);
+    EXPECT_EQ(files[0].string(), file.path());
+    EXPECT_EQ(std::filesystem::status(file.path()).permissions() & std::filesystem::perms::all,
+              std::filesystem::perms::owner_read | std::filesystem::perms::owner_write |
+              std::filesystem::perms::group_read | std::filesystem::perms::others_read);
+}
+
+// Test that concurrent saves of one agent id never publish a torn file
+TEST_F(MetaCacheFileTest, ConcurrentSaveTest) {
+    MetaCacheFile file(path("agent"));
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 4; ++w) {
+        writers.emplace_back([&file, w]() {
+            std::vector<MetaCacheEntry> entries;
+            for (int i = 0; i < 2000; ++i) {
+                entries.push_back({MetaCacheEntryType::SQL, 0, "writer" + std::to_string(w)});
+            }
+            for (int round = 0; round < 5; ++round) {
+                EXPECT_TRUE(file.save("agent", w, entries));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    std::vector<MetaCacheEntry> loaded;
+    ASSERT_TRUE(file.load("agent", loaded));
+    ASSERT_EQ(loaded.size(), 2000u);
+    EXPECT_TRUE(std::all_of(loaded.begin(), loaded.end(),
+                            [&loaded](const MetaCacheEntry& entry) { return entry.value == loaded[0].value; }))
+        << "Entries of different writers were mixed";
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator(dir_), std::filesystem::directory_iterator()), 1);
+}
+
+// Test that for_each visits least recently used first, so replaying it restores LRU order
+TEST_F(MetaCacheFileTest, CacheForEachPreservesLruOrderTest) {
+    IdCache cache(3);
+    cache.get("a");
+    cache.get("b");
+    cache.get("c");
+    cache.get("a");  // full: promotes "a" to most recently used
+
+    std::vector<std::string> order;
+    cache.for_each([&order](const std::string& key, int32_t) { order.push_back(key); });
+    EXPECT_EQ(order, (std::vector<std::string>{"b", "c", "a"}));
+
+    IdCache restored(3);
+    for (const auto& key : order) {
+        restored.get(key);
+    }
+    restored.get("d");  // evicts the least recently used entry, "b"
+    EXPECT_TRUE(restored.get("a").found);
+    EXPECT_TRUE(restored.get("c").found);
+
+    std::vector<std::string> after;
+    restored.for_each([&after](const std::string& key, int32_t) { after.push_back(key); });
+    EXPECT_EQ(std::count(after.begin(), after.end(), "b"), 0);
+}
+
+}  // namespace pinpoint
@@ -91,12 +91,21 @@ private:
         saved_env_vars_[full_env(env::CONFIG_FILE)] = GetEnvVar(full_env(env::CONFIG_FILE));
         saved_env_vars_[full_env(env::SQL_MAX_BIND_ARGS_SIZE)] = GetEnvVar(full_env(env::SQL_MAX_BIND_ARGS_SIZE));
         saved_env_vars_[full_env(env::SQL_ENABLE_SQL_STATS)] = GetEnvVar(full_env(env::SQL_ENABLE_SQL_STATS));
+        saved_env_vars_[full_env(env::SQL_ASYNC_NORMALIZE)] = GetEnvVar(full_env(env::SQL_ASYNC_NORMALIZE));
+        saved_env_vars_[full_env(env::METADATA_CACHE_DIR)] = GetEnvVar(full_env(env::METADATA_CACHE_DIR));
+        saved_env_vars_[full_env(env::METADATA_MAX_CONCURRENT_REQUESTS)] = GetEnvVar(full_env(env::METADATA_MAX_CONCURRENT_REQUESTS));
+        saved_env_vars_[full_env(env::METADATA_EXCEPTION_DEDUP_INTERVAL_MS)] = GetEnvVar(full_env(env::METADATA_EXCEPTION_DEDUP_INTERVAL_MS));
+        saved_env_vars_[full_env(env::METADATA_EXCEPTION_MAX_UNIQUE_STACKS)] = GetEnvVar(full_env(env::METADATA_EXCEPTION_MAX_UNIQUE_STACKS));
         saved_env_vars_[full_env(env::ENABLE_CALLSTACK_TRACE)] = GetEnvVar(full_env(env::ENABLE_CALLSTACK_TRACE));
         saved_env_vars_[full_env(env::HTTP_COLLECT_URL_STAT)] = GetEnvVar(full_env(env::HTTP_COLLECT_URL_STAT));
         saved_env_vars_[full_env(env::HTTP_URL_STAT_LIMIT)] = GetEnvVar(full_env(env::HTTP_URL_STAT_LIMIT));
         saved_env_vars_[full_env(env::HTTP_URL_STAT_ENABLE_TRIM_PATH)] = GetEnvVar(full_env(env::HTTP_URL_STAT_ENABLE_TRIM_PATH));
         saved_env_vars_[full_env(env::HTTP_URL_STAT_TRIM_PATH_DEPTH)] = GetEnvVar(full_env(env::HTTP_URL_STAT_TRIM_PATH_DEPTH));
         saved_env_vars_[full_env(env::HTTP_URL_STAT_METHOD_PREFIX)] = GetEnvVar(full_env(env::HTTP_URL_STAT_METHOD_PREFIX));
+        saved_env_vars_[full_env(env::HTTP_URL_STAT_PERCENTILE_BOUNDS)] = GetEnvVar(full_env(env::HTTP_URL_STAT_PERCENTILE_BOUNDS));
+        saved_env_vars_[full_env(env::HTTP_URL_STAT_HEAVY_HITTER)] = GetEnvVar(full_env(env::HTTP_URL_STAT_HEAVY_HITTER));
+        saved_env_vars_[full_env(env::HTTP_URL_STAT_TICK_INTERVAL_MS)] = GetEnvVar(full_env(env::HTTP_URL_STAT_TICK_INTERVAL_MS));
+        saved_env_vars_[full_env(env::HTTP_URL_STAT_SEND_INTERVAL_MS)] = GetEnvVar(full_env(env::HTTP_URL_STAT_SEND_INTERVAL_MS));
         saved_env_vars_[full_env(env::HTTP_SERVER_STATUS_CODE_ERRORS)] = GetEnvVar(full_env(env::HTTP_SERVER_STATUS_CODE_ERRORS));
         saved_env_vars_[full_env(env::HTTP_SERVER_EXCLUDE_URL)] = GetEnvVar(full_env(env::HTTP_SERVER_EXCLUDE_URL));
         saved_env_vars_[full_env(env::HTTP_SERVER_EXCLUDE_METHOD)] = GetEnvVar(full_env(env::HTTP_SERVER_EXCLUDE_METHOD));
@@ -116,6 +125,7 @@ private:
         saved_env_vars_[full_env(env::STAT_ENABLE)] = GetEnvVar(full_env(env::STAT_ENABLE));
         saved_env_vars_[full_env(env::STAT_BATCH_COUNT)] = GetEnvVar(full_env(env::STAT_BATCH_COUNT));
         saved_env_vars_[full_env(env::STAT_BATCH_INTERVAL)] = GetEnvVar(full_env(env::STAT_BATCH_INTERVAL));
+        saved_env_vars_[full_env(env::STAT_RETAINED_BATCHES)] = GetEnvVar(full_env(env::STAT_RETAINED_BATCHES));
         saved_env_vars_[full_env(env::AGENT_NAME)] = GetEnvVar(full_env(env::AGENT_NAME));
 
         // Clear environment variables for clean test
@@ -198,6 +208,7 @@ Stat:
   Enable: true
   BatchCount: 10
   BatchInterval: 7000
+  RetainedBatches: 20
 
 Http:
   CollectUrlStat: true
@@ -205,6 +216,10 @@ Http:
   UrlStatEnableTrimPath: false
   UrlStatTrimPathDepth: 3
   UrlStatMethodPrefix: true
+  UrlStatPercentileBounds: [1, 2, 5, 10]
+  UrlStatHeavyHitter: true
+  UrlStatTickIntervalMs: 5000
+  UrlStatSendIntervalMs: 10000
   
   Server:
     StatusCodeErrors: ["5xx", "401", "403"]
@@ -222,6 +237,13 @@ Http:
 Sql:
   MaxBindArgsSize: 2048
   EnableSqlStats: true
+  AsyncNormalize: true
+
+Metadata:
+  CacheDir: "/var/cache/pinpoint"
+  MaxConcurrentRequests: 8
+  ExceptionDedupIntervalMs: 5000
+  ExceptionMaxUniqueStacks: 200
 )";
 
     const std::string partial_config_yaml_ = R"(
@@ -324,6 +346,7 @@ TEST_F(ConfigTest, DefaultConfigurationTest) {
     EXPECT_TRUE(config->stat.enable) << "Stat should be enabled by default";
     EXPECT_EQ(config->stat.batch_count, 6) << "Default batch count should be 6";
     EXPECT_EQ(config->stat.collect_interval, 5000) << "Default collect interval should be 5000ms";
+    EXPECT_EQ(config->stat.retained_batches, 10) << "Default retained batches should be 10";
     
     // Test HTTP defaults
     EXPECT_FALSE(config->http.url_stat.enable) << "URL stat should be disabled by default";
@@ -331,6 +354,10 @@ TEST_F(ConfigTest, DefaultConfigurationTest) {
     EXPECT_TRUE(config->http.url_stat.enable_trim_path) << "Enable trim path should be true by default";
     EXPECT_EQ(config->http.url_stat.trim_path_depth, 1) << "Default path depth should be 1";
     EXPECT_FALSE(config->http.url_stat.method_prefix) << "Method prefix should be false by default";
+    EXPECT_TRUE(config->http.url_stat.percentile_bounds.empty()) << "No percentile bounds by default";
+    EXPECT_FALSE(config->http.url_stat.heavy_hitter) << "Heavy-hitter mode should be off by default";
+    EXPECT_EQ(config->http.url_stat.tick_interval_ms, 30000) << "Default URL stat tick should be 30s";
+    EXPECT_EQ(config->http.url_stat.send_interval_ms, 30000) << "Default URL stat send interval should be 30s";
     
     // Test HTTP server defaults
     EXPECT_EQ(config->http.server.status_errors.size(), 1) << "Should have default status error";
@@ -349,6 +376,14 @@ TEST_F(ConfigTest, DefaultConfigurationTest) {
     // Test SQL defaults
     EXPECT_EQ(config->sql.max_bind_args_size, 1024) << "Default max bind args size should be 1024";
     EXPECT_FALSE(config->sql.enable_sql_stats) << "SQL stats should be disabled by default";
+    EXPECT_FALSE(config->sql.async_normalize) << "SQL should be normalized on the calling thread by default";
+
+    // Test metadata defaults
+    EXPECT_TRUE(config->metadata.cache_dir.empty()) << "Metadata cache file should be disabled by default";
+    EXPECT_EQ(config->metadata.max_concurrent_requests, 1) << "Metadata should be sent sequentially by default";
+    EXPECT_EQ(config->metadata.exception_dedup_interval_ms, 0) << "Exception dedup should be disabled by default";
+    EXPECT_EQ(config->metadata.exception_max_unique_stacks, 1000) << "Default exception max unique stacks should be 1000";
+    EXPECT_EQ(config->span.batch.metadata_barrier_timeout_ms, 0) << "Span/metadata ordering barrier should be disabled by default";
     
     // Test CallStack trace default
     EXPECT_FALSE(config->enable_callstack_trace) << "CallStack trace should be disabled by default";
@@ -425,6 +460,7 @@ TEST_F(ConfigTest, CompleteYamlConfigurationTest) {
     EXPECT_TRUE(config->stat.enable) << "Stat enable should match YAML";
     EXPECT_EQ(config->stat.batch_count, 10) << "Batch count should match YAML";
     EXPECT_EQ(config->stat.collect_interval, 7000) << "Collect interval should match YAML";
+    EXPECT_EQ(config->stat.retained_batches, 20) << "Retained batches should match YAML";
     
     // Test HTTP configuration
     EXPECT_TRUE(config->http.url_stat.enable) << "URL stat enable should match YAML";
@@ -432,6 +468,11 @@ TEST_F(ConfigTest, CompleteYamlConfigurationTest) {
     EXPECT_FALSE(config->http.url_stat.enable_trim_path) << "URL stat enable trim path should match YAML";
     EXPECT_EQ(config->http.url_stat.trim_path_depth, 3) << "URL stat path depth should match YAML";
     EXPECT_TRUE(config->http.url_stat.method_prefix) << "URL stat method prefix should match YAML";
+    EXPECT_EQ(config->http.url_stat.percentile_bounds, (std::vector<int>{1, 2, 5, 10}))
+        << "URL stat percentile bounds should match YAML";
+    EXPECT_TRUE(config->http.url_stat.heavy_hitter) << "URL stat heavy-hitter mode should match YAML";
+    EXPECT_EQ(config->http.url_stat.tick_interval_ms, 5000) << "URL stat tick interval should match YAML";
+    EXPECT_EQ(config->http.url_stat.send_interval_ms, 10000) << "URL stat send interval should match YAML";
     
     // Test HTTP server configuration
     EXPECT_EQ(config->http.server.status_errors.size(), 3) << "Should have 3 status errors";
@@ -470,6 +511,13 @@ TEST_F(ConfigTest, CompleteYamlConfigurationTest) {
     // Test SQL configuration
     EXPECT_EQ(config->sql.max_bind_args_size, 2048) << "Max bind args size should match YAML";
     EXPECT_TRUE(config->sql.enable_sql_stats) << "SQL stats should be enabled as per YAML";
+    EXPECT_TRUE(config->sql.async_normalize) << "Async SQL normalization should be enabled as per YAML";
+
+    // Test metadata configuration
+    EXPECT_EQ(config->metadata.cache_dir, "/var/cache/pinpoint") << "Metadata cache dir should match YAML";
+    EXPECT_EQ(config->metadata.max_concurrent_requests, 8) << "Metadata max concurrent requests should match YAML";
+    EXPECT_EQ(config->metadata.exception_dedup_interval_ms, 5000) << "Exception dedup interval should match YAML";
+    EXPECT_EQ(config->metadata.exception_max_unique_stacks, 200) << "Exception max unique stacks should match YAML";
 }
 
 // Test partial YAML configuration
@@ -528,7 +576,17 @@ TEST_F(ConfigTest, EnvironmentVariableConfigurationTest) {
     setenv(full_env(env::IS_CONTAINER).c_str(), "true", 1);
     setenv(full_env(env::SQL_MAX_BIND_ARGS_SIZE).c_str(), "4096", 1);
     setenv(full_env(env::SQL_ENABLE_SQL_STATS).c_str(), "true", 1);
+    setenv(full_env(env::SQL_ASYNC_NORMALIZE).c_str(), "true", 1);
+    setenv(full_env(env::METADATA_CACHE_DIR).c_str(), "/env/meta", 1);
+    setenv(full_env(env::METADATA_MAX_CONCURRENT_REQUESTS).c_str(), "16", 1);
+    setenv(full_env(env::METADATA_EXCEPTION_DEDUP_INTERVAL_MS).c_str(), "2000", 1);
+    setenv(full_env(env::STAT_RETAINED_BATCHES).c_str(), "30", 1);
+    setenv(full_env(env::METADATA_EXCEPTION_MAX_UNIQUE_STACKS).c_str(), "50", 1);
     setenv(full_env(env::HTTP_URL_STAT_ENABLE_TRIM_PATH).c_str(), "false", 1);
+    setenv(full_env(env::HTTP_URL_STAT_PERCENTILE_BOUNDS).c_str(), "5,x,20,,50", 1);
+    setenv(full_env(env::HTTP_URL_STAT_HEAVY_HITTER).c_str(), "true", 1);
+    setenv(full_env(env::HTTP_URL_STAT_TICK_INTERVAL_MS).c_str(), "1000", 1);
+    setenv(full_env(env::HTTP_URL_STAT_SEND_INTERVAL_MS).c_str(), "5000", 1);
     setenv(full_env(env::AGENT_INFO_REFRESH_INTERVAL_MS).c_str(), "120000", 1);
     setenv(full_env(env::AGENT_INFO_SEND_RETRY_INTERVAL_MS).c_str(), "50", 1);
     setenv(full_env(env::AGENT_INFO_MAX_TRY_PER_ATTEMPT).c_str(), "4", 1);
@@ -555,9 +613,20 @@ TEST_F(ConfigTest, EnvironmentVariableConfigurationTest) {
     // Test SQL environment variable values
     EXPECT_EQ(config->sql.max_bind_args_size, 4096) << "Max bind args size should match environment variable";
     EXPECT_TRUE(config->sql.enable_sql_stats) << "SQL stats should be enabled as per environment variable";
+    EXPECT_TRUE(config->sql.async_normalize) << "Async SQL normalization should match environment variable";
+    EXPECT_EQ(config->metadata.cache_dir, "/env/meta") << "Metadata cache dir should match environment variable";
+    EXPECT_EQ(config->metadata.max_concurrent_requests, 16) << "Metadata max concurrent requests should match environment variable";
+    EXPECT_EQ(config->metadata.exception_dedup_interval_ms, 2000) << "Exception dedup interval should match environment variable";
+    EXPECT_EQ(config->stat.retained_batches, 30) << "Retained batches should match environment variable";
+    EXPECT_EQ(config->metadata.exception_max_unique_stacks, 50) << "Exception max unique stacks should match environment variable";
     
     // Test HTTP environment variable values
     EXPECT_FALSE(config->http.url_stat.enable_trim_path) << "URL stat enable trim path should match environment variable";
+    EXPECT_EQ(config->http.url_stat.percentile_bounds, (std::vector<int>{5, 20, 50}))
+        << "URL stat percentile bounds should skip invalid environment entries";
+    EXPECT_TRUE(config->http.url_stat.heavy_hitter) << "URL stat heavy-hitter mode should match environment variable";
+    EXPECT_EQ(config->http.url_stat.tick_interval_ms, 1000) << "URL stat tick interval should match environment variable";
+    EXPECT_EQ(config->http.url_stat.send_interval_ms, 5000) << "URL stat send interval should match environment variable";
 
     EXPECT_EQ(config->agent_info.refresh_interval_ms, 120000) << "AgentInfo refresh interval should match environment variable";
     EXPECT_EQ(config->agent_info.send_retry_interval_ms, 50) << "AgentInfo retry interval should match environment variable";
@@ -871,9 +940,13 @@ TEST_F(ConfigTest, NonDefaultConfigStringsTest) {
     config.http.url_stat.enable = true;
     config.sql.enable_sql_stats = true;
     config.uid_version_ = "v4";
+    config.metadata.cache_dir = "/tmp/meta";
+    config.metadata.max_concurrent_requests = 4;
+    config.metadata.exception_dedup_interval_ms = 1000;
+    config.span.batch.metadata_barrier_timeout_ms = 250;
 
     const auto config_strings = to_non_default_config_strings(config);
-    EXPECT_EQ(config_strings.size(), 5);
+    EXPECT_EQ(config_strings.size(), 9);
 
     auto contains_config = [&config_strings](const std::string& expected) {
         for (const auto& config_string : config_strings) {
@@ -889,6 +962,10 @@ TEST_F(ConfigTest, NonDefaultConfigStringsTest) {
     EXPECT_TRUE(contains_config("Span.MaxEventDepth=32"));
     EXPECT_TRUE(contains_config("Http.CollectUrlStat=true"));
     EXPECT_TRUE(contains_config("Sql.EnableSqlStats=true"));
+    EXPECT_TRUE(contains_config("Metadata.CacheDir=/tmp/meta"));
+    EXPECT_TRUE(contains_config("Metadata.MaxConcurrentRequests=4"));
+    EXPECT_TRUE(contains_config("Metadata.ExceptionDedupIntervalMs=1000"));
+    EXPECT_TRUE(contains_config("Span.Batch.MetadataBarrierTimeoutMs=250"));
 }
 
 // ========== Integration Tests ==========
@@ -2073,6 +2150,86 @@ Stat:
     EXPECT_EQ(config->stat.batch_count, 100) << "batch_count 100 (max) should be valid";
 }
 
+// Test stat retained_batches out of range
+TEST_F(ConfigTest, StatRetainedBatchesOutOfRangeTest) {
+    set_config_string(R"(
+Stat:
+  RetainedBatches: 0
+)");
+    auto config = make_config();
+    EXPECT_EQ(config->stat.retained_batches, defaults::STAT_RETAINED_BATCHES)
+        << "retained_batches 0 should be reset to default";
+
+    set_config_string(R"(
+Stat:
+  RetainedBatches: 101
+)");
+    config = make_config();
+    EXPECT_EQ(config->stat.retained_batches, defaults::STAT_RETAINED_BATCHES)
+        << "retained_batches 101 should be reset to default";
+
+    set_config_string(R"(
+Stat:
+  RetainedBatches: 1
+)");
+    config = make_config();
+    EXPECT_EQ(config->stat.retained_batches, 1) << "retained_batches 1 (min) should be valid";
+}
+
+// Test invalid URL stat percentile bounds
+TEST_F(ConfigTest, UrlStatPercentileBoundsInvalidTest) {
+    set_config_string(R"(
+Http:
+  UrlStatPercentileBounds: [10, 5]
+)");
+    auto config = make_config();
+    EXPECT_TRUE(config->http.url_stat.percentile_bounds.empty()) << "Decreasing bounds should be ignored";
+
+    set_config_string(R"(
+Http:
+  UrlStatPercentileBounds: [0, 5]
+)");
+    config = make_config();
+    EXPECT_TRUE(config->http.url_stat.percentile_bounds.empty()) << "Non-positive bounds should be ignored";
+
+    std::string many = "Http:\n  UrlStatPercentileBounds: [";
+    for (int i = 1; i <= 65; i++) {
+        many += std::to_string(i) + (i < 65 ? ", " : "]\n");
+    }
+    set_config_string(many);
+    config = make_config();
+    EXPECT_TRUE(config->http.url_stat.percentile_bounds.empty()) << "More than 64 bounds should be ignored";
+}
+
+// Test invalid URL stat tick and send intervals
+TEST_F(ConfigTest, UrlStatIntervalsOutOfRangeTest) {
+    for (const auto* tick : {"500", "1500", "7000", "60000"}) {
+        set_config_string(std::string("Http:\n  UrlStatTickIntervalMs: ") + tick + "\n");
+        const auto config = make_config();
+        EXPECT_EQ(config->http.url_stat.tick_interval_ms, defaults::HTTP_URL_STAT_TICK_INTERVAL_MS)
+            << "tick interval " << tick << "ms should be reset to default";
+    }
+    for (const auto* tick : {"1000", "3000", "15000"}) {
+        set_config_string(std::string("Http:\n  UrlStatTickIntervalMs: ") + tick + "\n");
+        const auto config = make_config();
+        EXPECT_EQ(config->http.url_stat.tick_interval_ms, std::stoi(tick)) << "tick interval " << tick << "ms is valid";
+    }
+
+    set_config_string(R"(
+Http:
+  UrlStatSendIntervalMs: 999
+)");
+    auto config = make_config();
+    EXPECT_EQ(config->http.url_stat.send_interval_ms, defaults::HTTP_URL_STAT_SEND_INTERVAL_MS);
+
+    set_config_string(R"(
+Http:
+  UrlStatSendIntervalMs: 60001
+)");
+    config = make_config();
+    EXPECT_EQ(config->http.url_stat.send_interval_ms, defaults::HTTP_URL_STAT_SEND_INTERVAL_MS);
+}
+
 // Test stat collect_interval out of range
 TEST_F(ConfigTest, StatCollectIntervalOutOfRangeTest) {
     // Below minimum (1000)
@@ -109,6 +109,152 @@ TEST(ExponentialBackoffTest, JitterStaysWithinRandomizationRange) {
     }
 }
 
+TEST(MetaWatermarkTest, AdvancesOnlyOverContiguousSettledSequences) {
+    MetaWatermark watermark;
+    const auto first = watermark.issue();
+    const auto second = watermark.issue();
+    const auto third = watermark.issue();
+    EXPECT_EQ(watermark.issued(), third);
+    EXPECT_EQ(watermark.watermark(), 0u);
+
+    // Out-of-order settles (pipelined sends) must not skip the gap
+    watermark.settle(third);
+    watermark.settle(second);
+    EXPECT_EQ(watermark.watermark(), 0u);
+
+    watermark.settle(first);
+    EXPECT_EQ(watermark.watermark(), third);
+
+    // Settling an already covered sequence is a no-op
+    watermark.settle(first);
+    EXPECT_EQ(watermark.watermark(), third);
+}
+
+TEST(MetaWatermarkTest, WaitForIsBoundedAndWakesOnSettle) {
+    MetaWatermark watermark;
+    const auto sequence = watermark.issue();
+
+    EXPECT_TRUE(watermark.wait_for(0, std::chrono::milliseconds(0)));
+    EXPECT_FALSE(watermark.wait_for(sequence, std::chrono::milliseconds(20)));
+
+    std::thread settler([&watermark, sequence] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        watermark.settle(sequence);
+    });
+    EXPECT_TRUE(watermark.wait_for(sequence, std::chrono::seconds(5)));
+    settler.join();
+}
+
+TEST(MetaWatermarkTest, InterruptReleasesWaiters) {
+    MetaWatermark watermark;
+    const auto sequence = watermark.issue();
+
+    const auto start = std::chrono::steady_clock::now();
+    std::thread interrupter([&watermark] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        watermark.interrupt();
+    });
+    EXPECT_FALSE(watermark.wait_for(sequence, std::chrono::seconds(30)));
+    interrupter.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+
+    // Later waits return at once; an already reached sequence still reports true
+    EXPECT_FALSE(watermark.wait_for(sequence, std::chrono::seconds(30)));
+    EXPECT_TRUE(watermark.wait_for(0, std::chrono::seconds(30)));
+}
+
+static std::unique_ptr<Exception> make_exception(std::string_view message, std::string_view top_function) {
+    auto callstack = std::make_unique<CallStack>(message);
+    callstack->push("module", top_function, "handler.cpp", 10);
+    callstack->push("module", "dispatch", "server.cpp", 20);
+    callstack->push("module", "main", "main.cpp", 30);
+    return std::make_unique<Exception>(std::move(callstack));
+}
+
+static ExceptionMeta make_exception_meta(int64_t span_id, std::vector<std::unique_ptr<Exception>> exceptions) {
+    return ExceptionMeta(TraceId{"agent", 1000, span_id}, span_id, "/api", std::move(exceptions));
+}
+
+TEST(ExceptionMetaAggregatorTest, SendsEachCallStackOncePerInterval) {
+    ExceptionMetaAggregator aggregator(100);
+    for (int64_t span_id = 1; span_id <= 3; ++span_id) {
+        std::vector<std::unique_ptr<Exception>> exceptions;
+        exceptions.push_back(make_exception("timeout " + std::to_string(span_id), "handle"));
+        aggregator.add(make_exception_meta(span_id, std::move(exceptions)));
+    }
+    EXPECT_EQ(aggregator.size(), 3u);
+    EXPECT_EQ(aggregator.repeatedCount(), 2u);
+
+    auto drained = aggregator.drain();
+    ASSERT_EQ(drained.size(), 3u);
+    const auto& first = *drained[0].exceptions_[0];
+    EXPECT_EQ(first.getCallStack().getStack().size(), 3u);
+    EXPECT_EQ(first.getCallStack().getErrorMessage(), "timeout 1");
+    // Repeats keep their id, class name and message; one marker frame replaces the stack.
+    for (size_t i = 1; i < drained.size(); ++i) {
+        ASSERT_EQ(drained[i].exceptions_.size(), 1u);
+        const auto& repeat = drained[i].exceptions_[0]->getCallStack();
+        EXPECT_EQ(repeat.getErrorMessage(), "timeout " + std::to_string(i + 1));
+        EXPECT_EQ(repeat.getModuleName(), "module");
+        ASSERT_EQ(repeat.getStack().size(), 1u);
+        EXPECT_EQ(repeat.getStack()[0].function, "(same call stack as exception " + std::to_string(first.getId()) + ")");
+    }
+    EXPECT_TRUE(aggregator.empty());
+    EXPECT_EQ(aggregator.repeatedCount(), 0u);
+
+    // A new interval sends the stack again
+    std::vector<std::unique_ptr<Exception>> exceptions;
+    exceptions.push_back(make_exception("timeout", "handle"));
+    aggregator.add(make_exception_meta(4, std::move(exceptions)));
+    drained = aggregator.drain();
+    ASSERT_EQ(drained.size(), 1u);
+    EXPECT_EQ(drained[0].exceptions_[0]->getCallStack().getStack().size(), 3u);
+}
+
+TEST(ExceptionMetaAggregatorTest, CapsUniqueStacksAndMergesPerSpan) {
+    ExceptionMetaAggregator aggregator(2);
+    std::vector<int32_t> ids;
+    for (const auto* function : {"a", "b", "c", "a"}) {
+        std::vector<std::unique_ptr<Exception>> exceptions;
+        exceptions.push_back(make_exception("error", function));
+        ids.push_back(exceptions.back()->getId());
+        aggregator.add(make_exception_meta(7, std::move(exceptions)));
+    }
+    EXPECT_EQ(aggregator.size(), 1u);
+    EXPECT_EQ(aggregator.repeatedCount(), 1u);
+    EXPECT_EQ(aggregator.overflowCount(), 1u);
+
+    auto drained = aggregator.drain();
+    ASSERT_EQ(drained.size(), 1u);
+    const auto& exceptions = drained[0].exceptions_;
+    ASSERT_EQ(exceptions.size(), 4u) << "Every exception id referenced by the span is sent";
+    for (size_t i = 0; i < exceptions.size(); ++i) {
+        EXPECT_EQ(exceptions[i]->getId(), ids[i]);
+        EXPECT_EQ(exceptions[i]->getCallStack().getModuleName(), "module");
+    }
+    EXPECT_EQ(exceptions[0]->getCallStack().getStack().size(), 3u);
+    EXPECT_EQ(exceptions[1]->getCallStack().getStack().size(), 3u);
+    ASSERT_EQ(exceptions[2]->getCallStack().getStack().size(), 1u);
+    EXPECT_EQ(exceptions[2]->getCallStack().getStack()[0].function,
+              "(call stack omitted: unique call stack limit reached)");
+    ASSERT_EQ(exceptions[3]->getCallStack().getStack().size(), 1u);
+    EXPECT_EQ(exceptions[3]->getCallStack().getStack()[0].function,
+              "(same call stack as exception " + std::to_string(ids[0]) + ")");
+}
+
+TEST(ExceptionMetaAggregatorTest, FingerprintIgnoresErrorMessage) {
+    CallStack first("first");
+    CallStack second("second");
+    CallStack other("first");
+    for (auto* callstack : {&first, &second, &other}) {
+        callstack->push("module", "handle", "handler.cpp", 10);
+    }
+    other.push("module", "main", "main.cpp", 30);
+
+    EXPECT_EQ(ExceptionMetaAggregator::fingerprint(first), ExceptionMetaAggregator::fingerprint(second));
+    EXPECT_NE(ExceptionMetaAggregator::fingerprint(first), ExceptionMetaAggregator::fingerprint(other));
+}
+
 // GrpcClient Tests
 
 TEST_F(GrpcTest, GrpcClientConstructorTest) {
@@ -501,6 +647,20 @@ TEST_F(GrpcTest, GrpcAgentMultipleMetaEnqueueTest) {
     SUCCEED() << "Enqueuing multiple meta types should succeed";
 }
 
+TEST_F(GrpcTest, GrpcMetadataEnqueueBatchTest) {
+    GrpcMetadata metadata(mock_agent_service_->getConfig()); metadata.setAgentService(mock_agent_service_.get());
+
+    std::vector<std::unique_ptr<MetaData>> batch;
+    batch.push_back(std::make_unique<MetaData>(META_API, 1, 100, "api1"));
+    batch.push_back(nullptr);
+    batch.push_back(std::make_unique<MetaData>(META_STRING, 2, "sql1", STRING_META_SQL));
+    metadata.enqueueMetaBatch(std::move(batch));
+
+    metadata.enqueueMetaBatch({});
+
+    SUCCEED() << "Enqueuing a metadata batch (with null and empty entries) should succeed";
+}
+
 TEST_F(GrpcTest, GrpcSpanMultipleEnqueueTest) {
     GrpcSpan span_client(mock_agent_service_->getConfig()); span_client.setAgentService(mock_agent_service_.get());
 
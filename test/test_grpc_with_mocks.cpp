@@ -16,11 +16,14 @@
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <future>
+#include <iostream>
 #include <mutex>
 #include <thread>
 #include <memory>
@@ -226,6 +229,218 @@ private:
     std::vector<std::function<void(grpc::Status)>> held_;
 };
 
+// Hand-written fake for the Metadata stub acting as a local mock collector:
+// every RPC, sync or callback-based async, completes after a fixed latency.
+// Async completions are delivered from a single collector thread so many
+// calls can be in flight at once, which the generated MockMetadataStub (whose
+// async() returns nullptr) cannot model.
+class FakeMetadataStub : public v1::Metadata::StubInterface {
+public:
+    explicit FakeMetadataStub(std::chrono::milliseconds latency)
+        : latency_(latency), fake_async_(this), collector_([this] { run_collector(); }) {}
+
+    ~FakeMetadataStub() override {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        collector_.join();
+    }
+
+    grpc::Status RequestApiMetaData(grpc::ClientContext*, const v1::PApiMetaData&, v1::PResult* response) override {
+        return handle_sync(response);
+    }
+    grpc::Status RequestStringMetaData(grpc::ClientContext*, const v1::PStringMetaData&, v1::PResult* response) override {
+        return handle_sync(response);
+    }
+    grpc::Status RequestSqlMetaData(grpc::ClientContext*, const v1::PSqlMetaData&, v1::PResult* response) override {
+        return handle_sync(response);
+    }
+    grpc::Status RequestSqlUidMetaData(grpc::ClientContext*, const v1::PSqlUidMetaData&, v1::PResult* response) override {
+        return handle_sync(response);
+    }
+    grpc::Status RequestExceptionMetaData(grpc::ClientContext*, const v1::PExceptionMetaData&, v1::PResult* response) override {
+        return handle_sync(response);
+    }
+
+    async_interface* async() override { return &fake_async_; }
+
+    // The next `count` calls reply with PResult.success=false.
+    void failNext(int count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        fail_remaining_ = count;
+    }
+
+    int callCount() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return calls_;
+    }
+
+    int succeededCount() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return succeeded_;
+    }
+
+    int maxInFlight() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return max_in_flight_;
+    }
+
+    bool waitForSucceeded(int count, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return done_cv_.wait_for(lock, timeout, [&] { return succeeded_ >= count; });
+    }
+
+private:
+    class FakeAsync : public v1::Metadata::StubInterface::async_interface {
+    public:
+        explicit FakeAsync(FakeMetadataStub* owner) : owner_(owner) {}
+        void RequestSqlMetaData(grpc::ClientContext*, const v1::PSqlMetaData*, v1::PResult* response,
+                                std::function<void(grpc::Status)> on_done) override {
+            owner_->handle_async(response, std::move(on_done));
+        }
+        void RequestSqlMetaData(grpc::ClientContext*, const v1::PSqlMetaData*, v1::PResult*,
+                                grpc::ClientUnaryReactor*) override {}
+        void RequestSqlUidMetaData(grpc::ClientContext*, const v1::PSqlUidMetaData*, v1::PResult* response,
+                                   std::function<void(grpc::Status)> on_done) override {
+            owner_->handle_async(response, std::move(on_done));
+        }
+        void RequestSqlUidMetaData(grpc::ClientContext*, const v1::PSqlUidMetaData*, v1::PResult*,
+                                   grpc::ClientUnaryReactor*) override {}
+        void RequestApiMetaData(grpc::ClientContext*, const v1::PApiMetaData*, v1::PResult* response,
+                                std::function<void(grpc::Status)> on_done) override {
+            owner_->handle_async(response, std::move(on_done));
+        }
+        void RequestApiMetaData(grpc::ClientContext*, const v1::PApiMetaData*, v1::PResult*,
+                                grpc::ClientUnaryReactor*) override {}
+        void RequestStringMetaData(grpc::ClientContext*, const v1::PStringMetaData*, v1::PResult* response,
+                                   std::function<void(grpc::Status)> on_done) override {
+            owner_->handle_async(response, std::move(on_done));
+        }
+        void RequestStringMetaData(grpc::ClientContext*, const v1::PStringMetaData*, v1::PResult*,
+                                   grpc::ClientUnaryReactor*) override {}
+        void RequestExceptionMetaData(grpc::ClientContext*, const v1::PExceptionMetaData*, v1::PResult* response,
+                                      std::function<void(grpc::Status)> on_done) override {
+            owner_->handle_async(response, std::move(on_done));
+        }
+        void RequestExceptionMetaData(grpc::ClientContext*, const v1::PExceptionMetaData*, v1::PResult*,
+                                      grpc::ClientUnaryReactor*) override {}
+
+    private:
+        FakeMetadataStub* owner_;
+    };
+
+    struct Completion {
+        std::chrono::steady_clock::time_point due;
+        v1::PResult* response;
+        bool success;
+        std::function<void(grpc::Status)> on_done;
+    };
+
+    // Caller must hold mutex_.
+    bool next_result() {
+        ++calls_;
+        if (fail_remaining_ > 0) {
+            --fail_remaining_;
+            return false;
+        }
+        return true;
+    }
+
+    grpc::Status handle_sync(v1::PResult* response) {
+        bool success;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            success = next_result();
+            max_in_flight_ = std::max(max_in_flight_, 1);
+        }
+        std::this_thread::sleep_for(latency_);
+        response->set_success(success);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (success) {
+                ++succeeded_;
+            }
+        }
+        done_cv_.notify_all();
+        return grpc::Status::OK;
+    }
+
+    void handle_async(v1::PResult* response, std::function<void(grpc::Status)> on_done) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            const bool success = next_result();
+            completions_.push_back(Completion{std::chrono::steady_clock::now() + latency_, response, success,
+                                              std::move(on_done)});
+            max_in_flight_ = std::max(max_in_flight_, static_cast<int>(completions_.size()));
+        }
+        cv_.notify_all();
+    }
+
+    void run_collector() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            if (completions_.empty()) {
+                if (stopping_) {
+                    return;
+                }
+                cv_.wait(lock, [this] { return stopping_ || !completions_.empty(); });
+                continue;
+            }
+            const auto due = completions_.front().due;
+            if (std::chrono::steady_clock::now() < due) {
+                cv_.wait_until(lock, due);
+                continue;
+            }
+            auto completion = std::move(completions_.front());
+            completions_.pop_front();
+            lock.unlock();
+            completion.response->set_success(completion.success);
+            completion.on_done(grpc::Status::OK);
+            lock.lock();
+            if (completion.success) {
+                ++succeeded_;
+            }
+            done_cv_.notify_all();
+        }
+    }
+
+    grpc::ClientAsyncResponseReaderInterface<v1::PResult>* AsyncRequestSqlMetaDataRaw(
+        grpc::ClientContext*, const v1::PSqlMetaData&, grpc::CompletionQueue*) override { return nullptr; }
+    grpc::ClientAsyncResponseReaderInterface<v1::PResult>* PrepareAsyncRequestSqlMetaDataRaw(
+        grpc::ClientContext*, const v1::PSqlMetaData&, grpc::CompletionQueue*) override { return nullptr; }
+    grpc::ClientAsyncResponseReaderInterface<v1::PResult>* AsyncRequestSqlUidMetaDataRaw(
+        grpc::ClientContext*, const v1::PSqlUidMetaData&, grpc::CompletionQueue*) override { return nullptr; }
+    grpc::ClientAsyncResponseReaderInterface<v1::PResult>* PrepareAsyncRequestSqlUidMetaDataRaw(
+        grpc::ClientContext*, const v1::PSqlUidMetaData&, grpc::CompletionQueue*) override { return nullptr; }
+    grpc::ClientAsyncResponseReaderInterface<v1::PResult>* AsyncRequestApiMetaDataRaw(
+        grpc::ClientContext*, const v1::PApiMetaData&, grpc::CompletionQueue*) override { return nullptr; }
+    grpc::ClientAsyncResponseReaderInterface<v1::PResult>* PrepareAsyncRequestApiMetaDataRaw(
+        grpc::ClientContext*, const v1::PApiMetaData&, grpc::CompletionQueue*) override { return nullptr; }
+    grpc::ClientAsyncResponseReaderInterface<v1::PResult>* AsyncRequestStringMetaDataRaw(
+        grpc::ClientContext*, const v1::PStringMetaData&, grpc::CompletionQueue*) override { return nullptr; }
+    grpc::ClientAsyncResponseReaderInterface<v1::PResult>* PrepareAsyncRequestStringMetaDataRaw(
+        grpc::ClientContext*, const v1::PStringMetaData&, grpc::CompletionQueue*) override { return nullptr; }
+    grpc::ClientAsyncResponseReaderInterface<v1::PResult>* AsyncRequestExceptionMetaDataRaw(
+        grpc::ClientContext*, const v1::PExceptionMetaData&, grpc::CompletionQueue*) override { return nullptr; }
+    grpc::ClientAsyncResponseReaderInterface<v1::PResult>* PrepareAsyncRequestExceptionMetaDataRaw(
+        grpc::ClientContext*, const v1::PExceptionMetaData&, grpc::CompletionQueue*) override { return nullptr; }
+
+    const std::chrono::milliseconds latency_;
+    FakeAsync fake_async_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable done_cv_;
+    std::deque<Completion> completions_;
+    int calls_{0};
+    int succeeded_{0};
+    int fail_remaining_{0};
+    int max_in_flight_{0};
+    bool stopping_{false};
+    std::thread collector_;
+};
+
 // Testable gRPC classes that inject mock stubs
 class TestableGrpcMetadata : public GrpcMetadata {
 public:
@@ -237,6 +452,10 @@ public:
         set_meta_stub(std::move(mock_stub));
     }
 
+    void setMetaStub(std::unique_ptr<v1::Metadata::StubInterface> stub) {
+        set_meta_stub(std::move(stub));
+    }
+
     bool readyChannel() override {
         return ready_channel_;
     }
@@ -775,9 +994,10 @@ TEST_F(GrpcMockTest, GrpcStatsOverflowRequestsStatsQueuePurge) {
     EXPECT_TRUE(stats_client.emptyStatsQueueIfRequestedForTest());
     EXPECT_FALSE(stats_client.emptyStatsQueueIfRequestedForTest());
 
+    // Agent stats are kept for the next batch; only the URL snapshot is purged
     AgentStatsSnapshot agent_snapshot;
     mock_agent_service_->getAgentStats().collectAgentStat(agent_snapshot);
-    EXPECT_EQ(agent_snapshot.num_sample_new_, 0);
+    EXPECT_EQ(agent_snapshot.num_sample_new_, 1);
     EXPECT_TRUE(mock_agent_service_->getUrlStats().takeSnapshot()->getEachStats().empty());
 }
 
@@ -796,9 +1016,10 @@ TEST_F(GrpcMockTest, GrpcStatsSlowChannelRecoveryRequestsStatsQueuePurge) {
     EXPECT_TRUE(stats_client.emptyStatsQueueIfRequestedForTest());
     EXPECT_FALSE(stats_client.emptyStatsQueueIfRequestedForTest());
 
+    // Agent stats are kept for the next batch; only the URL snapshot is purged
     AgentStatsSnapshot agent_snapshot;
     mock_agent_service_->getAgentStats().collectAgentStat(agent_snapshot);
-    EXPECT_EQ(agent_snapshot.num_sample_new_, 0);
+    EXPECT_EQ(agent_snapshot.num_sample_new_, 1);
     EXPECT_TRUE(mock_agent_service_->getUrlStats().takeSnapshot()->getEachStats().empty());
 }
 
@@ -1756,6 +1977,96 @@ TEST_F(GrpcMockTest, GrpcSpanSendBatchSuccessTest) {
     EXPECT_TRUE(request.span(1).has_span());
 }
 
+TEST_F(GrpcMockTest, GrpcSpanMetadataBarrierHoldsBatchUntilMetadataSettledTest) {
+    auto& cfg = mock_agent_service_->mutableConfig();
+    cfg->span.batch.size = 1;
+    cfg->span.batch.flush_interval_ms = 50;
+    cfg->span.batch.collect_deadline_ms = 0;
+    cfg->span.batch.metadata_barrier_timeout_ms = 5000;
+
+    TestableGrpcSpan span_client(mock_agent_service_.get());
+    auto fake_stub = std::make_unique<FakeSpanStub>();
+    auto* fake = fake_stub.get();
+    span_client.setMockSpanStub(std::move(fake_stub));
+
+    auto watermark = std::make_shared<MetaWatermark>();
+    span_client.setMetaWatermark(watermark);
+
+    // Metadata queued before the span finished must be acknowledged first
+    const auto sequence = watermark->issue();
+    auto span_data = make_test_span_data_ptr(*mock_agent_service_, "barrier-op");
+    span_client.enqueueSpan(std::make_unique<SpanChunk>(span_data, true));
+
+    std::thread worker([&span_client] { span_client.sendSpanWorker(); });
+
+    EXPECT_FALSE(fake->waitForBatchCount(1, std::chrono::milliseconds(200)))
+        << "The batch must wait for the metadata watermark";
+    watermark->settle(sequence);
+    EXPECT_TRUE(fake->waitForBatchCount(1, std::chrono::seconds(2)))
+        << "The batch should be sent once its metadata is acknowledged";
+
+    mock_agent_service_->setExiting(true);
+    span_client.stopSpanWorker();
+    if (worker.joinable()) worker.join();
+}
+
+TEST_F(GrpcMockTest, GrpcSpanMetadataBarrierWaitIsBoundedTest) {
+    auto& cfg = mock_agent_service_->mutableConfig();
+    cfg->span.batch.size = 1;
+    cfg->span.batch.flush_interval_ms = 50;
+    cfg->span.batch.collect_deadline_ms = 0;
+    cfg->span.batch.metadata_barrier_timeout_ms = 50;
+
+    TestableGrpcSpan span_client(mock_agent_service_.get());
+    auto fake_stub = std::make_unique<FakeSpanStub>();
+    auto* fake = fake_stub.get();
+    span_client.setMockSpanStub(std::move(fake_stub));
+
+    auto watermark = std::make_shared<MetaWatermark>();
+    span_client.setMetaWatermark(watermark);
+    watermark->issue();  // never settled
+
+    auto span_data = make_test_span_data_ptr(*mock_agent_service_, "barrier-timeout-op");
+    span_client.enqueueSpan(std::make_unique<SpanChunk>(span_data, true));
+
+    std::thread worker([&span_client] { span_client.sendSpanWorker(); });
+
+    EXPECT_TRUE(fake->waitForBatchCount(1, std::chrono::seconds(2)))
+        << "The batch should be sent once the barrier timeout elapses";
+
+    mock_agent_service_->setExiting(true);
+    span_client.stopSpanWorker();
+    if (worker.joinable()) worker.join();
+}
+
+TEST_F(GrpcMockTest, GrpcSpanStopInterruptsMetadataBarrierWaitTest) {
+    auto& cfg = mock_agent_service_->mutableConfig();
+    cfg->span.batch.size = 1;
+    cfg->span.batch.flush_interval_ms = 50;
+    cfg->span.batch.collect_deadline_ms = 0;
+    cfg->span.batch.metadata_barrier_timeout_ms = 30000;
+
+    TestableGrpcSpan span_client(mock_agent_service_.get());
+    span_client.setMockSpanStub(std::make_unique<FakeSpanStub>());
+
+    auto watermark = std::make_shared<MetaWatermark>();
+    span_client.setMetaWatermark(watermark);
+    watermark->issue();  // never settled
+
+    auto span_data = make_test_span_data_ptr(*mock_agent_service_, "barrier-stop-op");
+    span_client.enqueueSpan(std::make_unique<SpanChunk>(span_data, true));
+
+    std::thread worker([&span_client] { span_client.sendSpanWorker(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const auto start = std::chrono::steady_clock::now();
+    mock_agent_service_->setExiting(true);
+    span_client.stopSpanWorker();
+    if (worker.joinable()) worker.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10))
+        << "Stopping the worker must not wait out the metadata barrier timeout";
+}
+
 TEST_F(GrpcMockTest, GrpcSpanSendBatchSpanVsSpanChunkTest) {
     auto& cfg = mock_agent_service_->mutableConfig();
     cfg->span.batch.size = 2;
@@ -2178,6 +2489,160 @@ TEST_F(GrpcMockTest, GrpcAgentStopAgentInfoDuringRetriesReturnsPromptly) {
         << "stopAgentInfo should interrupt the retry delay instead of waiting it out";
 }
 
+// ============================================================
+// GrpcMetadata pipelined (async) mode tests
+// ============================================================
+
+TEST_F(GrpcMockTest, GrpcMetadataPipelinedSendsAllTypesTest) {
+    mock_agent_service_->mutableConfig()->metadata.max_concurrent_requests = 4;
+
+    TestableGrpcMetadata metadata(mock_agent_service_.get());
+    auto fake_stub = std::make_unique<FakeMetadataStub>(std::chrono::milliseconds(20));
+    auto* fake = fake_stub.get();
+    metadata.setMetaStub(std::move(fake_stub));
+
+    metadata.enqueueMeta(std::make_unique<MetaData>(META_API, 1, 100, "pipelined.api"));
+    metadata.enqueueMeta(std::make_unique<MetaData>(META_STRING, 2, "error msg", STRING_META_ERROR));
+    metadata.enqueueMeta(std::make_unique<MetaData>(META_STRING, 3, "SELECT 1", STRING_META_SQL));
+    SqlUid uid = {1, 2, 3};
+    metadata.enqueueMeta(std::make_unique<MetaData>(META_SQL_UID, uid, "SELECT * FROM t"));
+    TraceId txid{"agent", 100, 0};
+    std::vector<std::unique_ptr<Exception>> exceptions;
+    exceptions.push_back(std::make_unique<Exception>(std::make_unique<CallStack>("err")));
+    metadata.enqueueMeta(std::make_unique<MetaData>(META_EXCEPTION, txid, 1, "/api", std::move(exceptions)));
+    for (int i = 0; i < 5; ++i) {
+        metadata.enqueueMeta(std::make_unique<MetaData>(META_API, 10 + i, 100, "pipelined.api." + std::to_string(i)));
+    }
+
+    std::thread meta_worker([&metadata]() { metadata.sendMetaWorker(); });
+
+    EXPECT_TRUE(fake->waitForSucceeded(10, std::chrono::seconds(5)));
+
+    mock_agent_service_->setExiting(true);
+    metadata.stopMetaWorker();
+    if (meta_worker.joinable()) meta_worker.join();
+
+    EXPECT_GT(fake->maxInFlight(), 1) << "Requests should overlap in pipelined mode";
+    EXPECT_LE(fake->maxInFlight(), 4) << "In-flight requests must not exceed the permit count";
+}
+
+TEST_F(GrpcMockTest, GrpcMetadataPipelinedRetriesFailedResultTest) {
+    mock_agent_service_->mutableConfig()->metadata.max_concurrent_requests = 4;
+
+    TestableGrpcMetadata metadata(mock_agent_service_.get());
+    metadata.setRetryDelay(std::chrono::milliseconds(50));
+    auto fake_stub = std::make_unique<FakeMetadataStub>(std::chrono::milliseconds(1));
+    auto* fake = fake_stub.get();
+    fake->failNext(1);
+    metadata.setMetaStub(std::move(fake_stub));
+
+    metadata.enqueueMeta(std::make_unique<MetaData>(META_API, 1, 100, "pipelined.retry"));
+
+    std::thread meta_worker([&metadata]() { metadata.sendMetaWorker(); });
+
+    // The failed async call is handed back to the worker and retried
+    EXPECT_TRUE(fake->waitForSucceeded(1, std::chrono::seconds(5)));
+
+    mock_agent_service_->setExiting(true);
+    metadata.stopMetaWorker();
+    if (meta_worker.joinable()) meta_worker.join();
+
+    EXPECT_EQ(fake->callCount(), 2);
+    EXPECT_EQ(mock_agent_service_->removed_api_count_, 0);
+}
+
+TEST_F(GrpcMockTest, GrpcMetadataPipelinedEvictsCacheAfterRetryExhaustionTest) {
+    mock_agent_service_->mutableConfig()->metadata.max_concurrent_requests = 4;
+
+    TestableGrpcMetadata metadata(mock_agent_service_.get());
+    metadata.setRetryDelay(std::chrono::milliseconds(50));
+    auto fake_stub = std::make_unique<FakeMetadataStub>(std::chrono::milliseconds(1));
+    auto* fake = fake_stub.get();
+    fake->failNext(100);
+    metadata.setMetaStub(std::move(fake_stub));
+
+    metadata.enqueueMeta(std::make_unique<MetaData>(META_API, 1, 100, "pipelined.exhaust"));
+
+    std::thread meta_worker([&metadata]() { metadata.sendMetaWorker(); });
+
+    EXPECT_TRUE(wait_for_condition(
+        [this] { return mock_agent_service_->removed_api_count_ >= 1; }, std::chrono::seconds(10)));
+
+    mock_agent_service_->setExiting(true);
+    metadata.stopMetaWorker();
+    if (meta_worker.joinable()) meta_worker.join();
+
+    EXPECT_EQ(fake->callCount(), 4) << "Initial attempt plus 3 retries";
+    EXPECT_EQ(mock_agent_service_->removed_api_count_, 1);
+}
+
+TEST_F(GrpcMockTest, GrpcMetadataWatermarkSettlesOnAckAndExhaustionTest) {
+    mock_agent_service_->mutableConfig()->metadata.max_concurrent_requests = 4;
+
+    TestableGrpcMetadata metadata(mock_agent_service_.get());
+    metadata.setRetryDelay(std::chrono::milliseconds(10));
+    auto fake_stub = std::make_unique<FakeMetadataStub>(std::chrono::milliseconds(1));
+    auto* fake = fake_stub.get();
+    fake->failNext(4);  // early calls fail: payloads are retried and possibly dropped
+    metadata.setMetaStub(std::move(fake_stub));
+
+    metadata.enqueueMeta(std::make_unique<MetaData>(META_API, 1, 100, "watermark.dropped"));
+    metadata.enqueueMeta(std::make_unique<MetaData>(META_API, 2, 100, "watermark.acked"));
+    auto watermark = metadata.metaWatermark();
+    EXPECT_EQ(watermark->issued(), 2u);
+
+    std::thread meta_worker([&metadata]() { metadata.sendMetaWorker(); });
+
+    // Both the acknowledged and the finally dropped payload settle the watermark
+    EXPECT_TRUE(watermark->wait_for(2, std::chrono::seconds(5)));
+    EXPECT_GE(fake->succeededCount(), 1);
+
+    mock_agent_service_->setExiting(true);
+    metadata.stopMetaWorker();
+    if (meta_worker.joinable()) meta_worker.join();
+}
+
+// Warm-up benchmark against the fake collector: registers a burst of APIs
+// with a fixed per-RPC latency, first sequentially, then pipelined. Timing
+// depends on the host, so it only reports; run it explicitly with
+// --gtest_also_run_disabled_tests.
+TEST_F(GrpcMockTest, DISABLED_GrpcMetadataPipelinedWarmupBenchmarkTest) {
+    constexpr int kMetaCount = 200;
+    const auto latency = std::chrono::milliseconds(2);
+
+    auto run = [this, latency](int max_concurrent_requests) {
+        mock_agent_service_->mutableConfig()->metadata.max_concurrent_requests = max_concurrent_requests;
+
+        TestableGrpcMetadata metadata(mock_agent_service_.get());
+        auto fake_stub = std::make_unique<FakeMetadataStub>(latency);
+        auto* fake = fake_stub.get();
+        metadata.setMetaStub(std::move(fake_stub));
+
+        std::vector<std::unique_ptr<MetaData>> batch;
+        for (int i = 0; i < kMetaCount; ++i) {
+            batch.push_back(std::make_unique<MetaData>(META_API, i + 1, 100, "warmup.api." + std::to_string(i)));
+        }
+        metadata.enqueueMetaBatch(std::move(batch));
+
+        const auto start = std::chrono::steady_clock::now();
+        std::thread meta_worker([&metadata]() { metadata.sendMetaWorker(); });
+        EXPECT_TRUE(fake->waitForSucceeded(kMetaCount, std::chrono::seconds(30)));
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        metadata.stopMetaWorker();
+        if (meta_worker.joinable()) meta_worker.join();
+        return elapsed;
+    };
+
+    const auto sequential = run(1);
+    const auto pipelined = run(16);
+
+    std::cout << "[ BENCH    ] " << kMetaCount << " metadata RPCs @ " << latency.count()
+              << "ms latency: sequential=" << sequential.count() << "ms"
+              << " pipelined(16)=" << pipelined.count() << "ms" << std::endl;
+}
+
 // ============================================================
 // GrpcMetadata queue boundary tests
 // ============================================================
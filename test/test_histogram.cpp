@@ -0,0 +1,124 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../src/histogram.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace pinpoint {
+
+using Histogram = LogLinearHistogram;
+
+// Test that every value falls inside its bucket and buckets are at most 1/16 wide
+TEST(LogLinearHistogramTest, BucketBoundsTest) {
+    const std::vector<int64_t> values = {0, 1, 15, 16, 17, 31, 32, 100, 1000, 4095, 4096, 65537, 1'000'000, 4'294'967'295};
+    for (const auto value : values) {
+        const auto index = Histogram::bucket_index(value);
+        ASSERT_LT(index, Histogram::kBucketCount);
+        EXPECT_GE(Histogram::bucket_upper(index), value) << value;
+        if (index > 0) {
+            EXPECT_LT(Histogram::bucket_upper(index - 1), value) << value;
+        }
+        const auto width = Histogram::bucket_upper(index) - (index > 0 ? Histogram::bucket_upper(index - 1) : -1);
+        EXPECT_LE(width * Histogram::kSubBucketCount, std::max<int64_t>(value, Histogram::kSubBucketCount)) << value;
+    }
+
+    // Out-of-range values are clamped instead of overflowing the bucket array
+    EXPECT_EQ(Histogram::bucket_index(-5), 0u);
+    EXPECT_EQ(Histogram::bucket_index(int64_t{1} << 40), Histogram::kBucketCount - 1);
+}
+
+// Test that percentiles of a uniform distribution stay within the bucket error
+TEST(LogLinearHistogramTest, PercentilesTest) {
+    Histogram histogram;
+    for (int64_t value = 1; value <= 10000; ++value) {
+        histogram.record(value);
+    }
+
+    Histogram::Snapshot snapshot;
+    histogram.drain_into(snapshot);
+    snapshot.max = 10000;
+    EXPECT_EQ(snapshot.total, 10000u);
+
+    for (const auto& [percentile, expected] : {std::pair{50.0, 5000}, {90.0, 9000}, {99.0, 9900}}) {
+        const auto reported = snapshot.percentile(percentile);
+        EXPECT_GE(reported, expected) << percentile;
+        EXPECT_LE(reported, expected + expected / Histogram::kSubBucketCount) << percentile;
+    }
+    EXPECT_EQ(snapshot.percentile(100), 10000);
+}
+
+// Test that an empty snapshot reports 0 and reported values never exceed the max
+TEST(LogLinearHistogramTest, EmptyAndMaxCapTest) {
+    Histogram::Snapshot empty;
+    EXPECT_EQ(empty.percentile(99), 0);
+
+    Histogram histogram;
+    histogram.record(1000);
+    Histogram::Snapshot snapshot;
+    histogram.drain_into(snapshot);
+    snapshot.max = 1000;
+    EXPECT_EQ(snapshot.percentile(50), 1000);
+}
+
+// Test that draining resets the histogram and merges several histograms
+TEST(LogLinearHistogramTest, DrainMergesAndResetsTest) {
+    Histogram first;
+    Histogram second;
+    first.record(10);
+    second.record(10);
+    second.record(20);
+
+    Histogram::Snapshot merged;
+    first.drain_into(merged);
+    second.drain_into(merged);
+    EXPECT_EQ(merged.total, 3u);
+    EXPECT_EQ(merged.counts[Histogram::bucket_index(10)], 2u);
+
+    Histogram::Snapshot after;
+    first.drain_into(after);
+    second.drain_into(after);
+    EXPECT_EQ(after.total, 0u);
+}
+
+// Test that concurrent recording loses no counts
+TEST(LogLinearHistogramTest, ConcurrentRecordTest) {
+    constexpr int kThreads = 8;
+    constexpr int kPerThread = 10000;
+    auto histogram = std::make_unique<Histogram>();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&histogram, t]() {
+            for (int i = 0; i < kPerThread; ++i) {
+                histogram->record(t * 100 + i % 100);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    Histogram::Snapshot snapshot;
+    histogram->drain_into(snapshot);
+    EXPECT_EQ(snapshot.total, static_cast<uint64_t>(kThreads) * kPerThread);
+}
+
+}  // namespace pinpoint
@@ -368,6 +368,10 @@ TEST_F(NoopTest, NoopAgentBasicBehaviorTest) {
     auto span3 = agent.NewSpan("operation", "rpc", "GET", reader);
     EXPECT_NE(span3, nullptr) << "NewSpan with method and reader should return a valid Span";
 
+    MetadataCatalog catalog;
+    catalog.apis.push_back({"operation", API_TYPE_DEFAULT});
+    agent.RegisterMetadata(catalog); // Should not throw
+
     agent.Shutdown(); // Should not throw
 
     SUCCEED() << "All NoopAgent methods should execute without throwing exceptions";
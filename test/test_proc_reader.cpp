@@ -0,0 +1,283 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../src/proc_reader.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+namespace pinpoint {
+
+// Test the /proc/stat aggregate cpu line parser
+TEST(ProcParseTest, CpuTicksTest) {
+    int64_t ticks = 0;
+    EXPECT_TRUE(proc_parse::cpu_ticks("cpu  100 20 300 4000 50 0 6 0 0 0\ncpu0 1 2 3 4\n", ticks));
+    EXPECT_EQ(ticks, 420);
+
+    EXPECT_FALSE(proc_parse::cpu_ticks("cpu0 1 2 3 4\n", ticks));
+    EXPECT_FALSE(proc_parse::cpu_ticks("cpu  100 20\n", ticks));
+    EXPECT_FALSE(proc_parse::cpu_ticks("", ticks));
+}
+
+// Test the /proc/self/status parser
+TEST(ProcParseTest, StatusTest) {
+    const std::string status =
+        "Name:\tapp\n"
+        "VmPeak:\t  123456 kB\n"
+        "VmSize:\t  120000 kB\n"
+        "VmRSS:\t    4096 kB\n"
+        "Threads:\t12\n"
+        "SigQ:\t0/63450\n";
+    int64_t vm_peak = 0, threads = 0;
+    EXPECT_TRUE(proc_parse::status(status, vm_peak, threads));
+    EXPECT_EQ(vm_peak, 123456 * 1024);
+    EXPECT_EQ(threads, 12);
+
+    EXPECT_FALSE(proc_parse::status("Name:\tapp\nThreads:\t3\n", vm_peak, threads));
+}
+
+// Test the statm, cgroup cpu.stat, single value and /proc/self/cgroup parsers
+TEST(ProcParseTest, StatmAndCgroupTest) {
+    int64_t resident = 0;
+    EXPECT_TRUE(proc_parse::statm_resident("5000 1200 300 10 0 900 0\n", resident));
+    EXPECT_EQ(resident, 1200);
+    EXPECT_FALSE(proc_parse::statm_resident("5000\n", resident));
+
+    int64_t usage = 0, throttled = -1;
+    EXPECT_TRUE(proc_parse::cgroup_cpu_stat(
+        "usage_usec 987654\nuser_usec 600000\nsystem_usec 387654\n"
+        "nr_periods 10\nnr_throttled 2\nthrottled_usec 5000\n", usage, throttled));
+    EXPECT_EQ(usage, 987654);
+    EXPECT_EQ(throttled, 5000);
+
+    // No CPU limit: throttling fields are absent
+    EXPECT_TRUE(proc_parse::cgroup_cpu_stat("usage_usec 10\nuser_usec 5\nsystem_usec 5\n", usage, throttled));
+    EXPECT_EQ(throttled, 0);
+
+    int64_t value = 0;
+    EXPECT_TRUE(proc_parse::single_value("268435456\n", value));
+    EXPECT_EQ(value, 268435456);
+    EXPECT_FALSE(proc_parse::single_value("max\n", value));
+
+    EXPECT_EQ(proc_parse::cgroup_v2_path("12:memory:/a\n0::/system.slice/app.service\n"), "/system.slice/app.service");
+    EXPECT_TRUE(proc_parse::cgroup_v2_path("12:memory:/a\n").empty());
+}
+
+// Test the cgroup CPU quota parsers for v2 cpu.max and v1 /proc/self/cgroup and cpu.stat
+TEST(ProcParseTest, CgroupCpuQuotaTest) {
+    int64_t quota = 0, period = 0;
+    EXPECT_TRUE(proc_parse::cgroup_cpu_max("200000 100000\n", quota, period));
+    EXPECT_EQ(quota, 200000);
+    EXPECT_EQ(period, 100000);
+    EXPECT_TRUE(proc_parse::cgroup_cpu_max("max 100000\n", quota, period));
+    EXPECT_EQ(quota, -1);
+    EXPECT_EQ(period, 100000);
+    EXPECT_FALSE(proc_parse::cgroup_cpu_max("", quota, period));
+
+    std::string_view controllers, path;
+    EXPECT_TRUE(proc_parse::cgroup_v1_entry("5:memory:/m\n4:cpu,cpuacct:/kubepods/pod1\n",
+                                            "cpu", controllers, path));
+    EXPECT_EQ(controllers, "cpu,cpuacct");
+    EXPECT_EQ(path, "/kubepods/pod1");
+    // "cpuacct" and "cpuset" are other controllers
+    EXPECT_FALSE(proc_parse::cgroup_v1_entry("3:cpuset:/\n2:cpuacct:/\n0::/\n", "cpu", controllers, path));
+
+    int64_t throttled_ns = 0;
+    EXPECT_TRUE(proc_parse::key_value("nr_periods 10\nnr_throttled 2\nthrottled_time 3000000\n",
+                                      "throttled_time", throttled_ns));
+    EXPECT_EQ(throttled_ns, 3000000);
+    EXPECT_FALSE(proc_parse::key_value("nr_throttled_time 1\n", "throttled_time", throttled_ns));
+}
+
+class ProcSamplerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root_ = std::filesystem::temp_directory_path() / ("pinpoint_proc_test_" + std::to_string(::getpid()));
+        std::filesystem::create_directories(root_ / "proc" / "self");
+        std::filesystem::create_directories(root_ / "cgroup" / "app");
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove_all(root_, ec);
+    }
+
+    void write(const std::filesystem::path& path, const std::string& content) {
+        std::ofstream out(root_ / path, std::ios::trunc);
+        out << content;
+    }
+
+    std::filesystem::path root_;
+};
+
+// Test that a fake /proc and cgroup tree is sampled, and rewritten files are re-read through the kept descriptors
+TEST_F(ProcSamplerTest, SamplesFakeTreeTest) {
+    write("proc/stat", "cpu  1 2 3 4\n");
+    write("proc/self/status", "VmPeak:\t 2048 kB\nThreads:\t7\n");
+    write("proc/self/statm", "100 10 5 1 0 20 0\n");
+    write("proc/self/cgroup", "0::/app\n");
+    write("cgroup/app/cpu.stat", "usage_usec 1000\nthrottled_usec 10\n");
+    write("cgroup/app/memory.current", "65536\n");
+
+    ProcSampler sampler((root_ / "proc").string(), (root_ / "cgroup").string());
+    EXPECT_TRUE(sampler.hasCgroup());
+    EXPECT_EQ(sampler.systemCpuTicks(), 6);
+
+    auto sample = sampler.sample();
+    EXPECT_EQ(sample.vm_peak_bytes, 2048 * 1024);
+    EXPECT_EQ(sample.num_threads, 7);
+    EXPECT_EQ(sample.rss_bytes, 10 * sysconf(_SC_PAGESIZE));
+    EXPECT_EQ(sample.cgroup_cpu_usage_usec, 1000);
+    EXPECT_EQ(sample.cgroup_cpu_throttled_usec, 10);
+    EXPECT_EQ(sample.cgroup_memory_bytes, 65536);
+
+    // Overwrite in place (same inode), as the kernel does for /proc
+    write("proc/stat", "cpu  10 20 30 40\n");
+    EXPECT_EQ(sampler.systemCpuTicks(), 60);
+}
+
+// Test that the cgroup v2 cpu.max quota is read as CPUs and re-read after a resize
+TEST_F(ProcSamplerTest, CgroupV2CpuLimitTest) {
+    write("proc/self/cgroup", "0::/app\n");
+    write("cgroup/app/cpu.stat", "usage_usec 1000\n");
+    write("cgroup/app/cpu.max", "150000 100000\n");
+
+    ProcSampler sampler((root_ / "proc").string(), (root_ / "cgroup").string());
+    EXPECT_DOUBLE_EQ(sampler.cpuLimit(), 1.5);
+
+    write("cgroup/app/cpu.max", "max 100000\n");
+    EXPECT_DOUBLE_EQ(sampler.cpuLimit(), 0);
+}
+
+// Test that a cgroup v1 CFS quota and throttled time are read from the cpu controller
+TEST_F(ProcSamplerTest, CgroupV1CpuLimitTest) {
+    std::filesystem::create_directories(root_ / "cgroup" / "cpu,cpuacct" / "docker" / "c1");
+    write("proc/self/cgroup", "4:cpu,cpuacct:/docker/c1\n3:memory:/docker/c1\n");
+    write("cgroup/cpu,cpuacct/docker/c1/cpu.cfs_quota_us", "50000\n");
+    write("cgroup/cpu,cpuacct/docker/c1/cpu.cfs_period_us", "100000\n");
+    write("cgroup/cpu,cpuacct/docker/c1/cpu.stat", "nr_periods 20\nnr_throttled 4\nthrottled_time 7000000\n");
+
+    ProcSampler sampler((root_ / "proc").string(), (root_ / "cgroup").string());
+    EXPECT_FALSE(sampler.hasCgroup());
+    EXPECT_TRUE(sampler.hasCgroupV1Cpu());
+    EXPECT_DOUBLE_EQ(sampler.cpuLimit(), 0.5);
+    EXPECT_EQ(sampler.sample().cgroup_cpu_throttled_usec, 7000);
+
+    write("cgroup/cpu,cpuacct/docker/c1/cpu.cfs_quota_us", "-1\n");
+    EXPECT_DOUBLE_EQ(sampler.cpuLimit(), 0);
+}
+
+// Test that the entries of /proc/self/fd are counted
+TEST_F(ProcSamplerTest, OpenFileDescriptorsTest) {
+    std::filesystem::create_directories(root_ / "proc" / "self" / "fd");
+    for (const auto* name : {"0", "1", "2", "17"}) {
+        write(std::filesystem::path("proc/self/fd") / name, "");
+    }
+
+    ProcSampler sampler((root_ / "proc").string(), (root_ / "cgroup").string());
+    EXPECT_EQ(sampler.openFileDescriptors(), 4);
+
+#ifdef __linux__
+    // The real directory: the descriptor listing it is not counted
+    ProcSampler real;
+    const auto before = real.openFileDescriptors();
+    EXPECT_GE(before, 3);
+    const int fd = ::open("/dev/null", O_RDONLY);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(real.openFileDescriptors(), before + 1);
+    ::close(fd);
+#endif
+}
+
+// Test that missing sources are reported as unavailable
+TEST_F(ProcSamplerTest, MissingSourcesTest) {
+    ProcSampler sampler((root_ / "proc").string(), (root_ / "cgroup").string());
+    EXPECT_FALSE(sampler.hasCgroup());
+    EXPECT_FALSE(sampler.hasCgroupV1Cpu());
+    EXPECT_EQ(sampler.systemCpuTicks(), -1);
+    EXPECT_DOUBLE_EQ(sampler.cpuLimit(), 0);
+    EXPECT_EQ(sampler.openFileDescriptors(), -1);
+
+    const auto sample = sampler.sample();
+    EXPECT_EQ(sample.rss_bytes, -1);
+    EXPECT_EQ(sample.num_threads, -1);
+    EXPECT_EQ(sample.cgroup_memory_bytes, -1);
+}
+
+#ifdef __linux__
+// Benchmark: one collection's worth of reads via fopen/fgets/sscanf versus kept descriptors and pread.
+// Reporting only, so it is disabled unless --gtest_also_run_disabled_tests is given.
+TEST(ProcSamplerBenchmarkTest, DISABLED_CollectionCostTest) {
+    constexpr int kIterations = 2000;
+
+    auto legacy_sample = []() {
+        int64_t ticks = 0, threads = 0;
+        if (FILE* fp = fopen("/proc/stat", "r")) {
+            char buf[256];
+            unsigned long user = 0, nice = 0, system = 0;
+            if (fgets(buf, sizeof(buf), fp) != nullptr &&
+                sscanf(buf, "%*s %lu %lu %lu", &user, &nice, &system) == 3) {
+                ticks = static_cast<int64_t>(user + nice + system);
+            }
+            fclose(fp);
+        }
+        if (FILE* fp = fopen("/proc/self/status", "r")) {
+            char buf[256];
+            while (fgets(buf, sizeof(buf), fp) != nullptr) {
+                long value = 0;
+                if (sscanf(buf, "Threads: %ld", &value) == 1) {
+                    threads = value;
+                }
+            }
+            fclose(fp);
+        }
+        return ticks + threads;
+    };
+
+    ProcSampler sampler;
+    ASSERT_GE(sampler.systemCpuTicks(), 0);
+    ASSERT_GT(sampler.sample().num_threads, 0);
+
+    int64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        sink += legacy_sample();
+    }
+    const auto legacy = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        sink += sampler.systemCpuTicks() + sampler.sample().num_threads;
+    }
+    const auto persistent = std::chrono::steady_clock::now() - start;
+
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+    std::cout << "[ BENCH    ] per collection: fopen/fgets="
+              << duration_cast<nanoseconds>(legacy).count() / kIterations / 1000.0 << "us"
+              << " pread(stat,status,statm" << (sampler.hasCgroup() ? ",cgroup" : "") << ")="
+              << duration_cast<nanoseconds>(persistent).count() / kIterations / 1000.0 << "us" << std::endl;
+    EXPECT_GT(sink, 0);
+}
+#endif
+
+}  // namespace pinpoint
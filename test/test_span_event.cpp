@@ -953,6 +953,45 @@ TEST_F(SpanEventTest, SetSqlQueryWithSqlStatsDisabledTest) {
         << "cacheSql should be called when sql stats is disabled";
 }
 
+TEST_F(SpanEventTest, SetSqlQueryAsyncNormalizeTest) {
+    const std::string sql = "SELECT * FROM users WHERE id IN (1, 2, 3) AND name = 'kim'";
+    auto sync = make_test_span_event(*test_span_, "test-op");
+    sync.SetServiceType(SERVICE_TYPE_MYSQL_QUERY);
+    sync.SetSqlQuery(sql, "args");
+
+    mock_agent_service_->mutableConfig()->sql.async_normalize = true;
+    auto deferred = make_test_span_event(*test_span_, "test-op");
+    deferred.SetServiceType(SERVICE_TYPE_MYSQL_QUERY);
+    const auto sql_id_counter = mock_agent_service_->getSqlIdCounter();
+    deferred.SetSqlQuery("SELECT * FROM users WHERE id IN (4, 5) AND name = 'lee'", "");
+    deferred.SetSqlQuery(sql, "args");
+
+    // Nothing is normalized or cached on the calling thread
+    EXPECT_TRUE(deferred.hasPendingSqlQuery());
+    EXPECT_EQ(mock_agent_service_->getSqlIdCounter(), sql_id_counter);
+    EXPECT_TRUE(deferred.getAnnotations()->getAnnotations().empty());
+
+    // The span worker's result matches synchronous normalization
+    deferred.resolveSqlQueries();
+    EXPECT_FALSE(deferred.hasPendingSqlQuery());
+
+    const auto& resolved = deferred.getAnnotations()->getAnnotations();
+    const auto& expected = sync.getAnnotations()->getAnnotations();
+    ASSERT_EQ(resolved.size(), 2u);
+    ASSERT_EQ(expected.size(), 1u);
+    EXPECT_EQ(resolved.back().first, ANNOTATION_SQL_ID);
+    EXPECT_EQ(resolved.back().first, expected.front().first);
+    EXPECT_EQ(std::get<IntStringStringValue>(resolved.front().second.data).intValue,
+              std::get<IntStringStringValue>(resolved.back().second.data).intValue)
+        << "IN lists of any length share one SQL id";
+    const auto& value = std::get<IntStringStringValue>(resolved.back().second.data);
+    const auto& expected_value = std::get<IntStringStringValue>(expected.front().second.data);
+    EXPECT_EQ(value.intValue, expected_value.intValue);
+    EXPECT_EQ(value.stringValue1, "1,, 2,, 3,kim");
+    EXPECT_EQ(value.stringValue1, expected_value.stringValue1);
+    EXPECT_EQ(value.stringValue2, "args");
+}
+
 // ========== SetOperationName Does Not Update ApiId ==========
 
 TEST_F(SpanEventTest, SetOperationNameDoesNotUpdateApiIdTest) {
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../src/spsc_ring.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace pinpoint {
+
+// Test that an uninitialized ring rejects pushes and pops nothing
+TEST(SpscRingTest, UninitializedTest) {
+    SpscRing<int> ring;
+    std::vector<int> out;
+    EXPECT_FALSE(ring.push(1));
+    EXPECT_EQ(ring.pop(out, 10), 0u);
+    EXPECT_EQ(ring.capacity(), 0u);
+
+    EXPECT_FALSE(ring.init(0));
+    EXPECT_TRUE(ring.init(4));
+    EXPECT_FALSE(ring.init(8)) << "capacity is fixed once initialized";
+    EXPECT_EQ(ring.capacity(), 4u);
+}
+
+// Test that a full ring keeps the oldest entries and rejects new ones
+TEST(SpscRingTest, FullRingKeepsOldestTest) {
+    SpscRing<int> ring;
+    ASSERT_TRUE(ring.init(3));
+    EXPECT_TRUE(ring.push(1));
+    EXPECT_TRUE(ring.push(2));
+    EXPECT_TRUE(ring.push(3));
+    EXPECT_FALSE(ring.push(4));
+    EXPECT_EQ(ring.size(), 3u);
+
+    std::vector<int> out;
+    EXPECT_EQ(ring.pop(out, 2), 2u);
+    EXPECT_EQ(out, (std::vector<int>{1, 2}));
+    EXPECT_EQ(ring.size(), 1u);
+}
+
+// Test that indices wrap around the storage in FIFO order
+TEST(SpscRingTest, WrapAroundTest) {
+    SpscRing<int> ring;
+    ASSERT_TRUE(ring.init(4));
+    std::vector<int> out;
+    int next = 0;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 3; ++i) {
+            ASSERT_TRUE(ring.push(next++));
+        }
+        ASSERT_EQ(ring.pop(out, 3), 3u);
+    }
+    ASSERT_EQ(out.size(), 30u);
+    for (int i = 0; i < 30; ++i) {
+        EXPECT_EQ(out[i], i);
+    }
+}
+
+// Test that one producer and one consumer running concurrently lose and reorder nothing
+TEST(SpscRingTest, ConcurrentProducerConsumerTest) {
+    constexpr int kCount = 200000;
+    SpscRing<int> ring;
+    ASSERT_TRUE(ring.init(64));
+
+    std::thread producer([&ring]() {
+        for (int i = 0; i < kCount;) {
+            if (ring.push(i)) {
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<int> out;
+    out.reserve(kCount);
+    while (out.size() < static_cast<size_t>(kCount)) {
+        if (ring.pop(out, 16) == 0) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    for (int i = 0; i < kCount; ++i) {
+        ASSERT_EQ(out[i], i);
+    }
+    EXPECT_EQ(ring.size(), 0u);
+}
+
+}  // namespace pinpoint
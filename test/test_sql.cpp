@@ -15,7 +15,12 @@
  */
 
 #include "../src/sql.h"
+#include "../src/sql_scan.h"
+#include "pinpoint/tracer.h"
 #include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <random>
 #include <string>
 #include <vector>
 
@@ -806,4 +811,203 @@ TEST_F(SqlTest, JavaPostgresPositionalParameterCases) {
     ExpectJavaCombine("'$''123'", "'0$'", "$''123");
 }
 
+// Test that the vector scanners agree with the scalar ones at every offset of random input
+TEST(SqlScanTest, VectorMatchesScalarTest) {
+    std::mt19937 rng(46);
+    const std::string alphabet = "abcXYZ _,.()=*\t\n\"`[\\/-'$0123456789\x80\xff";
+    for (int round = 0; round < 200; ++round) {
+        std::string text(rng() % 100, ' ');
+        for (auto& c : text) {
+            // Mostly plain letters so that long runs cross several vector strides.
+            c = rng() % 8 ? static_cast<char>('a' + rng() % 26) : alphabet[rng() % alphabet.size()];
+        }
+        for (size_t pos = 0; pos <= text.size(); ++pos) {
+            ASSERT_EQ(sql_scan::find_special(text.data(), text.size(), pos),
+                      sql_scan::find_special_scalar(text.data(), text.size(), pos)) << text << " @" << pos;
+            ASSERT_EQ(sql_scan::find_special(text.data(), text.size(), pos, '"', '`', '('),
+                      sql_scan::find_special_scalar(text.data(), text.size(), pos, '"', '`', '(')) << text << " @" << pos;
+            ASSERT_EQ(sql_scan::find_first_of(text.data(), text.size(), pos, '\'', ',', '\\'),
+                      sql_scan::find_first_of_scalar(text.data(), text.size(), pos, '\'', ',', '\\'))
+                << text << " @" << pos;
+        }
+    }
+    for (int c = 0; c < 256; ++c) {
+        const std::string text(40, static_cast<char>(c));
+        EXPECT_EQ(sql_scan::find_special(text.data(), text.size(), 0) == 0, sql_scan::is_special(static_cast<char>(c)))
+            << "byte " << c;
+    }
+}
+
+// Test that long statements with literals straddling vector strides normalize like short ones
+TEST_F(SqlTest, LongStatementTest) {
+    std::string sql = "SELECT ";
+    std::string expected = "SELECT ";
+    std::string params;
+    for (int i = 0; i < 300; ++i) {
+        const auto column = "t0.column_name_" + std::to_string(i) + ", ";
+        sql += column;
+        expected += column;
+    }
+    sql += "x FROM t0 WHERE a IN (";
+    expected += "x FROM t0 WHERE a IN (";
+    for (int i = 0; i < 100; ++i) {
+        sql += std::to_string(i * 7) + ",'v, " + std::to_string(i) + "',";
+        expected += std::to_string(2 * i) + "#,'" + std::to_string(2 * i + 1) + "$',";
+        params += (i ? "," : "") + std::to_string(i * 7) + ",v,, " + std::to_string(i);
+    }
+    sql += "/* trailing */ NULL)";
+    expected += " NULL)";
+
+    SqlNormalizer normalizer(SQL_NORMALIZE_MAX_LENGTH);
+    const auto result = normalizer.normalize(sql);
+    EXPECT_EQ(result.normalized_sql, expected);
+    EXPECT_EQ(result.parameters, params);
+    EXPECT_EQ(result.param_index, 200);
+}
+
+// Test that normalizing into a reused result matches a fresh result and keeps its buffers
+TEST_F(SqlTest, NormalizeIntoReusedResultTest) {
+    const std::vector<std::string> queries = {
+        "SELECT * FROM orders WHERE id = 12345 AND name = 'a, b' /* hint */",
+        "UPDATE t SET v = 'x''y' WHERE k = 1.5e3",
+        "",
+        "SELECT 1",
+    };
+
+    SqlNormalizeResult reused;
+    normalizer_->normalize(queries[0], reused);
+    const auto* sql_buffer = reused.normalized_sql.data();
+    const auto* param_buffer = reused.parameters.data();
+    for (const auto& query : queries) {
+        const auto fresh = normalizer_->normalize(query);
+        normalizer_->normalize(query, reused);
+        EXPECT_EQ(reused.normalized_sql, fresh.normalized_sql) << query;
+        EXPECT_EQ(reused.parameters, fresh.parameters) << query;
+        EXPECT_EQ(reused.param_index, fresh.param_index) << query;
+        EXPECT_EQ(reused.normalized_sql.data(), sql_buffer) << "no reallocation for shorter statements";
+        EXPECT_EQ(reused.parameters.data(), param_buffer);
+    }
+}
+
+static void ExpectDialectCombine(SqlDialect dialect, std::string_view original_sql, std::string_view normalized_sql,
+    std::string_view output_params) {
+    SqlNormalizer normalizer(2048, false, dialect);
+    ExpectNormalize(normalizer, original_sql, normalized_sql, output_params);
+    EXPECT_EQ(normalizer.combineOutputParams(normalized_sql, ParseOutputParameter(output_params)), original_sql);
+}
+
+// Test that the service type selects the dialect
+TEST(SqlDialectTest, ServiceTypeTest) {
+    EXPECT_EQ(sql_dialect_for(SERVICE_TYPE_MYSQL_QUERY), SqlDialect::MYSQL);
+    EXPECT_EQ(sql_dialect_for(SERVICE_TYPE_PGSQL_QUERY), SqlDialect::POSTGRESQL);
+    EXPECT_EQ(sql_dialect_for(SERVICE_TYPE_ORACLE_QUERY), SqlDialect::ORACLE);
+    EXPECT_EQ(sql_dialect_for(SERVICE_TYPE_MSSQL_QUERY), SqlDialect::MSSQL);
+    EXPECT_EQ(sql_dialect_for(SERVICE_TYPE_CPP_FUNC), SqlDialect::GENERIC);
+}
+
+// Test that IN lists of bind markers or literals collapse regardless of their length
+TEST(SqlDialectTest, InListCollapseTest) {
+    SqlNormalizer mysql(2048, true, SqlDialect::MYSQL);
+    const auto two = mysql.normalize("SELECT * FROM t WHERE id IN (?, ?)");
+    const auto five = mysql.normalize("SELECT * FROM t WHERE id in(?,?,?,?,?) AND k = ?");
+    EXPECT_EQ(two.normalized_sql, "SELECT * FROM t WHERE id IN (?, ...)");
+    EXPECT_EQ(five.normalized_sql, "SELECT * FROM t WHERE id in(?, ...) AND k = ?");
+    EXPECT_EQ(two.parameters, "");
+
+    ExpectDialectCombine(SqlDialect::MYSQL, "SELECT * FROM t WHERE id IN (1, 2, 3) AND v = 4",
+        "SELECT * FROM t WHERE id IN (0#) AND v = 1#", "1,, 2,, 3,4");
+    ExpectDialectCombine(SqlDialect::POSTGRESQL, "SELECT * FROM t WHERE c IN ( 'a,b', 'it''s', -1.5 )",
+        "SELECT * FROM t WHERE c IN (0#)", " 'a,,b',, 'it''s',, -1.5 ");
+    EXPECT_EQ(mysql.normalize("SELECT * FROM t WHERE id IN (1, 2)").normalized_sql,
+              mysql.normalize("SELECT * FROM t WHERE id IN (7, 8, 9, 10)").normalized_sql);
+
+    // Left alone: a single bind marker, mixed lists, subqueries, expressions and names ending in "in".
+    ExpectNormalize(mysql, "SELECT 1 FROM t WHERE id IN (?)", "SELECT 0# FROM t WHERE id IN (?)", "1");
+    ExpectNormalize(mysql, "WHERE id IN (?, 1)", "WHERE id IN (?, 0#)", "1");
+    ExpectNormalize(mysql, "WHERE id IN (SELECT id FROM u)", "WHERE id IN (SELECT id FROM u)");
+    ExpectNormalize(mysql, "WHERE id IN (1 + 2)", "WHERE id IN (0# + 1#)", "1,2");
+    ExpectNormalize(mysql, "SELECT min(1, 2)", "SELECT min(0#, 1#)", "1,2");
+    ExpectNormalize(mysql, "WHERE id IN (1, 2", "WHERE id IN (0#, 1#", "1,2");
+
+    SqlNormalizer generic;
+    ExpectNormalize(generic, "WHERE id IN (?, ?)", "WHERE id IN (?, ?)");
+}
+
+// Test that IN lists of dialect-specific bind markers collapse to that dialect's form
+TEST(SqlDialectTest, InListCollapseBindMarkerTest) {
+    SqlNormalizer postgresql(2048, true, SqlDialect::POSTGRESQL);
+    ExpectNormalize(postgresql, "SELECT * FROM t WHERE a = $1 AND id IN ($2, $3)",
+                    "SELECT * FROM t WHERE a = $1 AND id IN ($n, ...)");
+    EXPECT_EQ(postgresql.normalize("WHERE id IN ($1,$2,$3,$4,$5)").normalized_sql, "WHERE id IN ($n, ...)");
+    ExpectNormalize(postgresql, "WHERE id IN (?, ?)", "WHERE id IN (?, ...)");
+
+    SqlNormalizer oracle(2048, true, SqlDialect::ORACLE);
+    ExpectNormalize(oracle, "SELECT * FROM t WHERE a = :1 AND id IN (:2, :3, :4)",
+                    "SELECT * FROM t WHERE a = :1 AND id IN (:n, ...)");
+    ExpectNormalize(oracle, "WHERE id IN (:id1, :id2)", "WHERE id IN (:n, ...)");
+
+    SqlNormalizer mssql(2048, true, SqlDialect::MSSQL);
+    ExpectNormalize(mssql, "WHERE id IN (@p0, @p1, @p2)", "WHERE id IN (@p, ...)");
+
+    // Left alone: mixed marker kinds, a single marker, and markers of another dialect.
+    ExpectNormalize(postgresql, "WHERE id IN ($1, ?)", "WHERE id IN ($1, ?)");
+    ExpectNormalize(oracle, "WHERE id IN (:1)", "WHERE id IN (:1)");
+    ExpectNormalize(SqlNormalizer(2048, true, SqlDialect::MYSQL), "WHERE id IN ($1, $2)", "WHERE id IN ($1, $2)");
+    ExpectNormalize(mssql, "WHERE id IN (@@ROWCOUNT, @p1)", "WHERE id IN (@@ROWCOUNT, @p1)");
+}
+
+// Test the MySQL string rules: double quotes, backslash escapes, backticks and hex literals
+TEST(SqlDialectTest, MysqlTest) {
+    ExpectDialectCombine(SqlDialect::MYSQL, "SELECT * FROM `t1` WHERE a = \"x,1\" AND b = 'it\\'s' AND c = 0x1F",
+        "SELECT * FROM `t1` WHERE a = \"0$\" AND b = '1$' AND c = 2#", "x,,1,it\\'s,0x1F");
+    ExpectDialectCombine(SqlDialect::MYSQL, "SELECT 'a\\\\', 2", "SELECT '0$', 1#", "a\\\\,2");
+    ExpectDialectCombine(SqlDialect::MYSQL, "SELECT 0b101, col0x", "SELECT 0#, col0x", "0b101");
+}
+
+// Test the PostgreSQL rules: quoted identifiers, E'...' escapes and dollar quoting
+TEST(SqlDialectTest, PostgresqlTest) {
+    ExpectDialectCombine(SqlDialect::POSTGRESQL, "SELECT \"col 1\" FROM t WHERE a = E'x\\'y' AND id = $1",
+        "SELECT \"col 1\" FROM t WHERE a = E'0$' AND id = $1", "x\\'y");
+    ExpectDialectCombine(SqlDialect::POSTGRESQL, "SELECT $$it's 1$$, $fn$a,b$fn$, 2",
+        "SELECT $$0$$$, $fn$1$$fn$, 2#", "it's 1,a,,b,2");
+    // Without E, a backslash is an ordinary character.
+    ExpectDialectCombine(SqlDialect::POSTGRESQL, "SELECT 'a\\', 1", "SELECT '0$', 1#", "a\\,1");
+}
+
+// Test the Oracle and SQL Server quoting rules
+TEST(SqlDialectTest, OracleAndMssqlTest) {
+    ExpectDialectCombine(SqlDialect::ORACLE, "SELECT q'[it's]', \"T1\".c FROM \"T1\" WHERE x = 1",
+        "SELECT q'0$', \"T1\".c FROM \"T1\" WHERE x = 1#", "[it's],1");
+    ExpectDialectCombine(SqlDialect::MSSQL, "SELECT [col 1], [a]]2] FROM t WHERE v = 0xFF AND n = N'x'",
+        "SELECT [col 1], [a]]2] FROM t WHERE v = 0# AND n = N'1$'", "0xFF,x");
+}
+
+// Benchmark normalization of an ORM-style statement of ~40KB; prints MB/s
+// and is only run with --gtest_also_run_disabled_tests
+TEST_F(SqlTest, DISABLED_NormalizeThroughputBenchmark) {
+    std::string sql = "SELECT ";
+    for (int i = 0; sql.size() < 30 * 1024; ++i) {
+        sql += "order_item" + std::to_string(i % 8) + "_.order_item_description AS order_item_desc_" +
+               std::to_string(i) + "_, ";
+    }
+    sql += "1 FROM order_item order_item0_ WHERE order_item0_.status = 'SHIPPED' AND order_item0_.id IN (";
+    for (int i = 0; sql.size() < 40 * 1024; ++i) {
+        sql += std::to_string(100000 + i) + ", ";
+    }
+    sql += "0)";
+
+    constexpr int kIterations = 200;
+    SqlNormalizer normalizer(SQL_NORMALIZE_MAX_LENGTH);
+    size_t sink = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        sink += normalizer.normalize(sql).normalized_sql.size();
+    }
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "[ BENCH    ] normalize " << sql.size() / 1024 << "KB statement: "
+              << static_cast<double>(sql.size()) * kIterations / elapsed / (1024 * 1024) << " MB/s" << std::endl;
+    EXPECT_GT(sink, 0u);
+}
+
 } // namespace pinpoint
@@ -15,11 +15,17 @@
  */
 
 #include <gtest/gtest.h>
+#include <atomic>
+#include <iostream>
 #include <memory>
 #include <thread>
 #include <chrono>
 #include <cmath>
 #include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
 
 #include "../src/stat.h"
 #include "../src/url_stat.h"
@@ -45,8 +51,17 @@ protected:
         mock_agent_service_.reset();
     }
 
+    // Spans embed their registry slot; tests keep one per made-up span id.
+    void addActiveSpan(int64_t span_id, int64_t start_time) {
+        agent_stats_->addActiveSpan(active_slots_[span_id], start_time);
+    }
+    void dropActiveSpan(int64_t span_id) {
+        agent_stats_->dropActiveSpan(active_slots_[span_id]);
+    }
+
     std::unique_ptr<MockAgentService> mock_agent_service_;
     std::unique_ptr<AgentStats> agent_stats_;
+    std::unordered_map<int64_t, ActiveRequestSlot> active_slots_;
 };
 
 // ========== Agent Stats Global Functions Tests ==========
@@ -74,6 +89,39 @@ TEST_F(StatTest, CollectAgentStatTest) {
     EXPECT_GE(snapshot.num_threads_, 0) << "Number of threads should be non-negative";
 }
 
+// Test that native process metrics are collected as per-interval deltas
+TEST_F(StatTest, ProcessMetricsTest) {
+    AgentStatsSnapshot snapshot;
+    agent_stats_->collectAgentStat(snapshot);
+
+    // Touch fresh pages so the next interval sees minor faults
+    std::vector<char> pages(16 * 1024 * 1024);
+    for (size_t i = 0; i < pages.size(); i += 4096) {
+        pages[i] = 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    agent_stats_->collectAgentStat(snapshot);
+
+    EXPECT_GE(snapshot.voluntary_context_switches_, 0);
+    EXPECT_GE(snapshot.involuntary_context_switches_, 0);
+    EXPECT_GE(snapshot.major_page_faults_, 0);
+#ifdef __linux__
+    EXPECT_GT(snapshot.minor_page_faults_, 0);
+    EXPECT_GE(snapshot.open_file_descriptors_, 3) << "stdin, stdout and stderr";
+
+    // A descriptor opened in between is counted
+    const auto before = snapshot.open_file_descriptors_;
+    const int fd = open("/dev/null", O_RDONLY);
+    ASSERT_GE(fd, 0);
+    agent_stats_->collectAgentStat(snapshot);
+    EXPECT_EQ(snapshot.open_file_descriptors_, before + 1);
+    close(fd);
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    EXPECT_GT(snapshot.malloc_in_use_bytes_, 0);
+#endif
+}
+
 TEST_F(StatTest, CollectResponseTimeTest) {
     // Test response time collection
     agent_stats_->collectResponseTime(100);
@@ -117,8 +165,8 @@ TEST_F(StatTest, ActiveSpanManagementTest) {
     int64_t start_time = 1234567890;
     
     // Add active spans directly via AgentStats
-    agent_stats_->addActiveSpan(span_id_1, start_time);
-    agent_stats_->addActiveSpan(span_id_2, start_time + 100);
+    addActiveSpan(span_id_1, start_time);
+    addActiveSpan(span_id_2, start_time + 100);
     
     AgentStatsSnapshot snapshot;
     agent_stats_->collectAgentStat(snapshot);
@@ -130,7 +178,7 @@ TEST_F(StatTest, ActiveSpanManagementTest) {
     EXPECT_GT(total_active, 0) << "Should have active spans";
     
     // Drop one span
-    agent_stats_->dropActiveSpan(span_id_1);
+    dropActiveSpan(span_id_1);
     
     agent_stats_->collectAgentStat(snapshot);
     
@@ -140,18 +188,41 @@ TEST_F(StatTest, ActiveSpanManagementTest) {
     EXPECT_LE(new_total_active, total_active) << "Should have same or fewer active spans after dropping";
 }
 
-TEST_F(StatTest, GetAgentStatSnapshotsTest) {
-    // Test that we can get the snapshots vector
-    std::vector<AgentStatsSnapshot>& snapshots = agent_stats_->getSnapshots();
-    
-    size_t initial_size = snapshots.size();
-    
-    // Collect some stats
-    AgentStatsSnapshot snapshot;
-    agent_stats_->collectAgentStat(snapshot);
-    
-    // The snapshots vector should be accessible
-    EXPECT_GE(snapshots.size(), initial_size) << "Snapshots vector should be accessible";
+TEST_F(StatTest, TakeSnapshotsBeforeWorkerTest) {
+    // Nothing is pending before the worker has collected anything
+    std::vector<AgentStatsSnapshot> snapshots;
+    EXPECT_EQ(agent_stats_->takeSnapshots(snapshots, 6), 0u);
+    EXPECT_TRUE(snapshots.empty());
+    EXPECT_EQ(agent_stats_->pendingSnapshots(), 0u);
+}
+
+// Test that the worker retains batch_count * retained_batches snapshots while nothing drains them
+TEST_F(StatTest, AgentStatsWorkerRetainsSnapshotsTest) {
+    auto& config = mock_agent_service_->mutableConfig();
+    config->stat.collect_interval = 5;
+    config->stat.batch_count = 2;
+    config->stat.retained_batches = 3;
+
+    std::thread worker_thread([this]() { agent_stats_->agentStatsWorker(); });
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (agent_stats_->droppedSnapshots() == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    mock_agent_service_->setExiting(true);
+    agent_stats_->stopAgentStatsWorker();
+    worker_thread.join();
+
+    EXPECT_GT(agent_stats_->droppedSnapshots(), 0);
+    EXPECT_EQ(agent_stats_->pendingSnapshots(), 6u);
+    EXPECT_GT(mock_agent_service_->recorded_stats_calls_, 0);
+
+    // Drained oldest first, one batch at a time
+    std::vector<AgentStatsSnapshot> batch;
+    EXPECT_EQ(agent_stats_->takeSnapshots(batch, 2), 2u);
+    EXPECT_LE(batch[0].sample_time_, batch[1].sample_time_);
+    EXPECT_EQ(agent_stats_->takeSnapshots(batch, 10), 4u);
+    EXPECT_EQ(batch.size(), 6u);
+    EXPECT_EQ(agent_stats_->pendingSnapshots(), 0u);
 }
 
 // ========== AgentStats Class Tests ==========
@@ -263,10 +334,10 @@ TEST_F(StatTest, ActiveSpanTimeDistributionTest) {
     
     // Add spans with different durations using unique IDs
     int64_t base_id = 10000;  // Use higher IDs to avoid conflicts
-    agent_stats_->addActiveSpan(base_id + 1, now_ms - 500);   // 500ms old - should be in bucket 0
-    agent_stats_->addActiveSpan(base_id + 2, now_ms - 1500);  // 1.5s old - should be in bucket 1
-    agent_stats_->addActiveSpan(base_id + 3, now_ms - 3500);  // 3.5s old - should be in bucket 2
-    agent_stats_->addActiveSpan(base_id + 4, now_ms - 6000);  // 6s old - should be in bucket 3
+    addActiveSpan(base_id + 1, now_ms - 500);   // 500ms old - should be in bucket 0
+    addActiveSpan(base_id + 2, now_ms - 1500);  // 1.5s old - should be in bucket 1
+    addActiveSpan(base_id + 3, now_ms - 3500);  // 3.5s old - should be in bucket 2
+    addActiveSpan(base_id + 4, now_ms - 6000);  // 6s old - should be in bucket 3
     
     AgentStatsSnapshot snapshot;
     agent_stats_->collectAgentStat(snapshot);
@@ -287,10 +358,10 @@ TEST_F(StatTest, ActiveSpanTimeDistributionTest) {
     EXPECT_TRUE(has_distribution) << "Spans should be distributed in time buckets";
     
     // Clean up our test spans
-    agent_stats_->dropActiveSpan(base_id + 1);
-    agent_stats_->dropActiveSpan(base_id + 2);
-    agent_stats_->dropActiveSpan(base_id + 3);
-    agent_stats_->dropActiveSpan(base_id + 4);
+    dropActiveSpan(base_id + 1);
+    dropActiveSpan(base_id + 2);
+    dropActiveSpan(base_id + 3);
+    dropActiveSpan(base_id + 4);
 }
 
 TEST_F(StatTest, StatSnapshotMemoryLayoutTest) {
@@ -453,9 +524,42 @@ TEST_F(StatTest, ResponseTimeAverageCalculationTest) {
     EXPECT_EQ(snapshot.response_time_max_, 300);
 }
 
+// Test response time percentiles merged across threads and reset per interval
+TEST_F(StatTest, ResponseTimePercentilesTest) {
+    // 98 fast requests and 2 slow ones, spread over threads so several shards are merged
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([this, t]() {
+            for (int i = 0; i < 25; i++) {
+                agent_stats_->collectResponseTime(t == 0 && i < 2 ? 3000 : 10);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    AgentStatsSnapshot snapshot;
+    agent_stats_->collectAgentStat(snapshot);
+
+    EXPECT_EQ(snapshot.response_time_p50_, 10);
+    EXPECT_EQ(snapshot.response_time_p90_, 10);
+    EXPECT_GE(snapshot.response_time_p99_, 3000);
+    EXPECT_LE(snapshot.response_time_p99_, snapshot.response_time_max_);
+
+    const auto percentiles = agent_stats_->getResponseTimePercentiles();
+    EXPECT_EQ(percentiles.p50, snapshot.response_time_p50_);
+    EXPECT_EQ(percentiles.p99, snapshot.response_time_p99_);
+
+    // The next interval starts from an empty histogram
+    agent_stats_->collectResponseTime(50);
+    agent_stats_->collectAgentStat(snapshot);
+    EXPECT_EQ(snapshot.response_time_p99_, 50);
+}
+
 // Test dropping a non-existent span ID (should not crash)
 TEST_F(StatTest, DropNonExistentSpanTest) {
-    agent_stats_->dropActiveSpan(99999);
+    dropActiveSpan(99999);
     SUCCEED();
 }
 
@@ -464,19 +568,18 @@ TEST_F(StatTest, DuplicateSpanIdTest) {
     auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::system_clock::now().time_since_epoch()).count();
 
-    agent_stats_->addActiveSpan(100, now_ms);
-    agent_stats_->addActiveSpan(100, now_ms - 5000); // Same ID, different start time
+    addActiveSpan(100, now_ms);
+    addActiveSpan(100, now_ms - 5000); // Same ID, different start time
 
     AgentStatsSnapshot snapshot;
     agent_stats_->collectAgentStat(snapshot);
 
-    // std::unordered_map::insert does NOT overwrite existing key,
-    // so only 1 entry should exist
+    // Adding an already registered slot is ignored, so only 1 entry should exist
     int total = snapshot.active_requests_[0] + snapshot.active_requests_[1] +
                 snapshot.active_requests_[2] + snapshot.active_requests_[3];
     EXPECT_EQ(total, 1) << "Duplicate spanId insert should keep original entry";
 
-    agent_stats_->dropActiveSpan(100);
+    dropActiveSpan(100);
 }
 
 // Test active request bucket boundary values
@@ -485,13 +588,13 @@ TEST_F(StatTest, ActiveRequestBucketBoundariesTest) {
         std::chrono::system_clock::now().time_since_epoch()).count();
 
     // Bucket 0: < 1000ms
-    agent_stats_->addActiveSpan(1001, now_ms - 999);
+    addActiveSpan(1001, now_ms - 999);
     // Bucket 1: >= 1000ms and < 3000ms (exactly at boundary)
-    agent_stats_->addActiveSpan(1002, now_ms - 1000);
+    addActiveSpan(1002, now_ms - 1000);
     // Bucket 2: >= 3000ms and < 5000ms (exactly at boundary)
-    agent_stats_->addActiveSpan(1003, now_ms - 3000);
+    addActiveSpan(1003, now_ms - 3000);
     // Bucket 3: >= 5000ms (exactly at boundary)
-    agent_stats_->addActiveSpan(1004, now_ms - 5000);
+    addActiveSpan(1004, now_ms - 5000);
 
     AgentStatsSnapshot snapshot;
     agent_stats_->collectAgentStat(snapshot);
@@ -506,10 +609,10 @@ TEST_F(StatTest, ActiveRequestBucketBoundariesTest) {
     // The 5000ms span should be in bucket 3
     EXPECT_GE(snapshot.active_requests_[3], 1) << "5s+ span should be in last bucket";
 
-    agent_stats_->dropActiveSpan(1001);
-    agent_stats_->dropActiveSpan(1002);
-    agent_stats_->dropActiveSpan(1003);
-    agent_stats_->dropActiveSpan(1004);
+    dropActiveSpan(1001);
+    dropActiveSpan(1002);
+    dropActiveSpan(1003);
+    dropActiveSpan(1004);
 }
 
 // Test all active spans in a single bucket
@@ -519,7 +622,7 @@ TEST_F(StatTest, AllSpansInOneBucketTest) {
 
     // All spans are very recent (< 1s)
     for (int i = 0; i < 5; i++) {
-        agent_stats_->addActiveSpan(2000 + i, now_ms - 10);
+        addActiveSpan(2000 + i, now_ms - 10);
     }
 
     AgentStatsSnapshot snapshot;
@@ -531,7 +634,7 @@ TEST_F(StatTest, AllSpansInOneBucketTest) {
     EXPECT_EQ(snapshot.active_requests_[3], 0);
 
     for (int i = 0; i < 5; i++) {
-        agent_stats_->dropActiveSpan(2000 + i);
+        dropActiveSpan(2000 + i);
     }
 }
 
@@ -539,10 +642,10 @@ TEST_F(StatTest, CollectActiveRequestsMatchesHistogramBucketsTest) {
     auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::system_clock::now().time_since_epoch()).count();
 
-    agent_stats_->addActiveSpan(3001, now_ms - 100);
-    agent_stats_->addActiveSpan(3002, now_ms - 1200);
-    agent_stats_->addActiveSpan(3003, now_ms - 3200);
-    agent_stats_->addActiveSpan(3004, now_ms - 5200);
+    addActiveSpan(3001, now_ms - 100);
+    addActiveSpan(3002, now_ms - 1200);
+    addActiveSpan(3003, now_ms - 3200);
+    addActiveSpan(3004, now_ms - 5200);
 
     int32_t active_requests[4]{};
     agent_stats_->collectActiveRequests(active_requests, now_ms);
@@ -552,10 +655,10 @@ TEST_F(StatTest, CollectActiveRequestsMatchesHistogramBucketsTest) {
     EXPECT_EQ(active_requests[2], 1);
     EXPECT_EQ(active_requests[3], 1);
 
-    agent_stats_->dropActiveSpan(3001);
-    agent_stats_->dropActiveSpan(3002);
-    agent_stats_->dropActiveSpan(3003);
-    agent_stats_->dropActiveSpan(3004);
+    dropActiveSpan(3001);
+    dropActiveSpan(3002);
+    dropActiveSpan(3003);
+    dropActiveSpan(3004);
 }
 
 // Test empty active span map
@@ -573,13 +676,13 @@ TEST_F(StatTest, AddAndDropAllSpansTest) {
     auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::system_clock::now().time_since_epoch()).count();
 
-    agent_stats_->addActiveSpan(3001, now_ms);
-    agent_stats_->addActiveSpan(3002, now_ms);
-    agent_stats_->addActiveSpan(3003, now_ms);
+    addActiveSpan(3001, now_ms);
+    addActiveSpan(3002, now_ms);
+    addActiveSpan(3003, now_ms);
 
-    agent_stats_->dropActiveSpan(3001);
-    agent_stats_->dropActiveSpan(3002);
-    agent_stats_->dropActiveSpan(3003);
+    dropActiveSpan(3001);
+    dropActiveSpan(3002);
+    dropActiveSpan(3003);
 
     AgentStatsSnapshot snapshot;
     agent_stats_->collectAgentStat(snapshot);
@@ -616,6 +719,48 @@ TEST_F(StatTest, ConcurrentSamplingCounterTest) {
     EXPECT_EQ(snapshot.num_unsample_new_, num_threads * increments_per_thread);
 }
 
+// False-sharing microbenchmark: 64 threads hammering incrSampleNew() against
+// the previous layout of one shared atomic per counter. Disabled by default
+// because it spins up 64 threads and only reports timings.
+TEST_F(StatTest, DISABLED_SamplingCounterFalseSharingBenchmarkTest) {
+    constexpr int kThreads = 64;
+    constexpr int kIncrementsPerThread = 100000;
+
+    auto run = [](auto&& increment) {
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; t++) {
+            threads.emplace_back([&go, &increment]() {
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                for (int i = 0; i < kIncrementsPerThread; i++) {
+                    increment();
+                }
+            });
+        }
+        const auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& t : threads) {
+            t.join();
+        }
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    };
+
+    std::atomic<int64_t> shared_counter{0};
+    const auto shared = run([&shared_counter]() { shared_counter++; });
+    const auto sharded = run([this]() { agent_stats_->incrSampleNew(); });
+
+    AgentStatsSnapshot snapshot;
+    agent_stats_->collectAgentStat(snapshot);
+
+    std::cout << "[ BENCH    ] " << kThreads << " threads x " << kIncrementsPerThread
+              << " increments: shared atomic=" << shared.count() << "ms"
+              << " per-thread shards=" << sharded.count() << "ms" << std::endl;
+    EXPECT_EQ(shared_counter.load(), static_cast<int64_t>(kThreads) * kIncrementsPerThread);
+    EXPECT_EQ(snapshot.num_sample_new_, static_cast<int64_t>(kThreads) * kIncrementsPerThread);
+}
+
 // Test concurrent response time collection
 TEST_F(StatTest, ConcurrentResponseTimeTest) {
     const int count_per_thread = 100;
@@ -650,10 +795,11 @@ TEST_F(StatTest, ConcurrentActiveSpanTest) {
     auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::system_clock::now().time_since_epoch()).count();
 
-    auto add_fn = [this, now_ms](int thread_index) {
-        const int base_id = 100000 + thread_index * spans_per_thread;
+    std::vector<ActiveRequestSlot> slots(num_threads * spans_per_thread);
+    auto add_fn = [this, now_ms, &slots](int thread_index) {
+        const int base = thread_index * spans_per_thread;
         for (int i = 0; i < spans_per_thread; i++) {
-            agent_stats_->addActiveSpan(base_id + i, now_ms - 10);
+            agent_stats_->addActiveSpan(slots[base + i], now_ms - 10);
         }
     };
 
@@ -673,10 +819,10 @@ TEST_F(StatTest, ConcurrentActiveSpanTest) {
     EXPECT_EQ(total, num_threads * spans_per_thread);
 
     threads.clear();
-    auto drop_fn = [this](int thread_index) {
-        const int base_id = 100000 + thread_index * spans_per_thread;
+    auto drop_fn = [this, &slots](int thread_index) {
+        const int base = thread_index * spans_per_thread;
         for (int i = 0; i < spans_per_thread; i++) {
-            agent_stats_->dropActiveSpan(base_id + i);
+            agent_stats_->dropActiveSpan(slots[base + i]);
         }
     };
 
@@ -769,13 +915,11 @@ TEST_F(StatTest, AllCountersMixedIncrementTest) {
     EXPECT_EQ(snapshot.num_skip_cont_, 60);
 }
 
-// Test getSnapshots returns modifiable reference
-TEST_F(StatTest, GetSnapshotsModifiableTest) {
-    auto& snapshots = agent_stats_->getSnapshots();
-    size_t original_size = snapshots.size();
-
-    snapshots.resize(original_size + 3);
-    EXPECT_EQ(agent_stats_->getSnapshots().size(), original_size + 3);
+// Test takeSnapshots appends to the caller's vector
+TEST_F(StatTest, TakeSnapshotsAppendsTest) {
+    std::vector<AgentStatsSnapshot> snapshots(3);
+    EXPECT_EQ(agent_stats_->takeSnapshots(snapshots, 6), 0u);
+    EXPECT_EQ(snapshots.size(), 3u);
 }
 
 // Test many active spans
@@ -785,7 +929,7 @@ TEST_F(StatTest, ManyActiveSpansTest) {
 
     const int span_count = 100;
     for (int i = 0; i < span_count; i++) {
-        agent_stats_->addActiveSpan(5000 + i, now_ms - 100);
+        addActiveSpan(5000 + i, now_ms - 100);
     }
 
     AgentStatsSnapshot snapshot;
@@ -796,7 +940,7 @@ TEST_F(StatTest, ManyActiveSpansTest) {
     EXPECT_EQ(total, span_count);
 
     for (int i = 0; i < span_count; i++) {
-        agent_stats_->dropActiveSpan(5000 + i);
+        dropActiveSpan(5000 + i);
     }
 }
 
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2020-present NAVER Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../src/timing_wheel.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace pinpoint {
+
+using Wheel = TimingWheel<int>;
+using std::chrono::milliseconds;
+
+static std::vector<int> expire_all(Wheel& wheel, Wheel::Clock::time_point now) {
+    std::vector<int> expired;
+    wheel.expire(now, [&expired](int&& item) { expired.push_back(item); });
+    return expired;
+}
+
+// Test that items expire only once their deadline has passed
+TEST(TimingWheelTest, ExpiresItemsAtDeadlineTest) {
+    Wheel wheel(milliseconds(10), 16);
+    const auto base = Wheel::Clock::now();
+
+    wheel.schedule(base + milliseconds(50), 1);
+    wheel.schedule(base + milliseconds(100), 2);
+    EXPECT_EQ(wheel.size(), 2u);
+
+    EXPECT_TRUE(expire_all(wheel, base + milliseconds(20)).empty());
+    EXPECT_EQ(expire_all(wheel, base + milliseconds(70)), std::vector<int>{1});
+    EXPECT_EQ(expire_all(wheel, base + milliseconds(120)), std::vector<int>{2});
+    EXPECT_TRUE(wheel.empty());
+}
+
+// Test that deadlines more than one revolution out wait for their round
+TEST(TimingWheelTest, DeadlinesBeyondOneRevolutionTest) {
+    Wheel wheel(milliseconds(10), 4);  // one revolution = 40ms
+    const auto base = Wheel::Clock::now();
+
+    wheel.schedule(base + milliseconds(30), 1);
+    wheel.schedule(base + milliseconds(110), 2);  // same slot as 1, three rounds later
+
+    EXPECT_EQ(expire_all(wheel, base + milliseconds(50)), std::vector<int>{1});
+    EXPECT_TRUE(expire_all(wheel, base + milliseconds(90)).empty());
+    EXPECT_EQ(expire_all(wheel, base + milliseconds(130)), std::vector<int>{2});
+}
+
+// Test that a long gap between expire() calls still delivers every due item
+TEST(TimingWheelTest, LongGapExpiresEverythingDueTest) {
+    Wheel wheel(milliseconds(10), 8);
+    const auto base = Wheel::Clock::now();
+
+    for (int i = 0; i < 100; ++i) {
+        wheel.schedule(base + milliseconds(10 * (i + 1)), i);
+    }
+    auto expired = expire_all(wheel, base + milliseconds(10'000));
+    std::sort(expired.begin(), expired.end());
+    ASSERT_EQ(expired.size(), 100u);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(expired[i], i);
+    }
+    EXPECT_TRUE(wheel.empty());
+}
+
+// Test that next_deadline() reports the earliest held deadline, rounded up to a tick
+TEST(TimingWheelTest, NextDeadlineTest) {
+    Wheel wheel(milliseconds(10), 4);
+    EXPECT_EQ(wheel.next_deadline(), Wheel::Clock::time_point::max());
+
+    const auto base = Wheel::Clock::now();
+    wheel.schedule(base + milliseconds(200), 1);  // beyond one revolution
+    const auto far = wheel.next_deadline();
+    EXPECT_GE(far, base + milliseconds(200));
+    EXPECT_LT(far, base + milliseconds(210));
+
+    wheel.schedule(base + milliseconds(25), 2);
+    const auto near = wheel.next_deadline();
+    EXPECT_GE(near, base + milliseconds(25));
+    EXPECT_LT(near, base + milliseconds(35));
+
+    expire_all(wheel, near);
+    EXPECT_EQ(wheel.next_deadline(), far);
+}
+
+// Test that past deadlines expire on the next call and move-only items are supported
+TEST(TimingWheelTest, PastDeadlineAndMoveOnlyItemsTest) {
+    TimingWheel<std::unique_ptr<int>> wheel(milliseconds(10), 8);
+    const auto now = TimingWheel<std::unique_ptr<int>>::Clock::now();
+
+    wheel.schedule(now - milliseconds(100), std::make_unique<int>(7));
+
+    int value = 0;
+    wheel.expire(now + milliseconds(10), [&value](std::unique_ptr<int>&& item) { value = *item; });
+    EXPECT_EQ(value, 7);
+    EXPECT_TRUE(wheel.empty());
+}
+
+}  // namespace pinpoint
@@ -385,6 +385,26 @@ TEST_F(TracerCApiTest, CreateAgentWithTypeAndServerMetadata) {
     pt_agent_destroy(agent);
 }
 
+TEST_F(TracerCApiTest, RegisterMetadata) {
+    const pt_api_metadata_t apis[] = {
+        {"c-api-operation", PT_API_TYPE_WEB_REQUEST},
+        {nullptr, PT_API_TYPE_DEFAULT},
+        {"c-api-event", PT_API_TYPE_DEFAULT},
+    };
+    const pt_sql_metadata_t sqls[] = {
+        {"SELECT * FROM t WHERE id = 1", PT_SERVICE_TYPE_MYSQL_QUERY},
+        {nullptr, PT_SERVICE_TYPE_MYSQL_QUERY},
+    };
+    const char* errors[] = {"CApiError"};
+
+    EXPECT_NO_FATAL_FAILURE(pt_agent_register_metadata(agent_, apis, 3, sqls, 2, errors, 1));
+    EXPECT_NO_FATAL_FAILURE(pt_agent_register_metadata(agent_, nullptr, 0, nullptr, 0, nullptr, 0));
+    EXPECT_NO_FATAL_FAILURE(pt_agent_register_metadata(agent_, apis, -1, sqls, -1, errors, -1));
+
+    const int32_t id = mock_agent_->cacheApi("c-api-operation", PT_API_TYPE_WEB_REQUEST);
+    EXPECT_LT(id, mock_agent_->cacheApi("c-api-unregistered", PT_API_TYPE_WEB_REQUEST));
+}
+
 // ============================================================================
 // 3. Null-handle safety — no crashes on NULL inputs
 // ============================================================================
@@ -396,6 +416,7 @@ TEST(TracerCNullSafetyTest, NullAgentCalls) {
     EXPECT_EQ(pt_agent_new_span(nullptr, "op", "/rpc"), nullptr);
     EXPECT_EQ(pt_agent_new_span_with_reader(nullptr, "op", "/rpc", nullptr), nullptr);
     EXPECT_EQ(pt_agent_new_span_with_method(nullptr, "op", "/rpc", "GET", nullptr), nullptr);
+    EXPECT_NO_FATAL_FAILURE(pt_agent_register_metadata(nullptr, nullptr, 0, nullptr, 0, nullptr, 0));
 }
 
 TEST(TracerCNullSafetyTest, NullSpanCalls) {
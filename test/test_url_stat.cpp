@@ -15,9 +15,11 @@
  */
 
 #include <gtest/gtest.h>
+#include <atomic>
 #include <memory>
 #include <thread>
 #include <chrono>
+#include <vector>
 
 #include "../src/url_stat.h"
 #include "../src/config.h"
@@ -160,10 +162,10 @@ TEST_F(UrlStatTest, EachUrlStatHistogramModificationTest) {
 // ========== UrlKey Tests ==========
 
 TEST_F(UrlStatTest, UrlKeyComparisonTest) {
-    UrlKey key1{"/api/users", 1000};
-    UrlKey key2{"/api/users", 1000};
-    UrlKey key3{"/api/users", 2000};
-    UrlKey key4{"/api/posts", 1000};
+    UrlKey key1{1, 1000};
+    UrlKey key2{1, 1000};
+    UrlKey key3{1, 2000};
+    UrlKey key4{0, 1000};
     
     // Same keys should not be less than each other
     EXPECT_FALSE(key1 < key2) << "Identical keys should not be less than each other";
@@ -174,8 +176,111 @@ TEST_F(UrlStatTest, UrlKeyComparisonTest) {
     EXPECT_FALSE(key3 < key1) << "Same URL with later tick should not be less";
     
     // Different URLs
-    EXPECT_TRUE(key4 < key1) << "Alphabetically earlier URL should be less";
-    EXPECT_FALSE(key1 < key4) << "Alphabetically later URL should not be less";
+    EXPECT_TRUE(key4 < key1) << "Earlier interned URL should be less";
+    EXPECT_FALSE(key1 < key4) << "Later interned URL should not be less";
+    EXPECT_TRUE(key1 == key2);
+    EXPECT_FALSE(key1 == key3);
+    EXPECT_EQ(UrlKeyHash{}(key1), UrlKeyHash{}(key2));
+}
+
+// ========== UrlTemplateTable Tests ==========
+
+TEST_F(UrlStatTest, UrlTemplateTableInternTest) {
+    UrlTemplateTable table;
+    const auto users = table.intern("/api/users");
+    const auto posts = table.intern("GET /api/posts");
+
+    EXPECT_EQ(users, 0u) << "Ids should be assigned densely from 0";
+    EXPECT_EQ(posts, 1u);
+    EXPECT_EQ(table.intern(std::string("/api/users")), users) << "Interning again should return the same id";
+    EXPECT_EQ(table.size(), 2u);
+
+    const auto& url = table.url(users);
+    for (int i = 0; i < 1000; i++) {
+        table.intern("/api/" + std::to_string(i));
+    }
+    EXPECT_EQ(&url, &table.url(users)) << "Interned strings should never move";
+    EXPECT_EQ(table.url(posts), "GET /api/posts");
+}
+
+// Test that samples of one pattern share a single interned id
+TEST_F(UrlStatTest, SnapshotInternedKeyTest) {
+    UrlStatSnapshot snapshot;
+    Config config;
+    config.http.url_stat.enable_trim_path = true;
+    config.http.url_stat.trim_path_depth = 2;
+    auto& tick_clock = mock_agent_service_->getUrlStats().getTickClock();
+    const auto now = std::chrono::system_clock::now();
+
+    // Distinct raw paths that trim to the same template share its id
+    for (const auto* path : {"/api/users/1", "/api/users/2", "/api/users/1"}) {
+        UrlStatEntry stat(path, "GET", 200);
+        stat.elapsed_ = 10;
+        stat.end_time_ = now;
+        snapshot.add(&stat, config, tick_clock);
+    }
+
+    const auto& stats = snapshot.getEachStats();
+    ASSERT_EQ(stats.size(), 1u);
+    const auto& [key, each] = *stats.begin();
+    EXPECT_EQ(snapshot.url(key), "/api/users/*");
+    EXPECT_EQ(each->getTotalHistogram().total(), 30);
+}
+
+// Test merging snapshots that intern into different tables
+TEST_F(UrlStatTest, SnapshotMergeAcrossTablesTest) {
+    Config config;
+    TickClock tick_clock(30);
+    UrlStatSnapshot a;
+    UrlStatSnapshot b;
+    const auto now = std::chrono::system_clock::now();
+
+    UrlStatEntry users("/users", "GET", 200);
+    users.elapsed_ = 10;
+    users.end_time_ = now;
+    UrlStatEntry posts("/posts", "GET", 200);
+    posts.elapsed_ = 30;
+    posts.end_time_ = now;
+    a.add(&users, config, tick_clock);
+    b.add(&posts, config, tick_clock);  // id 0 in b's table as well
+    b.add(&users, config, tick_clock);
+
+    a.merge(b, 10);
+    ASSERT_EQ(a.getEachStats().size(), 2u);
+    std::unordered_map<std::string, int64_t> totals;
+    for (const auto& [key, each] : a.getEachStats()) {
+        totals[a.url(key)] = each->getTotalHistogram().total();
+    }
+    EXPECT_EQ(totals["/users"], 20) << "Same URL from another table should be summed";
+    EXPECT_EQ(totals["/posts"], 30);
+}
+
+// Test that takeSnapshot resolves URLs after the interning table is replaced
+TEST_F(UrlStatTest, TemplateTableResetTest) {
+    mock_agent_service_->mutableConfig()->http.url_stat.limit = 1;
+    mock_agent_service_->mutableConfig()->http.url_stat.enable_trim_path = false;
+    UrlStats url_stats(mock_agent_service_.get());
+    const auto now = std::chrono::system_clock::now();
+
+    auto record = [&url_stats, now](const std::string& path) {
+        UrlStatEntry stat(path, "GET", 200);
+        stat.elapsed_ = 10;
+        stat.end_time_ = now;
+        url_stats.recordUrlStat(stat);
+    };
+    // Only the first URL fits the limit, but every URL is interned
+    for (int i = 0; i < 8; i++) {
+        record("/api/" + std::to_string(i));
+    }
+    auto first = url_stats.takeSnapshot();
+    record("/api/again");
+    auto second = url_stats.takeSnapshot();
+
+    ASSERT_EQ(first->getEachStats().size(), 1u);
+    EXPECT_EQ(first->url(first->getEachStats().begin()->first), "/api/0");
+    ASSERT_EQ(second->getEachStats().size(), 1u);
+    EXPECT_EQ(second->url(second->getEachStats().begin()->first), "/api/again");
+    EXPECT_EQ(second->getEachStats().begin()->first.id_, 0u) << "A replaced table should start from id 0";
 }
 
 // ========== UrlStat Tests ==========
@@ -222,44 +327,29 @@ TEST_F(UrlStatTest, UrlStatsConstructorTest) {
     SUCCEED() << "UrlStats constructor should not crash";
 }
 
-TEST_F(UrlStatTest, UrlStatsEnqueueTest) {
+TEST_F(UrlStatTest, UrlStatsRecordTest) {
     UrlStats url_stats(mock_agent_service_.get());
     
-    auto stat = std::make_unique<UrlStatEntry>("/api/test", "POST", 201);
-    url_stats.enqueueUrlStats(std::move(stat));
+    UrlStatEntry stat("/api/test", "POST", 201);
+    stat.end_time_ = std::chrono::system_clock::now();
+    url_stats.recordUrlStat(stat);
     
-    SUCCEED() << "Enqueue should not crash";
+    EXPECT_EQ(url_stats.takeSnapshot()->getEachStats().size(), 1u) << "Recorded stat should be aggregated immediately";
 }
 
-TEST_F(UrlStatTest, UrlStatsEnqueueWithDisabledConfigTest) {
+TEST_F(UrlStatTest, UrlStatsRecordWithDisabledConfigTest) {
     mock_agent_service_->mutableConfig()->http.url_stat.enable = false;
     UrlStats url_stats(mock_agent_service_.get());
     
-    auto stat = std::make_unique<UrlStatEntry>("/api/test", "POST", 201);
-    url_stats.enqueueUrlStats(std::move(stat));
+    UrlStatEntry stat("/api/test", "POST", 201);
+    url_stats.recordUrlStat(stat);
     
-    SUCCEED() << "Enqueue with disabled config should not crash";
+    EXPECT_TRUE(url_stats.takeSnapshot()->getEachStats().empty()) << "Disabled URL stats should record nothing";
 }
 
 TEST_F(UrlStatTest, UrlStatsWorkerStartStopTest) {
     UrlStats url_stats(mock_agent_service_.get());
     
-    // Test add worker
-    std::thread add_worker([&url_stats]() {
-        url_stats.addUrlStatsWorker();
-    });
-    
-    // Give worker time to start
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    
-    // Signal to stop and wait
-    mock_agent_service_->setExiting(true);
-    url_stats.stopAddUrlStatsWorker();
-    add_worker.join();
-    
-    // Reset for send worker test
-    mock_agent_service_->setExiting(false);
-    
     // Test send worker
     std::thread send_worker([&url_stats]() {
         url_stats.sendUrlStatsWorker();
@@ -280,16 +370,11 @@ TEST_F(UrlStatTest, UrlStatsWithExitingAgentTest) {
     mock_agent_service_->setExiting(true);
     UrlStats url_stats(mock_agent_service_.get());
     
-    // Test that workers exit quickly when agent is exiting
-    std::thread add_worker([&url_stats]() {
-        url_stats.addUrlStatsWorker();
-    });
-    
+    // Test that the send worker exits quickly when agent is exiting
     std::thread send_worker([&url_stats]() {
         url_stats.sendUrlStatsWorker();
     });
     
-    add_worker.join();
     send_worker.join();
     
     SUCCEED() << "Workers should exit quickly when agent is exiting";
@@ -359,65 +444,97 @@ TEST_F(UrlStatTest, TrimUrlPathDepthTest) {
 TEST_F(UrlStatTest, FullWorkflowTest) {
     UrlStats url_stats(mock_agent_service_.get());
     
-    // Create and enqueue multiple stats
-    auto stat1 = std::make_unique<UrlStatEntry>("/api/users", "GET", 200);
-    stat1->elapsed_ = 100;
-    auto stat2 = std::make_unique<UrlStatEntry>("/api/posts", "POST", 201);
-    stat2->elapsed_ = 200;
-    auto stat3 = std::make_unique<UrlStatEntry>("/api/users", "GET", 500);
-    stat3->elapsed_ = 300;
-    
-    url_stats.enqueueUrlStats(std::move(stat1));
-    url_stats.enqueueUrlStats(std::move(stat2));
-    url_stats.enqueueUrlStats(std::move(stat3));
-    
-    // Start add worker
-    std::thread add_worker([&url_stats]() {
-        url_stats.addUrlStatsWorker();
-    });
-    
-    // Let it process for a bit
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // Record multiple stats within one tick
+    const auto end_time = std::chrono::system_clock::now();
+    UrlStatEntry stat1("/api/users", "GET", 200);
+    stat1.elapsed_ = 100;
+    stat1.end_time_ = end_time;
+    UrlStatEntry stat2("/api/posts", "POST", 201);
+    stat2.elapsed_ = 200;
+    stat2.end_time_ = end_time;
+    UrlStatEntry stat3("/api/users", "GET", 500);
+    stat3.elapsed_ = 300;
+    stat3.end_time_ = end_time;
+    stat3.failed_ = true;
     
-    // Stop worker
-    mock_agent_service_->setExiting(true);
-    url_stats.stopAddUrlStatsWorker();
-    add_worker.join();
+    url_stats.recordUrlStat(stat1);
+    url_stats.recordUrlStat(stat2);
+    url_stats.recordUrlStat(stat3);
     
     // Take snapshot and verify
     auto snapshot = url_stats.takeSnapshot();
     auto& stats = snapshot->getEachStats();
 
-    EXPECT_FALSE(stats.empty()) << "Snapshot should contain processed stats";
-    
-    SUCCEED() << "Full workflow completed successfully";
+    ASSERT_EQ(stats.size(), 2u) << "Snapshot should contain one entry per URL";
+    int64_t total = 0, failed = 0;
+    for (const auto& [key, each] : stats) {
+        total += each->getTotalHistogram().total();
+        failed += each->getFailHistogram().total();
+    }
+    EXPECT_EQ(total, 600);
+    EXPECT_EQ(failed, 300);
 }
 
-TEST_F(UrlStatTest, ConcurrentEnqueueTest) {
+TEST_F(UrlStatTest, ConcurrentRecordTest) {
     UrlStats url_stats(mock_agent_service_.get());
     
     const int num_threads = 5;
-    const int stats_per_thread = 10;
+    const int stats_per_thread = 1000;
+    const auto end_time = std::chrono::system_clock::now();
     
     std::vector<std::thread> threads;
+    std::atomic<bool> done{false};
     
-    // Start multiple threads enqueueing stats
+    // Threads record the same URL set into their own partials while
+    // snapshots are taken concurrently
     for (int t = 0; t < num_threads; t++) {
-        threads.emplace_back([&url_stats, t]() {
+        threads.emplace_back([&url_stats, end_time]() {
             for (int i = 0; i < stats_per_thread; i++) {
-                auto stat = std::make_unique<UrlStatEntry>("/api/test" + std::to_string(t) + "/" + std::to_string(i), "GET", 200);
-                stat->elapsed_ = 100 + i;
-                url_stats.enqueueUrlStats(std::move(stat));
+                UrlStatEntry stat("/api/test" + std::to_string(i % 10), "GET", 200);
+                stat.elapsed_ = 1;
+                stat.end_time_ = end_time;
+                url_stats.recordUrlStat(stat);
             }
         });
     }
     
-    // Wait for all threads to complete
+    int32_t count = 0;
+    auto drain = [&url_stats, &count]() {
+        auto snapshot = url_stats.takeSnapshot();
+        for (const auto& [key, each] : snapshot->getEachStats()) {
+            count += static_cast<int32_t>(each->getTotalHistogram().total());
+        }
+    };
+    std::thread taker([&drain, &done]() {
+        while (!done.load()) {
+            drain();
+            std::this_thread::yield();
+        }
+    });
+    
     for (auto& thread : threads) {
         thread.join();
     }
+    done.store(true);
+    taker.join();
+    drain();
     
-    SUCCEED() << "Concurrent enqueue should not crash";
+    EXPECT_EQ(count, num_threads * stats_per_thread) << "No sample may be lost across merges";
+}
+
+// Test that partials of exited threads are merged before they are dropped
+TEST_F(UrlStatTest, ExitedThreadPartialTest) {
+    UrlStats url_stats(mock_agent_service_.get());
+    std::thread recorder([&url_stats]() {
+        UrlStatEntry stat("/api/exited", "GET", 200);
+        stat.elapsed_ = 10;
+        stat.end_time_ = std::chrono::system_clock::now();
+        url_stats.recordUrlStat(stat);
+    });
+    recorder.join();
+
+    EXPECT_EQ(url_stats.takeSnapshot()->getEachStats().size(), 1u);
+    EXPECT_TRUE(url_stats.takeSnapshot()->getEachStats().empty());
 }
 
 TEST_F(UrlStatTest, SendWorkerRecordsStatsTest) {
@@ -514,6 +631,118 @@ TEST_F(UrlStatTest, HistogramOutOfBoundsIndexTest) {
     EXPECT_EQ(histogram.histogram(100), 0);
 }
 
+// ========== UrlStatBucketSchema Tests ==========
+
+// Test that configured bounds are merged with the collector thresholds
+TEST_F(UrlStatTest, BucketSchemaMergesCollectorBoundsTest) {
+    const auto& collector = *UrlStatBucketSchema::collector();
+    EXPECT_EQ(collector.size(), static_cast<size_t>(URL_STATS_BUCKET_SIZE));
+    EXPECT_FALSE(collector.highResolution());
+
+    // Unsorted, duplicate and non-positive bounds are tolerated
+    UrlStatBucketSchema schema({10, 1, 300, 10, -5, 2000});
+    ASSERT_TRUE(schema.highResolution());
+    EXPECT_EQ(schema.size(), 11u) << "1, 10 and 2000 split the collector buckets; 300 is already one";
+
+    EXPECT_EQ(schema.bucket(0), 0u);
+    EXPECT_EQ(schema.bucket(1), 1u);
+    EXPECT_EQ(schema.bucket(9), 1u);
+    EXPECT_EQ(schema.bucket(10), 2u);
+    EXPECT_EQ(schema.bucket(99), 2u);
+    EXPECT_EQ(schema.bucket(100), 3u);
+    EXPECT_EQ(schema.bucket(100000), 10u);
+    EXPECT_EQ(schema.upper(1), 9);
+
+    // Buckets below 100ms all belong to collector bucket 0
+    EXPECT_EQ(schema.collectorBucket(0), 0);
+    EXPECT_EQ(schema.collectorBucket(2), 0);
+    EXPECT_EQ(schema.collectorBucket(3), 1);
+    EXPECT_EQ(schema.collectorBucket(6), 4) << "1000-1999ms";
+    EXPECT_EQ(schema.collectorBucket(7), 4) << "2000-2999ms";
+    EXPECT_EQ(schema.collectorBucket(10), 7);
+}
+
+// Test that a high-resolution histogram still fills the collector buckets
+TEST_F(UrlStatTest, HighResolutionHistogramDownsampleTest) {
+    const auto schema = std::make_shared<const UrlStatBucketSchema>(std::vector<int>{1, 2, 5, 10, 20, 50});
+    UrlStatHistogram fine(schema);
+    UrlStatHistogram coarse;
+    for (const auto elapsed : {0, 1, 3, 7, 15, 40, 80, 150, 700, 2500, 9000}) {
+        fine.add(elapsed);
+        coarse.add(elapsed);
+    }
+
+    for (int i = 0; i < URL_STATS_BUCKET_SIZE; i++) {
+        EXPECT_EQ(fine.histogram(i), coarse.histogram(i)) << "Collector bucket " << i;
+    }
+    EXPECT_EQ(fine.total(), coarse.total());
+    EXPECT_EQ(fine.max(), coarse.max());
+}
+
+// Test percentiles of sub-100ms samples resolved by fine buckets
+TEST_F(UrlStatTest, HistogramPercentileTest) {
+    const auto schema = std::make_shared<const UrlStatBucketSchema>(std::vector<int>{1, 2, 5, 10, 20, 50});
+    UrlStatHistogram fine(schema);
+    UrlStatHistogram coarse;
+    EXPECT_EQ(fine.percentile(99), 0) << "Empty histogram";
+
+    // 90 samples at 1ms, 9 at 7ms, 1 at 30ms
+    for (int i = 0; i < 100; i++) {
+        const auto elapsed = i < 90 ? 1 : (i < 99 ? 7 : 30);
+        fine.add(elapsed);
+        coarse.add(elapsed);
+    }
+
+    EXPECT_EQ(fine.percentile(50), 1) << "Upper bound of [1, 2)";
+    EXPECT_EQ(fine.percentile(95), 9) << "Upper bound of [5, 10)";
+    EXPECT_EQ(fine.percentile(99), 9);
+    EXPECT_EQ(fine.percentile(100), 30) << "Capped at the largest sample";
+    EXPECT_EQ(coarse.percentile(50), 30) << "Collector buckets only resolve to 100ms, capped at max";
+}
+
+// Test merging histograms with matching and differing schemas
+TEST_F(UrlStatTest, HighResolutionHistogramMergeTest) {
+    const auto schema = std::make_shared<const UrlStatBucketSchema>(std::vector<int>{1, 2, 5});
+    const auto same = std::make_shared<const UrlStatBucketSchema>(std::vector<int>{5, 2, 1});
+    UrlStatHistogram a(schema);
+    UrlStatHistogram b(same);
+    a.add(0);
+    b.add(3);
+    b.add(3);
+
+    a.merge(b);
+    EXPECT_EQ(a.histogram(0), 3);
+    EXPECT_EQ(a.percentile(50), 3) << "Fine counts merge when the bounds agree; [2, 5) is capped at max";
+
+    UrlStatHistogram coarse;
+    coarse.add(300);
+    a.merge(coarse);
+    EXPECT_EQ(a.histogram(2), 1);
+    EXPECT_EQ(a.percentile(50), 99) << "Falls back to collector buckets once fine counts are incomplete";
+}
+
+// Test that snapshots build the schema from the configured bounds
+TEST_F(UrlStatTest, SnapshotPercentileBoundsTest) {
+    UrlStatSnapshot snapshot;
+    Config config;
+    config.http.url_stat.percentile_bounds = {2, 4, 8};
+    auto& tick_clock = mock_agent_service_->getUrlStats().getTickClock();
+
+    UrlStatEntry stat("/api/fast", "GET", 200);
+    stat.end_time_ = std::chrono::system_clock::now();
+    for (const auto elapsed : {1, 1, 3, 6}) {
+        stat.elapsed_ = elapsed;
+        snapshot.add(&stat, config, tick_clock);
+    }
+
+    ASSERT_EQ(snapshot.getEachStats().size(), 1u);
+    auto& histogram = snapshot.getEachStats().begin()->second->getTotalHistogram();
+    EXPECT_EQ(histogram.histogram(0), 4);
+    EXPECT_EQ(histogram.percentile(50), 1);
+    EXPECT_EQ(histogram.percentile(75), 3);
+    EXPECT_EQ(histogram.percentile(99), 6);
+}
+
 // Test histogram with zero elapsed
 TEST_F(UrlStatTest, HistogramZeroElapsedTest) {
     UrlStatHistogram histogram;
@@ -782,8 +1011,9 @@ TEST_F(UrlStatTest, SnapshotMethodPrefixTest) {
 
     // Verify keys contain method prefix
     for (auto& [key, _] : stats) {
-        EXPECT_TRUE(key.url_.find("GET ") == 0 || key.url_.find("POST ") == 0)
-            << "Key URL should be prefixed with method: " << key.url_;
+        const auto& url = snapshot.url(key);
+        EXPECT_TRUE(url.find("GET ") == 0 || url.find("POST ") == 0)
+            << "Key URL should be prefixed with method: " << url;
     }
 }
 
@@ -883,20 +1113,22 @@ TEST_F(UrlStatTest, TickClockFarTimeDifferentTickTest) {
 
 // ========== Additional UrlKey Tests ==========
 
-// Test UrlKey with empty URL
+// Test that an empty URL is interned like any other
 TEST_F(UrlStatTest, UrlKeyEmptyUrlTest) {
-    UrlKey key1{"", 1000};
-    UrlKey key2{"/api", 1000};
+    UrlTemplateTable table;
+    UrlKey key1{table.intern(""), 1000};
+    UrlKey key2{table.intern("/api"), 1000};
 
-    EXPECT_TRUE(key1 < key2) << "Empty URL should be less than non-empty";
+    EXPECT_TRUE(key1 < key2) << "First interned URL should be less";
     EXPECT_FALSE(key2 < key1);
+    EXPECT_EQ(table.url(key1.id_), "");
 }
 
 // Test UrlKey with same URL different ticks
 TEST_F(UrlStatTest, UrlKeySameUrlDifferentTickTest) {
-    UrlKey key1{"/api", 1000};
-    UrlKey key2{"/api", 2000};
-    UrlKey key3{"/api", 1000};
+    UrlKey key1{0, 1000};
+    UrlKey key2{0, 2000};
+    UrlKey key3{0, 1000};
 
     EXPECT_TRUE(key1 < key2);
     EXPECT_FALSE(key2 < key1);
@@ -942,27 +1174,300 @@ TEST_F(UrlStatTest, TakeSnapshotReplacesWithFreshTest) {
     EXPECT_TRUE(snapshot2->getEachStats().empty()) << "Fresh snapshot after take should be empty";
 }
 
-// Test enqueueUrlStats queue overflow behavior
-TEST_F(UrlStatTest, EnqueueOverflowTest) {
+// Test that the URL limit also applies when thread partials are merged
+TEST_F(UrlStatTest, MergeLimitTest) {
+    mock_agent_service_->mutableConfig()->http.url_stat.limit = 3;
     UrlStats url_stats(mock_agent_service_.get());
+    const auto end_time = std::chrono::system_clock::now();
+
+    auto record = [&url_stats, end_time](int first) {
+        for (int i = first; i < first + 3; i++) {
+            UrlStatEntry stat("/api/test" + std::to_string(i), "GET", 200);
+            stat.elapsed_ = 100;
+            stat.end_time_ = end_time;
+            url_stats.recordUrlStat(stat);
+        }
+    };
+    record(0);
+    std::thread other(record, 1);
+    other.join();
+
+    // Keys 0-2 fit; the other thread's key 3 is dropped, its keys 1-2 are summed
+    const auto snapshot = url_stats.takeSnapshot();
+    EXPECT_EQ(snapshot->getEachStats().size(), 3u);
+    int64_t total = 0;
+    for (const auto& [key, each] : snapshot->getEachStats()) {
+        total += each->getTotalHistogram().total();
+    }
+    EXPECT_EQ(total, 500);
+}
+
+// ========== Heavy-Hitter Tests ==========
+
+namespace {
+    int32_t sample_count(UrlStatHistogram& histogram) {
+        int32_t count = 0;
+        for (int i = 0; i < URL_STATS_BUCKET_SIZE; i++) {
+            count += histogram.histogram(i);
+        }
+        return count;
+    }
+}
 
-    // Queue size is set to 100 in mock config
-    for (int i = 0; i < 150; i++) {
-        auto stat = std::make_unique<UrlStatEntry>("/api/test" + std::to_string(i), "GET", 200);
-        stat->elapsed_ = 100;
-        url_stats.enqueueUrlStats(std::move(stat));
+// Test that count-min estimates never undercount
+TEST_F(UrlStatTest, UrlCountMinSketchTest) {
+    UrlCountMinSketch sketch(16);
+    for (uint32_t id = 0; id < 1000; id++) {
+        sketch.increment(UrlKey{id, 30000});
     }
+    uint32_t estimate = 0;
+    for (int i = 0; i < 20; i++) {
+        estimate = sketch.increment(UrlKey{7, 60000});
+    }
+    EXPECT_GE(estimate, 20u);
+    EXPECT_GE(sketch.increment(UrlKey{3, 30000}), 2u);
 
-    // Should not crash; excess entries are silently dropped
-    SUCCEED();
+    sketch.clear();
+    EXPECT_EQ(sketch.increment(UrlKey{7, 60000}), 1u);
 }
 
-// Test enqueueUrlStats with null pointer (should not crash)
-TEST_F(UrlStatTest, EnqueueNullptrTest) {
+// Test that a burst of unique URLs is folded into "other" instead of evicting real endpoints
+TEST_F(UrlStatTest, HeavyHitterKeepsBusiestUrlsTest) {
+    UrlStatSnapshot snapshot;
+    Config config;
+    config.http.url_stat.limit = 3;
+    config.http.url_stat.enable_trim_path = false;
+    config.http.url_stat.heavy_hitter = true;
+    auto& tick_clock = mock_agent_service_->getUrlStats().getTickClock();
+    const auto now = std::chrono::system_clock::now();
+
+    auto record = [&](const std::string& path, int times) {
+        UrlStatEntry stat(path, "GET", 200);
+        stat.elapsed_ = 10;
+        stat.end_time_ = now;
+        for (int i = 0; i < times; i++) {
+            snapshot.add(&stat, config, tick_clock);
+        }
+    };
+    record("/scan/warmup", 1);
+    record("/api/users", 50);
+    record("/api/orders", 40);
+    for (int i = 0; i < 200; i++) {
+        record("/scan/" + std::to_string(i), 1);
+    }
+    record("/api/users", 5);
+
+    std::unordered_map<std::string, int32_t> counts;
+    for (const auto& [key, each] : snapshot.getEachStats()) {
+        counts[snapshot.url(key)] = sample_count(each->getTotalHistogram());
+    }
+    EXPECT_EQ(counts.size(), 4u) << "Limit URLs plus the other bucket";
+    EXPECT_EQ(counts["/api/users"], 55);
+    EXPECT_EQ(counts["/api/orders"], 40);
+    ASSERT_EQ(counts.count(std::string(UrlStatSnapshot::kOtherUrl)), 1u);
+
+    int32_t total = 0;
+    for (const auto& [url, count] : counts) {
+        total += count;
+    }
+    EXPECT_EQ(total, 1 + 55 + 40 + 200) << "Folding must not lose samples";
+}
+
+// Test that without heavy-hitter mode new URLs beyond the limit are still dropped
+TEST_F(UrlStatTest, HeavyHitterDisabledDropsNewUrlsTest) {
+    UrlStatSnapshot snapshot;
+    Config config;
+    config.http.url_stat.limit = 1;
+    auto& tick_clock = mock_agent_service_->getUrlStats().getTickClock();
+
+    UrlStatEntry first("/first", "GET", 200);
+    first.end_time_ = std::chrono::system_clock::now();
+    UrlStatEntry second("/second", "GET", 200);
+    second.end_time_ = first.end_time_;
+    snapshot.add(&first, config, tick_clock);
+    snapshot.add(&second, config, tick_clock);
+
+    ASSERT_EQ(snapshot.getEachStats().size(), 1u);
+    EXPECT_EQ(snapshot.url(snapshot.getEachStats().begin()->first), "/first");
+}
+
+// Test that takeSnapshot picks the top URLs over the traffic of every thread
+TEST_F(UrlStatTest, HeavyHitterAcrossThreadsTest) {
+    mock_agent_service_->mutableConfig()->http.url_stat.limit = 2;
+    mock_agent_service_->mutableConfig()->http.url_stat.enable_trim_path = false;
+    mock_agent_service_->mutableConfig()->http.url_stat.heavy_hitter = true;
     UrlStats url_stats(mock_agent_service_.get());
+    const auto now = std::chrono::system_clock::now();
 
-    url_stats.enqueueUrlStats(nullptr);
-    SUCCEED();
+    auto record = [&url_stats, now](const std::string& path, int times) {
+        UrlStatEntry stat(path, "GET", 200);
+        stat.elapsed_ = 10;
+        stat.end_time_ = now;
+        for (int i = 0; i < times; i++) {
+            url_stats.recordUrlStat(stat);
+        }
+    };
+    // Each thread alone would keep its own two URLs
+    std::thread first([&record]() { record("/a", 10); record("/b", 3); });
+    std::thread second([&record]() { record("/c", 8); record("/b", 6); });
+    first.join();
+    second.join();
+
+    const auto snapshot = url_stats.takeSnapshot();
+    std::unordered_map<std::string, int32_t> counts;
+    for (const auto& [key, each] : snapshot->getEachStats()) {
+        counts[snapshot->url(key)] = sample_count(each->getTotalHistogram());
+    }
+    EXPECT_EQ(counts["/a"], 10);
+    EXPECT_EQ(counts["/b"], 9) << "Combined traffic ranks /b above /c";
+    EXPECT_EQ(counts.count("/c"), 0u);
+    EXPECT_EQ(counts[std::string(UrlStatSnapshot::kOtherUrl)], 8);
+}
+
+// Test that rolling fine ticks up to 30s ticks preserves the totals of each URL
+TEST_F(UrlStatTest, RollUpPreservesTotalsTest) {
+    Config config;
+    config.http.url_stat.enable_trim_path = false;
+    TickClock tick_clock(1);
+    UrlStatSnapshot snapshot;
+    const auto base = std::chrono::system_clock::time_point(std::chrono::milliseconds(1'700'000'025'000));
+
+    int64_t expected_total = 0;
+    for (int i = 0; i < 20; i++) {
+        UrlStatEntry stat(i % 2 ? "/a" : "/b", "GET", i % 5 ? 200 : 500);
+        stat.end_time_ = base + std::chrono::milliseconds(i * 1500);  // crosses the 30s boundary at 1'700'000'040'000
+        stat.elapsed_ = 10 * (i + 1);
+        stat.failed_ = i % 5 == 0;
+        expected_total += stat.elapsed_;
+        snapshot.add(&stat, config, tick_clock);
+    }
+    EXPECT_GT(snapshot.getEachStats().size(), 4u);
+
+    snapshot.rollUp(30000);
+    ASSERT_EQ(snapshot.getEachStats().size(), 4u) << "two URLs in two 30s ticks";
+    int64_t total = 0;
+    int32_t samples = 0;
+    int32_t failed = 0;
+    for (const auto& [key, each] : snapshot.getEachStats()) {
+        EXPECT_EQ(each->tick() % 30000, 0);
+        EXPECT_EQ(each->tick(), key.tick_);
+        total += each->getTotalHistogram().total();
+        samples += sample_count(each->getTotalHistogram());
+        failed += sample_count(each->getFailHistogram());
+    }
+    EXPECT_EQ(total, expected_total);
+    EXPECT_EQ(samples, 20);
+    EXPECT_EQ(failed, 4);
+}
+
+// Test that takeSnapshot rolls a 1s tick up to the collector's 30s ticks
+TEST_F(UrlStatTest, FineTickRolledUpOnSnapshotTest) {
+    mock_agent_service_->mutableConfig()->http.url_stat.enable_trim_path = false;
+    mock_agent_service_->mutableConfig()->http.url_stat.tick_interval_ms = 1000;
+    UrlStats url_stats(mock_agent_service_.get());
+    EXPECT_EQ(url_stats.getTickClock().intervalMillis(), 1000);
+    const auto base = std::chrono::system_clock::time_point(std::chrono::milliseconds(1'700'000'010'000));
+
+    for (int i = 0; i < 10; i++) {
+        UrlStatEntry stat("/fine", "GET", 200);
+        stat.end_time_ = base + std::chrono::seconds(i);
+        stat.elapsed_ = 100;
+        url_stats.recordUrlStat(stat);
+    }
+
+    const auto snapshot = url_stats.takeSnapshot();
+    ASSERT_EQ(snapshot->getEachStats().size(), 1u);
+    const auto& each = snapshot->getEachStats().begin()->second;
+    EXPECT_EQ(each->tick(), 1'700'000'010'000 - 1'700'000'010'000 % 30000);
+    EXPECT_EQ(each->getTotalHistogram().total(), 1000);
+    EXPECT_EQ(sample_count(each->getTotalHistogram()), 10);
+}
+
+// Test that a fine tick does not shrink the number of URLs UrlStatLimit admits
+TEST_F(UrlStatTest, FineTickLimitCountsUrlsTest) {
+    mock_agent_service_->mutableConfig()->http.url_stat.enable_trim_path = false;
+    mock_agent_service_->mutableConfig()->http.url_stat.tick_interval_ms = 1000;
+    mock_agent_service_->mutableConfig()->http.url_stat.limit = 2;
+    UrlStats url_stats(mock_agent_service_.get());
+    const auto base = std::chrono::system_clock::time_point(std::chrono::milliseconds(1'700'000'010'000));
+
+    // Two URLs seen in every 1s tick of one collector tick fill the limit exactly.
+    for (const auto* url : {"/a", "/b"}) {
+        for (int i = 0; i < 30; i++) {
+            UrlStatEntry stat(url, "GET", 200);
+            stat.end_time_ = base + std::chrono::seconds(i);
+            stat.elapsed_ = 100;
+            url_stats.recordUrlStat(stat);
+        }
+    }
+    UrlStatEntry extra("/c", "GET", 200);
+    extra.end_time_ = base;
+    extra.elapsed_ = 100;
+    url_stats.recordUrlStat(extra);
+
+    const auto snapshot = url_stats.takeSnapshot();
+    ASSERT_EQ(snapshot->getEachStats().size(), 2u);
+    for (const auto& [key, each] : snapshot->getEachStats()) {
+        EXPECT_NE(snapshot->url(key), "/c") << "A third URL is beyond the limit";
+        EXPECT_EQ(sample_count(each->getTotalHistogram()), 30) << snapshot->url(key);
+    }
+}
+
+// Test that the limit covers every tick of a send interval longer than 30s
+TEST_F(UrlStatTest, LongSendIntervalLimitCountsUrlsTest) {
+    mock_agent_service_->mutableConfig()->http.url_stat.enable_trim_path = false;
+    mock_agent_service_->mutableConfig()->http.url_stat.tick_interval_ms = 1000;
+    mock_agent_service_->mutableConfig()->http.url_stat.send_interval_ms = 60000;
+    mock_agent_service_->mutableConfig()->http.url_stat.limit = 2;
+    UrlStats url_stats(mock_agent_service_.get());
+    const auto base = std::chrono::system_clock::time_point(std::chrono::milliseconds(1'700'000'010'000));
+
+    // Two URLs seen in every 1s tick of one 60s send interval fill the limit exactly.
+    for (const auto* url : {"/a", "/b"}) {
+        for (int i = 0; i < 60; i++) {
+            UrlStatEntry stat(url, "GET", 200);
+            stat.end_time_ = base + std::chrono::seconds(i);
+            stat.elapsed_ = 100;
+            url_stats.recordUrlStat(stat);
+        }
+    }
+    UrlStatEntry extra("/c", "GET", 200);
+    extra.end_time_ = base;
+    extra.elapsed_ = 100;
+    url_stats.recordUrlStat(extra);
+
+    // Rolled up into two collector ticks per URL.
+    const auto snapshot = url_stats.takeSnapshot();
+    ASSERT_EQ(snapshot->getEachStats().size(), 4u);
+    for (const auto& [key, each] : snapshot->getEachStats()) {
+        EXPECT_NE(snapshot->url(key), "/c") << "A third URL is beyond the limit";
+        EXPECT_EQ(sample_count(each->getTotalHistogram()), 30) << snapshot->url(key);
+    }
+}
+
+// Test UrlStatSnapshot::merge sums histograms of shared keys
+TEST_F(UrlStatTest, SnapshotMergeTest) {
+    Config config;
+    TickClock tick_clock(30);
+    UrlStatSnapshot a;
+    UrlStatSnapshot b;
+    UrlStatEntry stat("/api/merge", "GET", 200);
+    stat.end_time_ = std::chrono::system_clock::now();
+    stat.elapsed_ = 50;
+    a.add(&stat, config, tick_clock);
+    stat.elapsed_ = 5000;
+    stat.failed_ = true;
+    b.add(&stat, config, tick_clock);
+
+    a.merge(b, 10);
+    EXPECT_TRUE(b.getEachStats().empty());
+    ASSERT_EQ(a.getEachStats().size(), 1u);
+    const auto& each = a.getEachStats().begin()->second;
+    EXPECT_EQ(each->getTotalHistogram().total(), 5050);
+    EXPECT_EQ(each->getTotalHistogram().max(), 5000);
+    EXPECT_EQ(each->getTotalHistogram().histogram(0), 1);
+    EXPECT_EQ(each->getTotalHistogram().histogram(6), 1);
+    EXPECT_EQ(each->getFailHistogram().total(), 5000);
 }
 
 // Test EachUrlStat separate total and fail histograms